@@ -3,6 +3,7 @@
  * @brief   Encapsulation for byte-order operations
  * @author  Nik Yan
  * @version 1.0     2014-05-10
+ * @update          2026-10-18      Fix linux host byte order and build
  */
 
 #ifndef _LITE_BYTE_ORDER_H_
@@ -10,6 +11,13 @@
 
 #include "lite_base.h"
 
+#ifdef OS_LINUX
+#include <endian.h>
+// glibc defines these as macros, they are the names of BYTEORDER here
+#undef LITTLE_ENDIAN
+#undef BIG_ENDIAN
+#endif
+
 namespace lite {
 
 typedef enum BYTEORDER
@@ -23,7 +31,12 @@ typedef enum BYTEORDER
     #define HOST_BYTEORDER     LITTLE_ENDIAN   ///< host order
     #define NETWORK_BYTEORDER  BIG_ENDIAN      ///< network order
 #elif defined(OS_LINUX)
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    #define HOST_IS_LITTLE_ENDIAN
+    #define HOST_BYTEORDER     LITTLE_ENDIAN   ///< host order
+#else
     #define HOST_BYTEORDER     BIG_ENDIAN      ///< host order
+#endif
     #define NETWORK_BYTEORDER  BIG_ENDIAN      ///< network order
 #endif
 
@@ -46,7 +59,7 @@ inline uint32_t ReverseInt(uint32_t d)
 /**
  * @brief   Reverse Long Type
  */
-inline uint64_t ReverseLog(uint64_t d) 
+inline uint64_t ReverseLong(uint64_t d) 
 { 
     return (((d & 0xff00000000000000) >> 56) |
             ((d & 0x00ff000000000000) >> 40) |
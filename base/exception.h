@@ -18,6 +18,7 @@
 
 #ifdef OS_LINUX
 #include <execinfo.h>
+#include <cxxabi.h>
 #endif
 
 
@@ -3,6 +3,7 @@
  * @brief   This is the base header file of the lite cpplib
  * @author  Nik Yan
  * @version 1.0     2014-05-10
+ * @update          2026-10-18      Include string.h on linux
  */
 
 
@@ -65,6 +66,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <assert.h>
+#include <string.h>
 #include <string>
 #include <map>
 #include <list>
@@ -0,0 +1,430 @@
+/**
+ * @file    benchmark\contention_benchmark.cpp
+ * @brief   Contention scaling of shared structures from 1 to 64 threads:
+ *          WorkQueue::QueueWork, IOCP_IoContextPool Get/Put, IOCP_SocketContextPool::GetActiveContext,
+ *          async Logger push, and cache lookups(map behind a Mutex against ConcurrentCache).
+ *          Threads are pinned to cores round robin.
+ *          Reports throughput, sampled per-op latency, cycles per op and context switches.
+ *          Usage: contention_benchmark [-label name] [-json file] [-threads max] [-filter text]
+ *          Build: cl /O2 /EHsc /I.. /I..\event contention_benchmark.cpp
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ * @update          2026-10-18      Add cache lookups
+ */
+
+#include "base/lite_base.h"
+#include "event/event.h"
+#include "event/thread.h"
+#include "network/iocp_base.h"
+#include "tools/work_queue.h"
+#include "tools/logger.h"
+#include "tools/micro_benchmark.h"
+#include "tools/cache.h"
+#include <winternl.h>
+
+#define CONTENTION_TOTAL_OPS        (256 * 1024)    ///> Operations of all threads in one run
+#define CONTENTION_SAMPLE_EVERY     (16)            ///> One op of every 16 is timed for latency
+#define CONTENTION_MAX_THREADS      (64)
+#define CONTENTION_ACTIVE_SOCKETS   (1024)
+#define CONTENTION_CACHE_KEYS       (64 * 1024)
+#define CONTENTION_CACHE_PUT_EVERY  (64)            ///> One lookup of every 64 also stores
+
+/**
+ * @brief   Thread information of NtQuerySystemInformation(SystemProcessInformation),
+ *          winternl.h does not declare the thread array that follows each process entry
+ */
+typedef struct _CONTENTION_THREAD_INFORMATION
+{
+    LARGE_INTEGER   KernelTime;
+    LARGE_INTEGER   UserTime;
+    LARGE_INTEGER   CreateTime;
+    ULONG           WaitTime;
+    PVOID           StartAddress;
+    HANDLE          UniqueProcess;
+    HANDLE          UniqueThread;
+    LONG            Priority;
+    LONG            BasePriority;
+    ULONG           ContextSwitches;
+    ULONG           ThreadState;
+    ULONG           WaitReason;
+} CONTENTION_THREAD_INFORMATION;
+
+typedef NTSTATUS (WINAPI *NTQUERYSYSTEMINFORMATION)(SYSTEM_INFORMATION_CLASS, PVOID, ULONG, PULONG);
+
+/**
+ * @brief   Context switches of all threads of this process, 0 if not available
+ *          Windows has no user mode access to cache miss counters(perf_event_open on linux),
+ *          cycles per op from QueryThreadCycleTime is reported instead
+ */
+uint64_t ProcessContextSwitches()
+{
+    static NTQUERYSYSTEMINFORMATION query = (NTQUERYSYSTEMINFORMATION)GetProcAddress(GetModuleHandleA("ntdll.dll"), "NtQuerySystemInformation");
+    if (NULL == query)
+    {
+        return 0;
+    }
+
+    ULONG          size = 1024 * 1024;
+    vector<char>   buf;
+    NTSTATUS       status;
+    do
+    {
+        buf.resize(size);
+        status = query(SystemProcessInformation, &buf[0], size, &size);
+        size  *= 2;
+    }
+    while ((NTSTATUS)0xC0000004L == status);   // STATUS_INFO_LENGTH_MISMATCH
+    if (status < 0)
+    {
+        return 0;
+    }
+
+    HANDLE   pid = (HANDLE)(ULONG_PTR)GetCurrentProcessId();
+    char*    ptr = &buf[0];
+    while (true)
+    {
+        SYSTEM_PROCESS_INFORMATION* proc = (SYSTEM_PROCESS_INFORMATION*)ptr;
+        if (proc->UniqueProcessId == pid)
+        {
+            uint64_t                        switches = 0;
+            CONTENTION_THREAD_INFORMATION*  threads  = (CONTENTION_THREAD_INFORMATION*)(proc + 1);
+            for (ULONG i = 0; i < proc->NumberOfThreads; i++)
+            {
+                switches += threads[i].ContextSwitches;
+            }
+            return switches;
+        }
+        if (0 == proc->NextEntryOffset)
+        {
+            return 0;
+        }
+        ptr += proc->NextEntryOffset;
+    }
+}
+
+class ContentionThread;
+
+/**
+ * @brief   Operation of a target, index is the op number of the thread
+ */
+typedef void (*CONTENTIONOPFUNC)(ContentionThread* thread, uint64_t index);
+
+/**
+ * @brief   Pinned worker doing ops_ operations after the start event, latency sampled into its own histogram
+ */
+class ContentionThread : public Thread
+{
+public:
+    ContentionThread()
+        : Thread("<contention>")
+        , arg_(NULL)
+        , ops_(0)
+        , cycles_(0)
+        , id_(0)
+        , cpu_(0)
+        , func_(NULL)
+        , start_event_(NULL)
+    {
+    }
+
+    void Setup(CONTENTIONOPFUNC func, void* arg, Event* start_event, uint64_t ops, uint32_t id, int cpu)
+    {
+        id_          = id;
+        func_        = func;
+        arg_         = arg;
+        start_event_ = start_event;
+        ops_         = ops;
+        cpu_         = cpu;
+        cycles_      = 0;
+        latency_ns_.Reset();
+    }
+
+    void*               arg_;
+    uint64_t            ops_;
+    uint64_t            cycles_;                ///> CPU cycles of this thread for the ops
+    uint32_t            id_;                    ///> Index of the thread in a run
+    int                 cpu_;
+    LatencyHistogram    latency_ns_;
+
+protected:
+    virtual uint32_t _Run()
+    {
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu_);
+        start_event_->Wait();
+
+        ULONG64 cycles_start = 0;
+        ULONG64 cycles_end   = 0;
+        QueryThreadCycleTime(GetCurrentThread(), &cycles_start);
+        for (uint64_t i = 0; i < ops_; i++)
+        {
+            if (0 == i % CONTENTION_SAMPLE_EVERY)
+            {
+                uint64_t start = GetMonotonicNanoSecond();
+                func_(this, i);
+                latency_ns_.Record(GetMonotonicNanoSecond() - start);
+            }
+            else
+            {
+                func_(this, i);
+            }
+        }
+        QueryThreadCycleTime(GetCurrentThread(), &cycles_end);
+        cycles_ = cycles_end - cycles_start;
+        return 0;
+    }
+
+private:
+    CONTENTIONOPFUNC    func_;
+    Event*              start_event_;
+};
+
+/**
+ * @brief   WorkQueue target, works are allocated before the run and the queue is not started,
+ *          so only QueueWork is measured
+ */
+struct QueueWorkTarget
+{
+    WorkQueue       queue_;
+    vector<Work*>   works_[CONTENTION_MAX_THREADS];    ///> Works of each thread
+};
+
+void OpQueueWork(ContentionThread* thread, uint64_t index)
+{
+    QueueWorkTarget* target = (QueueWorkTarget*)thread->arg_;
+    target->queue_.QueueWork(target->works_[thread->id_][index]);
+}
+
+void OpIoContextPool(ContentionThread* thread, uint64_t index)
+{
+    IOCP_IoContextPool* pool    = (IOCP_IoContextPool*)thread->arg_;
+    IOCP_IoContext*     context = pool->GetIoContext();
+    pool->PutIoContext(context);
+}
+
+struct ActiveContextTarget
+{
+    IOCP_SocketContextPool* pool_;
+    unsigned long           first_id_;
+};
+
+void OpGetActiveContext(ContentionThread* thread, uint64_t index)
+{
+    ActiveContextTarget*  target = (ActiveContextTarget*)thread->arg_;
+    unsigned long         id     = target->first_id_ + (unsigned long)((index * 7 + thread->cpu_) % CONTENTION_ACTIVE_SOCKETS);
+    IOCP_SocketContextPtr sock_context = target->pool_->GetActiveContext(id);
+    BenchmarkKeep(NULL == sock_context.get() ? 0 : sock_context->sock_id_);
+}
+
+void OpLoggerPush(ContentionThread* thread, uint64_t index)
+{
+    ((Logger*)thread->arg_)->Info("contention line %llu", (unsigned long long)index);
+}
+
+/**
+ * @brief   Cache as services build it without a cache component
+ */
+struct MapCacheTarget
+{
+    map<uint64_t, uint64_t> map_;
+    Mutex                   mutex_;
+};
+
+typedef ConcurrentCache<uint64_t, uint64_t> ContentionCache;
+
+uint64_t CacheKey(ContentionThread* thread, uint64_t index)
+{
+    return (index * 2654435761u + thread->id_) % CONTENTION_CACHE_KEYS;
+}
+
+void OpMapMutexGet(ContentionThread* thread, uint64_t index)
+{
+    MapCacheTarget* target = (MapCacheTarget*)thread->arg_;
+    uint64_t        key    = CacheKey(thread, index);
+    MutexLock       lock(target->mutex_);
+    map<uint64_t, uint64_t>::iterator it = target->map_.find(key);
+    BenchmarkKeep(target->map_.end() == it ? 0 : it->second);
+    if (0 == index % CONTENTION_CACHE_PUT_EVERY)
+    {
+        target->map_[key] = index;
+    }
+}
+
+void OpCacheGet(ContentionThread* thread, uint64_t index)
+{
+    ContentionCache* cache = (ContentionCache*)thread->arg_;
+    uint64_t         key   = CacheKey(thread, index);
+    uint64_t         value = 0;
+    cache->Get(key, value);
+    BenchmarkKeep(value);
+    if (0 == index % CONTENTION_CACHE_PUT_EVERY)
+    {
+        cache->Put(key, index, sizeof(uint64_t));
+    }
+}
+
+/**
+ * @brief   Run op on num_threads pinned threads, add result with latency, cycles and context switches
+ */
+void RunScaling(MicroBenchmark& bench, ContentionThread* threads, const char* name, uint32_t num_threads, uint32_t num_cpus,
+                CONTENTIONOPFUNC func, void* arg)
+{
+    Event    start_event;
+    uint64_t ops = CONTENTION_TOTAL_OPS / num_threads;
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        threads[i].Setup(func, arg, &start_event, ops, i, (int)(i % num_cpus));
+        threads[i].Start();
+    }
+    Sleep(20);
+
+    uint64_t switches_start = ProcessContextSwitches();
+    uint64_t start          = GetMonotonicNanoSecond();
+    start_event.Signal();
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        threads[i].Stop();
+    }
+    uint64_t elapsed  = GetMonotonicNanoSecond() - start;
+    uint64_t switches = ProcessContextSwitches() - switches_start;
+
+    LatencyHistogram* latency_ns = new LatencyHistogram;
+    uint64_t          cycles     = 0;
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        latency_ns->Merge(threads[i].latency_ns_);
+        cycles += threads[i].cycles_;
+    }
+
+    char result_name[128];
+    sprintf(result_name, "%s/threads:%u", name, num_threads);
+    bench.AddResult(result_name, ops * num_threads, elapsed, latency_ns);
+    bench.AddCounter("cycles_per_op", (double)cycles / (ops * num_threads));
+    bench.AddCounter("context_switches", (double)switches);
+    delete latency_ns;
+}
+
+bool Selected(const string& name, const string& filter)
+{
+    return filter.empty() || string::npos != name.find(filter);
+}
+
+int main(int argc, char* argv[])
+{
+    string   label;
+    string   json_path;
+    string   filter;
+    uint32_t max_threads = CONTENTION_MAX_THREADS;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string arg = argv[i];
+        if ("-label" == arg)
+        {
+            label = argv[i + 1];
+        }
+        else if ("-json" == arg)
+        {
+            json_path = argv[i + 1];
+        }
+        else if ("-threads" == arg)
+        {
+            max_threads = (uint32_t)atoi(argv[i + 1]);
+        }
+        else if ("-filter" == arg)
+        {
+            filter = argv[i + 1];
+        }
+    }
+    if (0 == max_threads || max_threads > CONTENTION_MAX_THREADS)
+    {
+        max_threads = CONTENTION_MAX_THREADS;
+    }
+
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    uint32_t num_cpus = si.dwNumberOfProcessors > 64 ? 64 : si.dwNumberOfProcessors;
+
+    MicroBenchmark    bench(label);
+    ContentionThread* threads = new ContentionThread[CONTENTION_MAX_THREADS];
+
+    for (uint32_t n = 1; n <= max_threads; n *= 2)
+    {
+        if (Selected("workqueue", filter))
+        {
+            QueueWorkTarget* target = new QueueWorkTarget;
+            for (uint32_t i = 0; i < n; i++)
+            {
+                for (uint64_t j = 0; j < CONTENTION_TOTAL_OPS / n; j++)
+                {
+                    target->works_[i].push_back(new Work);
+                }
+            }
+            RunScaling(bench, threads, "workqueue/queue_work", n, num_cpus, OpQueueWork, target);
+            target->queue_.Flush(true);
+            delete target;
+        }
+
+        if (Selected("io_context_pool", filter))
+        {
+            IOCP_IoContextPool* pool = new IOCP_IoContextPool(MEM_POOL_SIZE);
+            RunScaling(bench, threads, "io_context_pool/get_put", n, num_cpus, OpIoContextPool, pool);
+            delete pool;
+        }
+
+        if (Selected("socket_context_pool", filter))
+        {
+            IOCP_IoContextPool*     pool_io   = new IOCP_IoContextPool(MEM_POOL_SIZE);
+            ActiveContextTarget     target;
+            target.pool_     = new IOCP_SocketContextPool(pool_io, 2 * CONTENTION_ACTIVE_SOCKETS);
+            target.first_id_ = 1;
+            for (unsigned long i = 0; i < CONTENTION_ACTIVE_SOCKETS; i++)
+            {
+                IOCP_SocketContextPtr sock_context = target.pool_->GetSocketContext();
+                sock_context->sock_id_ = target.first_id_ + i;
+                target.pool_->AddActiveContext(sock_context);
+            }
+            RunScaling(bench, threads, "socket_context_pool/get_active", n, num_cpus, OpGetActiveContext, &target);
+            target.pool_->ClearActiveContext();
+            delete target.pool_;
+            delete pool_io;
+        }
+
+        if (Selected("logger", filter))
+        {
+            CreateDirectoryA("bench_log", NULL);
+            Logger* logger = new Logger;
+            logger->SetModule("contention");
+            logger->SetPath("bench_log");
+            logger->SetOutputToScreen(false);
+            logger->SetOutputToFile(true);
+            logger->SetBackgroundRunning(true);
+            RunScaling(bench, threads, "logger/async_push", n, num_cpus, OpLoggerPush, logger);
+            logger->Flush();
+            logger->SetBackgroundRunning(false);
+            delete logger;
+        }
+
+        if (Selected("cache", filter))
+        {
+            MapCacheTarget*  target = new MapCacheTarget;
+            ContentionCache* cache  = new ContentionCache(CONTENTION_CACHE_KEYS * sizeof(uint64_t) * 2);
+            for (uint64_t key = 0; key < CONTENTION_CACHE_KEYS; key++)
+            {
+                target->map_[key] = key;
+                cache->Put(key, key, sizeof(uint64_t));
+            }
+            RunScaling(bench, threads, "cache/map_mutex_get", n, num_cpus, OpMapMutexGet, target);
+            RunScaling(bench, threads, "cache/concurrent_cache_get", n, num_cpus, OpCacheGet, cache);
+            delete cache;
+            delete target;
+        }
+    }
+
+    bench.Print();
+    delete[] threads;
+    if (!json_path.empty() && !bench.SaveJson(json_path.c_str()))
+    {
+        fprintf(stderr, "Save %s failed\n", json_path.c_str());
+        return 1;
+    }
+    return 0;
+}
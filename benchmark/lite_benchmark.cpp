@@ -0,0 +1,527 @@
+/**
+ * @file    benchmark\lite_benchmark.cpp
+ * @brief   Microbenchmarks of ByteStream, Mutex, Event, WorkQueue, ring queues and Logger
+ *          Usage: lite_benchmark [-label name] [-json file] [-time ms] [-filter text]
+ *          Build: cl /O2 /EHsc /I.. /I..\event lite_benchmark.cpp
+ *          Add /DLITE_ALLOC_TRACKING to report allocations per op and of each component
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ * @update          2026-10-18      Add allocation tracking
+ *                                  Add ring queues
+ */
+
+#ifdef LITE_ALLOC_TRACKING
+#define LITE_ALLOC_TRACKING_IMPL
+#endif
+
+#include "base/lite_base.h"
+#include "event/event.h"
+#include "event/mutex_lock.h"
+#include "event/thread.h"
+#include "tools/byte_stream.h"
+#include "tools/work_queue.h"
+#include "tools/ring_queue.h"
+#include "tools/logger.h"
+#include "tools/micro_benchmark.h"
+
+#define BENCH_BATCH             (1024)          ///> Values encoded before the stream is rewound
+#define BENCH_LATENCY_SAMPLES   (20000)
+#define BENCH_QUEUE_WORKS       (100000)        ///> Works of all producers in a throughput run
+#define BENCH_MAX_THREADS       (8)
+#define BENCH_RING_SIZE         (4096)
+#define BENCH_RING_VALUES       (4000000)       ///> Values of all producers in a ring run
+
+/**
+ * @brief   Encode/decode one value of each width
+ */
+inline void PutValue(ByteStream& bs, uint8_t value)  { bs.PutUint8(value);  }
+inline void PutValue(ByteStream& bs, uint16_t value) { bs.PutUint16(value); }
+inline void PutValue(ByteStream& bs, uint32_t value) { bs.PutUint32(value); }
+inline void PutValue(ByteStream& bs, uint64_t value) { bs.PutUint64(value); }
+inline void GetValue(ByteStream& bs, uint8_t& value)  { value = bs.GetUint8();  }
+inline void GetValue(ByteStream& bs, uint16_t& value) { value = bs.GetUint16(); }
+inline void GetValue(ByteStream& bs, uint32_t& value) { value = bs.GetUint32(); }
+inline void GetValue(ByteStream& bs, uint64_t& value) { value = bs.GetUint64(); }
+
+template <typename T>
+void BenchEncode(uint64_t iterations, void* arg)
+{
+    ByteStream bs(BENCH_BATCH * sizeof(T));
+    bs.SetByteOrder(*(BYTEORDER*)arg);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        if (0 == i % BENCH_BATCH)
+        {
+            bs.SetWritePtr(0);
+        }
+        PutValue(bs, (T)i);
+    }
+    BenchmarkKeep(bs.GetWritePtr());
+}
+
+template <typename T>
+void BenchDecode(uint64_t iterations, void* arg)
+{
+    ByteStream bs(BENCH_BATCH * sizeof(T));
+    bs.SetByteOrder(*(BYTEORDER*)arg);
+    for (uint32_t i = 0; i < BENCH_BATCH; i++)
+    {
+        PutValue(bs, (T)i);
+    }
+    uint64_t sum   = 0;
+    T        value = 0;
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        if (0 == i % BENCH_BATCH)
+        {
+            bs.SetReadPtr(0);
+        }
+        GetValue(bs, value);
+        sum += value;
+    }
+    BenchmarkKeep(sum);
+}
+
+void BenchMutexUncontended(uint64_t iterations, void* arg)
+{
+    Mutex& mt = *(Mutex*)arg;
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        MutexLock lock(mt);
+    }
+}
+
+/**
+ * @brief   Thread running a function until the start event, for multi-thread benchmarks
+ */
+class BenchThread : public Thread
+{
+public:
+    typedef void (*BENCHTHREADFUNC)(BenchThread* thread);
+
+    BenchThread()
+        : Thread("<bench>")
+        , arg_(NULL)
+        , ops_(0)
+        , func_(NULL)
+        , start_event_(NULL)
+    {
+    }
+
+    void Setup(BENCHTHREADFUNC func, void* arg, Event* start_event, uint64_t ops)
+    {
+        func_        = func;
+        arg_         = arg;
+        start_event_ = start_event;
+        ops_         = ops;
+    }
+
+    void*       arg_;
+    uint64_t    ops_;
+
+protected:
+    virtual uint32_t _Run()
+    {
+        start_event_->Wait();
+        func_(this);
+        return 0;
+    }
+
+private:
+    BENCHTHREADFUNC func_;
+    Event*          start_event_;
+};
+
+/**
+ * @brief   Start threads at once and return wall time until all finished
+ * @param   start_ns    Time the threads were started, for timing work which goes on after they finish
+ */
+uint64_t RunThreads(BenchThread* threads, uint32_t num_threads, BenchThread::BENCHTHREADFUNC func, void* arg, uint64_t ops_per_thread,
+                    uint64_t* start_ns = NULL)
+{
+    Event start_event;
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        threads[i].Setup(func, arg, &start_event, ops_per_thread);
+        threads[i].Start();
+    }
+    Sleep(10);
+    uint64_t start = GetMonotonicNanoSecond();
+    if (NULL != start_ns)
+    {
+        *start_ns = start;
+    }
+    start_event.Signal();
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        threads[i].Stop();
+    }
+    return GetMonotonicNanoSecond() - start;
+}
+
+void MutexContendedThread(BenchThread* thread)
+{
+    Mutex& mt = *(Mutex*)thread->arg_;
+    for (uint64_t i = 0; i < thread->ops_; i++)
+    {
+        MutexLock lock(mt);
+    }
+}
+
+/**
+ * @brief   Ping-pong between main thread and a waiter, the waiter records signal-to-wake time
+ */
+struct EventPingPong
+{
+    Event               ping_;
+    Event               pong_;
+    volatile uint64_t   signal_ns_;
+    uint32_t            samples_;
+    LatencyHistogram    latency_ns_;
+};
+
+void EventWaiterThread(BenchThread* thread)
+{
+    EventPingPong& pp = *(EventPingPong*)thread->arg_;
+    for (uint32_t i = 0; i < pp.samples_; i++)
+    {
+        pp.ping_.Wait();
+        uint64_t now = GetMonotonicNanoSecond();
+        pp.ping_.Reset();
+        pp.latency_ns_.Record(now - pp.signal_ns_);
+        pp.pong_.Signal();
+    }
+}
+
+/**
+ * @brief   Work carrying its enqueue time
+ */
+struct BenchWork : public Work
+{
+    uint64_t    enqueue_ns_;
+};
+
+struct WorkQueueBench
+{
+    WorkQueue           queue_;
+    Mutex               mt_;
+    LatencyHistogram    latency_ns_;
+    volatile LONG       executed_;
+};
+
+void BenchWorkFunc(Work* work)
+{
+    uint64_t        now   = GetMonotonicNanoSecond();
+    BenchWork*      bench = (BenchWork*)work;
+    WorkQueueBench& wq    = *(WorkQueueBench*)work->user_ptr_;
+    {
+        MutexLock lock(wq.mt_);
+        wq.latency_ns_.Record(now - bench->enqueue_ns_);
+    }
+    InterlockedIncrement(&wq.executed_);
+    delete bench;
+}
+
+void WorkProducerThread(BenchThread* thread)
+{
+    WorkQueueBench& wq = *(WorkQueueBench*)thread->arg_;
+    for (uint64_t i = 0; i < thread->ops_; i++)
+    {
+        BenchWork* work   = new BenchWork;
+        work->user_ptr_   = &wq;
+        work->work_func_  = BenchWorkFunc;
+        work->enqueue_ns_ = GetMonotonicNanoSecond();
+        wq.queue_.QueueWork(work);
+    }
+}
+
+/**
+ * @brief   Ring queues, the main thread consumes while producer threads push
+ */
+struct RingBench
+{
+    SpscRing<uint64_t>  spsc_;
+    MpscRing<uint64_t>  mpsc_;
+    MpmcRing<uint64_t>  mpmc_;
+    uint32_t            batch_;
+
+    RingBench()
+        : spsc_(BENCH_RING_SIZE)
+        , mpsc_(BENCH_RING_SIZE)
+        , mpmc_(BENCH_RING_SIZE)
+        , batch_(1)
+    {
+    }
+};
+
+void SpscProducerThread(BenchThread* thread)
+{
+    RingBench& rb = *(RingBench*)thread->arg_;
+    uint64_t   values[64];
+    for (uint64_t i = 0; i < thread->ops_; i += rb.batch_)
+    {
+        for (uint32_t j = 0; j < rb.batch_; j++)
+        {
+            values[j] = i + j;
+        }
+        for (uint32_t pushed = 0; pushed < rb.batch_;)
+        {
+            uint32_t count = rb.spsc_.PushBatch(values + pushed, rb.batch_ - pushed);
+            if (0 == count)
+            {
+                rb.spsc_.Push(values[pushed]);
+                count = 1;
+            }
+            pushed += count;
+        }
+    }
+}
+
+void MpscProducerThread(BenchThread* thread)
+{
+    RingBench& rb = *(RingBench*)thread->arg_;
+    for (uint64_t i = 0; i < thread->ops_; i++)
+    {
+        rb.mpsc_.Push(i);
+    }
+}
+
+void MpmcProducerThread(BenchThread* thread)
+{
+    RingBench& rb = *(RingBench*)thread->arg_;
+    for (uint64_t i = 0; i < thread->ops_; i++)
+    {
+        rb.mpmc_.Push(i);
+    }
+}
+
+/**
+ * @brief   Start producers, consume values on this thread and return wall time
+ */
+template <typename RING>
+uint64_t ConsumeRing(BenchThread* threads, uint32_t num_threads, BenchThread::BENCHTHREADFUNC func,
+                     RingBench* rb, RING& ring, uint64_t ops_per_thread)
+{
+    Event start_event;
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        threads[i].Setup(func, rb, &start_event, ops_per_thread);
+        threads[i].Start();
+    }
+    Sleep(10);
+    uint64_t start  = GetMonotonicNanoSecond();
+    uint64_t values[64];
+    uint64_t sum    = 0;
+    start_event.Signal();
+    for (uint64_t consumed = 0; consumed < ops_per_thread * num_threads;)
+    {
+        uint32_t count = ring.PopBatch(values, 64);
+        if (0 == count)
+        {
+            ring.Pop(values[0]);
+            count = 1;
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            sum += values[i];
+        }
+        consumed += count;
+    }
+    uint64_t elapsed = GetMonotonicNanoSecond() - start;
+    for (uint32_t i = 0; i < num_threads; i++)
+    {
+        threads[i].Stop();
+    }
+    BenchmarkKeep(sum);
+    return elapsed;
+}
+
+void LoggerThread(BenchThread* thread)
+{
+    Logger& logger = *(Logger*)thread->arg_;
+    for (uint64_t i = 0; i < thread->ops_; i++)
+    {
+        logger.Info("benchmark line %llu with some payload text", (unsigned long long)i);
+    }
+}
+
+bool Selected(const string& name, const string& filter)
+{
+    return filter.empty() || string::npos != name.find(filter);
+}
+
+int main(int argc, char* argv[])
+{
+    string   label;
+    string   json_path;
+    string   filter;
+    uint32_t min_time_ms = 200;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string arg = argv[i];
+        if ("-label" == arg)
+        {
+            label = argv[i + 1];
+        }
+        else if ("-json" == arg)
+        {
+            json_path = argv[i + 1];
+        }
+        else if ("-time" == arg)
+        {
+            min_time_ms = (uint32_t)atoi(argv[i + 1]);
+        }
+        else if ("-filter" == arg)
+        {
+            filter = argv[i + 1];
+        }
+    }
+
+#ifdef LITE_ALLOC_TRACKING
+    AllocTracker::Instance().Enable(true);
+#endif
+    MicroBenchmark bench(label);
+    bench.SetMinTime(min_time_ms);
+    BenchThread    threads[BENCH_MAX_THREADS];
+
+    // ByteStream encode/decode per field type and byte order
+    BYTEORDER   orders[2]      = { HOST_BYTEORDER, NETWORK_BYTEORDER };
+    const char* order_names[2] = { "host", "network" };
+    for (int i = 0; i < 2; i++)
+    {
+        string suffix = string("/") + order_names[i];
+        if (Selected("bytestream", filter))
+        {
+            bench.Run("bytestream/put_uint8"  + suffix, BenchEncode<uint8_t>,  &orders[i]);
+            bench.Run("bytestream/put_uint16" + suffix, BenchEncode<uint16_t>, &orders[i]);
+            bench.Run("bytestream/put_uint32" + suffix, BenchEncode<uint32_t>, &orders[i]);
+            bench.Run("bytestream/put_uint64" + suffix, BenchEncode<uint64_t>, &orders[i]);
+            bench.Run("bytestream/get_uint8"  + suffix, BenchDecode<uint8_t>,  &orders[i]);
+            bench.Run("bytestream/get_uint16" + suffix, BenchDecode<uint16_t>, &orders[i]);
+            bench.Run("bytestream/get_uint32" + suffix, BenchDecode<uint32_t>, &orders[i]);
+            bench.Run("bytestream/get_uint64" + suffix, BenchDecode<uint64_t>, &orders[i]);
+        }
+    }
+
+    // Mutex acquire, alone and with threads competing for one lock
+    if (Selected("mutex", filter))
+    {
+        Mutex mt;
+        bench.Run("mutex/uncontended", BenchMutexUncontended, &mt);
+        for (uint32_t n = 2; n <= BENCH_MAX_THREADS; n *= 2)
+        {
+            char     name[64];
+            uint64_t ops = 1000000;
+            sprintf(name, "mutex/contended/threads:%u", n);
+            uint64_t elapsed = RunThreads(threads, n, MutexContendedThread, &mt, ops);
+            bench.AddResult(name, ops * n, elapsed);
+        }
+    }
+
+    // Event signal-to-wake latency
+    if (Selected("event", filter))
+    {
+        EventPingPong* pp = new EventPingPong;
+        Event          go;
+        pp->samples_ = BENCH_LATENCY_SAMPLES;
+        go.Signal();
+        threads[0].Setup(EventWaiterThread, pp, &go, 0);
+        threads[0].Start();
+        uint64_t start = GetMonotonicNanoSecond();
+        for (uint32_t i = 0; i < pp->samples_; i++)
+        {
+            pp->signal_ns_ = GetMonotonicNanoSecond();
+            pp->ping_.Signal();
+            pp->pong_.Wait();
+            pp->pong_.Reset();
+        }
+        uint64_t elapsed = GetMonotonicNanoSecond() - start;
+        threads[0].Stop();
+        bench.AddResult("event/signal_to_wake", pp->samples_, elapsed, &pp->latency_ns_);
+        delete pp;
+    }
+
+    // WorkQueue enqueue-to-execute latency and throughput across producers
+    if (Selected("workqueue", filter))
+    {
+        for (uint32_t n = 1; n <= BENCH_MAX_THREADS; n *= 2)
+        {
+            WorkQueueBench* wq = new WorkQueueBench;
+            wq->executed_      = 0;
+            wq->queue_.Start();
+            uint64_t ops   = BENCH_QUEUE_WORKS / n;
+            uint64_t start = 0;
+            RunThreads(threads, n, WorkProducerThread, wq, ops, &start);
+            while ((uint64_t)wq->executed_ < ops * n)
+            {
+                Sleep(1);
+            }
+            uint64_t elapsed = GetMonotonicNanoSecond() - start;
+            wq->queue_.Signal();
+            wq->queue_.Stop();
+
+            char name[64];
+            sprintf(name, "workqueue/enqueue_to_execute/producers:%u", n);
+            bench.AddResult(name, ops * n, elapsed, &wq->latency_ns_);
+            delete wq;
+        }
+    }
+
+    // Ring queues, values per second from producers to one consumer
+    if (Selected("ring", filter))
+    {
+        RingBench* rb = new RingBench;
+        for (uint32_t batch = 1; batch <= 64; batch *= 64)
+        {
+            char name[64];
+            rb->batch_       = batch;
+            uint64_t elapsed = ConsumeRing(threads, 1, SpscProducerThread, rb, rb->spsc_, BENCH_RING_VALUES);
+            sprintf(name, "ring/spsc/batch:%u", batch);
+            bench.AddResult(name, BENCH_RING_VALUES, elapsed);
+        }
+        for (uint32_t n = 1; n <= BENCH_MAX_THREADS; n *= 2)
+        {
+            char     name[64];
+            uint64_t ops     = BENCH_RING_VALUES / n;
+            uint64_t elapsed = ConsumeRing(threads, n, MpscProducerThread, rb, rb->mpsc_, ops);
+            sprintf(name, "ring/mpsc/producers:%u", n);
+            bench.AddResult(name, ops * n, elapsed);
+            elapsed = ConsumeRing(threads, n, MpmcProducerThread, rb, rb->mpmc_, ops);
+            sprintf(name, "ring/mpmc/producers:%u", n);
+            bench.AddResult(name, ops * n, elapsed);
+        }
+        delete rb;
+    }
+
+    // Logger lines per second to file, sync and async
+    if (Selected("logger", filter))
+    {
+        CreateDirectoryA("bench_log", NULL);
+        for (int async = 0; async < 2; async++)
+        {
+            Logger* logger = new Logger;
+            logger->SetModule("bench");
+            logger->SetPath("bench_log");
+            logger->SetOutputToScreen(false);
+            logger->SetOutputToFile(true);
+            logger->SetBackgroundRunning(0 != async);
+            uint64_t ops     = 20000;
+            uint64_t elapsed = RunThreads(threads, 1, LoggerThread, logger, ops);
+            logger->Flush();
+            logger->SetBackgroundRunning(false);
+            bench.AddResult(async ? "logger/async/lines" : "logger/sync/lines", ops, elapsed);
+            delete logger;
+        }
+    }
+
+    bench.Print();
+#ifdef LITE_ALLOC_TRACKING
+    AllocTracker::Instance().Report();
+#endif
+    if (!json_path.empty() && !bench.SaveJson(json_path.c_str()))
+    {
+        fprintf(stderr, "Save %s failed\n", json_path.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,247 @@
+/**
+ * @file    benchmark\load_generator.cpp
+ * @brief   Open-loop load generator for servers built on this library, see network\load_generator.h
+ *          With -workers n, n worker processes of this program each send rate/n requests over
+ *          connections/n connections, the parent merges their results into one report.
+ *          UDP servers must echo the first 8 bytes of each request, which carry its sequence number.
+ *          Usage: load_generator -host ip -port n [-proto tcp|udp] [-connections n] [-rate n]
+ *                                [-duration ms] [-drain ms] [-size bytes] [-response bytes] [-workers n]
+ *          Build: cl /O2 /EHsc /I.. /I..\event load_generator.cpp
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ */
+
+#include "base/lite_base.h"
+#include "network/load_generator.h"
+
+#define LOADGEN_MAX_WORKERS     (MAXIMUM_WAIT_OBJECTS)
+
+/**
+ * @brief   Options of the command line, worker processes get the same ones with their share
+ */
+struct LoadGenOptions
+{
+    LoadGenConfig   config_;
+    uint32_t        size_;                          ///> Request size
+    uint32_t        workers_;
+    string          out_path_;                      ///> Set for a worker process, result is saved there
+
+    LoadGenOptions() : size_(64), workers_(1)
+    {
+        config_.dst_ip_ = "127.0.0.1";
+    }
+};
+
+bool ParseOptions(int argc, char* argv[], LoadGenOptions& options)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string arg   = argv[i];
+        string value = argv[i + 1];
+        if ("-host" == arg)
+        {
+            options.config_.dst_ip_ = value;
+        }
+        else if ("-port" == arg)
+        {
+            options.config_.dst_port_ = (UINT16)atoi(value.c_str());
+        }
+        else if ("-proto" == arg)
+        {
+            options.config_.udp_ = ("udp" == value);
+        }
+        else if ("-connections" == arg)
+        {
+            options.config_.connections_ = (uint32_t)atoi(value.c_str());
+        }
+        else if ("-rate" == arg)
+        {
+            options.config_.rate_ = (uint32_t)atoi(value.c_str());
+        }
+        else if ("-duration" == arg)
+        {
+            options.config_.duration_ms_ = (uint32_t)atoi(value.c_str());
+        }
+        else if ("-drain" == arg)
+        {
+            options.config_.drain_ms_ = (uint32_t)atoi(value.c_str());
+        }
+        else if ("-size" == arg)
+        {
+            options.size_ = (uint32_t)atoi(value.c_str());
+        }
+        else if ("-response" == arg)
+        {
+            options.config_.response_size_ = (uint32_t)atoi(value.c_str());
+        }
+        else if ("-workers" == arg)
+        {
+            options.workers_ = (uint32_t)atoi(value.c_str());
+        }
+        else if ("-out" == arg)
+        {
+            options.out_path_ = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    if (0 == options.config_.dst_port_ || 0 == options.size_ || 0 == options.workers_)
+    {
+        return false;
+    }
+    if (options.workers_ > LOADGEN_MAX_WORKERS)
+    {
+        options.workers_ = LOADGEN_MAX_WORKERS;
+    }
+    if (options.workers_ > options.config_.connections_)
+    {
+        options.workers_ = options.config_.connections_;
+    }
+    options.config_.request_.assign(options.size_, 'x');
+    return true;
+}
+
+/**
+ * @brief   Share of worker index when total is divided by count
+ */
+uint32_t Share(uint32_t total, uint32_t count, uint32_t index)
+{
+    return total / count + (index < total % count ? 1 : 0);
+}
+
+/**
+ * @brief   Start worker processes of this program and merge their results
+ * @return  false if a worker can not be started or its result can not be read
+ */
+bool RunWorkers(const LoadGenOptions& options, LoadGenResult& result)
+{
+    char exe_path[MAX_PATH];
+    char temp_dir[MAX_PATH];
+    if (0 == GetModuleFileNameA(NULL, exe_path, MAX_PATH) || 0 == GetTempPathA(MAX_PATH, temp_dir))
+    {
+        return false;
+    }
+
+    const LoadGenConfig& config = options.config_;
+    HANDLE               processes[LOADGEN_MAX_WORKERS];
+    vector<string>       out_paths;
+    uint32_t             started = 0;
+    for (uint32_t i = 0; i < options.workers_; i++)
+    {
+        char out_path[MAX_PATH];
+        sprintf(out_path, "%sload_generator_%u_%u.bin", temp_dir, GetCurrentProcessId(), i);
+        char cmd_line[1024];
+        sprintf(cmd_line,
+                "\"%s\" -host %s -port %u -proto %s -connections %u -rate %u -duration %u -drain %u"
+                " -size %u -response %u -out \"%s\"",
+                exe_path,
+                config.dst_ip_.c_str(),
+                config.dst_port_,
+                config.udp_ ? "udp" : "tcp",
+                Share(config.connections_, options.workers_, i),
+                Share(config.rate_, options.workers_, i),
+                config.duration_ms_,
+                config.drain_ms_,
+                options.size_,
+                config.response_size_,
+                out_path);
+
+        STARTUPINFOA        si;
+        PROCESS_INFORMATION pi;
+        ZeroMemory(&si, sizeof(si));
+        si.cb = sizeof(si);
+        if (!CreateProcessA(NULL, cmd_line, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi))
+        {
+            fprintf(stderr, "Start worker %u failed, error %u\n", i, GetLastError());
+            break;
+        }
+        CloseHandle(pi.hThread);
+        processes[started++] = pi.hProcess;
+        out_paths.push_back(out_path);
+    }
+
+    if (started > 0)
+    {
+        WaitForMultipleObjects(started, processes, TRUE, INFINITE);
+    }
+    bool ok = (started == options.workers_);
+    for (uint32_t i = 0; i < started; i++)
+    {
+        CloseHandle(processes[i]);
+        if (!result.MergeFromFile(out_paths[i].c_str()))
+        {
+            fprintf(stderr, "Read result of worker %u failed\n", i);
+            ok = false;
+        }
+        DeleteFileA(out_paths[i].c_str());
+    }
+    return ok;
+}
+
+void PrintReport(const LoadGenOptions& options, const LoadGenResult& result)
+{
+    const LoadGenConfig& config = options.config_;
+    printf("target       %s:%u %s, %u connections, %u workers\n",
+           config.dst_ip_.c_str(),
+           config.dst_port_,
+           config.udp_ ? "udp" : "tcp",
+           config.connections_,
+           options.workers_);
+    printf("rate         %u/s scheduled, %.1f/s sent, %.1f/s received\n",
+           config.rate_,
+           0 == config.duration_ms_ ? 0.0 : result.sent_ * 1000.0 / config.duration_ms_,
+           0 == config.duration_ms_ ? 0.0 : result.received_ * 1000.0 / config.duration_ms_);
+    printf("requests     sent %llu, received %llu, lost %llu, errors %llu, late sends %llu\n",
+           (unsigned long long)result.sent_,
+           (unsigned long long)result.received_,
+           (unsigned long long)(result.sent_ - min(result.sent_, result.received_)),
+           (unsigned long long)result.errors_,
+           (unsigned long long)result.late_sends_);
+    printf("latency(us)  %s\n", result.latency_.Summary().c_str());
+}
+
+int main(int argc, char* argv[])
+{
+    LoadGenOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        fprintf(stderr,
+                "Usage: load_generator -host ip -port n [-proto tcp|udp] [-connections n] [-rate n]\n"
+                "                      [-duration ms] [-drain ms] [-size bytes] [-response bytes] [-workers n]\n");
+        return 1;
+    }
+
+    WSADATA wsa_data;
+    WSAStartup(MAKEWORD(2, 2), &wsa_data);
+
+    LoadGenResult result;
+    bool          ok = false;
+    if (options.workers_ > 1 && options.out_path_.empty())
+    {
+        ok = RunWorkers(options, result);
+    }
+    else
+    {
+        LoadGenerator generator;
+        ok = generator.Run(options.config_, result);
+    }
+
+    if (!options.out_path_.empty())
+    {
+        // Worker process, the parent reports
+        if (!result.SaveToFile(options.out_path_.c_str()))
+        {
+            fprintf(stderr, "Save %s failed\n", options.out_path_.c_str());
+            ok = false;
+        }
+    }
+    else
+    {
+        PrintReport(options, result);
+    }
+
+    WSACleanup();
+    return ok ? 0 : 1;
+}
@@ -3,6 +3,8 @@
  * @brief   Encapsulation for event
  * @author  Nik Yan
  * @version 1.0     2014-06-29
+ * @update          2026-10-18      Add auto-reset event
+ *                                  Fix linux build and timed wait
  */
 
 #ifndef _LITE_EVENT_H_
@@ -26,7 +28,10 @@ namespace lite {
 class Event : private NonCopyable
 {
 public:
-    Event();
+    /**
+     * @param   manual_reset    false: a successful Wait resets the event, so one Signal wakes one waiter
+     */
+    Event(bool manual_reset = true);
 
     virtual ~Event();
 
@@ -42,8 +47,9 @@ private:
 
 #elif defined(OS_LINUX)
     pthread_mutex_t mutex_handle_;
-    pthread_coud_t  cond_;
+    pthread_cond_t  cond_;
     volatile bool   event_state_;
+    bool            manual_reset_;
 
 #else
 #endif
@@ -52,9 +58,9 @@ private:
 #ifdef OS_WIN
 
 inline
-Event::Event()
+Event::Event(bool manual_reset)
 {
-    event_handle_ = ::CreateEvent(NULL, true, false, NULL);
+    event_handle_ = ::CreateEvent(NULL, manual_reset, false, NULL);
     if (event_handle_ == NULL)
     {
         throw runtime_exception("Create event failure");
@@ -101,7 +107,7 @@ bool Event::Wait(uint32_t timeout)
 #elif defined(OS_LINUX)
 
 inline
-Event::Event() : event_state_(false)
+Event::Event(bool manual_reset) : event_state_(false), manual_reset_(manual_reset)
 {
     (void)pthread_mutex_init(&mutex_handle_, NULL);
     (void)pthread_cond_init(&cond_, NULL);
@@ -133,7 +139,14 @@ void Event::Signal()
         throw runtime_exception("Signal event failure");
     }
     event_state_ = true;
-    (void)pthread_cond_broadcast(&cond_);
+    if (manual_reset_)
+    {
+        (void)pthread_cond_broadcast(&cond_);
+    }
+    else
+    {
+        (void)pthread_cond_signal(&cond_);
+    }
     (void)pthread_mutex_unlock(&mutex_handle_);
 }
 
@@ -179,9 +192,9 @@ bool Event::Wait(uint32_t timeout)
             ts.tv_nsec -= 1000000000;
         }
 
-        while (event_state_)
+        while (!event_state_)
         {
-            if (pthread_cond_timewait(&cond_, &mutex_handle_, &ts) != 0)
+            if (pthread_cond_timedwait(&cond_, &mutex_handle_, &ts) != 0)
             {
                 (void)pthread_mutex_unlock(&mutex_handle_);
                 return false;
@@ -189,6 +202,10 @@ bool Event::Wait(uint32_t timeout)
         }
     }
 
+    if (!manual_reset_)
+    {
+        event_state_ = false;
+    }
     (void)pthread_mutex_unlock(&mutex_handle_);
     return true;
 }
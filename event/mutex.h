@@ -4,6 +4,7 @@
  * @author  Nik Yan
  * @caution Not support multi-processes
  * @version 1.0     2014-06-30
+ * @update          2026-10-18      Fix linux build of Unlock
  */
 
 #ifndef _LITE_MUTEX_H_
@@ -104,7 +105,7 @@ void Mutex::Lock()
 }
 
 inline
-void Unlock()
+void Mutex::Unlock()
 {
     pthread_mutex_unlock(&pthread_mutex_);
 }
@@ -3,6 +3,8 @@
  * @brief   Encapsulation for thread
  * @author  Nik Yan
  * @version 1.0     2014-06-30
+ * @update          2026-10-18      Fix the stop signal member name
+ *                                  Fix linux build
  */
 
 #ifndef _LITE_THREAD_H_
@@ -123,7 +125,7 @@ protected:
 #ifdef OS_WIN
         Sleep(milli_seconds);
 #elif defined(OS_LINUX)
-        usleep(milli_seconds * 1000)
+        usleep(milli_seconds * 1000);
 #endif
     }
 
@@ -222,9 +224,9 @@ bool Thread::Active() const
         return false;
     }
     int rc = pthread_kill(thread_handle_, 0);
-    return (rc 1= ESRCH && rc != EINVAL);
+    return (rc != ESRCH && rc != EINVAL);
 #else
-    return false
+    return false;
 #endif
 }
 
@@ -285,7 +287,7 @@ bool Thread::Stop(uint32_t timeout)
     bool is_alive = true;
 
     // Notity thread to stop
-    evnet_.Signal();
+    event_.Signal();
 
     while (is_alive && GetTickCount() - t1 < timeout)
     {
@@ -327,7 +329,7 @@ bool Thread::Start()
 {
     if (thread_handle_ == 0)
     {
-        ret = 0;
+        int ret = 0;
         do
         {
             pthread_attr_t thread_attr;
@@ -356,7 +358,7 @@ bool Thread::Start()
                                  &thread_attr,                      // the thread attr
                                  _threadproc,                       // the thread proc
                                  this);                             // current thread object as parameter
-            (void)pthread_attr_destroy(&thread_attr)
+            (void)pthread_attr_destroy(&thread_attr);
             id_ = static_cast<uint32_t>(thread_handle_);
         }
         while (0);
@@ -379,7 +381,7 @@ bool Thread::Stop(uint32_t timeout)
     THREAD_LOG_INFO("Stop thread: %s (id=%u)", name_.c_str(), id_);
 
     // Notity thread to stop
-    evnet_.Signal();
+    event_.Signal();
 
     if (timeout == 0xffffffff)
     {
@@ -0,0 +1,242 @@
+/**
+ * @file    network\admission_control.h
+ * @brief   Admission control of accepted TCP connections
+ *          Limits connections in total and per ip, rate of accepting, and sheds new connections
+ *          while the server is overloaded(work queue depth, latency or user check)
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ */
+
+#ifndef _LITE_ADMISSION_CONTROL_H_
+#define _LITE_ADMISSION_CONTROL_H_
+
+#include "iocp_base.h"
+#include "tools/work_queue.h"
+
+#ifdef OS_WIN
+
+namespace lite {
+
+/**
+ * @brief   Check whether server is overloaded
+ * @return  true to refuse new connections
+ * @note    Called for every accepted connection, needs to return quickly
+ */
+typedef bool (*OVERLOADCALLBACK)(void* user_ptr);
+
+/**
+ * @brief   Counters of admission control
+ */
+struct AdmissionStats
+{
+    uint64_t    accepted_;
+    uint64_t    rejected_max_;                      ///> Refused for max connections
+    uint64_t    rejected_ip_;                       ///> Refused for connections of one ip
+    uint64_t    rejected_rate_;                     ///> Refused for accept rate
+    uint64_t    rejected_overload_;                 ///> Refused for work queue, latency or user check
+    uint32_t    active_;                            ///> Admitted connections still open
+
+    AdmissionStats()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+};
+
+class IOCP_AdmissionControl : private NonCopyable
+{
+public:
+    IOCP_AdmissionControl()
+        : max_connections_(0)
+        , max_per_ip_(0)
+        , accept_rate_(0)
+        , accept_burst_(0)
+        , tokens_(0)
+        , token_tick_(0)
+        , work_queue_(NULL)
+        , max_pending_(0)
+        , max_latency_us_(0)
+        , latency_us_(0)
+        , OverloadCallback_(NULL)
+        , overload_user_ptr_(NULL)
+    {
+    }
+
+    /**
+     * @brief   Limit connections, 0 for no limit
+     */
+    void SetMaxConnections(uint32_t max_connections, uint32_t max_per_ip = 0)
+    {
+        MutexLock lock(mt_);
+        max_connections_ = max_connections;
+        max_per_ip_      = max_per_ip;
+    }
+
+    /**
+     * @brief   Limit accept rate by token bucket
+     * @param   rate    Connections per second, 0 for no limit
+     * @param   burst   Connections accepted at once after idle, 0 for rate
+     */
+    void SetAcceptRate(uint32_t rate, uint32_t burst = 0)
+    {
+        MutexLock lock(mt_);
+        accept_rate_  = rate;
+        accept_burst_ = 0 == burst ? rate : burst;
+        tokens_       = accept_burst_;
+        token_tick_   = GetTickCount();
+    }
+
+    /**
+     * @brief   Refuse connections while the work queue has more than max_pending works
+     */
+    void SetWorkQueueLimit(WorkQueue* work_queue, uint32_t max_pending)
+    {
+        MutexLock lock(mt_);
+        work_queue_  = work_queue;
+        max_pending_ = max_pending;
+    }
+
+    /**
+     * @brief   Refuse connections while the smoothed latency reported by UpdateLatency is higher
+     * @param   max_latency_us  0 for no limit
+     */
+    void SetLatencyLimit(uint32_t max_latency_us)
+    {
+        MutexLock lock(mt_);
+        max_latency_us_ = max_latency_us;
+    }
+
+    /**
+     * @brief   Report latency of a handled request, smoothed by 1/8 weight of the new value
+     */
+    void UpdateLatency(uint32_t latency_us)
+    {
+        MutexLock lock(mt_);
+        latency_us_ = 0 == latency_us_ ? latency_us : latency_us_ - latency_us_ / 8 + latency_us / 8;
+    }
+
+    /**
+     * @brief   Set user check of overload
+     */
+    void SetOverloadCallback(OVERLOADCALLBACK OverloadCallback, void* user_ptr)
+    {
+        MutexLock lock(mt_);
+        OverloadCallback_  = OverloadCallback;
+        overload_user_ptr_ = user_ptr;
+    }
+
+    /**
+     * @brief   Decide whether to keep a new connection, an admitted one must be released once
+     */
+    bool Admit(const SOCKADDR_IN& addr);
+
+    void Release(const SOCKADDR_IN& addr);
+
+    /**
+     * @brief   Release function set to socket context
+     */
+    static void ReleaseFunc(void* owner, const SOCKADDR_IN& addr)
+    {
+        ((IOCP_AdmissionControl*)owner)->Release(addr);
+    }
+
+    AdmissionStats GetStats()
+    {
+        MutexLock lock(mt_);
+        return stats_;
+    }
+
+private:
+    Mutex                   mt_;
+    uint32_t                max_connections_;
+    uint32_t                max_per_ip_;
+    uint32_t                accept_rate_;
+    uint32_t                accept_burst_;
+    uint32_t                tokens_;
+    DWORD                   token_tick_;
+    WorkQueue*              work_queue_;
+    uint32_t                max_pending_;
+    uint32_t                max_latency_us_;
+    uint32_t                latency_us_;            ///> Smoothed latency
+    OVERLOADCALLBACK        OverloadCallback_;
+    void*                   overload_user_ptr_;
+    map<ULONG, uint32_t>    map_ip_;                ///> Admitted connections of each ip
+    AdmissionStats          stats_;
+};
+
+inline
+bool IOCP_AdmissionControl::Admit(const SOCKADDR_IN& addr)
+{
+    MutexLock lock(mt_);
+
+    // Cheapest and most global checks first
+    if (0 != max_connections_ && stats_.active_ >= max_connections_)
+    {
+        stats_.rejected_max_++;
+        return false;
+    }
+    if ((NULL != work_queue_ && work_queue_->PendingCount() > max_pending_) ||
+        (0 != max_latency_us_ && latency_us_ > max_latency_us_) ||
+        (NULL != OverloadCallback_ && OverloadCallback_(overload_user_ptr_)))
+    {
+        stats_.rejected_overload_++;
+        return false;
+    }
+    if (0 != accept_rate_)
+    {
+        DWORD    now     = GetTickCount();
+        DWORD    elapsed = now - token_tick_;
+        uint64_t add     = (uint64_t)elapsed * accept_rate_ / 1000;
+        if (add > 0)
+        {
+            tokens_      = (uint32_t)(tokens_ + add > accept_burst_ ? accept_burst_ : tokens_ + add);
+            token_tick_ += (DWORD)(add * 1000 / accept_rate_);
+        }
+        if (0 == tokens_)
+        {
+            stats_.rejected_rate_++;
+            return false;
+        }
+    }
+
+    ULONG ip = addr.sin_addr.s_addr;
+    if (0 != max_per_ip_)
+    {
+        map<ULONG, uint32_t>::iterator it = map_ip_.find(ip);
+        if (it != map_ip_.end() && it->second >= max_per_ip_)
+        {
+            stats_.rejected_ip_++;
+            return false;
+        }
+    }
+
+    if (0 != accept_rate_)
+    {
+        tokens_--;
+    }
+    map_ip_[ip]++;
+    stats_.active_++;
+    stats_.accepted_++;
+    return true;
+}
+
+inline
+void IOCP_AdmissionControl::Release(const SOCKADDR_IN& addr)
+{
+    MutexLock lock(mt_);
+    map<ULONG, uint32_t>::iterator it = map_ip_.find(addr.sin_addr.s_addr);
+    if (it != map_ip_.end() && 0 == --it->second)
+    {
+        map_ip_.erase(it);
+    }
+    if (stats_.active_ > 0)
+    {
+        stats_.active_--;
+    }
+}
+
+} // end of namespace
+using namespace lite;
+
+#endif // ifdef OS_WIN
+
+#endif // ifndef _LITE_ADMISSION_CONTROL_H_
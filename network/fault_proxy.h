@@ -0,0 +1,712 @@
+/**
+ * @file    network\fault_proxy.h
+ * @brief   Loopback proxies injecting network faults for load tests
+ *          Delay, jitter, reordering, drops, partial writes and resets are decided by a seeded RNG,
+ *          the same seed with the same traffic order gives the same faults
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ * @update          2026-10-18      Reset closes with RST, items queued to closed sockets are dropped
+ */
+
+#ifndef _LITE_FAULT_PROXY_H_
+#define _LITE_FAULT_PROXY_H_
+
+#include "iocp_tcpserver.h"
+#include "iocp_tcpclient.h"
+#include "iocp_udppeer.h"
+
+#ifdef OS_WIN
+
+namespace lite {
+
+#define FAULT_TIMER_INTERVAL    (1)     ///> ms, timer resolution of Windows applies(see timeBeginPeriod)
+
+/**
+ * @brief   Faults to inject, all off by default
+ */
+struct FaultConfig
+{
+    uint32_t    delay_ms_;                          ///> Fixed delay of each chunk/datagram
+    uint32_t    jitter_ms_;                         ///> Random extra delay in [0, jitter_ms_]
+    double      drop_rate_;                         ///> UDP: probability to drop a datagram
+    double      reorder_rate_;                      ///> UDP: probability to hold a datagram back
+    uint32_t    reorder_delay_ms_;                  ///> UDP: extra delay of a held back datagram
+    uint32_t    partial_write_max_;                 ///> TCP: split data into writes of [1, max] bytes, 0 to disable
+    double      reset_rate_;                        ///> TCP: probability to reset both connections per chunk
+    uint32_t    seed_;                              ///> RNG seed
+
+    FaultConfig()
+        : delay_ms_(0)
+        , jitter_ms_(0)
+        , drop_rate_(0)
+        , reorder_rate_(0)
+        , reorder_delay_ms_(20)
+        , partial_write_max_(0)
+        , reset_rate_(0)
+        , seed_(1)
+    {
+    }
+};
+
+/**
+ * @brief   Counters of a fault proxy
+ */
+struct FaultStats
+{
+    uint64_t    forwarded_;                         ///> Chunks or datagrams forwarded
+    uint64_t    bytes_forwarded_;
+    uint64_t    dropped_;
+    uint64_t    reordered_;
+    uint64_t    partial_writes_;                    ///> Chunks split into several writes
+    uint64_t    resets_;
+
+    FaultStats()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+};
+
+/**
+ * @brief   xorshift32 generator, deterministic for a seed
+ */
+class FaultRandom
+{
+public:
+    explicit FaultRandom(uint32_t seed = 1)
+    {
+        Seed(seed);
+    }
+
+    void Seed(uint32_t seed)
+    {
+        state_ = 0 == seed ? 1 : seed;
+    }
+
+    uint32_t Next()
+    {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+
+    /**
+     * @brief   Random number in [0, n)
+     */
+    uint32_t Range(uint32_t n)
+    {
+        return 0 == n ? 0 : Next() % n;
+    }
+
+    bool Chance(double p)
+    {
+        return p > 0 && (double)Next() / 4294967296.0 < p;
+    }
+
+private:
+    uint32_t    state_;
+};
+
+class FaultProxy;
+
+/**
+ * @brief   Release delayed data when due
+ */
+class FaultProxyTimerThread : public Thread
+{
+public:
+    FaultProxyTimerThread(FaultProxy* proxy)
+        : Thread("<fault_proxy_timer>")
+        , proxy_(proxy)
+    {
+    }
+
+protected:
+    virtual uint32_t _Run();
+
+private:
+    FaultProxy*     proxy_;
+};
+
+/**
+ * @brief   Delay queue and RNG shared by TCP and UDP proxies
+ */
+class FaultProxy : private NonCopyable
+{
+    friend class FaultProxyTimerThread;
+
+public:
+    FaultProxy()
+        : seq_(0)
+        , timer_thread_(this)
+    {
+    }
+
+    virtual ~FaultProxy()
+    {
+    }
+
+    /**
+     * @brief   Change faults, RNG is seeded again
+     */
+    void SetConfig(const FaultConfig& config)
+    {
+        MutexLock lock(mt_);
+        config_ = config;
+        rand_.Seed(config.seed_);
+    }
+
+    FaultStats GetStats()
+    {
+        MutexLock lock(mt_);
+        return stats_;
+    }
+
+protected:
+    typedef enum _FAULT_ACTION
+    {
+        FAULT_SEND,
+        FAULT_CLOSE
+    }FAULT_ACTION;
+
+    struct FaultItem
+    {
+        FAULT_ACTION    action_;
+        unsigned long   sock_id_;
+        bool            upstream_;                  ///> TCP: sock_id_ is the upstream connection
+        SOCKADDR_IN     addr_;                      ///> UDP: destination
+        string          data_;
+    };
+
+    /**
+     * @brief   Fixed delay plus jitter, call with mt_ locked
+     */
+    uint64_t _NextDue()
+    {
+        return GetTickCount64() + config_.delay_ms_ + rand_.Range(config_.jitter_ms_ + 1);
+    }
+
+    /**
+     * @brief   Queue an item, items with the same due time keep the order, call with mt_ locked
+     */
+    void _Schedule(uint64_t due, const FaultItem& item)
+    {
+        map_item_.insert(make_pair(make_pair(due, seq_++), item));
+    }
+
+    /**
+     * @brief   Deliver a due item
+     */
+    virtual void _SendItem(const FaultItem& item) = 0;
+
+    /**
+     * @brief   Called by timer thread periodically
+     */
+    void _OnTimer()
+    {
+        vector<FaultItem> list_due;
+        {
+            MutexLock lock(mt_);
+            uint64_t now = GetTickCount64();
+            while (!map_item_.empty() && map_item_.begin()->first.first <= now)
+            {
+                list_due.push_back(map_item_.begin()->second);
+                map_item_.erase(map_item_.begin());
+            }
+        }
+        for (vector<FaultItem>::iterator it = list_due.begin(); it != list_due.end(); it++)
+        {
+            _SendItem(*it);
+        }
+    }
+
+    void _ClearItems()
+    {
+        MutexLock lock(mt_);
+        map_item_.clear();
+    }
+
+    /**
+     * @brief   Drop items queued to a socket, call with mt_ locked
+     */
+    void _PurgeItems(unsigned long sock_id, bool upstream)
+    {
+        map<pair<uint64_t, uint64_t>, FaultItem>::iterator it = map_item_.begin();
+        while (it != map_item_.end())
+        {
+            if (it->second.sock_id_ == sock_id && it->second.upstream_ == upstream)
+            {
+                map_item_.erase(it++);
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+
+    FaultConfig                                         config_;
+    FaultRandom                                         rand_;
+    FaultStats                                          stats_;
+    Mutex                                               mt_;
+    map<pair<uint64_t, uint64_t>, FaultItem>            map_item_;
+    uint64_t                                            seq_;
+    FaultProxyTimerThread                               timer_thread_;
+};
+
+inline
+uint32_t FaultProxyTimerThread::_Run()
+{
+    while (!_Signalled())
+    {
+        _Sleep(FAULT_TIMER_INTERVAL);
+        proxy_->_OnTimer();
+    }
+    return 0;
+}
+
+/**
+ * @brief   TCP proxy, each accepted connection is paired with a connection to upstream
+ *          Data keeps its order in each direction, delay and jitter only stretch the time.
+ *          Drop and reorder do not apply to TCP.
+ */
+class FaultTCPProxy : public FaultProxy
+{
+public:
+    FaultTCPProxy() : upstream_port_(0)
+    {
+    }
+
+    /**
+     * @brief   Initializing the proxy
+     * @param   listen_port     Port clients connect to
+     * @param   listen_ip       Ip address for listening, NULL for the first network card
+     * @param   upstream_ip     Ip address of the server under test
+     * @param   upstream_port   Port of the server under test
+     * @return  true:Success, false:Failed
+     */
+    bool Init(UINT16 listen_port, const char* listen_ip, const char* upstream_ip, UINT16 upstream_port,
+              const FaultConfig& config)
+    {
+        SetConfig(config);
+        upstream_ip_   = upstream_ip;
+        upstream_port_ = upstream_port;
+        if (!client_.Init(this, _OnUpReceived, _OnUpDisconnected))
+        {
+            return false;
+        }
+        return server_.Init(this, _OnConnected, _OnDownReceived, _OnDownDisconnected, listen_port, listen_ip);
+    }
+
+    bool Start()
+    {
+        return client_.Start() && server_.Start() && timer_thread_.Start();
+    }
+
+    void Stop()
+    {
+        timer_thread_.Signal();
+        timer_thread_.Stop();
+        server_.Stop();
+        client_.Stop();
+        _ClearItems();
+        MutexLock lock(mt_);
+        map_down_.clear();
+        map_up_.clear();
+    }
+
+    void DeInit()
+    {
+        server_.DeInit();
+        client_.DeInit();
+    }
+
+protected:
+    static void _OnConnected(unsigned long sock_id, void* user_ptr);
+
+    static void _OnDownReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr);
+
+    static void _OnDownDisconnected(unsigned long sock_id, void* user_ptr);
+
+    static void _OnUpReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr);
+
+    static void _OnUpDisconnected(unsigned long sock_id, void* user_ptr);
+
+    /**
+     * @brief   Schedule data to the other connection of a pair, call with mt_ locked
+     */
+    void _Forward(unsigned long dst_sock_id, bool upstream, const char* data, int data_len);
+
+    /**
+     * @brief   Close the other connection after its pending data, call with mt_ locked
+     */
+    void _ForwardClose(unsigned long dst_sock_id, bool upstream);
+
+    /**
+     * @brief   Abort both connections with RST, call with mt_ locked
+     */
+    void _Reset(unsigned long down_sock_id, unsigned long up_sock_id);
+
+    virtual void _SendItem(const FaultItem& item);
+
+private:
+    IOCP_TCPServer                      server_;
+    IOCP_TCPClient                      client_;
+    string                              upstream_ip_;
+    UINT16                              upstream_port_;
+    map<unsigned long, unsigned long>   map_down_;      ///> Accepted socket -> upstream socket
+    map<unsigned long, unsigned long>   map_up_;        ///> Upstream socket -> accepted socket
+    map<unsigned long, uint64_t>        map_last_due_;  ///> Due time of the last item to a socket
+};
+
+inline
+void FaultTCPProxy::_OnConnected(unsigned long sock_id, void* user_ptr)
+{
+    FaultTCPProxy* proxy = (FaultTCPProxy*)user_ptr;
+
+    // Locked over connect so upstream data waits for the pair to be recorded
+    MutexLock lock(proxy->mt_);
+    unsigned long up_sock_id = 0;
+    if (!proxy->client_.Connect(up_sock_id, proxy->upstream_ip_.c_str(), proxy->upstream_port_))
+    {
+        proxy->server_.CloseSocket(sock_id);
+        return;
+    }
+    proxy->map_down_[sock_id]  = up_sock_id;
+    proxy->map_up_[up_sock_id] = sock_id;
+}
+
+inline
+void FaultTCPProxy::_OnDownReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr)
+{
+    FaultTCPProxy* proxy = (FaultTCPProxy*)user_ptr;
+    MutexLock lock(proxy->mt_);
+    map<unsigned long, unsigned long>::iterator it = proxy->map_down_.find(sock_id);
+    if (it == proxy->map_down_.end())
+    {
+        return;
+    }
+    if (proxy->rand_.Chance(proxy->config_.reset_rate_))
+    {
+        proxy->_Reset(sock_id, it->second);
+        return;
+    }
+    proxy->_Forward(it->second, true, data, data_len);
+}
+
+inline
+void FaultTCPProxy::_OnUpReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr)
+{
+    FaultTCPProxy* proxy = (FaultTCPProxy*)user_ptr;
+    MutexLock lock(proxy->mt_);
+    map<unsigned long, unsigned long>::iterator it = proxy->map_up_.find(sock_id);
+    if (it == proxy->map_up_.end())
+    {
+        return;
+    }
+    if (proxy->rand_.Chance(proxy->config_.reset_rate_))
+    {
+        proxy->_Reset(it->second, sock_id);
+        return;
+    }
+    proxy->_Forward(it->second, false, data, data_len);
+}
+
+inline
+void FaultTCPProxy::_OnDownDisconnected(unsigned long sock_id, void* user_ptr)
+{
+    FaultTCPProxy* proxy = (FaultTCPProxy*)user_ptr;
+    MutexLock lock(proxy->mt_);
+    map<unsigned long, unsigned long>::iterator it = proxy->map_down_.find(sock_id);
+    if (it == proxy->map_down_.end())
+    {
+        return;
+    }
+    unsigned long up_sock_id = it->second;
+    proxy->map_down_.erase(it);
+    proxy->map_up_.erase(up_sock_id);
+    proxy->map_last_due_.erase(sock_id);
+    // The closed socket gets nothing more, its ID may be reused by a new connection
+    proxy->_PurgeItems(sock_id, false);
+    proxy->_ForwardClose(up_sock_id, true);
+}
+
+inline
+void FaultTCPProxy::_OnUpDisconnected(unsigned long sock_id, void* user_ptr)
+{
+    FaultTCPProxy* proxy = (FaultTCPProxy*)user_ptr;
+    MutexLock lock(proxy->mt_);
+    map<unsigned long, unsigned long>::iterator it = proxy->map_up_.find(sock_id);
+    if (it == proxy->map_up_.end())
+    {
+        return;
+    }
+    unsigned long down_sock_id = it->second;
+    proxy->map_up_.erase(it);
+    proxy->map_down_.erase(down_sock_id);
+    proxy->map_last_due_.erase(sock_id);
+    proxy->_PurgeItems(sock_id, true);
+    proxy->_ForwardClose(down_sock_id, false);
+}
+
+inline
+void FaultTCPProxy::_Forward(unsigned long dst_sock_id, bool upstream, const char* data, int data_len)
+{
+    // Not earlier than data already queued to the socket, so the stream keeps its order
+    uint64_t  due      = _NextDue();
+    uint64_t& last_due = map_last_due_[dst_sock_id];
+    if (due < last_due)
+    {
+        due = last_due;
+    }
+
+    FaultItem item;
+    item.action_   = FAULT_SEND;
+    item.sock_id_  = dst_sock_id;
+    item.upstream_ = upstream;
+    int pos = 0;
+    while (pos < data_len)
+    {
+        int len = data_len - pos;
+        if (0 != config_.partial_write_max_)
+        {
+            int max_len = (int)rand_.Range(config_.partial_write_max_) + 1;
+            if (len > max_len)
+            {
+                len = max_len;
+            }
+        }
+        item.data_.assign(data + pos, len);
+        _Schedule(due, item);
+        pos += len;
+        // Pieces go out on separate ticks so the peer reads them separately
+        if (pos < data_len)
+        {
+            due += FAULT_TIMER_INTERVAL;
+        }
+    }
+    if (0 != config_.partial_write_max_ && (uint32_t)data_len > config_.partial_write_max_)
+    {
+        stats_.partial_writes_++;
+    }
+    last_due = due;
+    stats_.forwarded_++;
+    stats_.bytes_forwarded_ += data_len;
+}
+
+inline
+void FaultTCPProxy::_ForwardClose(unsigned long dst_sock_id, bool upstream)
+{
+    FaultItem item;
+    item.action_   = FAULT_CLOSE;
+    item.sock_id_  = dst_sock_id;
+    item.upstream_ = upstream;
+
+    map<unsigned long, uint64_t>::iterator it = map_last_due_.find(dst_sock_id);
+    uint64_t due = GetTickCount64();
+    if (it != map_last_due_.end())
+    {
+        due = it->second > due ? it->second : due;
+        map_last_due_.erase(it);
+    }
+    _Schedule(due, item);
+}
+
+inline
+void FaultTCPProxy::_Reset(unsigned long down_sock_id, unsigned long up_sock_id)
+{
+    map_down_.erase(down_sock_id);
+    map_up_.erase(up_sock_id);
+    map_last_due_.erase(down_sock_id);
+    map_last_due_.erase(up_sock_id);
+    // Data still queued would go to dead sockets, or to new connections reusing the IDs
+    _PurgeItems(down_sock_id, false);
+    _PurgeItems(up_sock_id, true);
+    server_.CloseSocket(down_sock_id, true);
+    client_.CloseSocket(up_sock_id, true);
+    stats_.resets_++;
+}
+
+inline
+void FaultTCPProxy::_SendItem(const FaultItem& item)
+{
+    if (FAULT_CLOSE == item.action_)
+    {
+        if (item.upstream_)
+        {
+            client_.CloseSocket(item.sock_id_);
+        }
+        else
+        {
+            server_.CloseSocket(item.sock_id_);
+        }
+        return;
+    }
+    if (item.upstream_)
+    {
+        client_.Send(item.sock_id_, item.data_.data(), (int)item.data_.size());
+    }
+    else
+    {
+        server_.Send(item.sock_id_, item.data_.data(), (int)item.data_.size());
+    }
+}
+
+/**
+ * @brief   UDP proxy, each client address gets its own socket to upstream
+ *          Datagrams can be dropped, delayed with jitter, and held back so later ones overtake them
+ */
+class FaultUDPProxy : public FaultProxy
+{
+public:
+    FaultUDPProxy() : listen_sock_id_(0)
+    {
+        ZeroMemory(&upstream_addr_, sizeof(upstream_addr_));
+    }
+
+    /**
+     * @brief   Initializing the proxy
+     * @param   listen_port     Port clients send to
+     * @param   listen_ip       Ip address for binding, "*" or NULL for any
+     * @param   upstream_ip     Ip address of the server under test
+     * @param   upstream_port   Port of the server under test
+     * @return  true:Success, false:Failed
+     */
+    bool Init(UINT16 listen_port, const char* listen_ip, const char* upstream_ip, UINT16 upstream_port,
+              const FaultConfig& config)
+    {
+        SetConfig(config);
+        listen_port_                   = listen_port;
+        listen_ip_                     = NULL == listen_ip ? "*" : listen_ip;
+        upstream_addr_.sin_family      = AF_INET;
+        upstream_addr_.sin_addr.s_addr = inet_addr(upstream_ip);
+        upstream_addr_.sin_port        = htons(upstream_port);
+        return peer_.Init(this, _OnReceiveFrom);
+    }
+
+    bool Start()
+    {
+        if (!peer_.Start())
+        {
+            return false;
+        }
+        MutexLock lock(mt_);
+        if (!peer_.Create(listen_sock_id_, listen_ip_.c_str(), listen_port_))
+        {
+            return false;
+        }
+        return timer_thread_.Start();
+    }
+
+    void Stop()
+    {
+        timer_thread_.Signal();
+        timer_thread_.Stop();
+        peer_.Stop();
+        _ClearItems();
+        MutexLock lock(mt_);
+        map_client_.clear();
+        map_up_.clear();
+    }
+
+    void DeInit()
+    {
+        peer_.DeInit();
+    }
+
+protected:
+    static uint64_t _AddrKey(const SOCKADDR_IN& addr)
+    {
+        return ((uint64_t)addr.sin_addr.s_addr << 16) | addr.sin_port;
+    }
+
+    static void _OnReceiveFrom(unsigned long sock_id, const char* data, int data_len, SOCKADDR_IN src_addr, void* user_ptr);
+
+    /**
+     * @brief   Apply faults and schedule a datagram, call with mt_ locked
+     */
+    void _Forward(unsigned long sock_id, const SOCKADDR_IN& dst_addr, const char* data, int data_len);
+
+    virtual void _SendItem(const FaultItem& item)
+    {
+        SOCKADDR_IN addr = item.addr_;
+        peer_.SendTo(item.sock_id_, item.data_.data(), (int)item.data_.size(), addr);
+    }
+
+private:
+    IOCP_UDPPeer                        peer_;
+    string                              listen_ip_;
+    UINT16                              listen_port_;
+    unsigned long                       listen_sock_id_;
+    SOCKADDR_IN                         upstream_addr_;
+    map<uint64_t, unsigned long>        map_client_;    ///> Client address -> upstream socket
+    map<unsigned long, SOCKADDR_IN>     map_up_;        ///> Upstream socket -> client address
+};
+
+inline
+void FaultUDPProxy::_OnReceiveFrom(unsigned long sock_id, const char* data, int data_len, SOCKADDR_IN src_addr, void* user_ptr)
+{
+    FaultUDPProxy* proxy = (FaultUDPProxy*)user_ptr;
+    MutexLock lock(proxy->mt_);
+    if (sock_id != proxy->listen_sock_id_)
+    {
+        map<unsigned long, SOCKADDR_IN>::iterator it = proxy->map_up_.find(sock_id);
+        if (it != proxy->map_up_.end())
+        {
+            proxy->_Forward(proxy->listen_sock_id_, it->second, data, data_len);
+        }
+        return;
+    }
+
+    uint64_t key = _AddrKey(src_addr);
+    map<uint64_t, unsigned long>::iterator it = proxy->map_client_.find(key);
+    unsigned long up_sock_id = 0;
+    if (it == proxy->map_client_.end())
+    {
+        UINT16 port = 0;
+        if (!proxy->peer_.Create(up_sock_id, "*", port))
+        {
+            return;
+        }
+        proxy->map_client_[key]    = up_sock_id;
+        proxy->map_up_[up_sock_id] = src_addr;
+    }
+    else
+    {
+        up_sock_id = it->second;
+    }
+    proxy->_Forward(up_sock_id, proxy->upstream_addr_, data, data_len);
+}
+
+inline
+void FaultUDPProxy::_Forward(unsigned long sock_id, const SOCKADDR_IN& dst_addr, const char* data, int data_len)
+{
+    if (rand_.Chance(config_.drop_rate_))
+    {
+        stats_.dropped_++;
+        return;
+    }
+    uint64_t due = _NextDue();
+    if (rand_.Chance(config_.reorder_rate_))
+    {
+        due += config_.reorder_delay_ms_;
+        stats_.reordered_++;
+    }
+
+    FaultItem item;
+    item.action_   = FAULT_SEND;
+    item.sock_id_  = sock_id;
+    item.upstream_ = false;
+    item.addr_     = dst_addr;
+    item.data_.assign(data, data_len);
+    _Schedule(due, item);
+    stats_.forwarded_++;
+    stats_.bytes_forwarded_ += data_len;
+}
+
+} // end of namespace
+using namespace lite;
+
+#endif // ifdef OS_WIN
+
+#endif // ifndef _LITE_FAULT_PROXY_H_
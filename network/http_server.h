@@ -0,0 +1,976 @@
+/**
+ * @file    network\http_server.h
+ * @brief   Encapsulation for minimal HTTP/1.1 server over IOCP TCP server
+ *          Support keep-alive and pipelining, request is parsed in place without allocation
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ * @update          2026-10-18      Close connection after the last response is sent
+ *                                  Error response keeps the order of queued responses
+ *                                  Connections closed by server are released, queued responses
+ *                                  are dropped if their connection has gone
+ */
+
+#ifndef _LITE_HTTP_SERVER_H_
+#define _LITE_HTTP_SERVER_H_
+
+#include "iocp_tcpserver.h"
+#include "tools/work_queue.h"
+#include <ctype.h>
+
+#ifdef OS_WIN
+
+namespace lite {
+
+#define HTTP_MAX_REQUEST_SIZE           (8192)  ///> Max size of request line + headers + body
+#define HTTP_MAX_HEADERS                (32)    ///> Max header count of one request
+#define HTTP_CONNECTION_POOL_SIZE       (1000)
+
+/**
+ * @brief   Reference to a piece of receive buffer(not own the memory)
+ */
+struct HTTPStringRef
+{
+    const char* data_;
+    uint32_t    len_;
+
+    HTTPStringRef() : data_(NULL), len_(0)
+    {
+    }
+
+    HTTPStringRef(const char* data, uint32_t len) : data_(data), len_(len)
+    {
+    }
+
+    bool Empty() const
+    {
+        return 0 == len_;
+    }
+
+    bool Equals(const char* str) const
+    {
+        uint32_t len = (uint32_t)strlen(str);
+        return len == len_ && 0 == memcmp(data_, str, len);
+    }
+
+    /**
+     * @brief   Compare ignore case(header name and token value are case-insensitive)
+     */
+    bool EqualsNoCase(const char* str) const
+    {
+        uint32_t i = 0;
+        for (; i < len_ && str[i] != 0; i++)
+        {
+            if (tolower((unsigned char)data_[i]) != tolower((unsigned char)str[i]))
+            {
+                return false;
+            }
+        }
+        return i == len_ && str[i] == 0;
+    }
+
+    string ToString() const
+    {
+        return string(data_, len_);
+    }
+};
+
+struct HTTPHeader
+{
+    HTTPStringRef   name_;
+    HTTPStringRef   value_;
+};
+
+/**
+ * @brief   Parsed HTTP request, all fields refer to the buffer that was parsed
+ * @caution Only valid during the handler call
+ */
+struct HTTPRequest
+{
+    HTTPStringRef   method_;
+    HTTPStringRef   uri_;                           ///> Full request target
+    HTTPStringRef   path_;                          ///> Target without query string
+    HTTPStringRef   query_;                         ///> Query string without '?'
+    int             version_minor_;                 ///> 0: HTTP/1.0, 1: HTTP/1.1
+    HTTPHeader      headers_[HTTP_MAX_HEADERS];
+    uint32_t        header_count_;
+    HTTPStringRef   body_;
+    bool            keep_alive_;
+    unsigned long   sock_id_;                       ///> Socket ID which recv the request
+
+    HTTPRequest()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        method_        = HTTPStringRef();
+        uri_           = HTTPStringRef();
+        path_          = HTTPStringRef();
+        query_         = HTTPStringRef();
+        body_          = HTTPStringRef();
+        version_minor_ = 1;
+        header_count_  = 0;
+        keep_alive_    = true;
+        sock_id_       = 0;
+    }
+
+    /**
+     * @brief   Find header by name(case-insensitive)
+     * @return  NULL if not found
+     */
+    const HTTPStringRef* GetHeader(const char* name) const
+    {
+        for (uint32_t i = 0; i < header_count_; i++)
+        {
+            if (headers_[i].name_.EqualsNoCase(name))
+            {
+                return &headers_[i].value_;
+            }
+        }
+        return NULL;
+    }
+};
+
+typedef enum _HTTP_PARSE_RESULT
+{
+    HTTP_PARSE_INCOMPLETE = 0,                      ///> Need more data
+    HTTP_PARSE_DONE,                                ///> One request is parsed
+    HTTP_PARSE_BAD_REQUEST,                         ///> Syntax error
+    HTTP_PARSE_TOO_LARGE,                           ///> Exceed HTTP_MAX_REQUEST_SIZE or HTTP_MAX_HEADERS
+    HTTP_PARSE_NOT_IMPLEMENTED                      ///> Transfer-Encoding of request is not supported
+}HTTP_PARSE_RESULT;
+
+/**
+ * @brief   Incremental HTTP/1.x request parser
+ *          The parser remembers how far it scanned, so feeding a growing buffer is linear,
+ *          and never allocates: the request refers to the buffer passed in.
+ */
+class HTTPParser
+{
+public:
+    HTTPParser()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        scan_pos_    = 0;
+        request_len_ = 0;
+    }
+
+    /**
+     * @brief   Parse a request from the start of buffer
+     * @param   buf         Buffer begins with a request(the same data as last call plus new data)
+     * @param   len         Data length in buffer
+     * @param   request     Parsed request, refers to buf
+     * @param   consumed    Length of the parsed request when HTTP_PARSE_DONE
+     */
+    HTTP_PARSE_RESULT Parse(const char* buf, uint32_t len, HTTPRequest& request, uint32_t& consumed);
+
+protected:
+    HTTP_PARSE_RESULT _ParseHead(const char* buf, uint32_t head_len, HTTPRequest& request, uint32_t& content_len);
+
+    static const char* _Find(const char* begin, const char* end, char c)
+    {
+        const char* p = (const char*)memchr(begin, c, end - begin);
+        return NULL == p ? end : p;
+    }
+
+    static HTTPStringRef _Trim(const char* begin, const char* end)
+    {
+        while (begin < end && (*begin == ' ' || *begin == '\t'))
+        {
+            begin++;
+        }
+        while (end > begin && (*(end-1) == ' ' || *(end-1) == '\t'))
+        {
+            end--;
+        }
+        return HTTPStringRef(begin, (uint32_t)(end - begin));
+    }
+
+private:
+    uint32_t    scan_pos_;                          ///> Position that header terminator has been searched to,
+                                                    ///> or head length once the head is parsed
+    uint32_t    request_len_;                       ///> Total length once the head is parsed, 0 if unknown
+};
+
+inline
+HTTP_PARSE_RESULT HTTPParser::Parse(const char* buf, uint32_t len, HTTPRequest& request, uint32_t& consumed)
+{
+    // Head is known, wait for the whole body
+    if (0 != request_len_ && len < request_len_)
+    {
+        return HTTP_PARSE_INCOMPLETE;
+    }
+
+    // Search "\r\n\r\n" from where the last call stopped
+    uint32_t head_len = 0 != request_len_ ? scan_pos_ : 0;
+    uint32_t pos      = scan_pos_ > 3 ? scan_pos_ - 3 : 0;
+    for (; 0 == head_len && pos + 3 < len; pos++)
+    {
+        if (buf[pos+3] != '\n')
+        {
+            continue;
+        }
+        if (buf[pos] == '\r' && buf[pos+1] == '\n' && buf[pos+2] == '\r')
+        {
+            head_len = pos + 4;
+        }
+    }
+    if (0 == head_len)
+    {
+        scan_pos_ = len;
+        return len >= HTTP_MAX_REQUEST_SIZE ? HTTP_PARSE_TOO_LARGE : HTTP_PARSE_INCOMPLETE;
+    }
+
+    request.Reset();
+    uint32_t          content_len = 0;
+    HTTP_PARSE_RESULT ret         = _ParseHead(buf, head_len, request, content_len);
+    if (HTTP_PARSE_DONE != ret)
+    {
+        return ret;
+    }
+    if (head_len + content_len > HTTP_MAX_REQUEST_SIZE)
+    {
+        return HTTP_PARSE_TOO_LARGE;
+    }
+    if (head_len + content_len > len)
+    {
+        scan_pos_    = head_len;
+        request_len_ = head_len + content_len;
+        return HTTP_PARSE_INCOMPLETE;
+    }
+
+    request.body_ = HTTPStringRef(buf + head_len, content_len);
+    consumed      = head_len + content_len;
+    Reset();
+    return HTTP_PARSE_DONE;
+}
+
+inline
+HTTP_PARSE_RESULT HTTPParser::_ParseHead(const char* buf, uint32_t head_len, HTTPRequest& request, uint32_t& content_len)
+{
+    const char* end = buf + head_len - 2;           // Point to the last empty line
+
+    // Request line: method SP request-target SP HTTP-version CRLF
+    const char* line_end = _Find(buf, end, '\r');
+    const char* p        = _Find(buf, line_end, ' ');
+    if (p == buf || p == line_end)
+    {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+    request.method_ = HTTPStringRef(buf, (uint32_t)(p - buf));
+
+    const char* uri = p + 1;
+    p = _Find(uri, line_end, ' ');
+    if (p == uri || p == line_end)
+    {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+    request.uri_ = HTTPStringRef(uri, (uint32_t)(p - uri));
+    const char* query = _Find(uri, p, '?');
+    request.path_ = HTTPStringRef(uri, (uint32_t)(query - uri));
+    if (query != p)
+    {
+        request.query_ = HTTPStringRef(query + 1, (uint32_t)(p - query - 1));
+    }
+
+    const char* version = p + 1;
+    if (line_end - version != 8 || 0 != memcmp(version, "HTTP/1.", 7))
+    {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+    if (version[7] == '0')
+    {
+        request.version_minor_ = 0;
+        request.keep_alive_    = false;
+    }
+    else if (version[7] == '1')
+    {
+        request.version_minor_ = 1;
+        request.keep_alive_    = true;
+    }
+    else
+    {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+
+    // Header fields: name ":" OWS value OWS CRLF
+    for (p = line_end + 2; p < end; p = line_end + 2)
+    {
+        line_end = _Find(p, end, '\r');
+        if (line_end[1] != '\n')
+        {
+            return HTTP_PARSE_BAD_REQUEST;
+        }
+        const char* colon = _Find(p, line_end, ':');
+        if (colon == p || colon == line_end)
+        {
+            return HTTP_PARSE_BAD_REQUEST;
+        }
+        if (request.header_count_ >= HTTP_MAX_HEADERS)
+        {
+            return HTTP_PARSE_TOO_LARGE;
+        }
+        HTTPHeader& header = request.headers_[request.header_count_++];
+        header.name_  = HTTPStringRef(p, (uint32_t)(colon - p));
+        header.value_ = _Trim(colon + 1, line_end);
+
+        if (header.name_.EqualsNoCase("Content-Length"))
+        {
+            content_len = 0;
+            for (uint32_t i = 0; i < header.value_.len_; i++)
+            {
+                char c = header.value_.data_[i];
+                if (c < '0' || c > '9' || content_len > HTTP_MAX_REQUEST_SIZE)
+                {
+                    return HTTP_PARSE_BAD_REQUEST;
+                }
+                content_len = content_len * 10 + (c - '0');
+            }
+        }
+        else if (header.name_.EqualsNoCase("Connection"))
+        {
+            if (header.value_.EqualsNoCase("close"))
+            {
+                request.keep_alive_ = false;
+            }
+            else if (header.value_.EqualsNoCase("keep-alive"))
+            {
+                request.keep_alive_ = true;
+            }
+        }
+        else if (header.name_.EqualsNoCase("Transfer-Encoding"))
+        {
+            return HTTP_PARSE_NOT_IMPLEMENTED;
+        }
+    }
+    return HTTP_PARSE_DONE;
+}
+
+/**
+ * @brief   HTTP response filled by handler
+ */
+class HTTPResponse
+{
+public:
+    HTTPResponse(ByteStream& body)
+        : status_(200)
+        , content_type_("text/plain")
+        , body_(body)
+    {
+    }
+
+    void SetStatus(int status)
+    {
+        status_ = status;
+    }
+
+    /**
+     * @brief   Set content type(the string must stay valid until the handler returns)
+     */
+    void SetContentType(const char* content_type)
+    {
+        content_type_ = content_type;
+    }
+
+    /**
+     * @brief   Add an extra header line
+     */
+    void AddHeader(const char* name, const char* value)
+    {
+        headers_.Add(name);
+        headers_.Add(": ", 2);
+        headers_.Add(value);
+        headers_.Add("\r\n", 2);
+    }
+
+    /**
+     * @brief   Append data to response body
+     */
+    void Write(const void* data, uint32_t size)
+    {
+        body_.Add(data, size);
+    }
+
+    void Write(const char* text)
+    {
+        body_.Add(text);
+    }
+
+    int GetStatus() const
+    {
+        return status_;
+    }
+
+    const char* GetContentType() const
+    {
+        return content_type_;
+    }
+
+    const ByteStream& GetHeaders() const
+    {
+        return headers_;
+    }
+
+    const ByteStream& GetBody() const
+    {
+        return body_;
+    }
+
+private:
+    int             status_;
+    const char*     content_type_;
+    ByteStream      headers_;
+    ByteStream&     body_;
+};
+
+/**
+ * @brief   Callback function to handle a HTTP request
+ * @param   request     Parsed request, valid only during the call
+ * @param   response    Response to fill
+ * @param   user_ptr    User pointer registered with the handler
+ * @note    When dispatched inline, this function runs on the IOCP work thread and needs to return quickly
+ */
+typedef void (*HTTPHANDLER)(const HTTPRequest& request, HTTPResponse& response, void* user_ptr);
+
+class HTTPServer : private NonCopyable
+{
+public:
+    HTTPServer()
+        : default_handler_(NULL)
+        , default_user_ptr_(NULL)
+        , work_queue_(NULL)
+        , next_generation_(0)
+    {
+    }
+
+    virtual ~HTTPServer()
+    {
+        MutexLock lock(mt_conn_);
+        map_conn_.clear();
+        list_idle_conn_.clear();
+    }
+
+    /**
+     * @brief   Initializing the HTTP server
+     * @param   listen_port     Port number for server listening
+     * @param   host_ip         Ip address string for server, "*" for any, NULL for the first network card
+     * @return  true:Success, false:Failed
+     */
+    bool Init(UINT16 listen_port, const char* host_ip = NULL)
+    {
+        if (!server_.Init(this, _OnConnected, _OnReceived, _OnDisconnected, listen_port, host_ip))
+        {
+            return false;
+        }
+        server_.SetSendCompletedCallback(_OnSendCompleted);
+        return true;
+    }
+
+    /**
+     * @brief   Register handler for an exact path(call before Start)
+     */
+    void AddHandler(const char* path, HTTPHANDLER handler, void* user_ptr = NULL)
+    {
+        HTTPRoute route;
+        route.path_     = path;
+        route.handler_  = handler;
+        route.user_ptr_ = user_ptr;
+        routes_.push_back(route);
+    }
+
+    /**
+     * @brief   Register handler for unmatched path(default responds 404)
+     */
+    void SetDefaultHandler(HTTPHANDLER handler, void* user_ptr = NULL)
+    {
+        default_handler_  = handler;
+        default_user_ptr_ = user_ptr;
+    }
+
+    /**
+     * @brief   Dispatch handlers to a work queue instead of the IOCP work thread
+     * @param   work_queue  NULL to dispatch inline(default)
+     * @note    The request is copied into the work, responses of a connection keep the request order
+     *          because the work queue is FIFO
+     */
+    void SetWorkQueue(WorkQueue* work_queue)
+    {
+        work_queue_ = work_queue;
+    }
+
+    bool Start()
+    {
+        return server_.Start();
+    }
+
+    void Stop()
+    {
+        server_.Stop();
+    }
+
+    void DeInit()
+    {
+        server_.DeInit();
+    }
+
+    /**
+     * @brief   Get underlying TCP server
+     * @caution Do not replace its SENDCOMPLETEDCALLBACK or send with a context,
+     *          the callback closes the connection after the last response
+     */
+    IOCP_TCPServer& GetTCPServer()
+    {
+        return server_;
+    }
+
+protected:
+    /**
+     * @brief   Per-connection state, pooled and reused
+     */
+    struct HTTPConnection
+    {
+        HTTPParser      parser_;
+        char            buf_[HTTP_MAX_REQUEST_SIZE];    ///> Unparsed data carried over between recvs
+        uint32_t        len_;
+        bool            closing_;                       ///> No more requests accepted, closed after the last response
+        uint32_t        generation_;                    ///> Tells the connection from a later one with the same sock_id
+        ByteStream      out_;                           ///> Responses of one recv, sent in one batch
+        ByteStream      body_;
+
+        HTTPConnection() : len_(0), closing_(false), generation_(0)
+        {
+        }
+
+        void Reset()
+        {
+            parser_.Reset();
+            len_     = 0;
+            closing_ = false;
+            out_.SetWritePtr(0);
+            body_.SetWritePtr(0);
+        }
+    };
+
+    typedef std::tr1::shared_ptr<HTTPConnection> HTTPConnectionPtr;
+
+    struct HTTPRoute
+    {
+        string          path_;
+        HTTPHANDLER     handler_;
+        void*           user_ptr_;
+    };
+
+    /**
+     * @brief   Request handled on the work queue, stamped with the connection it came from
+     */
+    struct HTTPWork : public Work
+    {
+        uint32_t        generation_;
+
+        HTTPWork(uint8_t* buffer, uint32_t size, uint32_t generation)
+            : Work(buffer, size)
+            , generation_(generation)
+        {
+        }
+    };
+
+    static void _OnConnected(unsigned long sock_id, void* user_ptr);
+
+    static void _OnReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr);
+
+    static void _OnDisconnected(unsigned long sock_id, void* user_ptr);
+
+    static void _OnSendCompleted(unsigned long sock_id, void* context, void* user_ptr);
+
+    static void _WorkProc(Work* work);
+
+    /**
+     * @brief   Send an error response from the work queue, after the responses queued before it
+     */
+    static void _ErrorWorkProc(Work* work);
+
+    /**
+     * @brief   Send responses, the connection is closed when the last one has been sent
+     * @param   generation  Of the connection the responses belong to, they are dropped if it has gone
+     * @param   last        No more response follows
+     */
+    void _Send(unsigned long sock_id, uint32_t generation, const ByteStream& out, bool last);
+
+    HTTPConnectionPtr _GetConnection(unsigned long sock_id)
+    {
+        MutexLock lock(mt_conn_);
+        map<unsigned long, HTTPConnectionPtr>::iterator it = map_conn_.find(sock_id);
+        return it == map_conn_.end() ? HTTPConnectionPtr() : it->second;
+    }
+
+    /**
+     * @brief   Forget a connection, it is pooled when no recv still uses it
+     * @param   generation  0 for any
+     * @return  false if not found
+     */
+    bool _RemoveConnection(unsigned long sock_id, uint32_t generation);
+
+    /**
+     * @brief   Close a connection by server, which gets no disconnected callback
+     */
+    void _CloseConnection(unsigned long sock_id, uint32_t generation)
+    {
+        if (_RemoveConnection(sock_id, generation))
+        {
+            server_.CloseSocket(sock_id);
+        }
+    }
+
+    /**
+     * @brief   Parse and handle all complete requests in buf
+     * @return  Length of consumed data
+     */
+    uint32_t _Process(unsigned long sock_id, HTTPConnection* conn, const char* buf, uint32_t len);
+
+    /**
+     * @brief   Call handler and append response to out
+     */
+    void _Handle(const HTTPRequest& request, ByteStream& body, ByteStream& out);
+
+    static void _AppendResponse(ByteStream& out, int status, const char* content_type, const ByteStream* headers,
+                                const ByteStream& body, bool keep_alive);
+
+    static const char* _GetReasonPhrase(int status);
+
+private:
+    IOCP_TCPServer                          server_;
+    vector<HTTPRoute>                       routes_;
+    HTTPHANDLER                             default_handler_;
+    void*                                   default_user_ptr_;
+    WorkQueue*                              work_queue_;
+    map<unsigned long, HTTPConnectionPtr>   map_conn_;
+    list<HTTPConnectionPtr>                 list_idle_conn_;
+    uint32_t                                next_generation_;
+    Mutex                                   mt_conn_;
+};
+
+inline
+void HTTPServer::_OnConnected(unsigned long sock_id, void* user_ptr)
+{
+    HTTPServer*       server = (HTTPServer*)user_ptr;
+    HTTPConnectionPtr conn;
+    MutexLock lock(server->mt_conn_);
+    if (server->list_idle_conn_.empty())
+    {
+        conn.reset(new HTTPConnection);
+    }
+    else
+    {
+        conn = server->list_idle_conn_.front();
+        server->list_idle_conn_.pop_front();
+    }
+    // 0 is never used, it matches any connection in _RemoveConnection
+    if (0 == ++server->next_generation_)
+    {
+        ++server->next_generation_;
+    }
+    conn->generation_          = server->next_generation_;
+    server->map_conn_[sock_id] = conn;
+}
+
+inline
+void HTTPServer::_OnDisconnected(unsigned long sock_id, void* user_ptr)
+{
+    HTTPServer* server = (HTTPServer*)user_ptr;
+    server->_RemoveConnection(sock_id, 0);
+}
+
+inline
+bool HTTPServer::_RemoveConnection(unsigned long sock_id, uint32_t generation)
+{
+    MutexLock lock(mt_conn_);
+    map<unsigned long, HTTPConnectionPtr>::iterator it = map_conn_.find(sock_id);
+    if (it == map_conn_.end() || (0 != generation && it->second->generation_ != generation))
+    {
+        return false;
+    }
+    HTTPConnectionPtr conn = it->second;
+    map_conn_.erase(it);
+    // A recv still processing it frees it when done
+    if (conn.unique() && list_idle_conn_.size() < HTTP_CONNECTION_POOL_SIZE)
+    {
+        conn->Reset();
+        list_idle_conn_.push_back(conn);
+    }
+    return true;
+}
+
+inline
+void HTTPServer::_OnReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr)
+{
+    // Only one recv is posted per socket, so a connection is never processed concurrently
+    HTTPServer*       server = (HTTPServer*)user_ptr;
+    HTTPConnectionPtr conn   = server->_GetConnection(sock_id);
+    if (NULL == conn.get() || conn->closing_ || data_len <= 0)
+    {
+        return;
+    }
+
+    if (0 == conn->len_)
+    {
+        // Parse directly from the receive buffer, only the incomplete tail is copied
+        uint32_t used = server->_Process(sock_id, conn.get(), data, (uint32_t)data_len);
+        uint32_t rest = (uint32_t)data_len - used;
+        if (!conn->closing_ && rest > 0)
+        {
+            memcpy(conn->buf_, data + used, rest);
+            conn->len_ = rest;
+        }
+    }
+    else
+    {
+        uint32_t copy_len = (uint32_t)data_len;
+        if (copy_len > HTTP_MAX_REQUEST_SIZE - conn->len_)
+        {
+            copy_len = HTTP_MAX_REQUEST_SIZE - conn->len_;
+        }
+        memcpy(conn->buf_ + conn->len_, data, copy_len);
+        conn->len_ += copy_len;
+
+        uint32_t used = server->_Process(sock_id, conn.get(), conn->buf_, conn->len_);
+        if (used > 0)
+        {
+            memmove(conn->buf_, conn->buf_ + used, conn->len_ - used);
+            conn->len_ -= used;
+        }
+        // Carry buffer is full, process remained data after compacting
+        if (!conn->closing_ && copy_len < (uint32_t)data_len)
+        {
+            _OnReceived(sock_id, data + copy_len, data_len - (int)copy_len, user_ptr);
+            return;
+        }
+    }
+
+    // Responses kept before a recursive call are sent in its batch
+    if (conn->out_.GetWritePtr() > 0)
+    {
+        server->_Send(sock_id, conn->generation_, conn->out_, conn->closing_);
+        conn->out_.SetWritePtr(0);
+    }
+}
+
+inline
+void HTTPServer::_OnSendCompleted(unsigned long sock_id, void* context, void* user_ptr)
+{
+    // Context of the last send is the generation of its connection
+    HTTPServer* server = (HTTPServer*)user_ptr;
+    if (NULL != context)
+    {
+        server->_CloseConnection(sock_id, (uint32_t)(uintptr_t)context);
+    }
+}
+
+inline
+void HTTPServer::_Send(unsigned long sock_id, uint32_t generation, const ByteStream& out, bool last)
+{
+    // Held while posting, so the connection is not closed and its sock_id given to a new one meanwhile
+    MutexLock lock(mt_conn_);
+    map<unsigned long, HTTPConnectionPtr>::iterator it = map_conn_.find(sock_id);
+    if (it == map_conn_.end() || it->second->generation_ != generation)
+    {
+        return;
+    }
+    if (!last)
+    {
+        server_.Send(sock_id, (const char*)out.GetBuffer(), (int)out.GetWritePtr());
+        return;
+    }
+    // Closing now would cancel the pending send, so close on its completion.
+    // A shared buffer is posted as one send, which completes after all data before it
+    IOCP_SharedBufferPtr buf(new ByteStream(out));
+    if (!server_.Send(sock_id, buf, (void*)(uintptr_t)generation))
+    {
+        _CloseConnection(sock_id, generation);
+    }
+}
+
+inline
+uint32_t HTTPServer::_Process(unsigned long sock_id, HTTPConnection* conn, const char* buf, uint32_t len)
+{
+    uint32_t    used = 0;
+    HTTPRequest request;
+    while (used < len && !conn->closing_)
+    {
+        uint32_t consumed = 0;
+        HTTP_PARSE_RESULT ret = conn->parser_.Parse(buf + used, len - used, request, consumed);
+        if (HTTP_PARSE_INCOMPLETE == ret)
+        {
+            break;
+        }
+        if (HTTP_PARSE_DONE != ret)
+        {
+            int status = HTTP_PARSE_TOO_LARGE == ret ? 413 : (HTTP_PARSE_NOT_IMPLEMENTED == ret ? 501 : 400);
+            conn->closing_ = true;
+            if (NULL == work_queue_)
+            {
+                conn->body_.SetWritePtr(0);
+                _AppendResponse(conn->out_, status, "text/plain", NULL, conn->body_, false);
+            }
+            else
+            {
+                // Responses of earlier requests are still queued, the error response goes behind them
+                Work* work       = new HTTPWork((uint8_t*)&status, sizeof(status), conn->generation_);
+                work->user_ptr_  = this;
+                work->user_data_ = (void*)sock_id;
+                work->work_func_ = _ErrorWorkProc;
+                work_queue_->QueueWork(work);
+            }
+            return len;
+        }
+
+        request.sock_id_ = sock_id;
+        if (!request.keep_alive_)
+        {
+            conn->closing_ = true;
+        }
+
+        if (NULL == work_queue_)
+        {
+            _Handle(request, conn->body_, conn->out_);
+        }
+        else
+        {
+            Work* work       = new HTTPWork((uint8_t*)(buf + used), consumed, conn->generation_);
+            work->user_ptr_  = this;
+            work->user_data_ = (void*)sock_id;
+            work->work_func_ = _WorkProc;
+            work_queue_->QueueWork(work);
+        }
+        used += consumed;
+    }
+    return used;
+}
+
+inline
+void HTTPServer::_WorkProc(Work* work)
+{
+    HTTPServer*   server  = (HTTPServer*)work->user_ptr_;
+    unsigned long sock_id = (unsigned long)work->user_data_;
+
+    // Parse again from the copy owned by the work
+    HTTPParser  parser;
+    HTTPRequest request;
+    uint32_t    consumed = 0;
+    if (HTTP_PARSE_DONE == parser.Parse((const char*)work->user_buffer_.GetBuffer(),
+                                        work->user_buffer_.GetWritePtr(),
+                                        request,
+                                        consumed))
+    {
+        request.sock_id_ = sock_id;
+        ByteStream body;
+        ByteStream out;
+        server->_Handle(request, body, out);
+        server->_Send(sock_id, ((HTTPWork*)work)->generation_, out, !request.keep_alive_);
+    }
+    delete work;
+}
+
+inline
+void HTTPServer::_ErrorWorkProc(Work* work)
+{
+    HTTPServer*   server  = (HTTPServer*)work->user_ptr_;
+    unsigned long sock_id = (unsigned long)work->user_data_;
+
+    int status = 400;
+    memcpy(&status, work->user_buffer_.GetBuffer(), sizeof(status));
+    ByteStream body;
+    ByteStream out;
+    _AppendResponse(out, status, "text/plain", NULL, body, false);
+    server->_Send(sock_id, ((HTTPWork*)work)->generation_, out, true);
+    delete work;
+}
+
+inline
+void HTTPServer::_Handle(const HTTPRequest& request, ByteStream& body, ByteStream& out)
+{
+    HTTPHANDLER handler  = default_handler_;
+    void*       user_ptr = default_user_ptr_;
+    for (vector<HTTPRoute>::const_iterator it = routes_.begin(); it != routes_.end(); it++)
+    {
+        if (it->path_.length() == request.path_.len_ &&
+            0 == memcmp(it->path_.c_str(), request.path_.data_, request.path_.len_))
+        {
+            handler  = it->handler_;
+            user_ptr = it->user_ptr_;
+            break;
+        }
+    }
+
+    body.SetWritePtr(0);
+    HTTPResponse response(body);
+    if (NULL == handler)
+    {
+        response.SetStatus(404);
+    }
+    else
+    {
+        handler(request, response, user_ptr);
+    }
+    _AppendResponse(out,
+                    response.GetStatus(),
+                    response.GetContentType(),
+                    &response.GetHeaders(),
+                    response.GetBody(),
+                    request.keep_alive_);
+}
+
+inline
+void HTTPServer::_AppendResponse(ByteStream& out, int status, const char* content_type, const ByteStream* headers,
+                                 const ByteStream& body, bool keep_alive)
+{
+    char line[256];
+    int  len = sprintf(line,
+                       "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\nConnection: %s\r\n",
+                       status,
+                       _GetReasonPhrase(status),
+                       content_type,
+                       body.GetWritePtr(),
+                       keep_alive ? "keep-alive" : "close");
+    out.Add(line, (uint32_t)len);
+    if (NULL != headers)
+    {
+        out.Add(headers->GetBuffer(), headers->GetWritePtr());
+    }
+    out.Add("\r\n", 2);
+    out.Add(body.GetBuffer(), body.GetWritePtr());
+}
+
+inline
+const char* HTTPServer::_GetReasonPhrase(int status)
+{
+    switch (status)
+    {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default:  return "Unknown";
+    }
+}
+
+} // end of namespace
+using namespace lite;
+
+#endif // ifdef OS_WIN
+
+#endif // ifndef _LITE_HTTP_SERVER_H_
@@ -4,6 +4,16 @@
  * @author  Nik Yan
  * @version 1.0     2014-07-20      Only support windows
  * @update          2014-09-16      Add addr_size_, bug free for UDP
+ * @update          2026-10-18      Add shared send buffer, one encoded msg is sent to many sockets without copy
+ *                                  Add TRANSMIT_POSTED for file transfer
+ *                                  Add relay peer to socket context
+ *                                  Add session to socket context
+ *                                  Add counters for socket buffer autotuning
+ *                                  Add release function for admission control
+ *                                  Add receive message with kernel timestamp to socket context
+ *                                  Add send lock to socket context
+ *                                  Add PROBE_POSTED for sockets paused by receive budget
+ *                                  Add abortive close of socket context
  */
 
 #ifndef _LITE_IOCP_BASE_H_
@@ -11,6 +21,7 @@
 
 #include "base/lite_base.h"
 #include "event/mutex_lock.h"
+#include "tools/byte_stream.h"
 
 #ifdef OS_WIN
 
@@ -21,6 +32,7 @@
 #define MAX_IO_BUFFER_SIZE              (4096)
 #define WORKER_THREADS_PER_PROCESSOR    (2)
 #define MEM_POOL_SIZE                   (1000)
+#define MAX_IO_CONTROL_SIZE             (64)            ///> Control data of a received message(timestamp)
 
 namespace lite {
 
@@ -29,9 +41,25 @@ typedef enum _IO_OPERATION
     ACCEPT_POSTED = 0,
     RECV_POSTED,
     SEND_POSTED,
+    TRANSMIT_POSTED,
+    RELAY_POSTED,
+    PROBE_POSTED,                               ///> Zero byte recv watching a socket which is not read
     NULL_POSTED
 }IO_OPERATION;
 
+/**
+ * @brief   Reference counted send buffer, shared by all IO contexts which send it
+ */
+typedef std::tr1::shared_ptr<ByteStream> IOCP_SharedBufferPtr;
+
+class IOCP_TCPSession;
+typedef std::tr1::shared_ptr<IOCP_TCPSession> IOCP_TCPSessionPtr;
+
+/**
+ * @brief   Called when a connection is reset, with the remote address
+ */
+typedef void (*IOCP_RELEASEFUNC)(void* owner, const SOCKADDR_IN& addr);
+
 /**
  * @brief   IO overlap data struct
  */ 
@@ -45,6 +73,8 @@ typedef struct _IOCP_IoContext
     IO_OPERATION    operation_;                 ///> Network operation type
     SOCKADDR_IN     remote_addr_;               ///> Remote address
     int             addr_size_;                 ///> Remote address length(for UDP)
+    IOCP_SharedBufferPtr shared_buf_;           ///> Shared send buffer, wsa_buf_ points to it when not NULL
+    void*           user_data_;                 ///> User data passed back on completion(for file transfer)
 
     _IOCP_IoContext()
     {
@@ -56,6 +86,17 @@ typedef struct _IOCP_IoContext
         operation_   = NULL_POSTED;
         addr_size_   = sizeof(SOCKADDR_IN);
         trans_len_   = 0;
+        user_data_   = NULL;
+    }
+
+    /**
+     * @brief   Send from a shared buffer instead of buf_
+     */
+    void SetSharedBuffer(const IOCP_SharedBufferPtr& shared_buf)
+    {
+        shared_buf_  = shared_buf;
+        wsa_buf_.buf = (char*)shared_buf->GetBuffer();
+        wsa_buf_.len = shared_buf->GetWritePtr();
     }
 
     /**
@@ -71,11 +112,13 @@ typedef struct _IOCP_IoContext
         ZeroMemory(&overlapped_,  sizeof(overlapped_));
         ZeroMemory(buf_,          MAX_IO_BUFFER_SIZE);
         ZeroMemory(&remote_addr_, sizeof(SOCKADDR_IN));
+        shared_buf_.reset();
         wsa_buf_.buf = buf_;
         wsa_buf_.len = MAX_IO_BUFFER_SIZE;
         operation_   = NULL_POSTED;
         addr_size_   = sizeof(SOCKADDR_IN);
         trans_len_   = 0;
+        user_data_   = NULL;
     }
 
     /**
@@ -85,6 +128,7 @@ typedef struct _IOCP_IoContext
     {
         ZeroMemory(&overlapped_,  sizeof(overlapped_));
         ZeroMemory(buf_,          MAX_IO_BUFFER_SIZE);
+        shared_buf_.reset();
         wsa_buf_.buf = buf_;
         wsa_buf_.len = MAX_IO_BUFFER_SIZE;
         addr_size_   = sizeof(SOCKADDR_IN);
@@ -156,17 +200,53 @@ typedef struct _IOCP_SocketContext
     SOCKET                  sock_;
     Mutex                   mt_io_list_;
     list<IOCP_IoContext*>   list_io_context_;
+    Mutex                   mt_send_;               ///> Keeps the pieces of one send together
     IOCP_IoContext          recv_context_;
     SOCKADDR_IN             local_addr_;
     unsigned long           sock_id_;               ///> Socket ID
     bool                    is_listen_sock_;
+    unsigned long           relay_peer_id_;         ///> Socket ID that received data is relayed to, 0 if none
+    bool                    relay_eof_;             ///> Relayed socket has received FIN
+    IOCP_TCPSessionPtr      session_;               ///> Session created by factory on accept, NULL if none
+    volatile LONG64         bytes_recv_;            ///> Bytes received since last autotuning
+    volatile LONG64         bytes_sent_;            ///> Bytes sent since last autotuning
+    volatile LONG           recv_count_;            ///> Receives since last autotuning
+    volatile LONG           recv_full_;             ///> Receives which filled the buffer since last autotuning
+    volatile LONG           tuning_;                ///> Autotuning is running
+    DWORD                   tune_tick_;             ///> Time of last autotuning
+    int                     rcvbuf_;                ///> SO_RCVBUF set by autotuning, 0 if not set
+    int                     sndbuf_;                ///> SO_SNDBUF set by autotuning, 0 if not set
+    IOCP_RELEASEFUNC        release_func_;          ///> Called once on reset, NULL if none
+    void*                   release_owner_;
+    bool                    recv_timestamp_;        ///> Receive by WSARecvMsg with kernel timestamp(UDP)
+    WSAMSG                  recv_msg_;              ///> Message of recv_context_ when recv_timestamp_
+    char                    recv_control_[MAX_IO_CONTROL_SIZE];
 
     _IOCP_SocketContext(IOCP_IoContextPool* pool_io_context)
         : pool_io_context_(pool_io_context)
         , sock_(INVALID_SOCKET)
         , sock_id_(0)
         , is_listen_sock_(false)
+        , relay_peer_id_(0)
+        , relay_eof_(false)
+        , release_func_(NULL)
+        , release_owner_(NULL)
+        , recv_timestamp_(false)
     {
+        ZeroMemory(&recv_msg_, sizeof(recv_msg_));
+        ResetTuning();
+    }
+
+    void ResetTuning()
+    {
+        bytes_recv_ = 0;
+        bytes_sent_ = 0;
+        recv_count_ = 0;
+        recv_full_  = 0;
+        tuning_     = 0;
+        tune_tick_  = GetTickCount();
+        rcvbuf_     = 0;
+        sndbuf_     = 0;
     }
 
     virtual ~_IOCP_SocketContext(void)
@@ -176,14 +256,37 @@ typedef struct _IOCP_SocketContext
 
     /**
      * @brief   Reset connection
+     * @param   abortive    true: close with RST instead of FIN, data not yet sent is discarded
      */
-    void Reset()
+    void Reset(bool abortive = false)
     {
         sock_id_        = 0;
         is_listen_sock_ = false;
+        relay_peer_id_  = 0;
+        relay_eof_      = false;
+        session_.reset();
+        ResetTuning();
+        recv_timestamp_ = false;
+        if (NULL != release_func_)
+        {
+            IOCP_RELEASEFUNC release_func = release_func_;
+            release_func_ = NULL;
+            release_func(release_owner_, local_addr_);
+        }
         if (INVALID_SOCKET != sock_)
         {
-            shutdown(sock_, SD_SEND);
+            if (abortive)
+            {
+                // Zero linger without shutdown makes closesocket send RST
+                LINGER linger;
+                linger.l_onoff  = 1;
+                linger.l_linger = 0;
+                setsockopt(sock_, SOL_SOCKET, SO_LINGER, (const char*)&linger, sizeof(linger));
+            }
+            else
+            {
+                shutdown(sock_, SD_SEND);
+            }
             closesocket(sock_);
             sock_ = INVALID_SOCKET;
         }
@@ -290,8 +393,10 @@ public:
 
     /**
      * @brief   Delete socket connection
+     * @param   abortive    true: close with RST instead of FIN
+     * @return  false if the connection is not active
      */
-    void DelActiveContext(unsigned long sock_id)
+    bool DelActiveContext(unsigned long sock_id, bool abortive = false)
     {
         IOCP_SocketContextPtr context_ptr;
         {
@@ -299,7 +404,7 @@ public:
             map<unsigned long, IOCP_SocketContextPtr>::iterator it = map_active_.find(sock_id);
             if (it == map_active_.end())
             {
-                return;
+                return false;
             } 
             else
             {
@@ -307,7 +412,7 @@ public:
                 map_active_.erase(it);
             }
         }
-        context_ptr->Reset();
+        context_ptr->Reset(abortive);
         {
             MutexLock lock(mt_idle_);
             if (list_idle_.size() < pool_size_)
@@ -315,6 +420,7 @@ public:
                 list_idle_.push_back(context_ptr);
             }
         }
+        return true;
     }
 
     /**
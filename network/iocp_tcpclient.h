@@ -3,6 +3,8 @@
  * @brief   Encapsulation for IOCP TCP client
  * @author  Nik Yan
  * @version 1.0     2014-07-21      Only support windows
+ * @update          2026-10-18      Add socket options profile
+ *                                  Add abortive close to CloseSocket
  */
 
 #ifndef _LITE_IOCP_TCP_CLIENT_H_
@@ -56,10 +58,11 @@ public:
     /**
      * @brief   Close the socket
      * @param   sock_id     Socket ID
+     * @param   abortive    true: reset the connection with RST instead of FIN
      */
-    void CloseSocket(unsigned long sock_id)
+    void CloseSocket(unsigned long sock_id, bool abortive = false)
     {
-        pool_sock_context_->DelActiveContext(sock_id);
+        pool_sock_context_->DelActiveContext(sock_id, abortive);
     }
 
     /**
@@ -71,6 +74,19 @@ public:
      */
     bool Send(unsigned long sock_id, const char* data, int data_len);
 
+    /**
+     * @brief   Set options of connected sockets(call before Start)
+     * @param   sock_options    e.g. IOCP_SocketOptions::LowLatency()
+     */
+    void SetSocketOptions(const IOCP_SocketOptions& sock_options)
+    {
+        sock_options_ = sock_options;
+        for (list<IOCP_TCPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+        {
+            (*it)->RegisterSocketOptions(sock_options_);
+        }
+    }
+
     /**
      * @brief   Stop IOCP
      */
@@ -97,6 +113,7 @@ protected:
                                           NULL,
                                           ReceivedCallback_,
                                           DisconnectedCallback_);
+            pthread->RegisterSocketOptions(sock_options_);
             list_work_thread_.push_back(pthread);
         }
     }
@@ -112,6 +129,7 @@ private:
     LPFN_GETACCEPTEXSOCKADDRS   GetAcceptExSockAddrs_;
     RECEIVEDCALLBACK            ReceivedCallback_;
     DISCONNECTEDCALLBACK        DisconnectedCallback_;
+    IOCP_SocketOptions          sock_options_;
 
     bool                        is_start_;
     HANDLE                      iocp_handle_;
@@ -175,6 +193,9 @@ bool IOCP_TCPClient::Connect(unsigned long& sock_id, const char* dst_ip, UINT16
         return false;
     }
 	
+    // Buffer sizes before connecting, so the window scale is negotiated for them
+    sock_options_.Apply(sock_context->sock_);
+
     SOCKADDR_IN* remote_addr     = &sock_context->recv_context_.remote_addr_;
     ZeroMemory(remote_addr, sizeof(SOCKADDR_IN));
     remote_addr->sin_family      = AF_INET;
@@ -3,6 +3,21 @@
  * @brief   Encapsulation for IOCP TCP Server
  * @author  Nik Yan
  * @version 1.0     2014-07-21      Only support windows
+ * @update          2026-10-18      Send splits msg longer than MAX_IO_BUFFER_SIZE
+ *                                  Add Send of shared buffer
+ *                                  Add SendFile by TransmitFile
+ *                                  Add ConnectRelay, forward data between two sockets
+ *                                  Add Send of shared buffer with completion callback
+ *                                  Add busy polling mode
+ *                                  Add per-connection session created by factory
+ *                                  Add socket options profile
+ *                                  Add admission control
+ *                                  Add receive byte budgets with ReleaseRecvBytes
+ *                                  Add receive callback with receive time
+ *                                  Send of one msg is not interleaved with other sends of the socket
+ *                                  Release receive bytes by connection generation
+ *                                  Receive budget of a connection is removed by CloseSocket and Stop
+ *                                  Add abortive close to CloseSocket
  */
 
 #ifndef _LITE_IOCP_TCP_SERVER_H_
@@ -24,7 +39,12 @@ public:
         , user_ptr_(NULL)
         , is_start_(false)
         , ReceivedCallback_(NULL)
+        , ReceivedTsCallback_(NULL)
         , DisconnectedCallback_(NULL)
+        , TransmitFile_(NULL)
+        , SendFileCallback_(NULL)
+        , SendCompletedCallback_(NULL)
+        , SessionFactory_(NULL)
     {
     }
 
@@ -51,23 +71,191 @@ public:
     bool Start();
 
     /**
-     * @brief   Close the socket
+     * @brief   Close the socket, bytes it holds of receive budget are given back
      * @param   sock_id     Socket ID
+     * @param   abortive    true: reset the connection with RST instead of FIN
      */
-    void CloseSocket(unsigned long sock_id)
-    {
-        pool_sock_context_->DelActiveContext(sock_id);
-    }
+    void CloseSocket(unsigned long sock_id, bool abortive = false);
 
     /**
      * @brief   Send msg(asynchronous delivery, not block)
      * @param   sock_id     Socket ID
      * @param   data        Msg data pointer
-     * @param   data_len    Msg length
+     * @param   data_len    Msg length(longer msg is split by MAX_IO_BUFFER_SIZE, the pieces are
+     *                      posted together, so sends from other threads do not interleave with them)
      * @return  true:Success, false:Failed
      */
     bool Send(unsigned long sock_id, const char* data, int data_len);
 
+    /**
+     * @brief   Send a shared buffer(asynchronous delivery, not block, no copy)
+     * @param   sock_id     Socket ID
+     * @param   shared_buf  Encoded msg, which is held until the send is completed
+     *                      and must not be modified after sending
+     * @return  true:Success, false:Failed
+     */
+    bool Send(unsigned long sock_id, const IOCP_SharedBufferPtr& shared_buf);
+
+    /**
+     * @brief   Set callback for completion of Send with context(optional)
+     */
+    void SetSendCompletedCallback(SENDCOMPLETEDCALLBACK SendCompletedCallback)
+    {
+        SendCompletedCallback_ = SendCompletedCallback;
+        for (list<IOCP_TCPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+        {
+            (*it)->RegisterSendCompletedFunc(SendCompletedCallback_);
+        }
+    }
+
+    /**
+     * @brief   Send a shared buffer, SENDCOMPLETEDCALLBACK is called with context when completed
+     * @param   context     Not NULL, passed back to SENDCOMPLETEDCALLBACK
+     * @return  true:Success, false:Failed
+     */
+    bool Send(unsigned long sock_id, const IOCP_SharedBufferPtr& shared_buf, void* context);
+
+    /**
+     * @brief   Set callback for SendFile completion(optional)
+     */
+    void SetSendFileCallback(SENDFILECALLBACK SendFileCallback)
+    {
+        SendFileCallback_ = SendFileCallback;
+        for (list<IOCP_TCPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+        {
+            (*it)->RegisterSendFileFunc(TransmitFile_, SendFileCallback_);
+        }
+    }
+
+    /**
+     * @brief   Register callback with receive time, used instead of RECEIVEDCALLBACK(call after Init)
+     *          Pass recv_us as Work::recv_us_ to a WorkQueue with LatencyBreakdown to see where time goes
+     */
+    void SetReceiveTimestampCallback(RECEIVEDTSCALLBACK ReceivedTsCallback)
+    {
+        ReceivedTsCallback_ = ReceivedTsCallback;
+        for (list<IOCP_TCPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+        {
+            (*it)->RegisterTimestampFunc(ReceivedTsCallback_);
+        }
+    }
+
+    /**
+     * @brief   Create a session for each accepted connection(call before Start)
+     *          Data and disconnection of the connection go to the session instead of callbacks,
+     *          ConnectedCallback is still called if not NULL
+     */
+    void SetSessionFactory(SESSIONFACTORY SessionFactory)
+    {
+        SessionFactory_ = SessionFactory;
+        for (list<IOCP_TCPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+        {
+            (*it)->RegisterSessionFactory(SessionFactory_);
+        }
+    }
+
+    /**
+     * @brief   Set options of accepted and relay sockets(call before Start)
+     * @param   sock_options    e.g. IOCP_SocketOptions::LowLatency()
+     */
+    void SetSocketOptions(const IOCP_SocketOptions& sock_options)
+    {
+        sock_options_ = sock_options;
+        for (list<IOCP_TCPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+        {
+            (*it)->RegisterSocketOptions(sock_options_);
+        }
+    }
+
+    /**
+     * @brief   Enable admission control and get it for setting limits(call after Init and before Start)
+     */
+    IOCP_AdmissionControl& GetAdmissionControl()
+    {
+        for (list<IOCP_TCPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+        {
+            (*it)->RegisterAdmissionControl(&admission_);
+        }
+        return admission_;
+    }
+
+    /**
+     * @brief   Enable receive budgets and get it for setting limits(call after Init and before Start)
+     *          Data delivered to RECEIVEDCALLBACK or session counts until released by ReleaseRecvBytes,
+     *          a connection over budget is not read, so memory held stays bounded under overload
+     */
+    IOCP_RecvBudget& GetRecvBudget()
+    {
+        for (list<IOCP_TCPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+        {
+            (*it)->RegisterRecvBudget(&recv_budget_);
+        }
+        return recv_budget_;
+    }
+
+    /**
+     * @brief   Give back received bytes the application has processed or freed,
+     *          connections paused by the budget receive again
+     * @param   sock_id     Socket ID the data was received on, may be closed already
+     * @param   bytes       Bytes released, data_len of RECEIVEDCALLBACK in total
+     * @param   generation  GetRecvGeneration taken when the data was received, 0 for the current connection.
+     *                      Socket IDs are reused, pass it if bytes may be released after the connection closes,
+     *                      so they are not credited to a new connection with the same ID
+     */
+    void ReleaseRecvBytes(unsigned long sock_id, uint32_t bytes, uint64_t generation = 0);
+
+    /**
+     * @brief   Get generation of a connection for ReleaseRecvBytes, call in RECEIVEDCALLBACK or session OnData
+     * @return  0 if receive budgets are not enabled or the connection is closed
+     */
+    uint64_t GetRecvGeneration(unsigned long sock_id)
+    {
+        return recv_budget_.Generation(sock_id);
+    }
+
+    /**
+     * @brief   Send a range of file(asynchronous delivery, not block)
+     *          Data is sent by TransmitFile from file cache without copying to user memory
+     * @param   sock_id     Socket ID
+     * @param   fd          File descriptor(CRT), file must stay open until completion
+     * @param   offset      Start offset in file
+     * @param   len         Bytes to send(not more than 2GB-2)
+     * @param   context     Passed back to SENDFILECALLBACK
+     * @return  true:Success, false:Failed
+     * @note    Sends on the same socket must not be posted while the file transfer is pending,
+     *          or data may interleave
+     */
+    bool SendFile(unsigned long sock_id, int fd, uint64_t offset, uint32_t len, void* context = NULL);
+
+    /**
+     * @brief   Connect to a destination and relay data between it and an accepted socket
+     *          Data is forwarded from the recv buffer directly, and a side is not read again
+     *          until its data has been sent to the other side, so the slow side limits the fast one.
+     *          FIN is forwarded as half-close, and both sockets are closed when both sides finish.
+     *          RECEIVEDCALLBACK is not called for relayed sockets.
+     * @param   sock_id         Accepted socket ID
+     * @param   dst_ip          Destination ip address
+     * @param   dst_port        Destination port
+     * @param   peer_sock_id    Socket ID of the destination connection
+     * @return  true:Success, false:Failed
+     * @note    Call it in CONNECTEDCALLBACK(connect blocks the calling work thread),
+     *          so no data of the accepted socket is delivered to RECEIVEDCALLBACK
+     */
+    bool ConnectRelay(unsigned long sock_id, const char* dst_ip, UINT16 dst_port, unsigned long& peer_sock_id);
+
+    /**
+     * @brief   Opt-in busy polling for latency critical servers(call after Init and before Start)
+     *          Workers spin on the completion port and block again after idle for busy_poll_us,
+     *          so a completion is picked up without waking a blocked thread
+     * @param   num_workers     Work threads kept, others are removed so none of them blocks
+     *                          on the port and takes completions from the spinning ones.
+     *                          Each worker occupies a core while spinning.
+     * @param   busy_poll_us    Spin time after the last completion, 0 to disable
+     * @param   first_cpu       Worker i is pinned to CPU first_cpu + i, -1 for no pinning
+     * @return  true:Success, false:Failed
+     */
+    bool SetBusyPoll(uint32_t num_workers, uint32_t busy_poll_us, int first_cpu = -1);
+
     /**
      * @brief   Stop IOCP
      */
@@ -113,10 +301,20 @@ protected:
                                           ConnectedCallback_,
                                           ReceivedCallback_,
                                           DisconnectedCallback_);
+            pthread->RegisterSendFileFunc(TransmitFile_, SendFileCallback_);
+            pthread->RegisterSendCompletedFunc(SendCompletedCallback_);
+            pthread->RegisterTimestampFunc(ReceivedTsCallback_);
+            pthread->RegisterSessionFactory(SessionFactory_);
+            pthread->RegisterSocketOptions(sock_options_);
             list_work_thread_.push_back(pthread);
         }
     }
 
+    /**
+     * @brief   Post recv of connections resumed by receive budget
+     */
+    void _ResumeRecv(const vector<unsigned long>& resume);
+
     int _GetNoOfProcessors()
     {
         SYSTEM_INFO si;
@@ -128,7 +326,15 @@ private:
     LPFN_GETACCEPTEXSOCKADDRS   GetAcceptExSockAddrs_;
     CONNECTEDCALLBACK           ConnectedCallback_;
     RECEIVEDCALLBACK            ReceivedCallback_;
+    RECEIVEDTSCALLBACK          ReceivedTsCallback_;
     DISCONNECTEDCALLBACK        DisconnectedCallback_;
+    LPFN_TRANSMITFILE           TransmitFile_;
+    SENDFILECALLBACK            SendFileCallback_;
+    SENDCOMPLETEDCALLBACK       SendCompletedCallback_;
+    SESSIONFACTORY              SessionFactory_;
+    IOCP_SocketOptions          sock_options_;
+    IOCP_AdmissionControl       admission_;
+    IOCP_RecvBudget             recv_budget_;
 
     bool                        is_start_;
     HANDLE                      iocp_handle_;
@@ -212,13 +418,200 @@ bool IOCP_TCPServer::Send(unsigned long sock_id, const char* data, int data_len)
     {
         return false;
     }
+    // Split the msg by IO buffer size, overlapped sends on one socket complete in post order.
+    // The pieces are posted under the send lock, so a concurrent Send is not interleaved with them
+    IOCP_TCPWorkThread* worker = list_work_thread_.front();
+    MutexLock lock(sock_content->mt_send_);
+    while (data_len > 0)
+    {
+        int send_len = data_len > MAX_IO_BUFFER_SIZE ? MAX_IO_BUFFER_SIZE : data_len;
+        IOCP_IoContext* io_context = pool_io_context_->GetIoContext();
+        memcpy(io_context->buf_, data, send_len);
+        io_context->wsa_buf_.len   = send_len;
+        sock_content->AddContext(io_context);
+        if (!worker->PostSend(sock_content, io_context))
+        {
+            return false;
+        }
+        data     += send_len;
+        data_len -= send_len;
+    }
+    return true;
+}
+
+inline
+bool IOCP_TCPServer::Send(unsigned long sock_id, const IOCP_SharedBufferPtr& shared_buf)
+{
+    return Send(sock_id, shared_buf, NULL);
+}
+
+inline
+bool IOCP_TCPServer::Send(unsigned long sock_id, const IOCP_SharedBufferPtr& shared_buf, void* context)
+{
+    if (!is_start_ || NULL == shared_buf.get())
+    {
+        return false;
+    }
+    IOCP_SocketContextPtr sock_content = pool_sock_context_->GetActiveContext(sock_id);
+    if (NULL == sock_content.get())
+    {
+        return false;
+    }
+    IOCP_IoContext* io_context = pool_io_context_->GetIoContext();
+    io_context->SetSharedBuffer(shared_buf);
+    io_context->user_data_     = context;
+    sock_content->AddContext(io_context);
+
+    IOCP_TCPWorkThread* worker = list_work_thread_.front();
+    MutexLock lock(sock_content->mt_send_);
+    return worker->PostSend(sock_content, io_context);
+}
+
+inline
+void IOCP_TCPServer::CloseSocket(unsigned long sock_id, bool abortive)
+{
+    pool_sock_context_->DelActiveContext(sock_id, abortive);
+    // Later releases of its bytes are ignored, a new connection with the same ID gets a new generation
+    vector<unsigned long> resume;
+    recv_budget_.Remove(sock_id, resume);
+    _ResumeRecv(resume);
+}
+
+inline
+void IOCP_TCPServer::ReleaseRecvBytes(unsigned long sock_id, uint32_t bytes, uint64_t generation)
+{
+    vector<unsigned long> resume;
+    recv_budget_.Release(sock_id, generation, bytes, resume);
+    _ResumeRecv(resume);
+}
+
+inline
+void IOCP_TCPServer::_ResumeRecv(const vector<unsigned long>& resume)
+{
+    if (!is_start_ || resume.empty())
+    {
+        return;
+    }
+    IOCP_TCPWorkThread* worker = list_work_thread_.front();
+    for (size_t i = 0; i < resume.size(); i++)
+    {
+        IOCP_SocketContextPtr sock_context = pool_sock_context_->GetActiveContext(resume[i]);
+        if (NULL != sock_context.get())
+        {
+            worker->PostRecv(sock_context);
+        }
+    }
+}
+
+inline
+bool IOCP_TCPServer::SendFile(unsigned long sock_id, int fd, uint64_t offset, uint32_t len, void* context)
+{
+    if (!is_start_ || 0 == len || len > 0x7FFFFFFE)
+    {
+        return false;
+    }
+    HANDLE file = (HANDLE)_get_osfhandle(fd);
+    if (INVALID_HANDLE_VALUE == file)
+    {
+        return false;
+    }
+    IOCP_SocketContextPtr sock_content = pool_sock_context_->GetActiveContext(sock_id);
+    if (NULL == sock_content.get())
+    {
+        return false;
+    }
     IOCP_IoContext* io_context = pool_io_context_->GetIoContext();
-    memcpy(io_context->buf_, data, data_len);
-    io_context->wsa_buf_.len   = data_len;
+    io_context->user_data_     = context;
     sock_content->AddContext(io_context);
 
     IOCP_TCPWorkThread* worker = list_work_thread_.front();
-    return worker->PostSend(sock_content, io_context); 
+    if (!worker->PostTransmitFile(sock_content, io_context, file, offset, len))
+    {
+        sock_content->RemoveContext(io_context);
+        return false;
+    }
+    return true;
+}
+
+inline
+bool IOCP_TCPServer::ConnectRelay(unsigned long sock_id, const char* dst_ip, UINT16 dst_port, unsigned long& peer_sock_id)
+{
+    if (!is_start_)
+    {
+        return false;
+    }
+    IOCP_SocketContextPtr src_context = pool_sock_context_->GetActiveContext(sock_id);
+    if (NULL == src_context.get())
+    {
+        return false;
+    }
+
+    IOCP_SocketContextPtr sock_context = pool_sock_context_->GetSocketContext();
+    sock_context->sock_ = WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0, WSA_FLAG_OVERLAPPED);
+    if (INVALID_SOCKET == sock_context->sock_)
+    {
+        pool_sock_context_->PutSocketContext(sock_context);
+        return false;
+    }
+
+    // Buffer sizes before connecting, so the window scale is negotiated for them
+    sock_options_.Apply(sock_context->sock_);
+
+    SOCKADDR_IN* remote_addr     = &sock_context->recv_context_.remote_addr_;
+    ZeroMemory(remote_addr, sizeof(SOCKADDR_IN));
+    remote_addr->sin_family      = AF_INET;
+    remote_addr->sin_addr.s_addr = inet_addr(dst_ip);
+    remote_addr->sin_port        = htons(dst_port);
+    int ret = WSAConnect(sock_context->sock_,
+                         (PSOCKADDR)remote_addr,
+                         sizeof(SOCKADDR_IN),
+                         NULL, NULL, NULL, NULL);
+    if (SOCKET_ERROR == ret && WSAEWOULDBLOCK != WSAGetLastError())
+    {
+        closesocket(sock_context->sock_);
+        sock_context->sock_ = INVALID_SOCKET;
+        pool_sock_context_->PutSocketContext(sock_context);
+        return false;
+    }
+
+    sock_context->sock_id_       = (unsigned long)sock_context->sock_;
+    sock_context->relay_peer_id_ = sock_id;
+    peer_sock_id                 = sock_context->sock_id_;
+    pool_sock_context_->AddActiveContext(sock_context);
+    src_context->relay_peer_id_  = peer_sock_id;
+
+    IOCP_TCPWorkThread* worker = list_work_thread_.front();
+    if (!worker->AssociateWithIOCP(sock_context))
+    {
+        src_context->relay_peer_id_ = 0;
+        pool_sock_context_->DelActiveContext(peer_sock_id);
+        return false;
+    }
+    return worker->PostRecv(sock_context);
+}
+
+inline
+bool IOCP_TCPServer::SetBusyPoll(uint32_t num_workers, uint32_t busy_poll_us, int first_cpu)
+{
+    if (is_start_ || 0 == num_workers || list_work_thread_.empty())
+    {
+        return false;
+    }
+    while (list_work_thread_.size() > num_workers)
+    {
+        delete list_work_thread_.back();
+        list_work_thread_.pop_back();
+    }
+    int cpu = first_cpu;
+    for (list<IOCP_TCPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+    {
+        (*it)->SetBusyPoll(busy_poll_us, cpu);
+        if (cpu >= 0)
+        {
+            cpu++;
+        }
+    }
+    return true;
 }
 
 inline
@@ -238,6 +631,7 @@ void IOCP_TCPServer::Stop()
     }
     
     pool_sock_context_->ClearActiveContext();
+    recv_budget_.Clear();
 
     for (list<IOCP_IoContext*>::iterator it = listen_sock_context_->list_io_context_.begin();
          it != listen_sock_context_->list_io_context_.end(); it++)
@@ -275,6 +669,7 @@ bool IOCP_TCPServer::_InitializeListenSocket()
     // GUID of AcceptEx and GetAcceptExSockaddrs, used to export function
     GUID guid_acceptex             = WSAID_ACCEPTEX;  
     GUID guid_getacceptexsockaddrs = WSAID_GETACCEPTEXSOCKADDRS; 
+    GUID guid_transmitfile         = WSAID_TRANSMITFILE;
 
     // Overlap IO should be use WSASocket to create socket
     listen_sock_context_                  = pool_sock_context_->GetSocketContext();
@@ -349,6 +744,19 @@ bool IOCP_TCPServer::_InitializeListenSocket()
             break;
         }
 
+        if (SOCKET_ERROR == WSAIoctl(listen_sock_context_->sock_,
+                                     SIO_GET_EXTENSION_FUNCTION_POINTER,
+                                     &guid_transmitfile,
+                                     sizeof(guid_transmitfile),
+                                     &TransmitFile_,
+                                     sizeof(TransmitFile_),
+                                     &dw_bytes,
+                                     NULL,
+                                     NULL))
+        {
+            break;
+        }
+
         return true;
     } while (0);
 
@@ -3,13 +3,31 @@
  * @brief   Encapsulation for IOCP TCP work thread
  * @author  Nik Yan
  * @version 1.0     2014-07-20      Only support windows
+ * @update          2026-10-18      Add file transfer by TransmitFile
+ *                                  Add relay between two sockets
+ *                                  Add callback for completed send with context
+ *                                  Add busy polling mode
+ *                                  Add per-connection session created by factory
+ *                                  Add socket options on accept and buffer autotuning
+ *                                  Add admission control on accept
+ *                                  Add receive byte budgets, recv is not posted while exceeded
+ *                                  Add receive callback with receive time
+ *                                  Add allocation scopes, posting recv and send must not allocate
+ *                                  Failed file transfer closes its connection instead of stopping the thread
+ *                                  DISCONNECTEDCALLBACK is not repeated for a removed connection with session factory
+ *                                  Socket paused by receive budget is watched by zero byte recv
  */
 
 #ifndef _LITE_IOCP_TCP_WORK_THREAD_H_
 #define _LITE_IOCP_TCP_WORK_THREAD_H_
 
 #include "iocp_base.h"
+#include "socket_options.h"
+#include "admission_control.h"
+#include "recv_budget.h"
 #include "event/thread.h"
+#include "tools/time_tool.h"
+#include "tools/alloc_tracker.h"
 
 #ifdef OS_WIN
 
@@ -36,6 +54,15 @@ typedef void (*CONNECTEDCALLBACK)(unsigned long sock_id, void* user_ptr);
  */
 typedef void (*RECEIVEDCALLBACK)(unsigned long sock_id, const char* data, int data_len, void* user_ptr);
 
+/**
+ * @brief   Callback function when tcp socket recv msg, with receive time
+ * @param   recv_us     Time the receive completion was taken from the port, same clock as GetMonotonicMicroSecond.
+ *                      Windows timestamps only datagrams in the kernel(SIO_TIMESTAMPING), so for TCP this is
+ *                      the earliest time known in user space
+ * @note    Used instead of RECEIVEDCALLBACK when registered
+ */
+typedef void (*RECEIVEDTSCALLBACK)(unsigned long sock_id, const char* data, int data_len, uint64_t recv_us, void* user_ptr);
+
 /**
  * @brief   Callback function when tcp disconnect
  * @param   sock_id     Socket ID which disconnect
@@ -44,6 +71,72 @@ typedef void (*RECEIVEDCALLBACK)(unsigned long sock_id, const char* data, int da
  */
 typedef void (*DISCONNECTEDCALLBACK)(unsigned long sock_id, void* user_ptr);
 
+/**
+ * @brief   Callback function when a file transfer completes
+ * @param   sock_id     Socket ID
+ * @param   bytes_sent  Bytes transferred
+ * @param   success     Whether the whole range was sent
+ * @param   context     Context passed to SendFile
+ * @param   user_ptr    User pointer
+ * @note    This function needs to return quickly
+ */
+typedef void (*SENDFILECALLBACK)(unsigned long sock_id, uint32_t bytes_sent, bool success, void* context, void* user_ptr);
+
+/**
+ * @brief   Callback function when a send posted with context completes
+ * @param   sock_id     Socket ID
+ * @param   context     Context passed to Send
+ * @param   user_ptr    User pointer
+ * @note    Not called if the connection is closed before completion
+ */
+typedef void (*SENDCOMPLETEDCALLBACK)(unsigned long sock_id, void* context, void* user_ptr);
+
+/**
+ * @brief   Per-connection state, stored in the socket context so no lookup by sock_id is needed
+ *          RECEIVEDCALLBACK and DISCONNECTEDCALLBACK are not called for a connection with session
+ */
+class IOCP_TCPSession : private NonCopyable
+{
+public:
+    IOCP_TCPSession() : sock_id_(0)
+    {
+    }
+
+    virtual ~IOCP_TCPSession()
+    {
+    }
+
+    unsigned long SockId() const
+    {
+        return sock_id_;
+    }
+
+    /**
+     * @brief   Connection recv msg, calls of a session are not concurrent
+     * @note    This function needs to return quickly, or it will block the work thread of IOCP
+     */
+    virtual void OnData(const char* data, int data_len) = 0;
+
+    /**
+     * @brief   Connection disconnected by peer or IO error(not called for CloseSocket)
+     */
+    virtual void OnClose()
+    {
+    }
+
+private:
+    friend class IOCP_TCPWorkThread;
+    unsigned long   sock_id_;
+};
+
+/**
+ * @brief   Create session for a new tcp connection
+ * @param   sock_id     Socket ID
+ * @param   user_ptr    User pointer
+ * @return  Session allocated by new and released by the library, NULL to refuse the connection
+ */
+typedef IOCP_TCPSession* (*SESSIONFACTORY)(unsigned long sock_id, void* user_ptr);
+
 class IOCP_TCPWorkThread : public Thread
 {
 public:
@@ -54,7 +147,16 @@ public:
         , AcceptEx_(NULL)
         , GetAcceptExSockAddrs_(NULL)
         , ReceivedCallback_(NULL)
+        , ReceivedTsCallback_(NULL)
         , DisconnectedCallback_(NULL)
+        , TransmitFile_(NULL)
+        , SendFileCallback_(NULL)
+        , SendCompletedCallback_(NULL)
+        , SessionFactory_(NULL)
+        , admission_(NULL)
+        , recv_budget_(NULL)
+        , busy_poll_us_(0)
+        , cpu_(-1)
     {
     }
 
@@ -72,6 +174,64 @@ public:
         DisconnectedCallback_ = DisconnectedCallback;
     }
 
+    void RegisterSendFileFunc(LPFN_TRANSMITFILE TransmitFile, SENDFILECALLBACK SendFileCallback)
+    {
+        TransmitFile_     = TransmitFile;
+        SendFileCallback_ = SendFileCallback;
+    }
+
+    void RegisterSendCompletedFunc(SENDCOMPLETEDCALLBACK SendCompletedCallback)
+    {
+        SendCompletedCallback_ = SendCompletedCallback;
+    }
+
+    void RegisterTimestampFunc(RECEIVEDTSCALLBACK ReceivedTsCallback)
+    {
+        ReceivedTsCallback_ = ReceivedTsCallback;
+    }
+
+    void RegisterSessionFactory(SESSIONFACTORY SessionFactory)
+    {
+        SessionFactory_ = SessionFactory;
+    }
+
+    /**
+     * @brief   Options set on accepted sockets, and autotuning on IO completions
+     */
+    void RegisterSocketOptions(const IOCP_SocketOptions& sock_options)
+    {
+        sock_options_ = sock_options;
+    }
+
+    /**
+     * @brief   Check accepted connections before allocating anything for them
+     * @param   admission   NULL to accept all
+     */
+    void RegisterAdmissionControl(IOCP_AdmissionControl* admission)
+    {
+        admission_ = admission;
+    }
+
+    /**
+     * @brief   Charge data delivered to the application, stop posting recv while a budget is exceeded
+     * @param   recv_budget NULL for no limit
+     */
+    void RegisterRecvBudget(IOCP_RecvBudget* recv_budget)
+    {
+        recv_budget_ = recv_budget;
+    }
+
+    /**
+     * @brief   Spin on the completion port instead of blocking(call before Start)
+     * @param   busy_poll_us    Spin time after the last completion before blocking again, 0 to disable
+     * @param   cpu             CPU the thread is pinned to, -1 for no pinning
+     */
+    void SetBusyPoll(uint32_t busy_poll_us, int cpu)
+    {
+        busy_poll_us_ = busy_poll_us;
+        cpu_          = cpu;
+    }
+
     /**
      * @brief   Bind Sockets to IOCP
      */
@@ -91,9 +251,31 @@ public:
      * @brief   Delivery send
      */
     bool PostSend(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context);
+
+    /**
+     * @brief   Delivery zero byte recv, which completes when data or FIN arrives without reading it,
+     *          so disconnection of a socket paused by receive budget is noticed
+     */
+    bool PostProbe(IOCP_SocketContextPtr sock_context);
+
+    /**
+     * @brief   Delivery file transfer, data goes from file cache to socket inside kernel
+     */
+    bool PostTransmitFile(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context,
+                          HANDLE file, uint64_t offset, uint32_t len);
+
+    /**
+     * @brief   Close socket and its relay peer, notify disconnection
+     */
+    void CloseConnection(unsigned long sock_id);
 protected:
     virtual uint32_t _Run();
 
+    /**
+     * @brief   Get a completion, spin for busy_poll_us_ first in busy polling mode
+     */
+    BOOL _GetCompletion(DWORD& bytes_transfered, unsigned long& sock_id, LPOVERLAPPED& overlapped);
+
     /**
      * @brief   Processing IO results
      */
@@ -105,6 +287,61 @@ protected:
 
     void _DoSend(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context)
     {
+        if (sock_options_.autotune_)
+        {
+            InterlockedExchangeAdd64(&sock_context->bytes_sent_, io_context->wsa_buf_.len);
+            IOCP_AutoTune(sock_context.get(), sock_options_);
+        }
+        void* context = io_context->user_data_;
+        sock_context->RemoveContext(io_context);
+        if (NULL != context && NULL != SendCompletedCallback_)
+        {
+            SendCompletedCallback_(sock_context->sock_id_, context, user_ptr_);
+        }
+    }
+
+    /**
+     * @brief   Send received data of a relayed socket to its peer from the recv buffer
+     *          The next recv is posted when the send completes, so a slow peer stops the reading
+     */
+    bool _DoRelayForward(IOCP_SocketContextPtr sock_context);
+
+    /**
+     * @brief   Relay send completed on sock_context(the destination)
+     */
+    bool _DoRelaySend(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context, DWORD bytes_transfered);
+
+    /**
+     * @brief   Relayed socket received FIN, half-close the peer
+     */
+    void _DoRelayEof(IOCP_SocketContextPtr sock_context);
+
+    /**
+     * @brief   Remove an active connection, notify its session or DisconnectedCallback
+     * @return  false if the connection is not active
+     */
+    bool _RemoveConnection(unsigned long sock_id);
+
+    /**
+     * @brief   Zero byte recv of a paused socket completed, close the connection on FIN or error
+     */
+    void _DoProbe(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context);
+
+    /**
+     * @brief   Post recv of connections resumed by receive budget
+     */
+    void _ResumeRecv(const vector<unsigned long>& resume);
+
+    void _DoTransmitFile(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context, DWORD bytes_transfered, bool success)
+    {
+        if (NULL != SendFileCallback_)
+        {
+            SendFileCallback_(sock_context->sock_id_,
+                              (uint32_t)bytes_transfered,
+                              success && bytes_transfered == (DWORD)io_context->trans_len_,
+                              io_context->user_data_,
+                              user_ptr_);
+        }
         sock_context->RemoveContext(io_context);
     }
     
@@ -116,7 +353,17 @@ private:
 
     CONNECTEDCALLBACK           ConnectedCallback_;
     RECEIVEDCALLBACK            ReceivedCallback_;
+    RECEIVEDTSCALLBACK          ReceivedTsCallback_;
     DISCONNECTEDCALLBACK        DisconnectedCallback_;
+    LPFN_TRANSMITFILE           TransmitFile_;          ///> TransmitFile function pointer
+    SENDFILECALLBACK            SendFileCallback_;
+    SENDCOMPLETEDCALLBACK       SendCompletedCallback_;
+    SESSIONFACTORY              SessionFactory_;
+    IOCP_SocketOptions          sock_options_;
+    IOCP_AdmissionControl*      admission_;
+    IOCP_RecvBudget*            recv_budget_;
+    uint32_t                    busy_poll_us_;          ///> Spin time before blocking, 0 if busy polling is off
+    int                         cpu_;                   ///> Pinned CPU, -1 if not pinned
 
     HANDLE                      iocp_handle_;           ///> IOCP handle
     IOCP_SocketContextPool*     pool_sock_context_;     ///> Socket pool
@@ -131,17 +378,36 @@ uint32_t IOCP_TCPWorkThread::_Run()
     unsigned long           sock_id          = 0;
     LPOVERLAPPED            overlapped       = NULL;
     IOCP_IoContext*         io_data          = NULL;
+    if (cpu_ >= 0)
+    {
+        SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu_);
+    }
     while (!_Signalled())
     {
-        BOOL ret = GetQueuedCompletionStatus(iocp_handle_,
-                                             &bytes_transfered,
-                                             (PULONG_PTR)&sock_id,
-                                             &overlapped,
-                                             500);
+        BOOL ret = _GetCompletion(bytes_transfered, sock_id, overlapped);
         IOCP_SocketContextPtr sock_context = pool_sock_context_->GetActiveContext(sock_id);
         if (!ret)
         {
-            if (_HandleError(sock_context, GetLastError()))
+            DWORD err = GetLastError();
+            // Failed file transfer still completes its IO context, then its connection is closed
+            // and the thread goes on
+            if (NULL != overlapped && NULL != sock_context.get())
+            {
+                io_data = CONTAINING_RECORD(overlapped, IOCP_IoContext, overlapped_);
+                if (TRANSMIT_POSTED == io_data->operation_)
+                {
+                    _DoTransmitFile(sock_context, io_data, bytes_transfered, false);
+                    CloseConnection(sock_id);
+                    continue;
+                }
+                if (PROBE_POSTED == io_data->operation_)
+                {
+                    sock_context->RemoveContext(io_data);
+                    CloseConnection(sock_id);
+                    continue;
+                }
+            }
+            if (_HandleError(sock_context, err))
             {
                 continue;
             }
@@ -158,11 +424,18 @@ uint32_t IOCP_TCPWorkThread::_Run()
         }
 
         // If IO data has a length of 0 && (is a receive or send operation), connection needs to be closed
-        if (0 == bytes_transfered && (RECV_POSTED == io_data->operation_ || SEND_POSTED == io_data->operation_))
+        if (0 == bytes_transfered && (RECV_POSTED  == io_data->operation_ ||
+                                      SEND_POSTED  == io_data->operation_ ||
+                                      RELAY_POSTED == io_data->operation_))
         {
+            // Relayed socket keeps the other direction running
+            if (RECV_POSTED == io_data->operation_ && NULL != sock_context.get() && 0 != sock_context->relay_peer_id_)
+            {
+                _DoRelayEof(sock_context);
+                continue;
+            }
             // Unbind, free connection
-            pool_sock_context_->DelActiveContext(sock_id);
-            DisconnectedCallback_(sock_id, user_ptr_);
+            CloseConnection(sock_id);
             continue;
         }
 
@@ -186,6 +459,24 @@ uint32_t IOCP_TCPWorkThread::_Run()
                 _DoSend(sock_context, io_data);
             }
             break;
+
+        case TRANSMIT_POSTED:
+            {
+                _DoTransmitFile(sock_context, io_data, bytes_transfered, true);
+            }
+            break;
+
+        case RELAY_POSTED:
+            {
+                _DoRelaySend(sock_context, io_data, bytes_transfered);
+            }
+            break;
+
+        case PROBE_POSTED:
+            {
+                _DoProbe(sock_context, io_data);
+            }
+            break;
         default:
             break;
         }
@@ -208,6 +499,56 @@ bool IOCP_TCPWorkThread::AssociateWithIOCP(IOCP_SocketContextPtr sock_context)
     return true;
 }
 
+inline
+BOOL IOCP_TCPWorkThread::_GetCompletion(DWORD& bytes_transfered, unsigned long& sock_id, LPOVERLAPPED& overlapped)
+{
+    if (0 != busy_poll_us_)
+    {
+        LARGE_INTEGER freq, start, now;
+        QueryPerformanceFrequency(&freq);
+        QueryPerformanceCounter(&start);
+        LONGLONG idle_ticks = freq.QuadPart * busy_poll_us_ / 1000000;
+        for (uint32_t spins = 1; ; spins++)
+        {
+            overlapped = NULL;
+            BOOL ret = GetQueuedCompletionStatus(iocp_handle_,
+                                                 &bytes_transfered,
+                                                 (PULONG_PTR)&sock_id,
+                                                 &overlapped,
+                                                 0);
+            // Got a completion or a real error
+            if (ret || NULL != overlapped || WAIT_TIMEOUT != GetLastError())
+            {
+                return ret;
+            }
+
+            // Check idle time and stop signal every 64 spins, pause the core between polls
+            if (0 != (spins & 63))
+            {
+                YieldProcessor();
+                continue;
+            }
+            QueryPerformanceCounter(&now);
+            if (now.QuadPart - start.QuadPart >= idle_ticks || _Signalled())
+            {
+                break;
+            }
+            // Long idle, give the core to other threads on it between polls
+            if (spins >= 4096)
+            {
+                SwitchToThread();
+            }
+        }
+    }
+
+    // Idle for busy_poll_us_, block until next completion
+    return GetQueuedCompletionStatus(iocp_handle_,
+                                     &bytes_transfered,
+                                     (PULONG_PTR)&sock_id,
+                                     &overlapped,
+                                     500);
+}
+
 inline
 bool IOCP_TCPWorkThread::_HandleError(IOCP_SocketContextPtr sock_context, DWORD err)
 {
@@ -223,15 +564,13 @@ bool IOCP_TCPWorkThread::_HandleError(IOCP_SocketContextPtr sock_context, DWORD
         // Disconnect
         if (-1 == byte_send)
         {
-            pool_sock_context_->DelActiveContext(sock_id);
-            DisconnectedCallback_(sock_id, user_ptr_);
+            CloseConnection(sock_id);
         }
         return true;
     }
     else if (!sock_context->is_listen_sock_ && ERROR_NETNAME_DELETED == err)  ///> Peer has been disconnected
     {
-        pool_sock_context_->DelActiveContext(sock_id);
-        DisconnectedCallback_(sock_id, user_ptr_);
+        CloseConnection(sock_id);
         return true;
     }
     else ///> IO exception
@@ -288,10 +627,28 @@ bool IOCP_TCPWorkThread::_DoAccept(IOCP_SocketContextPtr sock_context, IOCP_IoCo
                           (LPSOCKADDR*)&remote_addr,
                           &remote_len);
 
+    // Refuse before anything is allocated, reset is cheaper than graceful close
+    if (NULL != admission_ && !admission_->Admit(*remote_addr))
+    {
+        LINGER linger;
+        linger.l_onoff  = 1;
+        linger.l_linger = 0;
+        setsockopt(io_context->sock_accept_, SOL_SOCKET, SO_LINGER, (const char*)&linger, sizeof(linger));
+        closesocket(io_context->sock_accept_);
+        io_context->sock_accept_ = INVALID_SOCKET;
+        io_context->ResetBuffer();
+        return PostAccept(sock_context, io_context);
+    }
+
     IOCP_SocketContextPtr new_sock_context = pool_sock_context_->GetSocketContext();
     new_sock_context->sock_                = io_context->sock_accept_;
     new_sock_context->sock_id_             = (unsigned long)io_context->sock_accept_;
     memcpy(&new_sock_context->local_addr_, remote_addr, sizeof(SOCKADDR_IN));
+    if (NULL != admission_)
+    {
+        new_sock_context->release_func_  = IOCP_AdmissionControl::ReleaseFunc;
+        new_sock_context->release_owner_ = admission_;
+    }
 
     pool_sock_context_->AddActiveContext(new_sock_context);
     if(!AssociateWithIOCP(new_sock_context))
@@ -299,12 +656,32 @@ bool IOCP_TCPWorkThread::_DoAccept(IOCP_SocketContextPtr sock_context, IOCP_IoCo
         pool_sock_context_->DelActiveContext(new_sock_context->sock_id_);
         return false;
     }
+    sock_options_.Apply(new_sock_context->sock_);
 
-    ConnectedCallback_(new_sock_context->sock_id_, user_ptr_);
+    if (NULL != SessionFactory_)
+    {
+        IOCP_TCPSession* session = SessionFactory_(new_sock_context->sock_id_, user_ptr_);
+        if (NULL == session)
+        {
+            // Refused, go on accepting
+            pool_sock_context_->DelActiveContext(new_sock_context->sock_id_);
+            io_context->ResetBuffer();
+            return PostAccept(sock_context, io_context);
+        }
+        session->sock_id_          = new_sock_context->sock_id_;
+        new_sock_context->session_ = IOCP_TCPSessionPtr(session);
+    }
+    if (NULL != recv_budget_)
+    {
+        recv_budget_->Add(new_sock_context->sock_id_);
+    }
+    if (NULL != ConnectedCallback_)
+    {
+        ConnectedCallback_(new_sock_context->sock_id_, user_ptr_);
+    }
+    // PostRecv notifies the disconnection on failure
     if(!PostRecv(new_sock_context))
     {
-        pool_sock_context_->DelActiveContext(new_sock_context->sock_id_);
-        DisconnectedCallback_(new_sock_context->sock_id_, user_ptr_);
         return false;
     }
 
@@ -318,55 +695,333 @@ bool IOCP_TCPWorkThread::PostRecv(IOCP_SocketContextPtr sock_context)
     DWORD dw_flags = 0;
     int   ret      = 0;
 
-    sock_context->recv_context_.ResetBuffer();
-    sock_context->recv_context_.operation_ = RECV_POSTED;
-    ret = WSARecv(sock_context->sock_,
-                  &sock_context->recv_context_.wsa_buf_,
-                  1,
-                  (DWORD*)&sock_context->recv_context_.trans_len_,
-                  &dw_flags,
-                  &sock_context->recv_context_.overlapped_,
-                  NULL);
+    {
+        LITE_NO_ALLOC_SCOPE();
+        sock_context->recv_context_.ResetBuffer();
+        sock_context->recv_context_.operation_ = RECV_POSTED;
+        ret = WSARecv(sock_context->sock_,
+                      &sock_context->recv_context_.wsa_buf_,
+                      1,
+                      (DWORD*)&sock_context->recv_context_.trans_len_,
+                      &dw_flags,
+                      &sock_context->recv_context_.overlapped_,
+                      NULL);
+    }
     if ((0 != ret) && (WSA_IO_PENDING != WSAGetLastError()))
     {
-        pool_sock_context_->DelActiveContext(sock_context->sock_id_);
-        DisconnectedCallback_(sock_context->sock_id_, user_ptr_);
+        CloseConnection(sock_context->sock_id_);
         return false;
     }
     return true;
 }
 
+inline
+bool IOCP_TCPWorkThread::PostProbe(IOCP_SocketContextPtr sock_context)
+{
+    DWORD dw_flags = 0;
+    int   ret      = 0;
+
+    IOCP_IoContext* io_context = sock_context->pool_io_context_->GetIoContext();
+    io_context->operation_     = PROBE_POSTED;
+    io_context->wsa_buf_.len   = 0;
+    sock_context->AddContext(io_context);
+    {
+        LITE_NO_ALLOC_SCOPE();
+        ret = WSARecv(sock_context->sock_,
+                      &io_context->wsa_buf_,
+                      1,
+                      (DWORD*)&io_context->trans_len_,
+                      &dw_flags,
+                      &io_context->overlapped_,
+                      NULL);
+    }
+    if ((0 != ret) && (WSA_IO_PENDING != WSAGetLastError()))
+    {
+        CloseConnection(sock_context->sock_id_);
+        return false;
+    }
+    return true;
+}
+
+inline
+void IOCP_TCPWorkThread::_DoProbe(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context)
+{
+    if (NULL == sock_context.get())
+    {
+        return;
+    }
+    sock_context->RemoveContext(io_context);
+
+    // Data or FIN has arrived, or a resumed recv has taken the data meanwhile.
+    // Peek without blocking, 0 means FIN. Overlapped IO is not affected by non-blocking mode
+    u_long non_blocking = 1;
+    char   c            = 0;
+    ioctlsocket(sock_context->sock_, FIONBIO, &non_blocking);
+    int ret = recv(sock_context->sock_, &c, 1, MSG_PEEK);
+    if (0 == ret || (SOCKET_ERROR == ret && WSAEWOULDBLOCK != WSAGetLastError()))
+    {
+        CloseConnection(sock_context->sock_id_);
+    }
+    // Unread data stays in the kernel buffer until resumed, FIN after it is noticed by the next recv
+}
+
+inline
+void IOCP_TCPWorkThread::_ResumeRecv(const vector<unsigned long>& resume)
+{
+    for (size_t i = 0; i < resume.size(); i++)
+    {
+        IOCP_SocketContextPtr sock_context = pool_sock_context_->GetActiveContext(resume[i]);
+        if (NULL != sock_context.get())
+        {
+            PostRecv(sock_context);
+        }
+    }
+}
+
 inline
 bool IOCP_TCPWorkThread::PostSend(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context)
 {
     DWORD dw_flags = 0;
     int   ret      = 0;
 
-    io_context->operation_ = SEND_POSTED;
-    ret = WSASend(sock_context->sock_,
-                  &io_context->wsa_buf_,
-                  1,
-                  (DWORD*)&io_context->trans_len_,
-                  dw_flags,
-                  &io_context->overlapped_,
-                  NULL);
+    {
+        LITE_NO_ALLOC_SCOPE();
+        io_context->operation_ = SEND_POSTED;
+        ret = WSASend(sock_context->sock_,
+                      &io_context->wsa_buf_,
+                      1,
+                      (DWORD*)&io_context->trans_len_,
+                      dw_flags,
+                      &io_context->overlapped_,
+                      NULL);
+    }
     if ((0 != ret) && (WSA_IO_PENDING != WSAGetLastError()))
     {
-        pool_sock_context_->DelActiveContext(sock_context->sock_id_);
-        DisconnectedCallback_(sock_context->sock_id_, user_ptr_);
+        CloseConnection(sock_context->sock_id_);
+        return false;
+    }
+    return true;
+}
+
+inline
+bool IOCP_TCPWorkThread::PostTransmitFile(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context,
+                                          HANDLE file, uint64_t offset, uint32_t len)
+{
+    if (NULL == TransmitFile_)
+    {
         return false;
     }
+
+    // File offset is given by the overlapped structure
+    io_context->operation_             = TRANSMIT_POSTED;
+    io_context->trans_len_             = (int)len;
+    io_context->overlapped_.Offset     = (DWORD)(offset & 0xFFFFFFFF);
+    io_context->overlapped_.OffsetHigh = (DWORD)(offset >> 32);
+    if (!TransmitFile_(sock_context->sock_,
+                       file,
+                       len,
+                       0,
+                       &io_context->overlapped_,
+                       NULL,
+                       TF_USE_KERNEL_APC))
+    {
+        if (WSA_IO_PENDING != WSAGetLastError())
+        {
+            return false;
+        }
+    }
     return true;
 }
 
+inline
+void IOCP_TCPWorkThread::CloseConnection(unsigned long sock_id)
+{
+    IOCP_SocketContextPtr sock_context = pool_sock_context_->GetActiveContext(sock_id);
+    unsigned long         peer_id      = NULL == sock_context.get() ? 0 : sock_context->relay_peer_id_;
+    if (0 == peer_id)
+    {
+        // Already removed: without a session factory the callback is repeated as before sessions existed,
+        // with one the id may belong to a session which has been notified by OnClose
+        if (!_RemoveConnection(sock_id) && NULL == SessionFactory_ && NULL != DisconnectedCallback_)
+        {
+            DisconnectedCallback_(sock_id, user_ptr_);
+        }
+        return;
+    }
+
+    // Both sides of a relay may close at the same time, notify each socket once
+    _RemoveConnection(sock_id);
+    _RemoveConnection(peer_id);
+}
+
+inline
+bool IOCP_TCPWorkThread::_RemoveConnection(unsigned long sock_id)
+{
+    IOCP_SocketContextPtr sock_context = pool_sock_context_->GetActiveContext(sock_id);
+    IOCP_TCPSessionPtr    session;
+    if (NULL != sock_context.get())
+    {
+        session = sock_context->session_;
+    }
+    if (!pool_sock_context_->DelActiveContext(sock_id))
+    {
+        return false;
+    }
+    if (NULL != recv_budget_)
+    {
+        // Bytes held by the connection are given back, which may resume others
+        vector<unsigned long> resume;
+        recv_budget_->Remove(sock_id, resume);
+        _ResumeRecv(resume);
+    }
+    if (NULL != session.get())
+    {
+        session->OnClose();
+    }
+    else if (NULL != DisconnectedCallback_)
+    {
+        DisconnectedCallback_(sock_id, user_ptr_);
+    }
+    return true;
+}
+
+inline
+bool IOCP_TCPWorkThread::_DoRelayForward(IOCP_SocketContextPtr sock_context)
+{
+    IOCP_SocketContextPtr peer_context = pool_sock_context_->GetActiveContext(sock_context->relay_peer_id_);
+    if (NULL == peer_context.get())
+    {
+        CloseConnection(sock_context->sock_id_);
+        return false;
+    }
+
+    // The recv context is idle until this send completes, so it carries the send
+    IOCP_IoContext& io_context = sock_context->recv_context_;
+    ZeroMemory(&io_context.overlapped_, sizeof(io_context.overlapped_));
+    io_context.operation_   = RELAY_POSTED;
+    io_context.wsa_buf_.buf = io_context.buf_;
+    io_context.wsa_buf_.len = io_context.trans_len_;
+    int ret = WSASend(peer_context->sock_,
+                      &io_context.wsa_buf_,
+                      1,
+                      NULL,
+                      0,
+                      &io_context.overlapped_,
+                      NULL);
+    if ((0 != ret) && (WSA_IO_PENDING != WSAGetLastError()))
+    {
+        CloseConnection(sock_context->sock_id_);
+        return false;
+    }
+    return true;
+}
+
+inline
+bool IOCP_TCPWorkThread::_DoRelaySend(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context, DWORD bytes_transfered)
+{
+    if (NULL == sock_context.get())
+    {
+        return false;
+    }
+    IOCP_SocketContextPtr src_context = pool_sock_context_->GetActiveContext(sock_context->relay_peer_id_);
+    if (NULL == src_context.get())
+    {
+        CloseConnection(sock_context->sock_id_);
+        return false;
+    }
+
+    // Partial send, send the rest
+    if (bytes_transfered < io_context->wsa_buf_.len)
+    {
+        ZeroMemory(&io_context->overlapped_, sizeof(io_context->overlapped_));
+        io_context->wsa_buf_.buf += bytes_transfered;
+        io_context->wsa_buf_.len -= bytes_transfered;
+        int ret = WSASend(sock_context->sock_,
+                          &io_context->wsa_buf_,
+                          1,
+                          NULL,
+                          0,
+                          &io_context->overlapped_,
+                          NULL);
+        if ((0 != ret) && (WSA_IO_PENDING != WSAGetLastError()))
+        {
+            CloseConnection(sock_context->sock_id_);
+            return false;
+        }
+        return true;
+    }
+    return PostRecv(src_context);
+}
+
+inline
+void IOCP_TCPWorkThread::_DoRelayEof(IOCP_SocketContextPtr sock_context)
+{
+    sock_context->relay_eof_ = true;
+    IOCP_SocketContextPtr peer_context = pool_sock_context_->GetActiveContext(sock_context->relay_peer_id_);
+    if (NULL == peer_context.get() || peer_context->relay_eof_)
+    {
+        // Both directions are finished
+        CloseConnection(sock_context->sock_id_);
+        return;
+    }
+    shutdown(peer_context->sock_, SD_SEND);
+}
+
 inline
 bool IOCP_TCPWorkThread::_DoRecv(IOCP_SocketContextPtr sock_context)
 {
+    LITE_ALLOC_SCOPE("iocp_tcp.recv");
+    uint64_t recv_us = NULL == ReceivedTsCallback_ ? 0 : GetMonotonicMicroSecond();
+    if (sock_options_.autotune_)
+    {
+        InterlockedExchangeAdd64(&sock_context->bytes_recv_, sock_context->recv_context_.trans_len_);
+        InterlockedIncrement(&sock_context->recv_count_);
+        if (MAX_IO_BUFFER_SIZE == sock_context->recv_context_.trans_len_)
+        {
+            InterlockedIncrement(&sock_context->recv_full_);
+        }
+        IOCP_AutoTune(sock_context.get(), sock_options_);
+    }
+    if (0 != sock_context->relay_peer_id_)
+    {
+        return _DoRelayForward(sock_context);
+    }
+
+    // Charge before delivery, the application may release the data inside the callback
+    if (NULL != recv_budget_)
+    {
+        recv_budget_->Charge(sock_context->sock_id_, sock_context->recv_context_.trans_len_);
+    }
+
     // First show the last data, then reset the status, issue the next recv request
-    ReceivedCallback_(sock_context->sock_id_,
-                      sock_context->recv_context_.buf_,
-                      sock_context->recv_context_.trans_len_,
-                      user_ptr_);
+    IOCP_TCPSessionPtr session = sock_context->session_;
+    if (NULL != session.get())
+    {
+        session->OnData(sock_context->recv_context_.buf_, sock_context->recv_context_.trans_len_);
+    }
+    else if (NULL != ReceivedTsCallback_)
+    {
+        ReceivedTsCallback_(sock_context->sock_id_,
+                            sock_context->recv_context_.buf_,
+                            sock_context->recv_context_.trans_len_,
+                            recv_us,
+                            user_ptr_);
+    }
+    else
+    {
+        ReceivedCallback_(sock_context->sock_id_,
+                          sock_context->recv_context_.buf_,
+                          sock_context->recv_context_.trans_len_,
+                          user_ptr_);
+    }
+
+    // Over budget, the kernel buffer fills up and TCP flow control stops the peer.
+    // The recv is posted by IOCP_TCPServer::ReleaseRecvBytes
+    if (NULL != recv_budget_ && recv_budget_->Pause(sock_context->sock_id_))
+    {
+        return PostProbe(sock_context);
+    }
+
     // Delivery next WSARecv request
     return PostRecv(sock_context);
 }
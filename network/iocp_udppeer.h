@@ -3,6 +3,8 @@
  * @brief   Encapsulation for IOCP UDP peer(server or client)
  * @author  Nik Yan
  * @version 1.0     2014-07-21      Only support windows
+ * @update          2026-10-18      Add multicast: join/leave groups, source-specific joins, interface, TTL and loopback
+ *                                  Add batched receive and kernel receive timestamps
  */
 
 #ifndef _LITE_IOCP_UDP_PEER_H_
@@ -12,6 +14,8 @@
 
 #ifdef OS_WIN
 
+#include <WS2tcpip.h>
+
 namespace lite {
 
 class IOCP_UDPPeer
@@ -24,6 +28,8 @@ public:
         , user_ptr_(NULL)
         , is_start_(false)
         , ReceiveFromCallback_(NULL)
+        , ReceiveFromTsCallback_(NULL)
+        , WSARecvMsg_(NULL)
     {
     }
 
@@ -47,9 +53,113 @@ public:
      * @param   sock_id     Socket ID, valid after socket creation is successful
      * @param   dst_ip      Local ip address
      * @param   dst_port    Bind port
+     * @param   reuse_addr  Set SO_REUSEADDR, so several sockets can receive a multicast group on one port
      * @return  true:Success, false:Failed
+     * @note    To receive multicast, bind "*" and the group port, then JoinGroup
      */
-    bool Create(unsigned long& sock_id, const char* bind_ip, UINT16& bind_port);
+    bool Create(unsigned long& sock_id, const char* bind_ip, UINT16& bind_port, bool reuse_addr = false);
+
+    /**
+     * @brief   Join a multicast group(any source)
+     * @param   group_ip    Multicast group address
+     * @param   iface_ip    Local interface address, "*" for the system choice
+     * @return  true:Success, false:Failed
+     */
+    bool JoinGroup(unsigned long sock_id, const char* group_ip, const char* iface_ip = "*")
+    {
+        ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = _ToAddr(group_ip);
+        mreq.imr_interface.s_addr = _ToAddr(iface_ip);
+        return _SetOption(sock_id, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+    }
+
+    bool LeaveGroup(unsigned long sock_id, const char* group_ip, const char* iface_ip = "*")
+    {
+        ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = _ToAddr(group_ip);
+        mreq.imr_interface.s_addr = _ToAddr(iface_ip);
+        return _SetOption(sock_id, IPPROTO_IP, IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
+    }
+
+    /**
+     * @brief   Join a multicast group for datagrams of one source only(SSM)
+     * @param   source_ip   Sender address
+     */
+    bool JoinSourceGroup(unsigned long sock_id, const char* group_ip, const char* source_ip, const char* iface_ip = "*")
+    {
+        ip_mreq_source mreq;
+        mreq.imr_multiaddr.s_addr  = _ToAddr(group_ip);
+        mreq.imr_sourceaddr.s_addr = _ToAddr(source_ip);
+        mreq.imr_interface.s_addr  = _ToAddr(iface_ip);
+        return _SetOption(sock_id, IPPROTO_IP, IP_ADD_SOURCE_MEMBERSHIP, &mreq, sizeof(mreq));
+    }
+
+    bool LeaveSourceGroup(unsigned long sock_id, const char* group_ip, const char* source_ip, const char* iface_ip = "*")
+    {
+        ip_mreq_source mreq;
+        mreq.imr_multiaddr.s_addr  = _ToAddr(group_ip);
+        mreq.imr_sourceaddr.s_addr = _ToAddr(source_ip);
+        mreq.imr_interface.s_addr  = _ToAddr(iface_ip);
+        return _SetOption(sock_id, IPPROTO_IP, IP_DROP_SOURCE_MEMBERSHIP, &mreq, sizeof(mreq));
+    }
+
+    /**
+     * @brief   Interface multicast datagrams are sent from
+     */
+    bool SetMulticastInterface(unsigned long sock_id, const char* iface_ip)
+    {
+        IN_ADDR addr;
+        addr.s_addr = _ToAddr(iface_ip);
+        return _SetOption(sock_id, IPPROTO_IP, IP_MULTICAST_IF, &addr, sizeof(addr));
+    }
+
+    /**
+     * @brief   TTL of sent multicast datagrams, 1 keeps them in the local network
+     */
+    bool SetMulticastTTL(unsigned long sock_id, int ttl)
+    {
+        DWORD value = (DWORD)ttl;
+        return _SetOption(sock_id, IPPROTO_IP, IP_MULTICAST_TTL, &value, sizeof(value));
+    }
+
+    /**
+     * @brief   Whether sent multicast datagrams are received by sockets of this host
+     */
+    bool SetMulticastLoopback(unsigned long sock_id, bool loopback)
+    {
+        DWORD value = loopback ? 1 : 0;
+        return _SetOption(sock_id, IPPROTO_IP, IP_MULTICAST_LOOP, &value, sizeof(value));
+    }
+
+    /**
+     * @brief   Register callback with receive time, used instead of RECEIVEFROMCALLBACK(call after Init)
+     */
+    void SetReceiveTimestampCallback(RECEIVEFROMTSCALLBACK ReceiveFromTsCallback)
+    {
+        ReceiveFromTsCallback_ = ReceiveFromTsCallback;
+        for (list<IOCP_UDPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+        {
+            (*it)->RegisterTimestampFunc(WSARecvMsg_, ReceiveFromTsCallback_);
+        }
+    }
+
+    /**
+     * @brief   Timestamp datagrams of a socket in the kernel(SIO_TIMESTAMPING, Windows 10 2004 and later)
+     *          Takes effect from the next receive posted
+     * @return  false if not supported, RECEIVEFROMTSCALLBACK gets the read time then
+     */
+    bool EnableRecvTimestamp(unsigned long sock_id);
+
+    /**
+     * @brief   Datagrams read for one completion(call after Init), 1 disables batching
+     */
+    void SetRecvBatch(uint32_t recv_batch)
+    {
+        for (list<IOCP_UDPWorkThread*>::iterator it = list_work_thread_.begin(); it != list_work_thread_.end(); it++)
+        {
+            (*it)->SetRecvBatch(recv_batch);
+        }
+    }
 
     /**
      * @brief   Close the socket
@@ -91,6 +201,21 @@ public:
      */
     void DeInit();
 protected:
+    ULONG _ToAddr(const char* ip)
+    {
+        return (NULL == ip || 0 == strcmp(ip, "*")) ? htonl(INADDR_ANY) : inet_addr(ip);
+    }
+
+    bool _SetOption(unsigned long sock_id, int level, int name, const void* value, int len)
+    {
+        IOCP_SocketContextPtr sock_context = pool_sock_context_->GetActiveContext(sock_id);
+        if (NULL == sock_context.get())
+        {
+            return false;
+        }
+        return 0 == setsockopt(sock_context->sock_, level, name, (const char*)value, len);
+    }
+
     bool _InitializeIOCP()
     {
         return (NULL != (iocp_handle_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0)));
@@ -115,6 +240,8 @@ protected:
     }
 private:
     RECEIVEFROMCALLBACK         ReceiveFromCallback_;
+    RECEIVEFROMTSCALLBACK       ReceiveFromTsCallback_;
+    LPFN_WSARECVMSG             WSARecvMsg_;
 
     bool                        is_start_;
     HANDLE                      iocp_handle_;
@@ -160,7 +287,7 @@ bool IOCP_UDPPeer::Start()
 }
 
 inline
-bool IOCP_UDPPeer::Create(unsigned long& sock_id, const char* bind_ip, UINT16& bind_port)
+bool IOCP_UDPPeer::Create(unsigned long& sock_id, const char* bind_ip, UINT16& bind_port, bool reuse_addr)
 {
     if (!is_start_)
     {
@@ -188,6 +315,12 @@ bool IOCP_UDPPeer::Create(unsigned long& sock_id, const char* bind_ip, UINT16& b
     }    
     sock_context->local_addr_.sin_port   = htons(bind_port);
 
+    if (reuse_addr)
+    {
+        BOOL reuse = TRUE;
+        setsockopt(sock_context->sock_, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    }
+
     int ret = bind(sock_context->sock_, (SOCKADDR*)&sock_context->local_addr_, sizeof(SOCKADDR));
     if (0 != ret)
     {
@@ -209,6 +342,10 @@ bool IOCP_UDPPeer::Create(unsigned long& sock_id, const char* bind_ip, UINT16& b
         bind_port = ntohs(sock_context->local_addr_.sin_port);
     }
 
+    // Batched receive reads queued datagrams without blocking, overlapped receives are not affected
+    u_long non_blocking = 1;
+    ioctlsocket(sock_context->sock_, FIONBIO, &non_blocking);
+
     sock_context->sock_id_     = (unsigned long)sock_context->sock_;
     sock_id                    = sock_context->sock_id_;
     pool_sock_context_->AddActiveContext(sock_context);
@@ -273,6 +410,46 @@ bool IOCP_UDPPeer::SendTo(unsigned long sock_id, const char* data, int data_len,
     return worker->PostSend(sock_content, io_context); 
 }
 
+inline
+bool IOCP_UDPPeer::EnableRecvTimestamp(unsigned long sock_id)
+{
+    IOCP_SocketContextPtr sock_context = pool_sock_context_->GetActiveContext(sock_id);
+    if (NULL == sock_context.get())
+    {
+        return false;
+    }
+
+    DWORD bytes = 0;
+    if (NULL == WSARecvMsg_)
+    {
+        GUID guid_recv_msg = WSAID_WSARECVMSG;
+        if (SOCKET_ERROR == WSAIoctl(sock_context->sock_,
+                                     SIO_GET_EXTENSION_FUNCTION_POINTER,
+                                     &guid_recv_msg,
+                                     sizeof(guid_recv_msg),
+                                     &WSARecvMsg_,
+                                     sizeof(WSARecvMsg_),
+                                     &bytes,
+                                     NULL,
+                                     NULL))
+        {
+            WSARecvMsg_ = NULL;
+            return false;
+        }
+        SetReceiveTimestampCallback(ReceiveFromTsCallback_);
+    }
+
+    TIMESTAMPING_CONFIG config;
+    ZeroMemory(&config, sizeof(config));
+    config.Flags = TIMESTAMPING_FLAG_RX;
+    if (SOCKET_ERROR == WSAIoctl(sock_context->sock_, SIO_TIMESTAMPING, &config, sizeof(config), NULL, 0, &bytes, NULL, NULL))
+    {
+        return false;
+    }
+    sock_context->recv_timestamp_ = true;
+    return true;
+}
+
 inline
 void IOCP_UDPPeer::Stop()
 {
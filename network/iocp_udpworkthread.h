@@ -3,6 +3,9 @@
  * @brief   Encapsulation for IOCP UDP work thread
  * @author  Nik Yan
  * @version 1.0     2014-07-21      Only support windows
+ * @update          2026-10-18      Add batched receive, datagrams already queued are read without completion
+ *                                  Add kernel receive timestamp by WSARecvMsg
+ *                                  Add allocation scopes, posting recv and send must not allocate
  */
 
 #ifndef _LITE_IOCP_UDP_WORK_THREAD_H_
@@ -10,9 +13,28 @@
 
 #include "iocp_base.h"
 #include "event/thread.h"
+#include "tools/time_tool.h"
+#include "tools/alloc_tracker.h"
 
 #ifdef OS_WIN
 #include <MSWSock.h>
+#include <MSTcpIP.h>
+
+// Declared by Windows SDK 10.0.19041 and later
+#ifndef SIO_TIMESTAMPING
+#define SIO_TIMESTAMPING                _WSAIOW(IOC_VENDOR, 235)
+#define TIMESTAMPING_FLAG_RX            (0x1)
+typedef struct _TIMESTAMPING_CONFIG
+{
+    ULONG   Flags;
+    USHORT  TxTimestampsBuffered;
+} TIMESTAMPING_CONFIG;
+#endif
+#ifndef SO_TIMESTAMP
+#define SO_TIMESTAMP                    (0x300A)
+#endif
+
+#define UDP_RECV_BATCH                  (32)            ///> Datagrams read for one completion by default
 
 namespace lite {
 
@@ -33,6 +55,20 @@ typedef void (*RECEIVEFROMCALLBACK)(
                                     SOCKADDR_IN     src_addr,
                                     void*           user_ptr);
 
+/**
+ * @brief   Callback function when udp socket recv msg, with receive time
+ * @param   recv_us     Kernel receive time if timestamping is enabled on the socket and supported,
+ *                      otherwise the time the datagram was read. Same clock as GetMonotonicMicroSecond
+ * @note    Used instead of RECEIVEFROMCALLBACK when registered
+ */
+typedef void (*RECEIVEFROMTSCALLBACK)(
+                                      unsigned long   sock_id,
+                                      const char*     data,
+                                      int             data_len,
+                                      SOCKADDR_IN     src_addr,
+                                      uint64_t        recv_us,
+                                      void*           user_ptr);
+
 class IOCP_UDPWorkThread : public Thread
 {
 public:
@@ -41,6 +77,9 @@ public:
         , pool_sock_context_(pool_sock_context)
         , user_ptr_(user_ptr)
         , ReceiveFromCallback_(NULL)
+        , ReceiveFromTsCallback_(NULL)
+        , WSARecvMsg_(NULL)
+        , recv_batch_(UDP_RECV_BATCH)
     {
     }
 
@@ -49,6 +88,20 @@ public:
         ReceiveFromCallback_ = ReceiveFromCallback;
     }
 
+    void RegisterTimestampFunc(LPFN_WSARECVMSG WSARecvMsg, RECEIVEFROMTSCALLBACK ReceiveFromTsCallback)
+    {
+        WSARecvMsg_            = WSARecvMsg;
+        ReceiveFromTsCallback_ = ReceiveFromTsCallback;
+    }
+
+    /**
+     * @brief   Datagrams read for one completion, 1 to read only the completed one
+     */
+    void SetRecvBatch(uint32_t recv_batch)
+    {
+        recv_batch_ = 0 == recv_batch ? 1 : recv_batch;
+    }
+
     /**
      * @brief   Bind Sockets to IOCP
      */
@@ -72,6 +125,43 @@ protected:
 
     bool _DoRecv(IOCP_SocketContextPtr sock_context);
 
+    /**
+     * @brief   Read a queued datagram into recv_context_ without blocking(socket is non-blocking)
+     * @return  false if no datagram is queued
+     */
+    bool _RecvNow(IOCP_SocketContextPtr sock_context);
+
+    /**
+     * @brief   Point recv_msg_ to recv_context_ for WSARecvMsg
+     */
+    void _PrepareRecvMsg(IOCP_SocketContextPtr sock_context);
+
+    /**
+     * @brief   Kernel timestamp of the received message, or now if there is none
+     */
+    uint64_t _GetRecvTime(IOCP_SocketContextPtr sock_context);
+
+    void _Deliver(IOCP_SocketContextPtr sock_context, uint64_t recv_us)
+    {
+        if (NULL != ReceiveFromTsCallback_)
+        {
+            ReceiveFromTsCallback_(sock_context->sock_id_,
+                                   sock_context->recv_context_.buf_,
+                                   sock_context->recv_context_.trans_len_,
+                                   sock_context->recv_context_.remote_addr_,
+                                   recv_us,
+                                   user_ptr_);
+        }
+        else
+        {
+            ReceiveFromCallback_(sock_context->sock_id_,
+                                 sock_context->recv_context_.buf_,
+                                 sock_context->recv_context_.trans_len_,
+                                 sock_context->recv_context_.remote_addr_,
+                                 user_ptr_);
+        }
+    }
+
     void _DoSend(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context)
     {
         sock_context->RemoveContext(io_context);
@@ -80,6 +170,9 @@ protected:
 private:
 
     RECEIVEFROMCALLBACK         ReceiveFromCallback_;
+    RECEIVEFROMTSCALLBACK       ReceiveFromTsCallback_;
+    LPFN_WSARECVMSG             WSARecvMsg_;            ///> WSARecvMsg function pointer
+    uint32_t                    recv_batch_;            ///> Datagrams read for one completion
 
     HANDLE                      iocp_handle_;           ///> IOCP handle
     IOCP_SocketContextPool*     pool_sock_context_;     ///> Socket pool
@@ -167,6 +260,7 @@ bool IOCP_UDPWorkThread::_HandleError(IOCP_SocketContextPtr sock_context, DWORD
 inline
 bool IOCP_UDPWorkThread::PostRecv(IOCP_SocketContextPtr sock_context)
 {
+    LITE_NO_ALLOC_SCOPE();
     DWORD dw_flags = 0;
     int   ret      = 0;
 
@@ -174,6 +268,21 @@ bool IOCP_UDPWorkThread::PostRecv(IOCP_SocketContextPtr sock_context)
     ZeroMemory(&sock_context->recv_context_.remote_addr_, sizeof(SOCKADDR_IN));
     sock_context->recv_context_.operation_ = RECV_POSTED;
 
+    if (sock_context->recv_timestamp_ && NULL != WSARecvMsg_)
+    {
+        _PrepareRecvMsg(sock_context);
+        ret = WSARecvMsg_(sock_context->sock_,
+                          &sock_context->recv_msg_,
+                          (DWORD*)&sock_context->recv_context_.trans_len_,
+                          &sock_context->recv_context_.overlapped_,
+                          NULL);
+        if ((0 != ret) && (WSA_IO_PENDING != WSAGetLastError()))
+        {
+            return false;
+        }
+        return true;
+    }
+
     ret = WSARecvFrom(sock_context->sock_,
 					  &sock_context->recv_context_.wsa_buf_,
 					  1,
@@ -195,6 +304,7 @@ bool IOCP_UDPWorkThread::PostRecv(IOCP_SocketContextPtr sock_context)
 inline
 bool IOCP_UDPWorkThread::PostSend(IOCP_SocketContextPtr sock_context, IOCP_IoContext* io_context)
 {
+    LITE_NO_ALLOC_SCOPE();
     int ret = 0;
     io_context->operation_ = SEND_POSTED;
     ret = WSASendTo(sock_context->sock_,
@@ -216,15 +326,86 @@ bool IOCP_UDPWorkThread::PostSend(IOCP_SocketContextPtr sock_context, IOCP_IoCon
 inline
 bool IOCP_UDPWorkThread::_DoRecv(IOCP_SocketContextPtr sock_context)
 {
-    ReceiveFromCallback_(sock_context->sock_id_,
-                         sock_context->recv_context_.buf_,
-                         sock_context->recv_context_.trans_len_,
-                         sock_context->recv_context_.remote_addr_,
-                         user_ptr_);
+    LITE_ALLOC_SCOPE("iocp_udp.recv");
+    uint64_t recv_us = NULL == ReceiveFromTsCallback_ ? 0 : _GetRecvTime(sock_context);
+    _Deliver(sock_context, recv_us);
+
+    // Read datagrams already queued in the socket, one completion is taken for a burst.
+    // Only one recv is pending on a socket, so datagrams are delivered in order
+    for (uint32_t i = 1; i < recv_batch_ && _RecvNow(sock_context); i++)
+    {
+        recv_us = NULL == ReceiveFromTsCallback_ ? 0 : _GetRecvTime(sock_context);
+        _Deliver(sock_context, recv_us);
+    }
+
     // Delivery next WSARecv request
     return PostRecv(sock_context);
 }
 
+inline
+bool IOCP_UDPWorkThread::_RecvNow(IOCP_SocketContextPtr sock_context)
+{
+    sock_context->recv_context_.ResetBuffer();
+    ZeroMemory(&sock_context->recv_context_.remote_addr_, sizeof(SOCKADDR_IN));
+
+    int ret = 0;
+    if (sock_context->recv_timestamp_ && NULL != WSARecvMsg_)
+    {
+        DWORD bytes = 0;
+        _PrepareRecvMsg(sock_context);
+        ret = WSARecvMsg_(sock_context->sock_, &sock_context->recv_msg_, &bytes, NULL, NULL);
+        sock_context->recv_context_.trans_len_ = (int)bytes;
+    }
+    else
+    {
+        ret = recvfrom(sock_context->sock_,
+                       sock_context->recv_context_.buf_,
+                       MAX_IO_BUFFER_SIZE,
+                       0,
+                       reinterpret_cast<sockaddr*>(&sock_context->recv_context_.remote_addr_),
+                       &sock_context->recv_context_.addr_size_);
+        sock_context->recv_context_.trans_len_ = ret;
+    }
+    return SOCKET_ERROR != ret;
+}
+
+inline
+void IOCP_UDPWorkThread::_PrepareRecvMsg(IOCP_SocketContextPtr sock_context)
+{
+    WSAMSG& msg       = sock_context->recv_msg_;
+    msg.name          = reinterpret_cast<LPSOCKADDR>(&sock_context->recv_context_.remote_addr_);
+    msg.namelen       = sizeof(SOCKADDR_IN);
+    msg.lpBuffers     = &sock_context->recv_context_.wsa_buf_;
+    msg.dwBufferCount = 1;
+    msg.Control.buf   = sock_context->recv_control_;
+    msg.Control.len   = MAX_IO_CONTROL_SIZE;
+    msg.dwFlags       = 0;
+}
+
+inline
+uint64_t IOCP_UDPWorkThread::_GetRecvTime(IOCP_SocketContextPtr sock_context)
+{
+    if (sock_context->recv_timestamp_ && NULL != WSARecvMsg_)
+    {
+        WSAMSG& msg = sock_context->recv_msg_;
+        for (WSACMSGHDR* cmsg = WSA_CMSG_FIRSTHDR(&msg); NULL != cmsg; cmsg = WSA_CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (SOL_SOCKET == cmsg->cmsg_level && SO_TIMESTAMP == cmsg->cmsg_type)
+            {
+                // Kernel timestamp is a QueryPerformanceCounter value
+                static LARGE_INTEGER freq = {0};
+                if (0 == freq.QuadPart)
+                {
+                    QueryPerformanceFrequency(&freq);
+                }
+                uint64_t counter = *(UINT64*)WSA_CMSG_DATA(cmsg);
+                return counter / freq.QuadPart * 1000000 + counter % freq.QuadPart * 1000000 / freq.QuadPart;
+            }
+        }
+    }
+    return GetMonotonicMicroSecond();
+}
+
 inline
 bool IOCP_UDPWorkThread::AssociateWithIOCP(IOCP_SocketContextPtr sock_context)
 {
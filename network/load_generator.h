@@ -0,0 +1,478 @@
+/**
+ * @file    network\load_generator.h
+ * @brief   Open-loop load generator over IOCP TCP client or UDP peer
+ *          Requests are sent on a fixed schedule whether or not responses came back,
+ *          and latency is measured from the scheduled time, so a stalled server is not hidden
+ *          by the generator slowing down(coordinated omission).
+ *          Each worker process saves its histogram, the parent merges them for the report.
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ * @update          2026-10-18      UDP responses are matched by the echoed sequence number
+ *                                  Schedule in ns without rounding the interval
+ *                                  Save and merge results of worker processes
+ */
+
+#ifndef _LITE_LOAD_GENERATOR_H_
+#define _LITE_LOAD_GENERATOR_H_
+
+#include "iocp_tcpclient.h"
+#include "iocp_udppeer.h"
+#include "tools/latency_histogram.h"
+#include "tools/time_tool.h"
+#include <deque>
+#include <set>
+
+#ifdef OS_WIN
+
+namespace lite {
+
+#define LOADGEN_SEQ_SIZE        (8)                 ///> UDP: sequence number at the head of request and response
+#define LOADGEN_RESULT_MAGIC    (0x4C475253)
+
+/**
+ * @brief   Load to generate
+ */
+struct LoadGenConfig
+{
+    string      dst_ip_;
+    UINT16      dst_port_;
+    bool        udp_;                               ///> Use UDP datagrams instead of TCP connections
+    uint32_t    connections_;                       ///> TCP connections or UDP sockets
+    uint32_t    rate_;                              ///> Requests per second of all connections
+    uint32_t    duration_ms_;                       ///> Sending time
+    uint32_t    drain_ms_;                          ///> Time to wait for responses after sending
+    string      request_;                           ///> Request payload, UDP: at least LOADGEN_SEQ_SIZE bytes,
+                                                    ///> the first ones are replaced by the sequence number
+    uint32_t    response_size_;                     ///> TCP: bytes of one response, 0 for the request size(echo)
+
+    LoadGenConfig()
+        : dst_port_(0)
+        , udp_(false)
+        , connections_(1)
+        , rate_(1000)
+        , duration_ms_(10000)
+        , drain_ms_(1000)
+        , response_size_(0)
+    {
+    }
+};
+
+/**
+ * @brief   Result of a run
+ */
+struct LoadGenResult
+{
+    uint64_t            sent_;
+    uint64_t            received_;
+    uint64_t            errors_;                    ///> Failed connects and sends
+    uint64_t            late_sends_;                ///> Sends behind schedule by more than 1ms
+    LatencyHistogram    latency_;                   ///> us, from scheduled send time to response
+
+    LoadGenResult() : sent_(0), received_(0), errors_(0), late_sends_(0)
+    {
+    }
+
+    void Merge(const LoadGenResult& other)
+    {
+        sent_       += other.sent_;
+        received_   += other.received_;
+        errors_     += other.errors_;
+        late_sends_ += other.late_sends_;
+        latency_.Merge(other.latency_);
+    }
+
+    /**
+     * @brief   Save to file, so worker processes can hand results to a parent
+     */
+    bool SaveToFile(const char* path) const
+    {
+        ByteStream bs;
+        bs.SetByteOrder(NETWORK_BYTEORDER);
+        bs.PutUint32(LOADGEN_RESULT_MAGIC);
+        bs.PutUint64(sent_);
+        bs.PutUint64(received_);
+        bs.PutUint64(errors_);
+        bs.PutUint64(late_sends_);
+        latency_.Encode(bs);
+        FILE* file = fopen(path, "wb");
+        if (NULL == file)
+        {
+            return false;
+        }
+        bool ok = (bs.GetWritePtr() == fwrite(bs.GetBuffer(), 1, bs.GetWritePtr(), file));
+        fclose(file);
+        return ok;
+    }
+
+    /**
+     * @brief   Merge a result saved by SaveToFile
+     * @return  false if the file can not be read or is broken, this result is not changed then
+     */
+    bool MergeFromFile(const char* path)
+    {
+        FILE* file = fopen(path, "rb");
+        if (NULL == file)
+        {
+            return false;
+        }
+        ByteStream bs;
+        char       buf[4096];
+        size_t     len = 0;
+        while (0 < (len = fread(buf, 1, sizeof(buf), file)))
+        {
+            bs.Add(buf, (uint32_t)len);
+        }
+        fclose(file);
+
+        LoadGenResult other;
+        try
+        {
+            bs.SetByteOrder(NETWORK_BYTEORDER);
+            if (LOADGEN_RESULT_MAGIC != bs.GetUint32())
+            {
+                return false;
+            }
+            other.sent_       = bs.GetUint64();
+            other.received_   = bs.GetUint64();
+            other.errors_     = bs.GetUint64();
+            other.late_sends_ = bs.GetUint64();
+        }
+        catch (access_violation_exception&)
+        {
+            return false;
+        }
+        if (!other.latency_.MergeFrom(bs))
+        {
+            return false;
+        }
+        Merge(other);
+        return true;
+    }
+};
+
+class LoadGenerator;
+
+/**
+ * @brief   Send requests on schedule
+ */
+class LoadGenSendThread : public Thread
+{
+public:
+    LoadGenSendThread(LoadGenerator* generator)
+        : Thread("<load_gen_send>")
+        , generator_(generator)
+    {
+    }
+
+protected:
+    virtual uint32_t _Run();
+
+private:
+    LoadGenerator*  generator_;
+};
+
+class LoadGenerator : private NonCopyable
+{
+    friend class LoadGenSendThread;
+
+public:
+    LoadGenerator()
+        : send_thread_(this)
+        , start_ns_(0)
+        , next_send_(0)
+        , total_sends_(0)
+    {
+    }
+
+    /**
+     * @brief   Open connections, send for duration_ms_, wait drain_ms_ for responses
+     * @return  false if no connection can be opened
+     */
+    bool Run(const LoadGenConfig& config, LoadGenResult& result);
+
+protected:
+    /**
+     * @brief   Per-connection state
+     *          TCP responses come back in request order, UDP ones are matched by sequence number
+     *          because datagrams may be lost or reordered
+     */
+    struct Connection
+    {
+        unsigned long           sock_id_;
+        deque<uint64_t>         pending_;           ///> TCP: scheduled send times(ns) of requests without response
+        uint32_t                recv_bytes_;        ///> TCP: bytes of the response being received
+        set<uint64_t>           pending_seq_;       ///> UDP: sequence numbers of requests without response
+    };
+
+    static void _OnReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr);
+
+    static void _OnDisconnected(unsigned long sock_id, void* user_ptr);
+
+    static void _OnReceiveFrom(unsigned long sock_id, const char* data, int data_len, SOCKADDR_IN src_addr, void* user_ptr);
+
+    /**
+     * @brief   Responses of data_len bytes arrived on a connection
+     */
+    void _OnResponse(unsigned long sock_id, const char* data, int data_len);
+
+    /**
+     * @brief   Scheduled send time of request seq, exact for any rate
+     */
+    uint64_t _DueTime(uint64_t seq) const
+    {
+        return start_ns_ + seq * 1000000000ULL / config_.rate_;
+    }
+
+    /**
+     * @brief   Send requests whose time has come, called by send thread
+     * @return  false when the sending time is over
+     */
+    bool _SendDue();
+
+private:
+    LoadGenConfig                       config_;
+    LoadGenResult*                      result_;
+    IOCP_TCPClient                      tcp_client_;
+    IOCP_UDPPeer                        udp_peer_;
+    SOCKADDR_IN                         dst_addr_;
+    vector<Connection>                  list_conn_;
+    map<unsigned long, uint32_t>        map_conn_;      ///> Socket ID -> index of list_conn_
+    Mutex                               mt_;
+    LoadGenSendThread                   send_thread_;
+    string                              request_;       ///> Request being sent, UDP: with sequence number
+    uint64_t                            start_ns_;
+    uint64_t                            next_send_;     ///> Sequence number of the next request
+    uint64_t                            total_sends_;
+};
+
+inline
+uint32_t LoadGenSendThread::_Run()
+{
+    while (!_Signalled() && generator_->_SendDue())
+    {
+    }
+    return 0;
+}
+
+inline
+bool LoadGenerator::Run(const LoadGenConfig& config, LoadGenResult& result)
+{
+    config_  = config;
+    result_  = &result;
+    if (0 == config_.connections_ || 0 == config_.rate_ || config_.request_.empty())
+    {
+        return false;
+    }
+    request_ = config_.request_;
+    if (config_.udp_ && request_.size() < LOADGEN_SEQ_SIZE)
+    {
+        request_.resize(LOADGEN_SEQ_SIZE, 0);
+    }
+    if (0 == config_.response_size_)
+    {
+        config_.response_size_ = (uint32_t)config_.request_.size();
+    }
+
+    bool ok = config_.udp_ ? (udp_peer_.Init(this, _OnReceiveFrom) && udp_peer_.Start())
+                           : (tcp_client_.Init(this, _OnReceived, _OnDisconnected) && tcp_client_.Start());
+    if (!ok)
+    {
+        return false;
+    }
+
+    ZeroMemory(&dst_addr_, sizeof(dst_addr_));
+    dst_addr_.sin_family      = AF_INET;
+    dst_addr_.sin_addr.s_addr = inet_addr(config_.dst_ip_.c_str());
+    dst_addr_.sin_port        = htons(config_.dst_port_);
+    {
+        MutexLock lock(mt_);
+        list_conn_.clear();
+        map_conn_.clear();
+        for (uint32_t i = 0; i < config_.connections_; i++)
+        {
+            Connection conn;
+            conn.recv_bytes_ = 0;
+            UINT16 port      = 0;
+            ok = config_.udp_ ? udp_peer_.Create(conn.sock_id_, "*", port)
+                              : tcp_client_.Connect(conn.sock_id_, config_.dst_ip_.c_str(), config_.dst_port_);
+            if (!ok)
+            {
+                result.errors_++;
+                continue;
+            }
+            map_conn_[conn.sock_id_] = (uint32_t)list_conn_.size();
+            list_conn_.push_back(conn);
+        }
+    }
+
+    if (!list_conn_.empty())
+    {
+        total_sends_ = (uint64_t)config_.duration_ms_ * config_.rate_ / 1000;
+        next_send_   = 0;
+        start_ns_    = GetMonotonicNanoSecond();
+        send_thread_.Start();
+        Sleep(config_.duration_ms_ + config_.drain_ms_);
+        send_thread_.Signal();
+        send_thread_.Stop();
+    }
+
+    if (config_.udp_)
+    {
+        udp_peer_.Stop();
+        udp_peer_.DeInit();
+    }
+    else
+    {
+        tcp_client_.Stop();
+        tcp_client_.DeInit();
+    }
+    return !list_conn_.empty();
+}
+
+inline
+bool LoadGenerator::_SendDue()
+{
+    if (next_send_ >= total_sends_)
+    {
+        return false;
+    }
+
+    uint64_t now = GetMonotonicNanoSecond();
+    uint64_t due = _DueTime(next_send_);
+    if (due > now)
+    {
+        // Sleep when far from the next send, otherwise spin to keep the schedule
+        if (due - now > 2000000)
+        {
+            Sleep(1);
+        }
+        return true;
+    }
+
+    // Behind schedule sends go out at once and keep their scheduled time
+    while (due <= now && next_send_ < total_sends_)
+    {
+        Connection* conn = NULL;
+        {
+            MutexLock lock(mt_);
+            conn = &list_conn_[next_send_ % list_conn_.size()];
+            if (config_.udp_)
+            {
+                conn->pending_seq_.insert(next_send_);
+            }
+            else
+            {
+                conn->pending_.push_back(due);
+            }
+            if (now - due > 1000000)
+            {
+                result_->late_sends_++;
+            }
+        }
+
+        bool ok = false;
+        if (config_.udp_)
+        {
+            // Only read by this process, so the host byte order is kept
+            memcpy(&request_[0], &next_send_, LOADGEN_SEQ_SIZE);
+            ok = udp_peer_.SendTo(conn->sock_id_, request_.data(), (int)request_.size(), dst_addr_);
+        }
+        else
+        {
+            ok = tcp_client_.Send(conn->sock_id_, request_.data(), (int)request_.size());
+        }
+
+        MutexLock lock(mt_);
+        if (ok)
+        {
+            result_->sent_++;
+        }
+        else
+        {
+            if (config_.udp_)
+            {
+                conn->pending_seq_.erase(next_send_);
+            }
+            else
+            {
+                conn->pending_.pop_back();
+            }
+            result_->errors_++;
+        }
+        next_send_++;
+        due = _DueTime(next_send_);
+    }
+    return true;
+}
+
+inline
+void LoadGenerator::_OnResponse(unsigned long sock_id, const char* data, int data_len)
+{
+    uint64_t now = GetMonotonicNanoSecond();
+    MutexLock lock(mt_);
+    map<unsigned long, uint32_t>::iterator it = map_conn_.find(sock_id);
+    if (it == map_conn_.end())
+    {
+        return;
+    }
+    Connection& conn = list_conn_[it->second];
+
+    // UDP: one datagram is one response, echoing the sequence number of its request
+    if (config_.udp_)
+    {
+        uint64_t seq = 0;
+        if (data_len < LOADGEN_SEQ_SIZE)
+        {
+            return;
+        }
+        memcpy(&seq, data, LOADGEN_SEQ_SIZE);
+        if (0 == conn.pending_seq_.erase(seq))
+        {
+            // Duplicate or not sent by this connection
+            return;
+        }
+        result_->latency_.Record((now - _DueTime(seq)) / 1000);
+        result_->received_++;
+        return;
+    }
+
+    conn.recv_bytes_ += data_len;
+    while (conn.recv_bytes_ >= config_.response_size_ && !conn.pending_.empty())
+    {
+        result_->latency_.Record((now - conn.pending_.front()) / 1000);
+        conn.pending_.pop_front();
+        conn.recv_bytes_ -= config_.response_size_;
+        result_->received_++;
+    }
+}
+
+inline
+void LoadGenerator::_OnReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr)
+{
+    ((LoadGenerator*)user_ptr)->_OnResponse(sock_id, data, data_len);
+}
+
+inline
+void LoadGenerator::_OnReceiveFrom(unsigned long sock_id, const char* data, int data_len, SOCKADDR_IN src_addr, void* user_ptr)
+{
+    ((LoadGenerator*)user_ptr)->_OnResponse(sock_id, data, data_len);
+}
+
+inline
+void LoadGenerator::_OnDisconnected(unsigned long sock_id, void* user_ptr)
+{
+    LoadGenerator* generator = (LoadGenerator*)user_ptr;
+    MutexLock lock(generator->mt_);
+    map<unsigned long, uint32_t>::iterator it = generator->map_conn_.find(sock_id);
+    if (it != generator->map_conn_.end())
+    {
+        generator->result_->errors_++;
+    }
+}
+
+} // end of namespace
+using namespace lite;
+
+#endif // ifdef OS_WIN
+
+#endif // ifndef _LITE_LOAD_GENERATOR_H_
@@ -0,0 +1,595 @@
+/**
+ * @file    network\pubsub_broker.h
+ * @brief   Topic based publish/subscribe broker over IOCP TCP server
+ *          A published message is encoded once and shared by all subscribers without copying,
+ *          each subscriber has a bounded queue with a policy for slow consumers
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ * @update          2026-10-18      Close only subscribers whose queue overflowed under PUBSUB_DISCONNECT
+ */
+
+#ifndef _LITE_PUBSUB_BROKER_H_
+#define _LITE_PUBSUB_BROKER_H_
+
+#include "iocp_tcpserver.h"
+#include <deque>
+#include <set>
+
+#ifdef OS_WIN
+
+namespace lite {
+
+#define PUBSUB_DEFAULT_MAX_IN_FLIGHT    (4)     ///> Sends posted to a socket and not yet completed
+#define PUBSUB_DEFAULT_MAX_QUEUED       (1024)  ///> Messages waiting behind the posted sends
+
+/**
+ * @brief   Policy when the queue of a subscriber is full
+ */
+typedef enum _PUBSUB_SLOW_POLICY
+{
+    PUBSUB_DROP_OLDEST,     ///> Drop the oldest queued message
+    PUBSUB_CONFLATE,        ///> Replace the queued message with the same key, drop the oldest if none
+    PUBSUB_DISCONNECT       ///> Close the subscriber
+}PUBSUB_SLOW_POLICY;
+
+/**
+ * @brief   Result of delivering a message to a subscriber
+ */
+typedef enum _PUBSUB_DELIVER_RESULT
+{
+    PUBSUB_DELIVERED,       ///> Posted, queued, conflated or dropped by policy
+    PUBSUB_CLOSED,          ///> Subscriber is already closed or the send failed
+    PUBSUB_OVERFLOW         ///> Queue is full under PUBSUB_DISCONNECT, the caller closes the subscriber
+}PUBSUB_DELIVER_RESULT;
+
+/**
+ * @brief   Counters of a broker
+ */
+struct PubSubStats
+{
+    uint64_t    published_;                         ///> Publish calls
+    uint64_t    sent_;                              ///> Messages posted to sockets
+    uint64_t    queued_;                            ///> Messages queued behind posted sends
+    uint64_t    dropped_;                           ///> Messages dropped for full queue
+    uint64_t    conflated_;                         ///> Queued messages replaced by newer ones
+    uint64_t    disconnected_;                      ///> Subscribers closed for full queue
+
+    PubSubStats()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+};
+
+class PubSubBroker : private NonCopyable
+{
+public:
+    PubSubBroker()
+        : user_ptr_(NULL)
+        , ConnectedCallback_(NULL)
+        , ReceivedCallback_(NULL)
+        , DisconnectedCallback_(NULL)
+        , max_in_flight_(PUBSUB_DEFAULT_MAX_IN_FLIGHT)
+        , max_queued_(PUBSUB_DEFAULT_MAX_QUEUED)
+        , policy_(PUBSUB_DROP_OLDEST)
+    {
+    }
+
+    /**
+     * @brief   Initializing the broker, callbacks are forwarded from the TCP server
+     *          Subscription requests are application protocol, parse them in ReceivedCallback
+     *          and call Subscribe/Unsubscribe
+     * @return  true:Success, false:Failed
+     */
+    bool Init(
+              void*                     user_ptr,
+              CONNECTEDCALLBACK         ConnectedCallback,
+              RECEIVEDCALLBACK          ReceivedCallback,
+              DISCONNECTEDCALLBACK      DisconnectedCallback,
+              UINT16                    listen_port,
+              const char*               host_ip = NULL)
+    {
+        user_ptr_             = user_ptr;
+        ConnectedCallback_    = ConnectedCallback;
+        ReceivedCallback_     = ReceivedCallback;
+        DisconnectedCallback_ = DisconnectedCallback;
+        if (!server_.Init(this, _OnConnected, _OnReceived, _OnDisconnected, listen_port, host_ip))
+        {
+            return false;
+        }
+        server_.SetSendCompletedCallback(_OnSendCompleted);
+        return true;
+    }
+
+    /**
+     * @brief   Set queue limits and slow consumer policy(call before Start)
+     * @param   max_in_flight   Sends posted to a socket at the same time, at least 1
+     * @param   max_queued      Messages waiting for a subscriber
+     */
+    void SetQueueLimit(uint32_t max_in_flight, uint32_t max_queued, PUBSUB_SLOW_POLICY policy)
+    {
+        max_in_flight_ = 0 == max_in_flight ? 1 : max_in_flight;
+        max_queued_    = max_queued;
+        policy_        = policy;
+    }
+
+    bool Start()
+    {
+        return server_.Start();
+    }
+
+    void Stop()
+    {
+        server_.Stop();
+    }
+
+    void DeInit()
+    {
+        server_.DeInit();
+        MutexLock lock_sub(mt_sub_);
+        MutexLock lock_topic(mt_topic_);
+        map_sub_.clear();
+        map_topic_.clear();
+    }
+
+    /**
+     * @brief   Subscribe a connection to a topic
+     * @return  false if the connection is closed
+     */
+    bool Subscribe(unsigned long sock_id, const string& topic);
+
+    void Unsubscribe(unsigned long sock_id, const string& topic);
+
+    /**
+     * @brief   Publish an encoded message to all subscribers of the topic
+     * @param   msg             Encoded message, must not be modified after publishing
+     * @param   conflate_key    Messages with the same non-zero key replace each other in
+     *                          the queue of a slow subscriber under PUBSUB_CONFLATE
+     * @return  Number of subscribers the message is sent or queued to
+     */
+    uint32_t Publish(const string& topic, const IOCP_SharedBufferPtr& msg, uint64_t conflate_key = 0);
+
+    /**
+     * @brief   Copy data into a new shared message
+     */
+    static IOCP_SharedBufferPtr MakeMessage(const void* data, uint32_t len)
+    {
+        IOCP_SharedBufferPtr msg(new ByteStream(len));
+        msg->Add(data, len);
+        return msg;
+    }
+
+    /**
+     * @brief   Close a connection, DisconnectedCallback is called
+     */
+    void CloseSocket(unsigned long sock_id)
+    {
+        server_.CloseSocket(sock_id);
+        _OnDisconnected(sock_id, this);
+    }
+
+    PubSubStats GetStats();
+
+    IOCP_TCPServer& GetTCPServer()
+    {
+        return server_;
+    }
+
+protected:
+    struct PendingMsg
+    {
+        IOCP_SharedBufferPtr    msg_;
+        uint64_t                key_;
+    };
+
+    /**
+     * @brief   Per-connection state
+     */
+    struct Subscriber
+    {
+        unsigned long           sock_id_;
+        Mutex                   mt_;
+        uint32_t                in_flight_;
+        deque<PendingMsg>       queue_;
+        set<string>             topics_;
+        bool                    closed_;
+        PubSubStats             stats_;
+
+        explicit Subscriber(unsigned long sock_id) : sock_id_(sock_id), in_flight_(0), closed_(false)
+        {
+        }
+    };
+    typedef std::tr1::shared_ptr<Subscriber>            SubscriberPtr;
+
+    /**
+     * @brief   Subscriber list of a topic, copied on change so Publish iterates it without lock
+     */
+    typedef std::tr1::shared_ptr<vector<SubscriberPtr> > SubscriberListPtr;
+
+    static void _OnConnected(unsigned long sock_id, void* user_ptr);
+
+    static void _OnReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr);
+
+    static void _OnDisconnected(unsigned long sock_id, void* user_ptr);
+
+    static void _OnSendCompleted(unsigned long sock_id, void* context, void* user_ptr);
+
+    SubscriberPtr _GetSubscriber(unsigned long sock_id)
+    {
+        MutexLock lock(mt_sub_);
+        map<unsigned long, SubscriberPtr>::iterator it = map_sub_.find(sock_id);
+        return it == map_sub_.end() ? SubscriberPtr() : it->second;
+    }
+
+    /**
+     * @brief   Send message to a subscriber or queue it
+     * @return  PUBSUB_OVERFLOW is returned once per subscriber, by the call which marked it closed
+     */
+    PUBSUB_DELIVER_RESULT _Deliver(const SubscriberPtr& sub, const IOCP_SharedBufferPtr& msg, uint64_t key);
+
+    /**
+     * @brief   Close the connection of a subscriber, nothing is done if the subscriber is already removed
+     */
+    void _CloseSubscriber(const SubscriberPtr& sub);
+
+    /**
+     * @brief   Unsubscribe a removed subscriber from its topics and call DisconnectedCallback
+     */
+    void _ReleaseSubscriber(const SubscriberPtr& sub);
+
+    /**
+     * @brief   Add or remove a subscriber of a topic
+     */
+    void _UpdateTopic(const string& topic, const SubscriberPtr& sub, bool add);
+
+private:
+    IOCP_TCPServer                              server_;
+    void*                                       user_ptr_;
+    CONNECTEDCALLBACK                           ConnectedCallback_;
+    RECEIVEDCALLBACK                            ReceivedCallback_;
+    DISCONNECTEDCALLBACK                        DisconnectedCallback_;
+    uint32_t                                    max_in_flight_;
+    uint32_t                                    max_queued_;
+    PUBSUB_SLOW_POLICY                          policy_;
+    map<unsigned long, SubscriberPtr>           map_sub_;
+    Mutex                                       mt_sub_;
+    map<string, SubscriberListPtr>              map_topic_;
+    Mutex                                       mt_topic_;
+    PubSubStats                                 stats_;         ///> Counters of closed subscribers and publish
+    Mutex                                       mt_stats_;
+};
+
+inline
+void PubSubBroker::_OnConnected(unsigned long sock_id, void* user_ptr)
+{
+    PubSubBroker* broker = (PubSubBroker*)user_ptr;
+    {
+        MutexLock lock(broker->mt_sub_);
+        broker->map_sub_[sock_id] = SubscriberPtr(new Subscriber(sock_id));
+    }
+    if (NULL != broker->ConnectedCallback_)
+    {
+        broker->ConnectedCallback_(sock_id, broker->user_ptr_);
+    }
+}
+
+inline
+void PubSubBroker::_OnReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr)
+{
+    PubSubBroker* broker = (PubSubBroker*)user_ptr;
+    if (NULL != broker->ReceivedCallback_)
+    {
+        broker->ReceivedCallback_(sock_id, data, data_len, broker->user_ptr_);
+    }
+}
+
+inline
+void PubSubBroker::_OnDisconnected(unsigned long sock_id, void* user_ptr)
+{
+    PubSubBroker* broker = (PubSubBroker*)user_ptr;
+    SubscriberPtr sub;
+    {
+        MutexLock lock(broker->mt_sub_);
+        map<unsigned long, SubscriberPtr>::iterator it = broker->map_sub_.find(sock_id);
+        if (it == broker->map_sub_.end())
+        {
+            return;
+        }
+        sub = it->second;
+        broker->map_sub_.erase(it);
+    }
+    broker->_ReleaseSubscriber(sub);
+}
+
+inline
+void PubSubBroker::_CloseSubscriber(const SubscriberPtr& sub)
+{
+    {
+        // The socket ID may belong to a new connection once the subscriber is removed
+        MutexLock lock(mt_sub_);
+        map<unsigned long, SubscriberPtr>::iterator it = map_sub_.find(sub->sock_id_);
+        if (it == map_sub_.end() || it->second != sub)
+        {
+            return;
+        }
+        map_sub_.erase(it);
+        server_.CloseSocket(sub->sock_id_);
+    }
+    _ReleaseSubscriber(sub);
+}
+
+inline
+void PubSubBroker::_ReleaseSubscriber(const SubscriberPtr& sub)
+{
+    set<string> topics;
+    {
+        MutexLock lock(sub->mt_);
+        sub->closed_ = true;
+        sub->queue_.clear();
+        topics.swap(sub->topics_);
+    }
+    for (set<string>::iterator it = topics.begin(); it != topics.end(); it++)
+    {
+        _UpdateTopic(*it, sub, false);
+    }
+    {
+        MutexLock lock(mt_stats_);
+        stats_.sent_         += sub->stats_.sent_;
+        stats_.queued_       += sub->stats_.queued_;
+        stats_.dropped_      += sub->stats_.dropped_;
+        stats_.conflated_    += sub->stats_.conflated_;
+        stats_.disconnected_ += sub->stats_.disconnected_;
+    }
+    if (NULL != DisconnectedCallback_)
+    {
+        DisconnectedCallback_(sub->sock_id_, user_ptr_);
+    }
+}
+
+inline
+void PubSubBroker::_OnSendCompleted(unsigned long sock_id, void* context, void* user_ptr)
+{
+    PubSubBroker* broker = (PubSubBroker*)user_ptr;
+    SubscriberPtr sub    = broker->_GetSubscriber(sock_id);
+    if (NULL == sub.get() || context != sub.get())
+    {
+        return;
+    }
+
+    // Post queued messages in order, the lock keeps a concurrent Publish behind them
+    MutexLock lock(sub->mt_);
+    if (sub->in_flight_ > 0)
+    {
+        sub->in_flight_--;
+    }
+    while (!sub->closed_ && sub->in_flight_ < broker->max_in_flight_ && !sub->queue_.empty())
+    {
+        IOCP_SharedBufferPtr msg = sub->queue_.front().msg_;
+        sub->queue_.pop_front();
+        sub->in_flight_++;
+        sub->stats_.sent_++;
+        if (!broker->server_.Send(sock_id, msg, sub.get()))
+        {
+            sub->in_flight_--;
+            break;
+        }
+    }
+}
+
+inline
+bool PubSubBroker::Subscribe(unsigned long sock_id, const string& topic)
+{
+    SubscriberPtr sub = _GetSubscriber(sock_id);
+    if (NULL == sub.get())
+    {
+        return false;
+    }
+    {
+        MutexLock lock(sub->mt_);
+        if (sub->closed_)
+        {
+            return false;
+        }
+        if (!sub->topics_.insert(topic).second)
+        {
+            return true;
+        }
+    }
+    _UpdateTopic(topic, sub, true);
+    return true;
+}
+
+inline
+void PubSubBroker::Unsubscribe(unsigned long sock_id, const string& topic)
+{
+    SubscriberPtr sub = _GetSubscriber(sock_id);
+    if (NULL == sub.get())
+    {
+        return;
+    }
+    {
+        MutexLock lock(sub->mt_);
+        if (0 == sub->topics_.erase(topic))
+        {
+            return;
+        }
+    }
+    _UpdateTopic(topic, sub, false);
+}
+
+inline
+void PubSubBroker::_UpdateTopic(const string& topic, const SubscriberPtr& sub, bool add)
+{
+    MutexLock lock(mt_topic_);
+    map<string, SubscriberListPtr>::iterator it = map_topic_.find(topic);
+    SubscriberListPtr list_sub(new vector<SubscriberPtr>);
+    if (it != map_topic_.end())
+    {
+        list_sub->reserve(it->second->size() + 1);
+        for (vector<SubscriberPtr>::iterator it_sub = it->second->begin(); it_sub != it->second->end(); it_sub++)
+        {
+            if ((*it_sub) != sub)
+            {
+                list_sub->push_back(*it_sub);
+            }
+        }
+    }
+    if (add)
+    {
+        list_sub->push_back(sub);
+    }
+
+    if (list_sub->empty())
+    {
+        if (it != map_topic_.end())
+        {
+            map_topic_.erase(it);
+        }
+    }
+    else
+    {
+        map_topic_[topic] = list_sub;
+    }
+}
+
+inline
+uint32_t PubSubBroker::Publish(const string& topic, const IOCP_SharedBufferPtr& msg, uint64_t conflate_key)
+{
+    if (NULL == msg.get())
+    {
+        return 0;
+    }
+    {
+        MutexLock lock(mt_stats_);
+        stats_.published_++;
+    }
+
+    SubscriberListPtr list_sub;
+    {
+        MutexLock lock(mt_topic_);
+        map<string, SubscriberListPtr>::iterator it = map_topic_.find(topic);
+        if (it == map_topic_.end())
+        {
+            return 0;
+        }
+        list_sub = it->second;
+    }
+
+    // Subscribers closed for slow consuming are removed after the loop,
+    // the list may hold subscribers already closed, they are skipped
+    uint32_t                count = 0;
+    vector<SubscriberPtr>   list_close;
+    for (vector<SubscriberPtr>::iterator it = list_sub->begin(); it != list_sub->end(); it++)
+    {
+        PUBSUB_DELIVER_RESULT result = _Deliver(*it, msg, conflate_key);
+        if (PUBSUB_DELIVERED == result)
+        {
+            count++;
+        }
+        else if (PUBSUB_OVERFLOW == result)
+        {
+            list_close.push_back(*it);
+        }
+    }
+    for (vector<SubscriberPtr>::iterator it = list_close.begin(); it != list_close.end(); it++)
+    {
+        _CloseSubscriber(*it);
+    }
+    return count;
+}
+
+inline
+PUBSUB_DELIVER_RESULT PubSubBroker::_Deliver(const SubscriberPtr& sub, const IOCP_SharedBufferPtr& msg, uint64_t key)
+{
+    MutexLock lock(sub->mt_);
+    if (sub->closed_)
+    {
+        return PUBSUB_CLOSED;
+    }
+
+    // Nothing waiting, post directly
+    if (sub->queue_.empty() && sub->in_flight_ < max_in_flight_)
+    {
+        sub->in_flight_++;
+        sub->stats_.sent_++;
+        if (!server_.Send(sub->sock_id_, msg, sub.get()))
+        {
+            // The server closes the socket and calls DisconnectedCallback itself
+            sub->in_flight_--;
+            return PUBSUB_CLOSED;
+        }
+        return PUBSUB_DELIVERED;
+    }
+
+    if (PUBSUB_CONFLATE == policy_ && 0 != key)
+    {
+        for (deque<PendingMsg>::iterator it = sub->queue_.begin(); it != sub->queue_.end(); it++)
+        {
+            if (it->key_ == key)
+            {
+                it->msg_ = msg;
+                sub->stats_.conflated_++;
+                return PUBSUB_DELIVERED;
+            }
+        }
+    }
+
+    if (sub->queue_.size() >= max_queued_)
+    {
+        if (PUBSUB_DISCONNECT == policy_)
+        {
+            sub->closed_ = true;
+            sub->queue_.clear();
+            sub->stats_.disconnected_++;
+            return PUBSUB_OVERFLOW;
+        }
+        if (sub->queue_.empty())
+        {
+            sub->stats_.dropped_++;
+            return PUBSUB_DELIVERED;
+        }
+        sub->queue_.pop_front();
+        sub->stats_.dropped_++;
+    }
+
+    PendingMsg pending;
+    pending.msg_ = msg;
+    pending.key_ = key;
+    sub->queue_.push_back(pending);
+    sub->stats_.queued_++;
+    return PUBSUB_DELIVERED;
+}
+
+inline
+PubSubStats PubSubBroker::GetStats()
+{
+    PubSubStats stats;
+    {
+        MutexLock lock(mt_stats_);
+        stats = stats_;
+    }
+    vector<SubscriberPtr> list_sub;
+    {
+        MutexLock lock(mt_sub_);
+        for (map<unsigned long, SubscriberPtr>::iterator it = map_sub_.begin(); it != map_sub_.end(); it++)
+        {
+            list_sub.push_back(it->second);
+        }
+    }
+    for (vector<SubscriberPtr>::iterator it = list_sub.begin(); it != list_sub.end(); it++)
+    {
+        MutexLock lock((*it)->mt_);
+        stats.sent_         += (*it)->stats_.sent_;
+        stats.queued_       += (*it)->stats_.queued_;
+        stats.dropped_      += (*it)->stats_.dropped_;
+        stats.conflated_    += (*it)->stats_.conflated_;
+        stats.disconnected_ += (*it)->stats_.disconnected_;
+    }
+    return stats;
+}
+
+} // end of namespace
+using namespace lite;
+
+#endif // ifdef OS_WIN
+
+#endif // ifndef _LITE_PUBSUB_BROKER_H_
@@ -0,0 +1,236 @@
+/**
+ * @file    network\recv_budget.h
+ * @brief   Byte budgets of received data held by the application
+ *          Data delivered to RECEIVEDCALLBACK is charged until the application releases it,
+ *          the next receive of a connection is not posted while a budget is exceeded,
+ *          so TCP flow control slows the sender down instead of memory growing
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ * @update          2026-10-18      Key connections by generation, bytes of a closed connection are given back
+ *                                  Add Clear for a stopped server
+ */
+
+#ifndef _LITE_RECV_BUDGET_H_
+#define _LITE_RECV_BUDGET_H_
+
+#include "iocp_base.h"
+#include <set>
+
+#ifdef OS_WIN
+
+namespace lite {
+
+/**
+ * @brief   Counters of receive budget
+ */
+struct RecvBudgetStats
+{
+    uint64_t    used_;                              ///> Bytes held by application
+    uint64_t    pauses_;                            ///> Times a connection stopped receiving
+    uint64_t    resumes_;
+    uint32_t    paused_;                            ///> Connections not receiving now
+
+    RecvBudgetStats()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+};
+
+class IOCP_RecvBudget : private NonCopyable
+{
+public:
+    IOCP_RecvBudget()
+        : global_limit_(0)
+        , conn_limit_(0)
+        , next_generation_(1)
+    {
+    }
+
+    /**
+     * @brief   Set budgets, 0 for no limit
+     * @param   global_limit    Bytes held of all connections
+     * @param   conn_limit      Bytes held of one connection
+     */
+    void SetLimits(uint64_t global_limit, uint64_t conn_limit)
+    {
+        MutexLock lock(mt_);
+        global_limit_ = global_limit;
+        conn_limit_   = conn_limit;
+    }
+
+    /**
+     * @brief   Start the budget of an accepted connection
+     *          Socket IDs are reused, so each connection gets a new generation
+     */
+    void Add(unsigned long sock_id)
+    {
+        MutexLock lock(mt_);
+        _Erase(sock_id);
+        RecvBudgetConn& conn = map_conn_[sock_id];
+        conn.generation_ = next_generation_++;
+        conn.used_       = 0;
+    }
+
+    /**
+     * @brief   Get generation of a connection, taken when its data is received
+     * @return  0 if the connection has been removed
+     */
+    uint64_t Generation(unsigned long sock_id)
+    {
+        MutexLock lock(mt_);
+        map<unsigned long, RecvBudgetConn>::iterator it = map_conn_.find(sock_id);
+        return it == map_conn_.end() ? 0 : it->second.generation_;
+    }
+
+    /**
+     * @brief   Charge bytes delivered to application
+     */
+    void Charge(unsigned long sock_id, uint32_t bytes)
+    {
+        MutexLock lock(mt_);
+        map<unsigned long, RecvBudgetConn>::iterator it = map_conn_.find(sock_id);
+        if (it == map_conn_.end())
+        {
+            return;
+        }
+        it->second.used_ += bytes;
+        stats_.used_     += bytes;
+    }
+
+    /**
+     * @brief   Stop receiving of a connection if a budget is exceeded
+     * @return  true if paused, the receive is posted again when Release gives it back
+     */
+    bool Pause(unsigned long sock_id)
+    {
+        MutexLock lock(mt_);
+        if (0 == map_conn_.count(sock_id) || _CanReceive(sock_id))
+        {
+            return false;
+        }
+        set_paused_.insert(sock_id);
+        stats_.pauses_++;
+        return true;
+    }
+
+    /**
+     * @brief   Release bytes the application has done with
+     * @param   generation  Generation of the connection the bytes were received on, 0 for the current one.
+     *                      Bytes of a removed connection have been given back by Remove and are ignored
+     * @param   resume      Paused connections which can receive again
+     */
+    void Release(unsigned long sock_id, uint64_t generation, uint32_t bytes, vector<unsigned long>& resume)
+    {
+        MutexLock lock(mt_);
+        map<unsigned long, RecvBudgetConn>::iterator it = map_conn_.find(sock_id);
+        if (it == map_conn_.end() || (0 != generation && generation != it->second.generation_))
+        {
+            return;
+        }
+        bytes              = bytes > it->second.used_ ? (uint32_t)it->second.used_ : bytes;
+        it->second.used_  -= bytes;
+        stats_.used_      -= bytes;
+        _Resume(resume);
+    }
+
+    /**
+     * @brief   Forget a closed connection, bytes still held are given back to the global budget
+     *          and later releases of them are ignored
+     * @param   resume      Paused connections which can receive again
+     */
+    void Remove(unsigned long sock_id, vector<unsigned long>& resume)
+    {
+        MutexLock lock(mt_);
+        _Erase(sock_id);
+        _Resume(resume);
+    }
+
+    /**
+     * @brief   Forget all connections when the server stops, generations are not reused
+     *          so releases of their bytes are ignored
+     */
+    void Clear()
+    {
+        MutexLock lock(mt_);
+        map_conn_.clear();
+        set_paused_.clear();
+        stats_.used_ = 0;
+    }
+
+    RecvBudgetStats GetStats()
+    {
+        MutexLock lock(mt_);
+        stats_.paused_ = (uint32_t)set_paused_.size();
+        return stats_;
+    }
+
+private:
+    struct RecvBudgetConn
+    {
+        uint64_t    generation_;
+        uint64_t    used_;                          ///> Bytes held by application
+    };
+
+    bool _CanReceive(unsigned long sock_id)
+    {
+        if (0 != global_limit_ && stats_.used_ > global_limit_)
+        {
+            return false;
+        }
+        if (0 != conn_limit_)
+        {
+            map<unsigned long, RecvBudgetConn>::iterator it = map_conn_.find(sock_id);
+            if (it != map_conn_.end() && it->second.used_ > conn_limit_)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief   Global budget frees all paused connections, connection budget frees only its own
+     */
+    void _Resume(vector<unsigned long>& resume)
+    {
+        for (set<unsigned long>::iterator it = set_paused_.begin(); it != set_paused_.end();)
+        {
+            if (_CanReceive(*it))
+            {
+                resume.push_back(*it);
+                set_paused_.erase(it++);
+                stats_.resumes_++;
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+
+    void _Erase(unsigned long sock_id)
+    {
+        map<unsigned long, RecvBudgetConn>::iterator it = map_conn_.find(sock_id);
+        if (it != map_conn_.end())
+        {
+            stats_.used_ -= it->second.used_;
+            map_conn_.erase(it);
+        }
+        set_paused_.erase(sock_id);
+    }
+
+    Mutex                                   mt_;
+    uint64_t                                global_limit_;
+    uint64_t                                conn_limit_;
+    uint64_t                                next_generation_;
+    map<unsigned long, RecvBudgetConn>      map_conn_;      ///> Accepted connections not removed yet
+    set<unsigned long>                      set_paused_;
+    RecvBudgetStats                         stats_;
+};
+
+} // end of namespace
+using namespace lite;
+
+#endif // ifdef OS_WIN
+
+#endif // ifndef _LITE_RECV_BUDGET_H_
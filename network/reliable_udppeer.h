@@ -0,0 +1,994 @@
+/**
+ * @file    network\reliable_udppeer.h
+ * @brief   Encapsulation for reliable ordered messaging over IOCP UDP peer
+ *          Sequence numbers, selective ACKs, RTT-estimated retransmission, congestion and flow windows
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ * @update          2026-10-18      Add sender epoch to packets, receiver restarts with a restarted sender
+ *                                  Channels of remote senders are created only by the first packets of an epoch,
+ *                                  limited by RUDP_MAX_CHANNELS and removed when idle
+ */
+
+#ifndef _LITE_RELIABLE_UDP_PEER_H_
+#define _LITE_RELIABLE_UDP_PEER_H_
+
+#include "iocp_udppeer.h"
+
+#ifdef OS_WIN
+
+namespace lite {
+
+#define RUDP_DATA_HEAD_SIZE     (9)                                 ///> type(1) + epoch(4) + seq(4)
+#define RUDP_MAX_PAYLOAD        (MAX_IO_BUFFER_SIZE - RUDP_DATA_HEAD_SIZE)
+#define RUDP_RECV_WINDOW        (256)                               ///> Max packets buffered out of order
+#define RUDP_ACK_EVERY          (8)                                 ///> Send ACK at once after so many packets
+#define RUDP_ACK_DELAY          (10)                                ///> Max delay of a batched ACK(ms)
+#define RUDP_MIN_RTO            (30)
+#define RUDP_MAX_RTO            (5000)
+#define RUDP_MAX_RETRIES        (10)                                ///> Sender of channel is reset when exceeded
+#define RUDP_TIMER_INTERVAL     (5)
+#define RUDP_EPOCH_TIMEOUT      (60000)                             ///> Any epoch is accepted after silence(ms)
+#define RUDP_MAX_CHANNELS       (4096)                              ///> Channels created by remote senders are refused above
+#define RUDP_CHANNEL_TIMEOUT    (120000)                            ///> Channel with nothing to send or ACK is removed after silence(ms)
+
+typedef enum _RUDP_PACKET_TYPE
+{
+    RUDP_DATA  = 1,
+    RUDP_ACK   = 2,
+    RUDP_RESET = 3                                                  ///> Receiver has no channel, sender restarts from seq 0
+}RUDP_PACKET_TYPE;
+
+/**
+ * @brief   Counters of a reliable UDP peer
+ */
+struct ReliableUDPStats
+{
+    uint64_t    data_sent_;                         ///> Data packets sent(first transmission)
+    uint64_t    data_retransmitted_;
+    uint64_t    data_received_;                     ///> Data packets received(include duplicate)
+    uint64_t    data_delivered_;
+    uint64_t    acks_sent_;
+    uint64_t    acks_received_;
+    uint64_t    packets_dropped_;                   ///> Packets dropped by loss injection
+    uint64_t    channels_reset_;                    ///> Senders reset for exceeding RUDP_MAX_RETRIES
+    uint64_t    epochs_changed_;                    ///> Receivers restarted for a new epoch of the peer sender
+    uint64_t    channels_expired_;                  ///> Idle channels removed after RUDP_CHANNEL_TIMEOUT
+    uint64_t    channels_refused_;                  ///> Packets dropped for RUDP_MAX_CHANNELS
+    uint64_t    senders_restarted_;                 ///> Senders restarted from seq 0 by a RESET of the peer
+
+    ReliableUDPStats()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+};
+
+class ReliableUDPPeer;
+
+/**
+ * @brief   Retransmission and ACK timer thread
+ */
+class ReliableUDPTimerThread : public Thread
+{
+public:
+    ReliableUDPTimerThread(ReliableUDPPeer* peer)
+        : Thread("<reliable_udp_timer>")
+        , peer_(peer)
+    {
+    }
+
+protected:
+    virtual uint32_t _Run();
+
+private:
+    ReliableUDPPeer*    peer_;
+};
+
+class ReliableUDPPeer : private NonCopyable
+{
+    friend class ReliableUDPTimerThread;
+
+public:
+    ReliableUDPPeer()
+        : user_ptr_(NULL)
+        , ReceiveFromCallback_(NULL)
+        , loss_rate_(0)
+        , rand_state_(1)
+        , last_epoch_(0)
+        , timer_thread_(this)
+    {
+    }
+
+    virtual ~ReliableUDPPeer()
+    {
+        _ClearChannels();
+    }
+
+    /**
+     * @brief   Initializing the peer, registering the callback
+     * @param   user_ptr                User pointer which will be used in callback
+     * @param   ReceiveFromCallback     Called with msgs of each remote address in send order, exactly once.
+     *                                  Msgs dropped by a sender reset or not delivered before the remote
+     *                                  sender restarts(new socket or process) are lost, not duplicated
+     * @return  true:Success, false:Failed
+     */
+    bool Init(void* user_ptr, RECEIVEFROMCALLBACK ReceiveFromCallback)
+    {
+        assert(NULL != ReceiveFromCallback);
+        user_ptr_            = user_ptr;
+        ReceiveFromCallback_ = ReceiveFromCallback;
+        return peer_.Init(this, _OnReceiveFrom);
+    }
+
+    bool Start()
+    {
+        if (!peer_.Start())
+        {
+            return false;
+        }
+        return timer_thread_.Start();
+    }
+
+    /**
+     * @brief   Create a UDP socket
+     * @see     IOCP_UDPPeer::Create
+     */
+    bool Create(unsigned long& sock_id, const char* bind_ip, UINT16& bind_port)
+    {
+        return peer_.Create(sock_id, bind_ip, bind_port);
+    }
+
+    void CloseSocket(unsigned long sock_id);
+
+    /**
+     * @brief   Send msg reliably(asynchronous delivery, not block)
+     * @param   data_len    Msg length, not more than RUDP_MAX_PAYLOAD
+     * @return  true:Queued, false:Failed
+     */
+    bool SendTo(unsigned long sock_id, const char* data, int data_len, const char* dst_ip, UINT16 dst_port)
+    {
+        SOCKADDR_IN addr;
+        ZeroMemory(&addr, sizeof(SOCKADDR_IN));
+        addr.sin_family      = AF_INET;
+        addr.sin_addr.s_addr = inet_addr(dst_ip);
+        addr.sin_port        = htons(dst_port);
+        return SendTo(sock_id, data, data_len, addr);
+    }
+
+    bool SendTo(unsigned long sock_id, const char* data, int data_len, SOCKADDR_IN& sock_addr);
+
+    /**
+     * @brief   Inject packet loss on send, for testing over loopback
+     * @param   loss_rate   Drop probability in [0, 1), applied to both data and ACK packets
+     * @param   seed        Random seed, same seed gives same drop sequence
+     */
+    void SetLossRate(double loss_rate, uint32_t seed = 1)
+    {
+        MutexLock lock(mt_);
+        loss_rate_  = loss_rate;
+        rand_state_ = 0 == seed ? 1 : seed;
+    }
+
+    /**
+     * @brief   Count of msgs queued or in flight to an address
+     */
+    uint32_t PendingCount(unsigned long sock_id, SOCKADDR_IN& sock_addr);
+
+    ReliableUDPStats GetStats()
+    {
+        MutexLock lock(mt_);
+        return stats_;
+    }
+
+    void Stop()
+    {
+        timer_thread_.Stop();
+        peer_.Stop();
+    }
+
+    void DeInit()
+    {
+        peer_.DeInit();
+        _ClearChannels();
+    }
+
+protected:
+    struct SendSegment
+    {
+        uint32_t    seq_;
+        ByteStream  packet_;                        ///> Encoded packet
+        DWORD       send_time_;
+        uint32_t    retries_;
+        bool        sacked_;                        ///> Received by peer out of order
+        bool        fast_retx_;                     ///> Fast retransmitted once
+
+        SendSegment(uint32_t seq) : seq_(seq), send_time_(0), retries_(0), sacked_(false), fast_retx_(false)
+        {
+        }
+    };
+
+    struct RecvSlot
+    {
+        bool        present_;
+        ByteStream  data_;
+
+        RecvSlot() : present_(false)
+        {
+        }
+    };
+
+    /**
+     * @brief   State of one (socket, remote address) pair
+     *          A sender starts from seq 0 with a new epoch, which is carried by DATA and ACK packets,
+     *          so a receiver knows a restarted sender and an ACK of a previous sender is ignored
+     */
+    struct Channel
+    {
+        unsigned long           sock_id_;
+        SOCKADDR_IN             addr_;
+
+        // Sender
+        uint32_t                epoch_;
+        uint32_t                next_seq_;
+        list<SendSegment*>      list_inflight_;     ///> In seq order
+        list<SendSegment*>      list_pending_;      ///> Wait for window
+        double                  cwnd_;              ///> Congestion window(packets)
+        uint32_t                ssthresh_;
+        uint32_t                peer_wnd_;          ///> Flow window advertised by peer
+        uint32_t                recover_;           ///> Seq sent when last window was reduced
+        uint32_t                srtt_;
+        uint32_t                rttvar_;
+        uint32_t                rto_;
+        bool                    has_rtt_;
+
+        DWORD                   active_time_;       ///> Time of the last send or received packet
+
+        // Receiver
+        uint32_t                peer_epoch_;        ///> Epoch of the peer sender, 0 if none received
+        DWORD                   recv_time_;         ///> Time of the last data packet
+        uint32_t                next_recv_;
+        RecvSlot                slots_[RUDP_RECV_WINDOW];
+        uint32_t                buffered_;
+        uint32_t                unacked_;           ///> Packets received but not acked
+        DWORD                   ack_time_;          ///> Time of the first unacked packet
+
+        Channel(unsigned long sock_id, const SOCKADDR_IN& addr, uint32_t epoch)
+            : sock_id_(sock_id)
+            , addr_(addr)
+            , epoch_(epoch)
+            , next_seq_(0)
+            , cwnd_(4)
+            , ssthresh_(RUDP_RECV_WINDOW)
+            , peer_wnd_(RUDP_RECV_WINDOW)
+            , recover_(0)
+            , srtt_(0)
+            , rttvar_(0)
+            , rto_(200)
+            , has_rtt_(false)
+            , active_time_(GetTickCount())
+            , peer_epoch_(0)
+            , recv_time_(0)
+            , next_recv_(0)
+            , buffered_(0)
+            , unacked_(0)
+            , ack_time_(0)
+        {
+        }
+
+        ~Channel()
+        {
+            _ClearSegments();
+        }
+
+        /**
+         * @brief   Drop queued msgs and restart from seq 0 with a new epoch
+         */
+        void ResetSender(uint32_t epoch)
+        {
+            _ClearSegments();
+            epoch_    = epoch;
+            next_seq_ = 0;
+            cwnd_     = 4;
+            ssthresh_ = RUDP_RECV_WINDOW;
+            peer_wnd_ = RUDP_RECV_WINDOW;
+            recover_  = 0;
+            srtt_     = 0;
+            rttvar_   = 0;
+            rto_      = 200;
+            has_rtt_  = false;
+        }
+
+        /**
+         * @brief   Nothing to send, retransmit or ACK
+         */
+        bool Idle() const
+        {
+            return list_inflight_.empty() && list_pending_.empty() && 0 == buffered_ && 0 == unacked_;
+        }
+
+        /**
+         * @brief   Drop buffered packets and expect seq 0 of the peer sender with epoch
+         */
+        void ResetReceiver(uint32_t peer_epoch)
+        {
+            for (uint32_t i = 0; i < RUDP_RECV_WINDOW; i++)
+            {
+                slots_[i].present_ = false;
+                slots_[i].data_.SetWritePtr(0);
+            }
+            peer_epoch_ = peer_epoch;
+            next_recv_  = 0;
+            buffered_   = 0;
+            unacked_    = 0;
+        }
+
+    private:
+        void _ClearSegments()
+        {
+            for (list<SendSegment*>::iterator it = list_inflight_.begin(); it != list_inflight_.end(); it++)
+            {
+                delete (*it);
+            }
+            list_inflight_.clear();
+            for (list<SendSegment*>::iterator it = list_pending_.begin(); it != list_pending_.end(); it++)
+            {
+                delete (*it);
+            }
+            list_pending_.clear();
+        }
+    };
+
+    typedef pair<unsigned long, uint64_t> ChannelKey;
+
+    static ChannelKey _MakeKey(unsigned long sock_id, const SOCKADDR_IN& addr)
+    {
+        return ChannelKey(sock_id, ((uint64_t)addr.sin_addr.s_addr << 16) | addr.sin_port);
+    }
+
+    /**
+     * @brief   Seq comparison with wrap around
+     */
+    static bool _SeqLess(uint32_t a, uint32_t b)
+    {
+        return (int32_t)(a - b) < 0;
+    }
+
+    static void _OnReceiveFrom(unsigned long sock_id, const char* data, int data_len, SOCKADDR_IN src_addr, void* user_ptr);
+
+    Channel* _GetChannel(unsigned long sock_id, const SOCKADDR_IN& addr);
+
+    /**
+     * @brief   Channel of a received packet
+     *          A DATA packet in the first receive window of an epoch creates the channel,
+     *          other packets of unknown addresses get NULL, so they can not fill memory with channels
+     */
+    Channel* _GetRecvChannel(unsigned long sock_id, const SOCKADDR_IN& addr, uint8_t type, uint32_t epoch, uint32_t seq);
+
+    /**
+     * @brief   Epoch for a new or reset sender, never 0
+     *          Based on wall clock ms, so a sender of a restarted process has a newer epoch,
+     *          and increased for each call, so senders of this process have newer epochs in turn
+     */
+    uint32_t _NewEpoch();
+
+    void _OnData(Channel* channel, uint32_t epoch, uint32_t seq, const char* payload, uint32_t payload_len);
+
+    void _OnAck(Channel* channel, uint32_t epoch, uint32_t cum_ack, uint32_t sack_bits, uint32_t peer_wnd);
+
+    /**
+     * @brief   Peer has no receiver for epoch, send msgs not acked again from seq 0 with a new epoch
+     */
+    void _OnReset(Channel* channel, uint32_t epoch);
+
+    void _SendAck(Channel* channel);
+
+    void _Transmit(Channel* channel, SendSegment* segment);
+
+    /**
+     * @brief   Move pending segments into flight while windows allow
+     */
+    void _FlushPending(Channel* channel);
+
+    void _UpdateRtt(Channel* channel, uint32_t rtt);
+
+    /**
+     * @brief   Send raw packet, subject to loss injection
+     */
+    void _SendPacket(Channel* channel, const ByteStream& packet)
+    {
+        _SendPacket(channel->sock_id_, channel->addr_, packet);
+    }
+
+    void _SendPacket(unsigned long sock_id, const SOCKADDR_IN& addr, const ByteStream& packet);
+
+    /**
+     * @brief   Called by timer thread: flush batched ACKs, retransmit timeout segments and remove idle channels
+     */
+    void _OnTimer();
+
+    void _ClearChannels()
+    {
+        MutexLock lock(mt_);
+        for (map<ChannelKey, Channel*>::iterator it = map_channel_.begin(); it != map_channel_.end(); it++)
+        {
+            delete it->second;
+        }
+        map_channel_.clear();
+    }
+
+private:
+    IOCP_UDPPeer                    peer_;
+    void*                           user_ptr_;
+    RECEIVEFROMCALLBACK             ReceiveFromCallback_;
+    map<ChannelKey, Channel*>       map_channel_;
+    Mutex                           mt_;                ///> Protect all channels(recursive, callback may send)
+    double                          loss_rate_;
+    uint32_t                        rand_state_;
+    uint32_t                        last_epoch_;
+    ReliableUDPStats                stats_;
+    ReliableUDPTimerThread          timer_thread_;
+};
+
+inline
+uint32_t ReliableUDPTimerThread::_Run()
+{
+    while (!_Signalled())
+    {
+        _Sleep(RUDP_TIMER_INTERVAL);
+        peer_->_OnTimer();
+    }
+    return 0;
+}
+
+inline
+void ReliableUDPPeer::CloseSocket(unsigned long sock_id)
+{
+    peer_.CloseSocket(sock_id);
+    MutexLock lock(mt_);
+    map<ChannelKey, Channel*>::iterator it = map_channel_.begin();
+    while (it != map_channel_.end())
+    {
+        if (it->first.first == sock_id)
+        {
+            delete it->second;
+            map_channel_.erase(it++);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+inline
+ReliableUDPPeer::Channel* ReliableUDPPeer::_GetChannel(unsigned long sock_id, const SOCKADDR_IN& addr)
+{
+    ChannelKey key = _MakeKey(sock_id, addr);
+    map<ChannelKey, Channel*>::iterator it = map_channel_.find(key);
+    if (it != map_channel_.end())
+    {
+        return it->second;
+    }
+    Channel* channel  = new Channel(sock_id, addr, _NewEpoch());
+    map_channel_[key] = channel;
+    return channel;
+}
+
+inline
+ReliableUDPPeer::Channel* ReliableUDPPeer::_GetRecvChannel(unsigned long sock_id,
+                                                           const SOCKADDR_IN& addr,
+                                                           uint8_t type,
+                                                           uint32_t epoch,
+                                                           uint32_t seq)
+{
+    map<ChannelKey, Channel*>::iterator it = map_channel_.find(_MakeKey(sock_id, addr));
+    if (it != map_channel_.end())
+    {
+        return it->second;
+    }
+    if (RUDP_DATA != type || 0 == epoch)
+    {
+        return NULL;
+    }
+    if (seq >= RUDP_RECV_WINDOW)
+    {
+        // A sender we have no state of(channel expired or process restarted), it restarts from seq 0
+        ByteStream packet(RUDP_DATA_HEAD_SIZE);
+        packet.SetByteOrder(NETWORK_BYTEORDER);
+        packet.PutUint8(RUDP_RESET);
+        packet.PutUint32(epoch);
+        packet.PutUint32(seq);
+        _SendPacket(sock_id, addr, packet);
+        return NULL;
+    }
+    if (map_channel_.size() >= RUDP_MAX_CHANNELS)
+    {
+        stats_.channels_refused_++;
+        return NULL;
+    }
+    return _GetChannel(sock_id, addr);
+}
+
+inline
+uint32_t ReliableUDPPeer::_NewEpoch()
+{
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint32_t now_ms = (uint32_t)((((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime) / 10000);
+    last_epoch_ = (0 == last_epoch_ || _SeqLess(last_epoch_, now_ms)) ? now_ms : last_epoch_ + 1;
+    if (0 == last_epoch_)
+    {
+        last_epoch_ = 1;
+    }
+    return last_epoch_;
+}
+
+inline
+bool ReliableUDPPeer::SendTo(unsigned long sock_id, const char* data, int data_len, SOCKADDR_IN& sock_addr)
+{
+    if (NULL == data || data_len <= 0 || data_len > RUDP_MAX_PAYLOAD)
+    {
+        return false;
+    }
+
+    MutexLock lock(mt_);
+    Channel* channel = _GetChannel(sock_id, sock_addr);
+    DWORD    now     = GetTickCount();
+    if (0 != channel->next_seq_ && channel->list_inflight_.empty() && channel->list_pending_.empty() &&
+        now - channel->active_time_ >= RUDP_CHANNEL_TIMEOUT / 2)
+    {
+        // All msgs are acked, but the peer may have removed its idle channel,
+        // start from seq 0 with a new epoch so the channel is created again
+        channel->ResetSender(_NewEpoch());
+    }
+    channel->active_time_ = now;
+
+    SendSegment* segment = new SendSegment(channel->next_seq_++);
+    segment->packet_.SetByteOrder(NETWORK_BYTEORDER);
+    segment->packet_.PutUint8(RUDP_DATA);
+    segment->packet_.PutUint32(channel->epoch_);
+    segment->packet_.PutUint32(segment->seq_);
+    segment->packet_.Add(data, (uint32_t)data_len);
+    channel->list_pending_.push_back(segment);
+    _FlushPending(channel);
+    return true;
+}
+
+inline
+uint32_t ReliableUDPPeer::PendingCount(unsigned long sock_id, SOCKADDR_IN& sock_addr)
+{
+    MutexLock lock(mt_);
+    map<ChannelKey, Channel*>::iterator it = map_channel_.find(_MakeKey(sock_id, sock_addr));
+    if (it == map_channel_.end())
+    {
+        return 0;
+    }
+    return (uint32_t)(it->second->list_inflight_.size() + it->second->list_pending_.size());
+}
+
+inline
+void ReliableUDPPeer::_OnReceiveFrom(unsigned long sock_id, const char* data, int data_len, SOCKADDR_IN src_addr, void* user_ptr)
+{
+    ReliableUDPPeer* peer = (ReliableUDPPeer*)user_ptr;
+    if (data_len <= 0)
+    {
+        return;
+    }
+
+    try
+    {
+        ByteStream bs((const uint8_t*)data, (uint32_t)data_len);
+        bs.SetByteOrder(NETWORK_BYTEORDER);
+        // All packets start with type, epoch and seq(cumulative ACK of ACK packets)
+        uint8_t  type  = bs.GetUint8();
+        uint32_t epoch = bs.GetUint32();
+        uint32_t seq   = bs.GetUint32();
+
+        MutexLock lock(peer->mt_);
+        Channel* channel = peer->_GetRecvChannel(sock_id, src_addr, type, epoch, seq);
+        if (NULL == channel)
+        {
+            return;
+        }
+        channel->active_time_ = GetTickCount();
+        if (RUDP_DATA == type)
+        {
+            peer->_OnData(channel, epoch, seq, data + bs.GetReadPtr(), (uint32_t)data_len - bs.GetReadPtr());
+        }
+        else if (RUDP_ACK == type)
+        {
+            uint32_t sack_bits = bs.GetUint32();
+            uint32_t peer_wnd  = bs.GetUint16();
+            peer->_OnAck(channel, epoch, seq, sack_bits, peer_wnd);
+        }
+        else if (RUDP_RESET == type)
+        {
+            peer->_OnReset(channel, epoch);
+        }
+    }
+    catch (access_violation_exception&)
+    {
+        // Truncated packet, drop it
+    }
+}
+
+inline
+void ReliableUDPPeer::_OnData(Channel* channel, uint32_t epoch, uint32_t seq, const char* payload, uint32_t payload_len)
+{
+    stats_.data_received_++;
+    DWORD now = GetTickCount();
+    if (0 == epoch ||
+        (0 != channel->peer_epoch_ && _SeqLess(epoch, channel->peer_epoch_) &&
+         now - channel->recv_time_ < RUDP_EPOCH_TIMEOUT))
+    {
+        // Delayed packet of a previous sender.
+        // After long silence the comparison may wrap, so an older epoch is taken as a restart
+        return;
+    }
+    channel->recv_time_ = now;
+    if (epoch != channel->peer_epoch_)
+    {
+        // The peer sender is new or restarted from seq 0, msgs of the old one are not delivered any more
+        if (0 != channel->peer_epoch_)
+        {
+            stats_.epochs_changed_++;
+        }
+        channel->ResetReceiver(epoch);
+    }
+
+    uint32_t offset = seq - channel->next_recv_;
+    if (_SeqLess(seq, channel->next_recv_))
+    {
+        // Duplicate, the ACK may be lost
+        _SendAck(channel);
+        return;
+    }
+    if (offset >= RUDP_RECV_WINDOW)
+    {
+        return;
+    }
+
+    if (0 == offset)
+    {
+        ReceiveFromCallback_(channel->sock_id_, payload, (int)payload_len, channel->addr_, user_ptr_);
+        stats_.data_delivered_++;
+        channel->next_recv_++;
+
+        // Deliver buffered packets which become in order
+        RecvSlot* slot = &channel->slots_[channel->next_recv_ % RUDP_RECV_WINDOW];
+        while (slot->present_)
+        {
+            ReceiveFromCallback_(channel->sock_id_,
+                                 (const char*)slot->data_.GetBuffer(),
+                                 (int)slot->data_.GetWritePtr(),
+                                 channel->addr_,
+                                 user_ptr_);
+            stats_.data_delivered_++;
+            slot->present_ = false;
+            slot->data_.SetWritePtr(0);
+            channel->buffered_--;
+            channel->next_recv_++;
+            slot = &channel->slots_[channel->next_recv_ % RUDP_RECV_WINDOW];
+        }
+    }
+    else
+    {
+        RecvSlot& slot = channel->slots_[seq % RUDP_RECV_WINDOW];
+        if (!slot.present_)
+        {
+            slot.present_ = true;
+            slot.data_.SetWritePtr(0);
+            slot.data_.Add(payload, payload_len);
+            channel->buffered_++;
+        }
+        // Out of order means loss, ACK at once so the sender can fast retransmit
+        _SendAck(channel);
+        return;
+    }
+
+    // Batch ACKs
+    if (0 == channel->unacked_++)
+    {
+        channel->ack_time_ = GetTickCount();
+    }
+    if (channel->unacked_ >= RUDP_ACK_EVERY)
+    {
+        _SendAck(channel);
+    }
+}
+
+inline
+void ReliableUDPPeer::_SendAck(Channel* channel)
+{
+    // Bit i of sack_bits means seq (next_recv_ + 1 + i) is received
+    uint32_t sack_bits = 0;
+    for (uint32_t i = 0; i < 32 && i + 1 < RUDP_RECV_WINDOW; i++)
+    {
+        if (channel->slots_[(channel->next_recv_ + 1 + i) % RUDP_RECV_WINDOW].present_)
+        {
+            sack_bits |= (1u << i);
+        }
+    }
+
+    ByteStream packet(20);
+    packet.SetByteOrder(NETWORK_BYTEORDER);
+    packet.PutUint8(RUDP_ACK);
+    packet.PutUint32(channel->peer_epoch_);
+    packet.PutUint32(channel->next_recv_);
+    packet.PutUint32(sack_bits);
+    packet.PutUint16((uint16_t)(RUDP_RECV_WINDOW - channel->buffered_));
+    _SendPacket(channel, packet);
+
+    stats_.acks_sent_++;
+    channel->unacked_ = 0;
+}
+
+inline
+void ReliableUDPPeer::_OnAck(Channel* channel, uint32_t epoch, uint32_t cum_ack, uint32_t sack_bits, uint32_t peer_wnd)
+{
+    stats_.acks_received_++;
+    if (epoch != channel->epoch_)
+    {
+        // ACK of a previous sender of this channel
+        return;
+    }
+    channel->peer_wnd_ = peer_wnd;
+    DWORD    now          = GetTickCount();
+    uint32_t newly_acked  = 0;
+    uint32_t highest_sack = cum_ack;
+    bool     has_sack     = false;
+
+    list<SendSegment*>::iterator it = channel->list_inflight_.begin();
+    while (it != channel->list_inflight_.end())
+    {
+        SendSegment* segment = *it;
+        if (_SeqLess(segment->seq_, cum_ack))
+        {
+            // Karn: only sample RTT of segments never retransmitted
+            if (0 == segment->retries_)
+            {
+                _UpdateRtt(channel, now - segment->send_time_);
+            }
+            delete segment;
+            it = channel->list_inflight_.erase(it);
+            newly_acked++;
+            continue;
+        }
+        uint32_t offset = segment->seq_ - cum_ack - 1;
+        if (offset < 32 && 0 != (sack_bits & (1u << offset)))
+        {
+            segment->sacked_ = true;
+            highest_sack     = segment->seq_;
+            has_sack         = true;
+        }
+        it++;
+    }
+
+    // Congestion window: slow start, then additive increase
+    for (uint32_t i = 0; i < newly_acked; i++)
+    {
+        if (channel->cwnd_ < channel->ssthresh_)
+        {
+            channel->cwnd_ += 1;
+        }
+        else
+        {
+            channel->cwnd_ += 1 / channel->cwnd_;
+        }
+    }
+
+    // Fast retransmit holes followed by at least 3 sacked segments
+    if (has_sack)
+    {
+        uint32_t sacked_after = 0;
+        for (list<SendSegment*>::reverse_iterator rit = channel->list_inflight_.rbegin();
+             rit != channel->list_inflight_.rend(); rit++)
+        {
+            SendSegment* segment = *rit;
+            if (_SeqLess(highest_sack, segment->seq_))
+            {
+                continue;
+            }
+            if (segment->sacked_)
+            {
+                sacked_after++;
+            }
+            else if (sacked_after >= 3 && !segment->fast_retx_)
+            {
+                segment->fast_retx_ = true;
+                // Reduce window once per window of data
+                if (!_SeqLess(segment->seq_, channel->recover_))
+                {
+                    channel->ssthresh_ = max((uint32_t)(channel->cwnd_ / 2), (uint32_t)2);
+                    channel->cwnd_     = channel->ssthresh_;
+                    channel->recover_  = channel->next_seq_;
+                }
+                _Transmit(channel, segment);
+            }
+        }
+    }
+
+    _FlushPending(channel);
+}
+
+inline
+void ReliableUDPPeer::_OnReset(Channel* channel, uint32_t epoch)
+{
+    if (epoch != channel->epoch_ || (channel->list_inflight_.empty() && channel->list_pending_.empty()))
+    {
+        // RESET of a previous sender, or nothing left to deliver
+        return;
+    }
+    stats_.senders_restarted_++;
+
+    // Msgs acked were delivered by the old receiver, the others are numbered again in order
+    list<SendSegment*> list_resend;
+    list_resend.splice(list_resend.end(), channel->list_inflight_);
+    list_resend.splice(list_resend.end(), channel->list_pending_);
+    channel->ResetSender(_NewEpoch());
+    for (list<SendSegment*>::iterator it = list_resend.begin(); it != list_resend.end(); it++)
+    {
+        SendSegment* segment = *it;
+        segment->seq_       = channel->next_seq_++;
+        segment->send_time_ = 0;
+        segment->retries_   = 0;
+        segment->sacked_    = false;
+        segment->fast_retx_ = false;
+
+        // Rewrite epoch and seq of the encoded head
+        uint32_t size = segment->packet_.GetWritePtr();
+        segment->packet_.SetWritePtr(1);
+        segment->packet_.PutUint32(channel->epoch_);
+        segment->packet_.PutUint32(segment->seq_);
+        segment->packet_.SetWritePtr(size);
+        channel->list_pending_.push_back(segment);
+    }
+    _FlushPending(channel);
+}
+
+inline
+void ReliableUDPPeer::_UpdateRtt(Channel* channel, uint32_t rtt)
+{
+    // Jacobson/Karels: srtt = 7/8 srtt + 1/8 rtt, rttvar = 3/4 rttvar + 1/4 |srtt - rtt|
+    if (!channel->has_rtt_)
+    {
+        channel->srtt_    = rtt;
+        channel->rttvar_  = rtt / 2;
+        channel->has_rtt_ = true;
+    }
+    else
+    {
+        uint32_t delta   = rtt > channel->srtt_ ? rtt - channel->srtt_ : channel->srtt_ - rtt;
+        channel->rttvar_ = (3 * channel->rttvar_ + delta) / 4;
+        channel->srtt_   = (7 * channel->srtt_ + rtt) / 8;
+    }
+    channel->rto_ = channel->srtt_ + 4 * channel->rttvar_;
+    if (channel->rto_ < RUDP_MIN_RTO)
+    {
+        channel->rto_ = RUDP_MIN_RTO;
+    }
+    else if (channel->rto_ > RUDP_MAX_RTO)
+    {
+        channel->rto_ = RUDP_MAX_RTO;
+    }
+}
+
+inline
+void ReliableUDPPeer::_FlushPending(Channel* channel)
+{
+    uint32_t wnd = min((uint32_t)channel->cwnd_, channel->peer_wnd_);
+    if (0 == wnd)
+    {
+        // Keep one segment in flight as a window probe
+        wnd = 1;
+    }
+    while (!channel->list_pending_.empty() && channel->list_inflight_.size() < wnd)
+    {
+        SendSegment* segment = channel->list_pending_.front();
+        channel->list_pending_.pop_front();
+        channel->list_inflight_.push_back(segment);
+        stats_.data_sent_++;
+        _Transmit(channel, segment);
+    }
+}
+
+inline
+void ReliableUDPPeer::_Transmit(Channel* channel, SendSegment* segment)
+{
+    if (0 != segment->send_time_)
+    {
+        segment->retries_++;
+        stats_.data_retransmitted_++;
+    }
+    segment->send_time_ = GetTickCount();
+    _SendPacket(channel, segment->packet_);
+}
+
+inline
+void ReliableUDPPeer::_SendPacket(unsigned long sock_id, const SOCKADDR_IN& addr, const ByteStream& packet)
+{
+    if (loss_rate_ > 0)
+    {
+        // xorshift32, deterministic for a seed
+        rand_state_ ^= rand_state_ << 13;
+        rand_state_ ^= rand_state_ >> 17;
+        rand_state_ ^= rand_state_ << 5;
+        if ((double)rand_state_ / 4294967296.0 < loss_rate_)
+        {
+            stats_.packets_dropped_++;
+            return;
+        }
+    }
+    SOCKADDR_IN dst_addr = addr;
+    peer_.SendTo(sock_id, (const char*)packet.GetBuffer(), (int)packet.GetWritePtr(), dst_addr);
+}
+
+inline
+void ReliableUDPPeer::_OnTimer()
+{
+    MutexLock lock(mt_);
+    DWORD now = GetTickCount();
+    map<ChannelKey, Channel*>::iterator it = map_channel_.begin();
+    while (it != map_channel_.end())
+    {
+        Channel* channel = it->second;
+
+        // Nothing happened for long, a new packet of the peer sender creates the channel again
+        if (channel->Idle() && now - channel->active_time_ >= RUDP_CHANNEL_TIMEOUT)
+        {
+            stats_.channels_expired_++;
+            delete channel;
+            map_channel_.erase(it++);
+            continue;
+        }
+
+        // Flush batched ACK
+        if (channel->unacked_ > 0 && now - channel->ack_time_ >= RUDP_ACK_DELAY)
+        {
+            _SendAck(channel);
+        }
+
+        // Retransmit timeout segments, the window collapses once per timer tick
+        bool timeout = false;
+        bool reset   = false;
+        for (list<SendSegment*>::iterator sit = channel->list_inflight_.begin();
+             sit != channel->list_inflight_.end(); sit++)
+        {
+            SendSegment* segment = *sit;
+            if (segment->sacked_ || now - segment->send_time_ < channel->rto_)
+            {
+                continue;
+            }
+            if (segment->retries_ >= RUDP_MAX_RETRIES)
+            {
+                reset = true;
+                break;
+            }
+            timeout = true;
+            _Transmit(channel, segment);
+        }
+
+        if (reset)
+        {
+            // Peer is unreachable, drop queued msgs and restart the sender with a new epoch.
+            // The receiver is kept, the peer sender is not affected
+            stats_.channels_reset_++;
+            channel->ResetSender(_NewEpoch());
+            it++;
+            continue;
+        }
+        if (timeout)
+        {
+            channel->ssthresh_ = max((uint32_t)(channel->cwnd_ / 2), (uint32_t)2);
+            channel->cwnd_     = 1;
+            channel->rto_      = min(channel->rto_ * 2, (uint32_t)RUDP_MAX_RTO);
+        }
+        it++;
+    }
+}
+
+} // end of namespace
+using namespace lite;
+
+#endif // ifdef OS_WIN
+
+#endif // ifndef _LITE_RELIABLE_UDP_PEER_H_
@@ -0,0 +1,208 @@
+/**
+ * @file    network\socket_options.h
+ * @brief   TCP socket option profiles applied at accept/connect, and socket buffer autotuning
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ */
+
+#ifndef _LITE_SOCKET_OPTIONS_H_
+#define _LITE_SOCKET_OPTIONS_H_
+
+#include "iocp_base.h"
+
+#ifdef OS_WIN
+
+#include <MSTcpIP.h>
+
+namespace lite {
+
+#define SOCKET_AUTOTUNE_INTERVAL        (1000)          ///> ms between two tunings of a socket
+#define SOCKET_AUTOTUNE_WINDOW          (100)           ///> ms of traffic a buffer should hold
+#define SOCKET_AUTOTUNE_QUEUED_SENDS    (4)             ///> Pending sends meaning data queues in user memory
+
+/**
+ * @brief   Options of a TCP socket, 0 keeps the system default
+ */
+struct IOCP_SocketOptions
+{
+    bool        nodelay_;                               ///> TCP_NODELAY, disable Nagle
+    int         sndbuf_;                                ///> SO_SNDBUF in bytes
+    int         rcvbuf_;                                ///> SO_RCVBUF in bytes
+    bool        keepalive_;                             ///> SO_KEEPALIVE
+    uint32_t    keepalive_time_ms_;                     ///> Idle time before the first probe
+    uint32_t    keepalive_interval_ms_;                 ///> Time between probes
+    bool        quickack_;                              ///> ACK every segment(SIO_TCP_SET_ACK_FREQUENCY 1)
+    bool        autotune_;                              ///> Tune SO_SNDBUF/SO_RCVBUF by throughput and queueing
+    int         autotune_min_;                          ///> Min buffer set by autotuning
+    int         autotune_max_;                          ///> Max buffer set by autotuning
+
+    IOCP_SocketOptions()
+        : nodelay_(false)
+        , sndbuf_(0)
+        , rcvbuf_(0)
+        , keepalive_(false)
+        , keepalive_time_ms_(0)
+        , keepalive_interval_ms_(0)
+        , quickack_(false)
+        , autotune_(false)
+        , autotune_min_(8 * 1024)
+        , autotune_max_(4 * 1024 * 1024)
+    {
+    }
+
+    /**
+     * @brief   Small request/response: no Nagle, no delayed ACK, fast dead peer detection
+     */
+    static IOCP_SocketOptions LowLatency()
+    {
+        IOCP_SocketOptions options;
+        options.nodelay_               = true;
+        options.quickack_              = true;
+        options.keepalive_             = true;
+        options.keepalive_time_ms_     = 10000;
+        options.keepalive_interval_ms_ = 1000;
+        return options;
+    }
+
+    /**
+     * @brief   Bulk transfer: large buffers grown with the throughput
+     */
+    static IOCP_SocketOptions BulkThroughput()
+    {
+        IOCP_SocketOptions options;
+        options.sndbuf_                = 256 * 1024;
+        options.rcvbuf_                = 256 * 1024;
+        options.keepalive_             = true;
+        options.keepalive_time_ms_     = 60000;
+        options.keepalive_interval_ms_ = 5000;
+        options.autotune_              = true;
+        options.autotune_min_          = 64 * 1024;
+        options.autotune_max_          = 16 * 1024 * 1024;
+        return options;
+    }
+
+    /**
+     * @brief   Set options on a socket
+     * @return  false if any option failed, the others are still set
+     */
+    bool Apply(SOCKET sock) const
+    {
+        bool ok = true;
+        if (nodelay_)
+        {
+            BOOL value = TRUE;
+            ok &= (0 == setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&value, sizeof(value)));
+        }
+        if (0 != sndbuf_)
+        {
+            ok &= (0 == setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char*)&sndbuf_, sizeof(sndbuf_)));
+        }
+        if (0 != rcvbuf_)
+        {
+            ok &= (0 == setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf_, sizeof(rcvbuf_)));
+        }
+        if (keepalive_)
+        {
+            DWORD          bytes = 0;
+            tcp_keepalive  vals;
+            vals.onoff             = 1;
+            vals.keepalivetime     = 0 == keepalive_time_ms_ ? 7200000 : keepalive_time_ms_;
+            vals.keepaliveinterval = 0 == keepalive_interval_ms_ ? 1000 : keepalive_interval_ms_;
+            ok &= (0 == WSAIoctl(sock, SIO_KEEPALIVE_VALS, &vals, sizeof(vals), NULL, 0, &bytes, NULL, NULL));
+        }
+#ifdef SIO_TCP_SET_ACK_FREQUENCY
+        if (quickack_)
+        {
+            DWORD bytes = 0;
+            int   freq  = 1;
+            ok &= (0 == WSAIoctl(sock, SIO_TCP_SET_ACK_FREQUENCY, &freq, sizeof(freq), NULL, 0, &bytes, NULL, NULL));
+        }
+#endif
+        return ok;
+    }
+};
+
+/**
+ * @brief   Grow or shrink socket buffers to hold SOCKET_AUTOTUNE_WINDOW of traffic,
+ *          and grow them faster when data queues(receives fill the user buffer, or sends pile up)
+ * @note    Cheap when not due, call it on IO completions. Only one thread tunes a socket at a time.
+ */
+inline
+void IOCP_AutoTune(IOCP_SocketContext* sock_context, const IOCP_SocketOptions& options)
+{
+    DWORD now = GetTickCount();
+    if (now - sock_context->tune_tick_ < SOCKET_AUTOTUNE_INTERVAL ||
+        0 != InterlockedCompareExchange(&sock_context->tuning_, 1, 0))
+    {
+        return;
+    }
+    DWORD elapsed = now - sock_context->tune_tick_;
+    if (elapsed < SOCKET_AUTOTUNE_INTERVAL)
+    {
+        // Tuned by another thread just now
+        InterlockedExchange(&sock_context->tuning_, 0);
+        return;
+    }
+
+    LONG64 bytes_recv = InterlockedExchange64(&sock_context->bytes_recv_, 0);
+    LONG64 bytes_sent = InterlockedExchange64(&sock_context->bytes_sent_, 0);
+    LONG   recv_count = InterlockedExchange(&sock_context->recv_count_, 0);
+    LONG   recv_full  = InterlockedExchange(&sock_context->recv_full_, 0);
+    size_t pending    = 0;
+    {
+        MutexLock lock(sock_context->mt_io_list_);
+        pending = sock_context->list_io_context_.size();
+    }
+
+    int* bufs[2]    = { &sock_context->rcvbuf_, &sock_context->sndbuf_ };
+    int  opts[2]    = { SO_RCVBUF, SO_SNDBUF };
+    bool queued[2]  = { recv_count > 0 && recv_full * 2 > recv_count,
+                        pending > SOCKET_AUTOTUNE_QUEUED_SENDS };
+    LONG64 bytes[2] = { bytes_recv, bytes_sent };
+    for (int i = 0; i < 2; i++)
+    {
+        int cur = *bufs[i];
+        if (0 == cur)
+        {
+            int len = sizeof(cur);
+            getsockopt(sock_context->sock_, SOL_SOCKET, opts[i], (char*)&cur, &len);
+        }
+
+        // Round up to power of 2, and change only by a factor of 2 or more to avoid flapping
+        LONG64 want   = bytes[i] * SOCKET_AUTOTUNE_WINDOW / elapsed;
+        int    target = options.autotune_min_;
+        while (target < want && target < options.autotune_max_)
+        {
+            target <<= 1;
+        }
+        if (queued[i] && target <= cur)
+        {
+            target = cur * 2;
+        }
+        if (target > options.autotune_max_)
+        {
+            target = options.autotune_max_;
+        }
+        if (target >= cur * 2 || target * 2 <= cur)
+        {
+            if (0 == setsockopt(sock_context->sock_, SOL_SOCKET, opts[i], (const char*)&target, sizeof(target)))
+            {
+                *bufs[i] = target;
+            }
+        }
+        else
+        {
+            *bufs[i] = cur;
+        }
+    }
+
+    sock_context->tune_tick_ = now;
+    InterlockedExchange(&sock_context->tuning_, 0);
+}
+
+} // end of namespace
+using namespace lite;
+
+#endif // ifdef OS_WIN
+
+#endif // ifndef _LITE_SOCKET_OPTIONS_H_
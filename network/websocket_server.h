@@ -0,0 +1,874 @@
+/**
+ * @file    network\websocket_server.h
+ * @brief   Encapsulation for WebSocket(RFC 6455) server over IOCP TCP server
+ *          Support upgrade handshake, fragmented messages, ping/pong keepalive and broadcast
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ * @update          2026-10-18      Complete closing handshake, close socket after Close frame or 400 is sent
+ */
+
+#ifndef _LITE_WEBSOCKET_SERVER_H_
+#define _LITE_WEBSOCKET_SERVER_H_
+
+#include "http_server.h"
+#include "tools/sha1.h"
+#include "tools/base64.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WEBSOCKET_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef OS_WIN
+
+namespace lite {
+
+#define WEBSOCKET_MAX_MESSAGE_SIZE      (1024*1024)     ///> Max size of a (reassembled) message
+#define WEBSOCKET_GUID                  "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+typedef enum _WEBSOCKET_OPCODE
+{
+    WS_OPCODE_CONTINUATION = 0x0,
+    WS_OPCODE_TEXT         = 0x1,
+    WS_OPCODE_BINARY       = 0x2,
+    WS_OPCODE_CLOSE        = 0x8,
+    WS_OPCODE_PING         = 0x9,
+    WS_OPCODE_PONG         = 0xA
+}WEBSOCKET_OPCODE;
+
+/**
+ * @brief   Close status code
+ */
+typedef enum _WEBSOCKET_CLOSE_CODE
+{
+    WS_CLOSE_NORMAL         = 1000,
+    WS_CLOSE_GOING_AWAY     = 1001,
+    WS_CLOSE_PROTOCOL_ERROR = 1002,
+    WS_CLOSE_TOO_BIG        = 1009
+}WEBSOCKET_CLOSE_CODE;
+
+/**
+ * @brief   Frame header
+ */
+struct WebSocketFrame
+{
+    bool        fin_;
+    uint8_t     opcode_;
+    bool        masked_;
+    uint8_t     mask_[4];
+    uint64_t    payload_len_;
+    uint32_t    head_len_;
+};
+
+class WebSocketCodec
+{
+public:
+    /**
+     * @brief   Parse frame header
+     * @return  1:Done, 0:Need more data, -1:Protocol error
+     */
+    static int ParseHeader(const uint8_t* buf, uint32_t len, WebSocketFrame& frame);
+
+    /**
+     * @brief   Mask or unmask payload in place(the operation is symmetric)
+     * @param   data    Payload
+     * @param   len     Payload length
+     * @param   mask    Masking key
+     */
+    static void Mask(uint8_t* data, uint32_t len, const uint8_t mask[4]);
+
+    /**
+     * @brief   Append frame header to stream
+     * @param   mask    Masking key, NULL for server frames which are not masked
+     */
+    static void EncodeHeader(ByteStream& out, uint8_t opcode, uint64_t payload_len, bool fin, const uint8_t* mask);
+
+    /**
+     * @brief   Encode an unfragmented server frame into a shared buffer, which can be sent to many sockets
+     */
+    static IOCP_SharedBufferPtr EncodeFrame(uint8_t opcode, const void* data, uint32_t len)
+    {
+        IOCP_SharedBufferPtr frame(new ByteStream(len + 10));
+        EncodeHeader(*frame, opcode, len, true, NULL);
+        frame->Add(data, len);
+        return frame;
+    }
+};
+
+inline
+int WebSocketCodec::ParseHeader(const uint8_t* buf, uint32_t len, WebSocketFrame& frame)
+{
+    if (len < 2)
+    {
+        return 0;
+    }
+    // RSV bits must be 0 without negotiated extension
+    if (0 != (buf[0] & 0x70))
+    {
+        return -1;
+    }
+    frame.fin_         = 0 != (buf[0] & 0x80);
+    frame.opcode_      = buf[0] & 0x0F;
+    frame.masked_      = 0 != (buf[1] & 0x80);
+    frame.payload_len_ = buf[1] & 0x7F;
+    frame.head_len_    = 2;
+
+    if (126 == frame.payload_len_)
+    {
+        if (len < 4)
+        {
+            return 0;
+        }
+        frame.payload_len_ = ((uint64_t)buf[2] << 8) | buf[3];
+        frame.head_len_    = 4;
+    }
+    else if (127 == frame.payload_len_)
+    {
+        if (len < 10)
+        {
+            return 0;
+        }
+        frame.payload_len_ = 0;
+        for (int i = 2; i < 10; i++)
+        {
+            frame.payload_len_ = (frame.payload_len_ << 8) | buf[i];
+        }
+        frame.head_len_ = 10;
+    }
+
+    // Control frame must not be fragmented and carries at most 125 bytes
+    if (0 != (frame.opcode_ & 0x08) && (!frame.fin_ || frame.payload_len_ > 125))
+    {
+        return -1;
+    }
+
+    if (frame.masked_)
+    {
+        if (len < frame.head_len_ + 4)
+        {
+            return 0;
+        }
+        memcpy(frame.mask_, buf + frame.head_len_, 4);
+        frame.head_len_ += 4;
+    }
+    return 1;
+}
+
+inline
+void WebSocketCodec::Mask(uint8_t* data, uint32_t len, const uint8_t mask[4])
+{
+    uint32_t key32 = 0;
+    memcpy(&key32, mask, 4);
+    uint32_t i = 0;
+
+    // Every block is a multiple of 4 bytes, so the key phase stays at 0
+#ifdef WEBSOCKET_USE_SSE2
+    __m128i key128 = _mm_set1_epi32((int)key32);
+    for (; i + 64 <= len; i += 64)
+    {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(data + i + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(data + i + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i*)(data + i + 48));
+        _mm_storeu_si128((__m128i*)(data + i),      _mm_xor_si128(v0, key128));
+        _mm_storeu_si128((__m128i*)(data + i + 16), _mm_xor_si128(v1, key128));
+        _mm_storeu_si128((__m128i*)(data + i + 32), _mm_xor_si128(v2, key128));
+        _mm_storeu_si128((__m128i*)(data + i + 48), _mm_xor_si128(v3, key128));
+    }
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        _mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(v, key128));
+    }
+#endif
+    uint64_t key64 = ((uint64_t)key32 << 32) | key32;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t v;
+        memcpy(&v, data + i, 8);
+        v ^= key64;
+        memcpy(data + i, &v, 8);
+    }
+    for (; i < len; i++)
+    {
+        data[i] ^= mask[i & 3];
+    }
+}
+
+inline
+void WebSocketCodec::EncodeHeader(ByteStream& out, uint8_t opcode, uint64_t payload_len, bool fin, const uint8_t* mask)
+{
+    uint8_t  head[14];
+    uint32_t head_len = 2;
+    uint8_t  mask_bit = NULL == mask ? 0 : 0x80;
+
+    head[0] = (uint8_t)((fin ? 0x80 : 0) | (opcode & 0x0F));
+    if (payload_len < 126)
+    {
+        head[1] = (uint8_t)(mask_bit | payload_len);
+    }
+    else if (payload_len <= 0xFFFF)
+    {
+        head[1]  = mask_bit | 126;
+        head[2]  = (uint8_t)(payload_len >> 8);
+        head[3]  = (uint8_t)payload_len;
+        head_len = 4;
+    }
+    else
+    {
+        head[1] = mask_bit | 127;
+        for (int i = 0; i < 8; i++)
+        {
+            head[2 + i] = (uint8_t)(payload_len >> (56 - 8 * i));
+        }
+        head_len = 10;
+    }
+    if (NULL != mask)
+    {
+        memcpy(head + head_len, mask, 4);
+        head_len += 4;
+    }
+    out.Add(head, head_len);
+}
+
+/**
+ * @brief   Callback function when a WebSocket connection is upgraded
+ * @param   sock_id     Socket ID
+ * @param   request     Upgrade request, valid only during the call
+ * @param   user_ptr    User pointer
+ * @note    This function needs to return quickly
+ */
+typedef void (*WSOPENCALLBACK)(unsigned long sock_id, const HTTPRequest& request, void* user_ptr);
+
+/**
+ * @brief   Callback function when a complete(reassembled) message is received
+ * @param   sock_id     Socket ID
+ * @param   data        Unmasked payload, valid only during the call
+ * @param   data_len    Payload length
+ * @param   is_binary   true:Binary message, false:Text message
+ * @param   user_ptr    User pointer
+ * @note    This function needs to return quickly, or it will block the work thread of IOCP
+ */
+typedef void (*WSMESSAGECALLBACK)(unsigned long sock_id, const char* data, uint32_t data_len, bool is_binary, void* user_ptr);
+
+/**
+ * @brief   Callback function when an upgraded WebSocket connection is closed
+ * @param   sock_id     Socket ID
+ * @param   user_ptr    User pointer
+ * @note    This function needs to return quickly
+ */
+typedef void (*WSCLOSECALLBACK)(unsigned long sock_id, void* user_ptr);
+
+class WebSocketServer;
+
+/**
+ * @brief   Ping timer thread(tools\timer.h is based on windows timer)
+ */
+class WebSocketPingThread : public Thread
+{
+public:
+    WebSocketPingThread(WebSocketServer* server)
+        : Thread("<websocket_ping>")
+        , server_(server)
+    {
+    }
+
+protected:
+    virtual uint32_t _Run();
+
+private:
+    WebSocketServer*    server_;
+};
+
+class WebSocketServer : private NonCopyable
+{
+    friend class WebSocketPingThread;
+
+public:
+    WebSocketServer()
+        : user_ptr_(NULL)
+        , OpenCallback_(NULL)
+        , MessageCallback_(NULL)
+        , CloseCallback_(NULL)
+        , ping_interval_(30000)
+        , last_ping_(0)
+        , ping_thread_(this)
+    {
+        ping_frame_ = WebSocketCodec::EncodeFrame(WS_OPCODE_PING, NULL, 0);
+    }
+
+    virtual ~WebSocketServer()
+    {
+    }
+
+    /**
+     * @brief   Initializing the WebSocket server, registering the callback
+     * @param   user_ptr        User pointer which will be used in callback
+     * @param   listen_port     Port number for server listening
+     * @param   host_ip         Ip address string for server, "*" for any, NULL for the first network card
+     * @return  true:Success, false:Failed
+     */
+    bool Init(
+              void*                     user_ptr,
+              WSOPENCALLBACK            OpenCallback,
+              WSMESSAGECALLBACK         MessageCallback,
+              WSCLOSECALLBACK           CloseCallback,
+              UINT16                    listen_port,
+              const char*               host_ip = NULL)
+    {
+        assert(NULL != MessageCallback);
+        user_ptr_        = user_ptr;
+        OpenCallback_    = OpenCallback;
+        MessageCallback_ = MessageCallback;
+        CloseCallback_   = CloseCallback;
+        if (!server_.Init(this, _OnConnected, _OnReceived, _OnDisconnected, listen_port, host_ip))
+        {
+            return false;
+        }
+        server_.SetSendCompletedCallback(_OnSendCompleted);
+        return true;
+    }
+
+    /**
+     * @brief   Set ping interval(default is 30s), connection silent for 2 intervals is closed
+     * @param   interval    Interval in ms, 0 to disable ping and idle check
+     */
+    void SetPingInterval(uint32_t interval)
+    {
+        ping_interval_ = interval;
+    }
+
+    bool Start()
+    {
+        if (!server_.Start())
+        {
+            return false;
+        }
+        last_ping_ = GetTickCount();
+        return ping_thread_.Start();
+    }
+
+    void Stop()
+    {
+        ping_thread_.Stop();
+        server_.Stop();
+    }
+
+    void DeInit()
+    {
+        server_.DeInit();
+        MutexLock lock(mt_conn_);
+        map_conn_.clear();
+    }
+
+    /**
+     * @brief   Send a message(asynchronous delivery, not block)
+     */
+    bool Send(unsigned long sock_id, const void* data, uint32_t data_len, bool is_binary)
+    {
+        return server_.Send(sock_id, WebSocketCodec::EncodeFrame(is_binary ? WS_OPCODE_BINARY : WS_OPCODE_TEXT,
+                                                                 data,
+                                                                 data_len));
+    }
+
+    /**
+     * @brief   Send a frame encoded by WebSocketCodec::EncodeFrame
+     */
+    bool SendFrame(unsigned long sock_id, const IOCP_SharedBufferPtr& frame)
+    {
+        return server_.Send(sock_id, frame);
+    }
+
+    /**
+     * @brief   Send a message to all upgraded connections, the frame is encoded once and shared
+     * @return  Count of connections that the message is delivered to
+     */
+    uint32_t Broadcast(const void* data, uint32_t data_len, bool is_binary)
+    {
+        return BroadcastFrame(WebSocketCodec::EncodeFrame(is_binary ? WS_OPCODE_BINARY : WS_OPCODE_TEXT,
+                                                          data,
+                                                          data_len));
+    }
+
+    uint32_t BroadcastFrame(const IOCP_SharedBufferPtr& frame);
+
+    /**
+     * @brief   Start closing handshake, the socket is closed when the peer responds or times out
+     */
+    void Close(unsigned long sock_id, uint16_t code = WS_CLOSE_NORMAL);
+
+    /**
+     * @brief   Get underlying TCP server
+     * @caution Do not replace its SENDCOMPLETEDCALLBACK, which closes the socket after the last frame
+     */
+    IOCP_TCPServer& GetTCPServer()
+    {
+        return server_;
+    }
+
+protected:
+    struct WebSocketConnection
+    {
+        bool            upgraded_;
+        bool            closing_;                   ///> Close frame or 400 has been sent
+        bool            closed_;                    ///> Socket is closed or closed after the last send
+        HTTPParser      parser_;                    ///> Parser of upgrade request
+        ByteStream      in_;                        ///> Unparsed data
+        ByteStream      msg_;                       ///> Fragmented message being reassembled
+        uint8_t         msg_opcode_;                ///> Opcode of fragmented message, 0 if none
+        volatile DWORD  last_active_;               ///> Tick count of the last received data
+
+        WebSocketConnection()
+            : upgraded_(false)
+            , closing_(false)
+            , closed_(false)
+            , msg_opcode_(0)
+            , last_active_(GetTickCount())
+        {
+        }
+    };
+    typedef std::tr1::shared_ptr<WebSocketConnection> WebSocketConnectionPtr;
+
+    static void _OnConnected(unsigned long sock_id, void* user_ptr);
+
+    static void _OnReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr);
+
+    static void _OnDisconnected(unsigned long sock_id, void* user_ptr);
+
+    static void _OnSendCompleted(unsigned long sock_id, void* context, void* user_ptr);
+
+    WebSocketConnectionPtr _GetConnection(unsigned long sock_id)
+    {
+        MutexLock lock(mt_conn_);
+        map<unsigned long, WebSocketConnectionPtr>::iterator it = map_conn_.find(sock_id);
+        return it == map_conn_.end() ? WebSocketConnectionPtr() : it->second;
+    }
+
+    /**
+     * @brief   Do upgrade handshake
+     * @return  Length of the consumed upgrade request, 0 if not finished
+     */
+    uint32_t _DoHandshake(unsigned long sock_id, WebSocketConnection* conn);
+
+    /**
+     * @brief   Parse and handle all complete frames in the receive buffer
+     */
+    void _ProcessFrames(unsigned long sock_id, WebSocketConnection* conn);
+
+    void _HandleFrame(unsigned long sock_id, WebSocketConnection* conn, const WebSocketFrame& frame,
+                      const uint8_t* payload, uint32_t payload_len);
+
+    /**
+     * @brief   Close socket and notify the user
+     */
+    void _CloseConnection(unsigned long sock_id)
+    {
+        server_.CloseSocket(sock_id);
+        _OnDisconnected(sock_id, this);
+    }
+
+    /**
+     * @brief   Send the last data and close the connection when it has been sent
+     *          Closing at once would cancel the pending send
+     */
+    void _CloseAfterSend(unsigned long sock_id, const IOCP_SharedBufferPtr& last)
+    {
+        if (!server_.Send(sock_id, last, this))
+        {
+            _CloseConnection(sock_id);
+        }
+    }
+
+    /**
+     * @brief   Called by ping thread periodically
+     */
+    void _OnTimer();
+
+    static bool _ContainsNoCase(const HTTPStringRef* value, const char* token);
+
+private:
+    IOCP_TCPServer                              server_;
+    void*                                       user_ptr_;
+    WSOPENCALLBACK                              OpenCallback_;
+    WSMESSAGECALLBACK                           MessageCallback_;
+    WSCLOSECALLBACK                             CloseCallback_;
+    map<unsigned long, WebSocketConnectionPtr>  map_conn_;
+    Mutex                                       mt_conn_;
+    uint32_t                                    ping_interval_;
+    DWORD                                       last_ping_;
+    IOCP_SharedBufferPtr                        ping_frame_;
+    WebSocketPingThread                         ping_thread_;
+};
+
+inline
+uint32_t WebSocketPingThread::_Run()
+{
+    while (!_Signalled())
+    {
+        _Sleep(100);
+        server_->_OnTimer();
+    }
+    return 0;
+}
+
+inline
+void WebSocketServer::_OnConnected(unsigned long sock_id, void* user_ptr)
+{
+    WebSocketServer* server = (WebSocketServer*)user_ptr;
+    MutexLock lock(server->mt_conn_);
+    server->map_conn_[sock_id] = WebSocketConnectionPtr(new WebSocketConnection);
+}
+
+inline
+void WebSocketServer::_OnDisconnected(unsigned long sock_id, void* user_ptr)
+{
+    WebSocketServer*       server = (WebSocketServer*)user_ptr;
+    WebSocketConnectionPtr conn;
+    {
+        MutexLock lock(server->mt_conn_);
+        map<unsigned long, WebSocketConnectionPtr>::iterator it = server->map_conn_.find(sock_id);
+        if (it == server->map_conn_.end())
+        {
+            return;
+        }
+        conn = it->second;
+        server->map_conn_.erase(it);
+    }
+    if (conn->upgraded_ && NULL != server->CloseCallback_)
+    {
+        server->CloseCallback_(sock_id, server->user_ptr_);
+    }
+}
+
+inline
+void WebSocketServer::_OnSendCompleted(unsigned long sock_id, void* context, void* user_ptr)
+{
+    WebSocketServer* server = (WebSocketServer*)user_ptr;
+    if (context == server)
+    {
+        server->_CloseConnection(sock_id);
+    }
+}
+
+inline
+void WebSocketServer::_OnReceived(unsigned long sock_id, const char* data, int data_len, void* user_ptr)
+{
+    WebSocketServer*       server = (WebSocketServer*)user_ptr;
+    WebSocketConnectionPtr conn   = server->_GetConnection(sock_id);
+    if (NULL == conn.get() || data_len <= 0)
+    {
+        return;
+    }
+    conn->last_active_ = GetTickCount();
+    // After sending Close, frames are still parsed to receive the Close reply of the peer
+    if (conn->closed_ || (conn->closing_ && !conn->upgraded_))
+    {
+        return;
+    }
+
+    conn->in_.Add(data, (uint32_t)data_len);
+    if (!conn->upgraded_)
+    {
+        uint32_t used = server->_DoHandshake(sock_id, conn.get());
+        if (0 == used || !conn->upgraded_)
+        {
+            return;
+        }
+        uint8_t* buf = (uint8_t*)conn->in_.GetBuffer();
+        memmove(buf, buf + used, conn->in_.GetWritePtr() - used);
+        conn->in_.SetWritePtr(conn->in_.GetWritePtr() - used);
+    }
+    server->_ProcessFrames(sock_id, conn.get());
+}
+
+inline
+bool WebSocketServer::_ContainsNoCase(const HTTPStringRef* value, const char* token)
+{
+    if (NULL == value)
+    {
+        return false;
+    }
+    uint32_t token_len = (uint32_t)strlen(token);
+    for (uint32_t i = 0; i + token_len <= value->len_; i++)
+    {
+        if (HTTPStringRef(value->data_ + i, token_len).EqualsNoCase(token))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline
+uint32_t WebSocketServer::_DoHandshake(unsigned long sock_id, WebSocketConnection* conn)
+{
+    static const char bad_request[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+    HTTPRequest request;
+    uint32_t    consumed = 0;
+    HTTP_PARSE_RESULT ret = conn->parser_.Parse((const char*)conn->in_.GetBuffer(),
+                                                conn->in_.GetWritePtr(),
+                                                request,
+                                                consumed);
+    if (HTTP_PARSE_INCOMPLETE == ret)
+    {
+        return 0;
+    }
+
+    const HTTPStringRef* key     = request.GetHeader("Sec-WebSocket-Key");
+    const HTTPStringRef* version = request.GetHeader("Sec-WebSocket-Version");
+    if (HTTP_PARSE_DONE != ret ||
+        !request.method_.Equals("GET") ||
+        !_ContainsNoCase(request.GetHeader("Upgrade"), "websocket") ||
+        !_ContainsNoCase(request.GetHeader("Connection"), "upgrade") ||
+        NULL == key ||
+        NULL == version || !version->Equals("13"))
+    {
+        conn->closing_ = true;
+        conn->closed_  = true;
+        IOCP_SharedBufferPtr response(new ByteStream);
+        response->Add(bad_request, (uint32_t)sizeof(bad_request) - 1);
+        _CloseAfterSend(sock_id, response);
+        return consumed;
+    }
+
+    // Sec-WebSocket-Accept = base64(sha1(key + GUID))
+    uint8_t digest[SHA1_DIGEST_SIZE];
+    Sha1    sha1;
+    sha1.Update(key->data_, key->len_);
+    sha1.Update(WEBSOCKET_GUID, (uint32_t)strlen(WEBSOCKET_GUID));
+    sha1.Final(digest);
+
+    char response[256];
+    int  len = sprintf(response,
+                       "HTTP/1.1 101 Switching Protocols\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Sec-WebSocket-Accept: %s\r\n\r\n",
+                       Base64Encode(digest, SHA1_DIGEST_SIZE).c_str());
+    if (!server_.Send(sock_id, response, len))
+    {
+        return consumed;
+    }
+    conn->upgraded_ = true;
+    if (NULL != OpenCallback_)
+    {
+        OpenCallback_(sock_id, request, user_ptr_);
+    }
+    return consumed;
+}
+
+inline
+void WebSocketServer::_ProcessFrames(unsigned long sock_id, WebSocketConnection* conn)
+{
+    uint8_t* buf  = (uint8_t*)conn->in_.GetBuffer();
+    uint32_t len  = conn->in_.GetWritePtr();
+    uint32_t used = 0;
+    while (used < len && !conn->closed_)
+    {
+        WebSocketFrame frame;
+        int ret = WebSocketCodec::ParseHeader(buf + used, len - used, frame);
+        if (0 == ret)
+        {
+            break;
+        }
+        // Frames from client must be masked
+        if (ret < 0 || !frame.masked_)
+        {
+            Close(sock_id, WS_CLOSE_PROTOCOL_ERROR);
+            break;
+        }
+        if (frame.payload_len_ > WEBSOCKET_MAX_MESSAGE_SIZE)
+        {
+            Close(sock_id, WS_CLOSE_TOO_BIG);
+            break;
+        }
+        uint32_t payload_len = (uint32_t)frame.payload_len_;
+        if (frame.head_len_ + payload_len > len - used)
+        {
+            break;
+        }
+
+        // Unmask in place, unfragmented message is delivered without copy
+        uint8_t* payload = buf + used + frame.head_len_;
+        WebSocketCodec::Mask(payload, payload_len, frame.mask_);
+        used += frame.head_len_ + payload_len;
+        _HandleFrame(sock_id, conn, frame, payload, payload_len);
+    }
+
+    if (used > 0)
+    {
+        memmove(buf, buf + used, len - used);
+        conn->in_.SetWritePtr(len - used);
+    }
+}
+
+inline
+void WebSocketServer::_HandleFrame(unsigned long sock_id, WebSocketConnection* conn, const WebSocketFrame& frame,
+                                   const uint8_t* payload, uint32_t payload_len)
+{
+    // Frames after our Close are discarded until the Close reply
+    if (conn->closing_ && WS_OPCODE_CLOSE != frame.opcode_)
+    {
+        return;
+    }
+
+    switch (frame.opcode_)
+    {
+    case WS_OPCODE_TEXT:
+    case WS_OPCODE_BINARY:
+        if (0 != conn->msg_opcode_)
+        {
+            // Expect continuation frame
+            Close(sock_id, WS_CLOSE_PROTOCOL_ERROR);
+        }
+        else if (frame.fin_)
+        {
+            MessageCallback_(sock_id, (const char*)payload, payload_len, WS_OPCODE_BINARY == frame.opcode_, user_ptr_);
+        }
+        else
+        {
+            conn->msg_opcode_ = frame.opcode_;
+            conn->msg_.SetWritePtr(0);
+            conn->msg_.Add(payload, payload_len);
+        }
+        break;
+
+    case WS_OPCODE_CONTINUATION:
+        if (0 == conn->msg_opcode_)
+        {
+            Close(sock_id, WS_CLOSE_PROTOCOL_ERROR);
+        }
+        else if (conn->msg_.GetWritePtr() + payload_len > WEBSOCKET_MAX_MESSAGE_SIZE)
+        {
+            Close(sock_id, WS_CLOSE_TOO_BIG);
+        }
+        else
+        {
+            conn->msg_.Add(payload, payload_len);
+            if (frame.fin_)
+            {
+                MessageCallback_(sock_id,
+                                 (const char*)conn->msg_.GetBuffer(),
+                                 conn->msg_.GetWritePtr(),
+                                 WS_OPCODE_BINARY == conn->msg_opcode_,
+                                 user_ptr_);
+                conn->msg_opcode_ = 0;
+                conn->msg_.SetWritePtr(0);
+            }
+        }
+        break;
+
+    case WS_OPCODE_PING:
+        server_.Send(sock_id, WebSocketCodec::EncodeFrame(WS_OPCODE_PONG, payload, payload_len));
+        break;
+
+    case WS_OPCODE_PONG:
+        // last_active_ has been refreshed
+        break;
+
+    case WS_OPCODE_CLOSE:
+        conn->closed_ = true;
+        if (conn->closing_)
+        {
+            // Reply of our Close, the handshake is completed
+            _CloseConnection(sock_id);
+        }
+        else
+        {
+            // Echo the status code, then close the TCP connection
+            conn->closing_ = true;
+            _CloseAfterSend(sock_id, WebSocketCodec::EncodeFrame(WS_OPCODE_CLOSE, payload, payload_len >= 2 ? 2 : 0));
+        }
+        break;
+
+    default:
+        Close(sock_id, WS_CLOSE_PROTOCOL_ERROR);
+        break;
+    }
+}
+
+inline
+void WebSocketServer::Close(unsigned long sock_id, uint16_t code)
+{
+    WebSocketConnectionPtr conn = _GetConnection(sock_id);
+    if (NULL == conn.get() || conn->closing_)
+    {
+        return;
+    }
+    conn->closing_ = true;
+    uint8_t payload[2] = { (uint8_t)(code >> 8), (uint8_t)code };
+    server_.Send(sock_id, WebSocketCodec::EncodeFrame(WS_OPCODE_CLOSE, payload, 2));
+}
+
+inline
+uint32_t WebSocketServer::BroadcastFrame(const IOCP_SharedBufferPtr& frame)
+{
+    vector<unsigned long> sock_ids;
+    {
+        MutexLock lock(mt_conn_);
+        sock_ids.reserve(map_conn_.size());
+        for (map<unsigned long, WebSocketConnectionPtr>::iterator it = map_conn_.begin(); it != map_conn_.end(); it++)
+        {
+            if (it->second->upgraded_ && !it->second->closing_)
+            {
+                sock_ids.push_back(it->first);
+            }
+        }
+    }
+
+    uint32_t count = 0;
+    for (vector<unsigned long>::iterator it = sock_ids.begin(); it != sock_ids.end(); it++)
+    {
+        if (server_.Send(*it, frame))
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+inline
+void WebSocketServer::_OnTimer()
+{
+    DWORD now = GetTickCount();
+    if (0 == ping_interval_ || now - last_ping_ < ping_interval_)
+    {
+        return;
+    }
+    last_ping_ = now;
+
+    vector<unsigned long> ping_ids;
+    vector<unsigned long> idle_ids;
+    {
+        MutexLock lock(mt_conn_);
+        for (map<unsigned long, WebSocketConnectionPtr>::iterator it = map_conn_.begin(); it != map_conn_.end(); it++)
+        {
+            if (now - it->second->last_active_ > 2 * ping_interval_)
+            {
+                idle_ids.push_back(it->first);
+            }
+            else if (it->second->upgraded_ && !it->second->closing_)
+            {
+                ping_ids.push_back(it->first);
+            }
+        }
+    }
+
+    // All connections share one encoded ping frame
+    for (vector<unsigned long>::iterator it = ping_ids.begin(); it != ping_ids.end(); it++)
+    {
+        server_.Send(*it, ping_frame_);
+    }
+    for (vector<unsigned long>::iterator it = idle_ids.begin(); it != idle_ids.end(); it++)
+    {
+        _CloseConnection(*it);
+    }
+}
+
+} // end of namespace
+using namespace lite;
+
+#endif // ifdef OS_WIN
+
+#endif // ifndef _LITE_WEBSOCKET_SERVER_H_
@@ -0,0 +1,528 @@
+/**
+ * @file    tools\actor.h
+ * @brief   Lightweight actors scheduled over a fixed pool of worker threads
+ *          Each actor has a lock-free MPSC mailbox and runs on one worker at a time,
+ *          so it handles its messages in order without locks, and idle actors cost no thread
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18      Only support windows
+ * @update          2026-10-18      Spawn fails without workers, owned actors not exited are deleted by Stop
+ */
+
+#ifndef _LITE_ACTOR_H_
+#define _LITE_ACTOR_H_
+
+#include "base/lite_base.h"
+#include "base/noncopyable.h"
+#include "event/thread.h"
+#include "event/mutex_lock.h"
+#include "ring_queue.h"
+
+#ifdef OS_WIN
+
+#include <windows.h>
+#include <set>
+
+#define ACTOR_ANY_WORKER        (0xffffffff)    ///> Affinity hint, spread actors over workers
+#define ACTOR_DEFAULT_BATCH     (32)            ///> Messages handled in one activation of an actor
+
+namespace lite {
+
+/**
+ * @brief   Link of intrusive MPSC queue
+ */
+struct MpscNode
+{
+    MpscNode* volatile  next_;
+
+    MpscNode()
+        : next_(NULL)
+    {
+    }
+};
+
+/**
+ * @brief   Unbounded intrusive MPSC queue(Vyukov), push is one exchange and never allocates
+ *          Push from any thread, Pop and Empty by one consumer
+ */
+class MpscNodeQueue : private NonCopyable
+{
+public:
+    MpscNodeQueue()
+        : head_(&stub_)
+        , tail_(&stub_)
+    {
+    }
+
+    void Push(MpscNode* node)
+    {
+        node->next_    = NULL;
+        MpscNode* prev = (MpscNode*)InterlockedExchangePointer((PVOID volatile*)&head_, node);
+        prev->next_    = node;
+    }
+
+    /**
+     * @return  NULL if empty, or a push is not linked yet(Empty() is false then)
+     */
+    MpscNode* Pop()
+    {
+        MpscNode* tail = tail_;
+        MpscNode* next = tail->next_;
+        if (&stub_ == tail)
+        {
+            if (NULL == next)
+            {
+                return NULL;
+            }
+            tail_ = next;
+            tail  = next;
+            next  = next->next_;
+        }
+        if (NULL != next)
+        {
+            tail_ = next;
+            return tail;
+        }
+        if (tail != head_)
+        {
+            return NULL;                        // Producer between exchange and link
+        }
+        Push(&stub_);
+        next = tail->next_;
+        if (NULL != next)
+        {
+            tail_ = next;
+            return tail;
+        }
+        return NULL;
+    }
+
+    bool Empty() const
+    {
+        return &stub_ == tail_ && &stub_ == head_;
+    }
+
+private:
+    MpscNode* volatile  head_;                  ///> Last pushed, exchanged by producers
+    char                pad_[RING_CACHE_LINE];
+    MpscNode*           tail_;                  ///> Next to pop, consumer only
+    MpscNode            stub_;
+};
+
+/**
+ * @brief   Message to an actor, derive from it for content
+ */
+struct ActorMessage : public MpscNode
+{
+    uint32_t    type_;
+    bool        keep_;                          ///> Set by Receive to keep the message(e.g. forward it), else deleted
+
+    ActorMessage(uint32_t type = 0)
+        : type_(type)
+        , keep_(false)
+    {
+    }
+
+    virtual ~ActorMessage()
+    {
+    }
+};
+
+class ActorSystem;
+class ActorWorker;
+
+/**
+ * @brief   Actor, derive from it and implement Receive
+ *          Receive of one actor is never called by two threads at once
+ */
+class Actor : public MpscNode, private NonCopyable
+{
+public:
+    Actor()
+        : system_(NULL)
+        , worker_(NULL)
+        , scheduled_(0)
+        , owned_(false)
+        , exiting_(false)
+    {
+    }
+
+    virtual ~Actor()
+    {
+        MpscNode* node = NULL;
+        while (NULL != (node = mailbox_.Pop()))
+        {
+            delete static_cast<ActorMessage*>(node);
+        }
+    }
+
+    /**
+     * @brief   Send a message, the actor owns it then, call after ActorSystem::Spawn
+     *          Thread safe, must not be called after the actor exited
+     */
+    void Send(ActorMessage* msg);
+
+    ActorSystem* System() const
+    {
+        return system_;
+    }
+
+protected:
+    friend class ActorSystem;
+    friend class ActorWorker;
+
+    /**
+     * @brief   Handle a message, set msg->keep_ to take it over
+     */
+    virtual void Receive(ActorMessage* msg) = 0;
+
+    /**
+     * @brief   Called in Receive to leave after this message, messages left are deleted,
+     *          and the actor too if spawned as owned
+     */
+    void _Exit()
+    {
+        exiting_ = true;
+    }
+
+private:
+    ActorSystem*    system_;
+    ActorWorker*    worker_;                    ///> Worker the actor runs on
+    volatile LONG   scheduled_;                 ///> 1 while in run queue of worker or running
+    bool            owned_;
+    bool            exiting_;
+    MpscNodeQueue   mailbox_;
+};
+
+/**
+ * @brief   Counters of a worker
+ */
+struct ActorWorkerStats
+{
+    uint64_t    activations_;                   ///> Times an actor was run
+    uint64_t    messages_;
+    uint64_t    retired_;                       ///> Actors exited
+
+    ActorWorkerStats()
+        : activations_(0)
+        , messages_(0)
+        , retired_(0)
+    {
+    }
+};
+
+/**
+ * @brief   Worker thread, runs actors of its run queue
+ */
+class ActorWorker : public Thread
+{
+public:
+    ActorWorker(uint32_t batch, RINGWAIT mode, int cpu)
+        : Thread("<actor_worker>")
+        , batch_(batch)
+        , cpu_(cpu)
+        , waiter_(mode)
+    {
+    }
+
+    /**
+     * @brief   Put an actor in run queue, thread safe
+     */
+    void Schedule(Actor* actor)
+    {
+        ready_.Push(actor);
+        waiter_.Notify();
+    }
+
+    ActorWorkerStats GetStats() const
+    {
+        ActorWorkerStats stats;
+        stats.activations_ = stats_.activations_;
+        stats.messages_    = stats_.messages_;
+        stats.retired_     = stats_.retired_;
+        return stats;
+    }
+
+protected:
+    virtual uint32_t _Run()
+    {
+        if (cpu_ >= 0)
+        {
+            SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu_);
+        }
+        uint32_t round = 0;
+        while (!_Signalled())
+        {
+            MpscNode* node = ready_.Pop();
+            if (NULL == node)
+            {
+                waiter_.Idle(round++, 0);
+                continue;
+            }
+            waiter_.Done(round);
+            round = 0;
+            _Activate(static_cast<Actor*>(node));
+        }
+        waiter_.Done(round);
+        return 0;
+    }
+
+private:
+    /**
+     * @brief   Handle up to batch_ messages of an actor, then queue it again if it has more
+     */
+    void _Activate(Actor* actor)
+    {
+        uint32_t count = 0;
+        while (count < batch_ && !actor->exiting_)
+        {
+            MpscNode* node = actor->mailbox_.Pop();
+            if (NULL == node)
+            {
+                break;
+            }
+            ActorMessage* msg = static_cast<ActorMessage*>(node);
+            msg->keep_        = false;
+            actor->Receive(msg);
+            if (!msg->keep_)
+            {
+                delete msg;
+            }
+            count++;
+        }
+        stats_.activations_++;
+        stats_.messages_ += count;
+
+        if (actor->exiting_)
+        {
+            stats_.retired_++;
+            _Retire(actor);
+            return;
+        }
+
+        // More messages, run it again after the other ready actors
+        if (!actor->mailbox_.Empty())
+        {
+            ready_.Push(actor);
+            return;
+        }
+        // Idle, a sender which sees scheduled_ 0 queues it again
+        InterlockedExchange(&actor->scheduled_, 0);
+        if (!actor->mailbox_.Empty() && 0 == InterlockedCompareExchange(&actor->scheduled_, 1, 0))
+        {
+            ready_.Push(actor);
+        }
+    }
+
+    void _Retire(Actor* actor);
+
+    uint32_t            batch_;
+    int                 cpu_;                   ///> Pinned processor, -1 for none
+    MpscNodeQueue       ready_;                 ///> Actors with messages
+    RingWaiter          waiter_;
+    ActorWorkerStats    stats_;                 ///> Written by worker thread only
+};
+
+/**
+ * @brief   Pool of workers running actors
+ *          ActorSystem system(4);
+ *          system.Start();
+ *          system.Spawn(new MyActor);              // Deleted by system when it calls _Exit
+ *          actor->Send(new ActorMessage(1));
+ */
+class ActorSystem : private NonCopyable
+{
+public:
+    /**
+     * @param   workers     Worker threads, 0 for number of processors
+     * @param   batch       Messages handled in one activation, a busy actor yields the worker after it
+     * @param   mode        Wait strategy of idle workers
+     */
+    ActorSystem(uint32_t workers = 0, uint32_t batch = ACTOR_DEFAULT_BATCH, RINGWAIT mode = RINGWAIT_Block)
+        : num_workers_(workers)
+        , batch_(0 == batch ? 1 : batch)
+        , mode_(mode)
+        , pin_workers_(false)
+        , next_worker_(0)
+        , actors_(0)
+    {
+        if (0 == num_workers_)
+        {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            num_workers_ = info.dwNumberOfProcessors;
+        }
+    }
+
+    virtual ~ActorSystem()
+    {
+        Stop();
+    }
+
+    /**
+     * @brief   Pin worker i to processor i, before Start
+     */
+    void SetPinWorkers(bool pin)
+    {
+        pin_workers_ = pin;
+    }
+
+    bool Start()
+    {
+        if (!vec_worker_.empty())
+        {
+            return false;
+        }
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        for (uint32_t i = 0; i < num_workers_; i++)
+        {
+            int cpu = pin_workers_ ? (int)(i % info.dwNumberOfProcessors) : -1;
+            vec_worker_.push_back(new ActorWorker(batch_, mode_, cpu));
+        }
+        for (size_t i = 0; i < vec_worker_.size(); i++)
+        {
+            if (!vec_worker_[i]->Start())
+            {
+                Stop();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief   Stop workers, owned actors not exited are deleted, the others are left to their owners
+     *          Actors must not be sent messages after it
+     */
+    void Stop()
+    {
+        for (size_t i = 0; i < vec_worker_.size(); i++)
+        {
+            vec_worker_[i]->Signal();
+        }
+        for (size_t i = 0; i < vec_worker_.size(); i++)
+        {
+            vec_worker_[i]->Stop();
+            delete vec_worker_[i];
+        }
+        vec_worker_.clear();
+
+        set<Actor*> owned;
+        {
+            MutexLock lock(mt_owned_);
+            owned.swap(set_owned_);
+        }
+        for (set<Actor*>::iterator it = owned.begin(); it != owned.end(); it++)
+        {
+            delete *it;
+        }
+        InterlockedExchange(&actors_, 0);
+    }
+
+    /**
+     * @brief   Attach an actor to a worker, after Start
+     * @param   affinity    Worker index(modulo workers), e.g. to keep actors which talk a lot together,
+     *                      ACTOR_ANY_WORKER for round robin
+     * @param   owned       Delete the actor when it exits or the system stops
+     * @return  false if the system is not started, the caller still owns the actor
+     */
+    bool Spawn(Actor* actor, uint32_t affinity = ACTOR_ANY_WORKER, bool owned = true)
+    {
+        if (vec_worker_.empty())
+        {
+            return false;
+        }
+        if (ACTOR_ANY_WORKER == affinity)
+        {
+            affinity = (uint32_t)InterlockedIncrement(&next_worker_);
+        }
+        actor->system_ = this;
+        actor->worker_ = vec_worker_[affinity % vec_worker_.size()];
+        actor->owned_  = owned;
+        if (owned)
+        {
+            MutexLock lock(mt_owned_);
+            set_owned_.insert(actor);
+        }
+        InterlockedIncrement(&actors_);
+        return true;
+    }
+
+    uint32_t Workers() const
+    {
+        return num_workers_;
+    }
+
+    /**
+     * @brief   Actors spawned and not exited
+     */
+    uint32_t Actors() const
+    {
+        return (uint32_t)actors_;
+    }
+
+    void GetStats(vector<ActorWorkerStats>& stats) const
+    {
+        stats.clear();
+        for (size_t i = 0; i < vec_worker_.size(); i++)
+        {
+            stats.push_back(vec_worker_[i]->GetStats());
+        }
+    }
+
+protected:
+    friend class ActorWorker;
+
+    void _Retired(Actor* actor)
+    {
+        if (actor->owned_)
+        {
+            MutexLock lock(mt_owned_);
+            set_owned_.erase(actor);
+        }
+        InterlockedDecrement(&actors_);
+    }
+
+    uint32_t                num_workers_;
+    uint32_t                batch_;
+    RINGWAIT                mode_;
+    bool                    pin_workers_;
+    volatile LONG           next_worker_;
+    volatile LONG           actors_;
+    vector<ActorWorker*>    vec_worker_;
+    Mutex                   mt_owned_;
+    set<Actor*>             set_owned_;             ///> Owned actors not exited
+};
+
+inline
+void Actor::Send(ActorMessage* msg)
+{
+    mailbox_.Push(msg);
+    if (0 == InterlockedCompareExchange(&scheduled_, 1, 0))
+    {
+        worker_->Schedule(this);
+    }
+}
+
+inline
+void ActorWorker::_Retire(Actor* actor)
+{
+    MpscNode* node = NULL;
+    while (NULL != (node = actor->mailbox_.Pop()))
+    {
+        delete static_cast<ActorMessage*>(node);
+    }
+    actor->system_->_Retired(actor);
+    if (actor->owned_)
+    {
+        delete actor;
+    }
+}
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifdef OS_WIN
+
+#endif // ifndef _LITE_ACTOR_H_
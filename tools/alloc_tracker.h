@@ -0,0 +1,490 @@
+/**
+ * @file    tools\alloc_tracker.h
+ * @brief   Opt-in allocation profiler, counts allocations and bytes per component and call site,
+ *          and checks scopes which must not allocate
+ *          Enable by defining LITE_ALLOC_TRACKING for all sources, and LITE_ALLOC_TRACKING_IMPL
+ *          before including this file in exactly one source file:
+ *          - Windows debug builds use the CRT allocation hook, call sites of "new" are known
+ *            by the _CRTDBG_MAP_ALLOC macro of lite_base.h
+ *          - Other builds replace global operator new/delete, allocations are counted per component only
+ *          Without LITE_ALLOC_TRACKING, LITE_ALLOC_SCOPE and LITE_NO_ALLOC_SCOPE are empty
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ */
+
+#ifndef _LITE_ALLOC_TRACKER_H_
+#define _LITE_ALLOC_TRACKER_H_
+
+#include "base/lite_base.h"
+#include "base/noncopyable.h"
+#include <stdio.h>
+#include <string.h>
+#include <new>
+#include <algorithm>
+
+#ifdef OS_WIN
+#include <windows.h>
+#define LITE_THREAD_LOCAL   __declspec(thread)
+#else
+#define LITE_THREAD_LOCAL   __thread
+#endif
+
+#define ALLOC_TRACKER_SLOTS (4096)              ///> Call sites kept, must be power of 2
+
+namespace lite {
+
+/**
+ * @brief   Allocations of one component and call site
+ */
+struct AllocSiteStats
+{
+    const char* component_;                     ///> Set by AllocScope, NULL if none
+    const char* file_;                          ///> NULL if call site unknown
+    int         line_;
+    uint64_t    count_;
+    uint64_t    bytes_;
+};
+
+/**
+ * @brief   Allocation state of a thread, POD for thread local storage
+ */
+struct AllocThreadState
+{
+    const char* component_;                     ///> Current AllocScope
+    uint32_t    no_alloc_depth_;                ///> Nested NoAllocScope
+    uint32_t    violations_;                    ///> Allocations in NoAllocScope
+    const char* violation_file_;                ///> First violation
+    int         violation_line_;
+    const char* violation_component_;
+    uint32_t    busy_;                          ///> Allocations of the tracker itself are not counted
+};
+
+class AllocTracker : private NonCopyable
+{
+public:
+    static AllocTracker& Instance()
+    {
+        static AllocTracker tracker;
+        return tracker;
+    }
+
+    static AllocThreadState& ThreadState()
+    {
+        static LITE_THREAD_LOCAL AllocThreadState state;
+        return state;
+    }
+
+    /**
+     * @brief   Start or stop counting, NoAllocScope is checked regardless
+     */
+    void Enable(bool enable)
+    {
+        Install();
+        enabled_ = enable;
+    }
+
+    bool IsEnabled() const
+    {
+        return enabled_;
+    }
+
+    /**
+     * @brief   Install the CRT allocation hook(Windows debug builds), done by Enable and NoAllocScope
+     */
+    void Install()
+    {
+#if defined(OS_WIN) && defined(_DEBUG)
+        if (!installed_)
+        {
+            installed_ = true;
+            prev_hook_ = _CrtSetAllocHook(_CrtHook);
+        }
+#endif
+    }
+
+    /**
+     * @brief   Record an allocation of current thread, called by the hooks
+     * @param   file    Call site, NULL if unknown
+     */
+    void OnAlloc(size_t size, const char* file, int line)
+    {
+        AllocThreadState& state = ThreadState();
+        if (0 != state.busy_)
+        {
+            return;
+        }
+        if (0 != state.no_alloc_depth_)
+        {
+            if (0 == state.violations_++)
+            {
+                state.violation_file_      = file;
+                state.violation_line_      = line;
+                state.violation_component_ = state.component_;
+            }
+        }
+        if (!enabled_)
+        {
+            return;
+        }
+
+        _Lock();
+        total_count_++;
+        total_bytes_ += size;
+        AllocSiteStats* site = _FindSite(state.component_, file, line);
+        if (NULL != site)
+        {
+            site->count_++;
+            site->bytes_ += size;
+        }
+        else
+        {
+            overflow_++;
+        }
+        _Unlock();
+    }
+
+    uint64_t TotalCount()
+    {
+        _Lock();
+        uint64_t count = total_count_;
+        _Unlock();
+        return count;
+    }
+
+    uint64_t TotalBytes()
+    {
+        _Lock();
+        uint64_t bytes = total_bytes_;
+        _Unlock();
+        return bytes;
+    }
+
+    /**
+     * @brief   Copy call sites, sorted by bytes
+     */
+    void Snapshot(vector<AllocSiteStats>& sites)
+    {
+        AllocThreadState& state = ThreadState();
+        state.busy_++;
+        sites.clear();
+        sites.reserve(used_);
+        _Lock();
+        for (uint32_t i = 0; i < ALLOC_TRACKER_SLOTS; i++)
+        {
+            if (0 != sites_[i].count_)
+            {
+                sites.push_back(sites_[i]);
+            }
+        }
+        _Unlock();
+        sort(sites.begin(), sites.end(), _MoreBytes);
+        state.busy_--;
+    }
+
+    /**
+     * @brief   Print totals of each component, then call sites
+     */
+    void Report(FILE* file = stdout)
+    {
+        AllocThreadState& state = ThreadState();
+        state.busy_++;
+        vector<AllocSiteStats> sites;
+        Snapshot(sites);
+
+        map<string, pair<uint64_t, uint64_t> > components;
+        for (size_t i = 0; i < sites.size(); i++)
+        {
+            pair<uint64_t, uint64_t>& total = components[_Name(sites[i].component_)];
+            total.first  += sites[i].count_;
+            total.second += sites[i].bytes_;
+        }
+        fprintf(file, "allocations: %llu  bytes: %llu  untracked sites: %llu\n",
+                (unsigned long long)TotalCount(), (unsigned long long)TotalBytes(), (unsigned long long)overflow_);
+        for (map<string, pair<uint64_t, uint64_t> >::iterator it = components.begin(); it != components.end(); it++)
+        {
+            fprintf(file, "  %-32s %12llu allocs %14llu bytes\n",
+                    it->first.c_str(), (unsigned long long)it->second.first, (unsigned long long)it->second.second);
+        }
+        for (size_t i = 0; i < sites.size(); i++)
+        {
+            fprintf(file, "  %-32s %12llu allocs %14llu bytes  %s:%d\n",
+                    _Name(sites[i].component_),
+                    (unsigned long long)sites[i].count_,
+                    (unsigned long long)sites[i].bytes_,
+                    NULL == sites[i].file_ ? "?" : sites[i].file_,
+                    sites[i].line_);
+        }
+        state.busy_--;
+    }
+
+    void Reset()
+    {
+        _Lock();
+        memset(sites_, 0, sizeof(sites_));
+        used_        = 0;
+        total_count_ = 0;
+        total_bytes_ = 0;
+        overflow_    = 0;
+        _Unlock();
+    }
+
+private:
+    AllocTracker()
+        : enabled_(false)
+        , installed_(false)
+        , lock_(0)
+        , used_(0)
+        , total_count_(0)
+        , total_bytes_(0)
+        , overflow_(0)
+#if defined(OS_WIN) && defined(_DEBUG)
+        , prev_hook_(NULL)
+#endif
+    {
+        memset(sites_, 0, sizeof(sites_));
+    }
+
+    /**
+     * @brief   Find or add the slot of a site, open addressing as nothing may be allocated here
+     * @return  NULL if table is full
+     */
+    AllocSiteStats* _FindSite(const char* component, const char* file, int line)
+    {
+        size_t hash = ((size_t)component * 31 + (size_t)file) * 31 + (size_t)line;
+        hash ^= hash >> 13;
+        for (uint32_t i = 0; i < ALLOC_TRACKER_SLOTS; i++)
+        {
+            AllocSiteStats& site = sites_[(hash + i) & (ALLOC_TRACKER_SLOTS - 1)];
+            if (0 == site.count_)
+            {
+                site.component_ = component;
+                site.file_      = file;
+                site.line_      = line;
+                used_++;
+                return &site;
+            }
+            if (site.component_ == component && site.file_ == file && site.line_ == line)
+            {
+                return &site;
+            }
+        }
+        return NULL;
+    }
+
+    /**
+     * @brief   Spin lock, a Mutex may allocate when created
+     */
+    void _Lock()
+    {
+#ifdef OS_WIN
+        while (0 != InterlockedCompareExchange(&lock_, 1, 0))
+        {
+            YieldProcessor();
+        }
+#else
+        while (__sync_lock_test_and_set(&lock_, 1))
+        {
+        }
+#endif
+    }
+
+    void _Unlock()
+    {
+#ifdef OS_WIN
+        InterlockedExchange(&lock_, 0);
+#else
+        __sync_lock_release(&lock_);
+#endif
+    }
+
+    static bool _MoreBytes(const AllocSiteStats& a, const AllocSiteStats& b)
+    {
+        return a.bytes_ > b.bytes_;
+    }
+
+    static const char* _Name(const char* component)
+    {
+        return NULL == component ? "(none)" : component;
+    }
+
+#if defined(OS_WIN) && defined(_DEBUG)
+    static int __cdecl _CrtHook(int alloc_type, void* data, size_t size, int block_type,
+                                long request, const unsigned char* file, int line)
+    {
+        // Allocations of CRT itself must not be touched
+        if (_CRT_BLOCK != block_type && (_HOOK_ALLOC == alloc_type || _HOOK_REALLOC == alloc_type))
+        {
+            Instance().OnAlloc(size, (const char*)file, line);
+        }
+        _CRT_ALLOC_HOOK prev_hook = Instance().prev_hook_;
+        return NULL == prev_hook ? TRUE : prev_hook(alloc_type, data, size, block_type, request, file, line);
+    }
+#endif
+
+    volatile bool   enabled_;
+    bool            installed_;
+#ifdef OS_WIN
+    volatile LONG   lock_;
+#else
+    volatile int    lock_;
+#endif
+    uint32_t        used_;
+    uint64_t        total_count_;
+    uint64_t        total_bytes_;
+    uint64_t        overflow_;                  ///> Allocations of sites not in table
+    AllocSiteStats  sites_[ALLOC_TRACKER_SLOTS];
+#if defined(OS_WIN) && defined(_DEBUG)
+    _CRT_ALLOC_HOOK prev_hook_;
+#endif
+};
+
+/**
+ * @brief   Charge allocations of current thread to a component until the scope ends
+ * @param   component   String literal, compared by address
+ */
+class AllocScope : private NonCopyable
+{
+public:
+    AllocScope(const char* component)
+        : prev_(AllocTracker::ThreadState().component_)
+    {
+        AllocTracker::ThreadState().component_ = component;
+    }
+
+    ~AllocScope()
+    {
+        AllocTracker::ThreadState().component_ = prev_;
+    }
+
+private:
+    const char* prev_;
+};
+
+/**
+ * @brief   Scope which must not allocate on current thread, asserts when it ends
+ *          Allocations of other threads are not checked
+ */
+class NoAllocScope : private NonCopyable
+{
+public:
+    /**
+     * @param   assert_on_exit  false to check Allocations() instead, e.g. in tests
+     */
+    NoAllocScope(const char* file, int line, bool assert_on_exit = true)
+        : file_(file)
+        , line_(line)
+        , assert_on_exit_(assert_on_exit)
+    {
+        AllocTracker::Instance().Install();
+        AllocThreadState& state = AllocTracker::ThreadState();
+        if (0 == state.no_alloc_depth_++)
+        {
+            state.violations_ = 0;
+        }
+        start_ = state.violations_;
+    }
+
+    ~NoAllocScope()
+    {
+        AllocThreadState& state = AllocTracker::ThreadState();
+        uint32_t allocations = state.violations_ - start_;
+        if (assert_on_exit_ && 0 != allocations)
+        {
+            fprintf(stderr, "%u allocations in no allocation scope %s:%d, first at %s:%d(%s)\n",
+                    allocations, file_, line_,
+                    NULL == state.violation_file_ ? "?" : state.violation_file_,
+                    state.violation_line_,
+                    NULL == state.violation_component_ ? "(none)" : state.violation_component_);
+            assert(0 == allocations);
+        }
+        state.no_alloc_depth_--;
+    }
+
+    /**
+     * @brief   Allocations of current thread since the scope began
+     */
+    uint32_t Allocations() const
+    {
+        return AllocTracker::ThreadState().violations_ - start_;
+    }
+
+private:
+    const char* file_;
+    int         line_;
+    bool        assert_on_exit_;
+    uint32_t    start_;
+};
+
+} // end of namespace lite
+
+using namespace lite;
+
+#ifdef LITE_ALLOC_TRACKING
+#define LITE_ALLOC_SCOPE(component)     AllocScope      lite_alloc_scope_(component)
+#define LITE_NO_ALLOC_SCOPE()           NoAllocScope    lite_no_alloc_scope_(__FILE__, __LINE__)
+#else
+#define LITE_ALLOC_SCOPE(component)
+#define LITE_NO_ALLOC_SCOPE()
+#endif
+
+// Replace global operator new/delete in the one source defining LITE_ALLOC_TRACKING_IMPL,
+// Windows debug builds see all allocations by the CRT hook instead
+#if defined(LITE_ALLOC_TRACKING_IMPL) && !(defined(OS_WIN) && defined(_DEBUG))
+#ifdef _MSC_VER
+#pragma push_macro("new")
+#endif
+#undef new
+
+void* operator new(size_t size)
+{
+    AllocTracker::Instance().OnAlloc(size, NULL, 0);
+    void* ptr = malloc(0 == size ? 1 : size);
+    if (NULL == ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+    AllocTracker::Instance().OnAlloc(size, NULL, 0);
+    return malloc(0 == size ? 1 : size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) throw()
+{
+    return operator new(size, nothrow);
+}
+
+void operator delete(void* ptr) throw()
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) throw()
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) throw()
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) throw()
+{
+    free(ptr);
+}
+
+#ifdef _MSC_VER
+#pragma pop_macro("new")
+#endif
+#endif // LITE_ALLOC_TRACKING_IMPL
+
+#endif // ifndef _LITE_ALLOC_TRACKER_H_
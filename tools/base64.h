@@ -0,0 +1,54 @@
+/**
+ * @file    tools\base64.h
+ * @brief   Base64 encoding(RFC 4648)
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ */
+
+#ifndef _LITE_BASE64_H_
+#define _LITE_BASE64_H_
+
+#include "base/lite_base.h"
+
+namespace lite {
+
+/**
+ * @brief   Encode data to base64 string
+ */
+inline
+string Base64Encode(const void* data, uint32_t size)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    const uint8_t* p = (const uint8_t*)data;
+    string         str;
+    str.reserve((size + 2) / 3 * 4);
+    uint32_t i = 0;
+    for (; i + 2 < size; i += 3)
+    {
+        uint32_t v = ((uint32_t)p[i] << 16) | ((uint32_t)p[i+1] << 8) | p[i+2];
+        str += table[(v >> 18) & 0x3F];
+        str += table[(v >> 12) & 0x3F];
+        str += table[(v >> 6) & 0x3F];
+        str += table[v & 0x3F];
+    }
+    if (i < size)
+    {
+        uint32_t v = (uint32_t)p[i] << 16;
+        if (i + 1 < size)
+        {
+            v |= (uint32_t)p[i+1] << 8;
+        }
+        str += table[(v >> 18) & 0x3F];
+        str += table[(v >> 12) & 0x3F];
+        str += (i + 1 < size) ? table[(v >> 6) & 0x3F] : '=';
+        str += '=';
+    }
+    return str;
+}
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_BASE64_H_
@@ -3,6 +3,7 @@
  * @brief   Encapsulation that operations on byte stream
  * @author  Nik Yan
  * @version 1.0     2014-06-29
+ * @update          2026-10-18      Fix build errors
  */
 
 #ifndef _LITE_BYTE_STREAM_H
@@ -27,7 +28,7 @@ public:
         {
             mallocated_  = true;
             stream_size_ = size;
-            data_        = new uint8_t[uSize];
+            data_        = new uint8_t[size];
         } 
         else
         {
@@ -66,7 +67,7 @@ public:
     {
         _Free();
         
-        if (c.m_uStreamSize > 0)
+        if (c.stream_size_ > 0)
         {
             data_        = new uint8_t[c.stream_size_];
             stream_size_ = c.stream_size_;
@@ -188,7 +189,7 @@ public:
      */
     void SetReadPtr(uint32_t read_idx) 
     {
-        if (read_idx > wirte_idx_)
+        if (read_idx > write_idx_)
         {
             throw -1;         
         }
@@ -633,37 +634,31 @@ private:
     void _ReadByteorder(int16_t& d)
     {
         d = byte_order_ == NETWORK_BYTEORDER ? static_cast<int16_t>(NtohUint16(static_cast<uint16_t>(d))) : (d);
-        return d; 
     }
 
     void _ReadByteorder(uint16_t& d)
     {
         d = byte_order_ == NETWORK_BYTEORDER ? NtohUint16(d) : (d);
-        return d; 
     }
 
     void _ReadByteorder(int32_t& d)
     {
         d = byte_order_ == NETWORK_BYTEORDER ? static_cast<int32_t>(NtohUint32(static_cast<uint32_t>(d))) : (d);
-        return d; 
     }
 
     void _ReadByteorder(uint32_t& d)
     {
         d = byte_order_ == NETWORK_BYTEORDER ? NtohUint32(d) : (d);
-        return d; 
     }
 
     void _ReadByteorder(int64_t& d)
     {
         d = byte_order_ == NETWORK_BYTEORDER ? static_cast<int64_t>(NtohUint64(static_cast<uint64_t>(d))) : (d);
-        return d; 
     }
 
     void _ReadByteorder(uint64_t& d)
     {
         d = byte_order_ == NETWORK_BYTEORDER ? NtohUint64(d) : (d);
-        return d; 
     }
 
     uint8_t*    data_;
@@ -0,0 +1,708 @@
+/**
+ * @file    tools\cache.h
+ * @brief   Concurrent in-process cache with CLOCK eviction
+ *          Keys are spread over shards, each with its own reader-writer lock and hash table
+ *          A hit only sets a reference bit, so reads share the lock and never relink a list as LRU does,
+ *          entries are evicted by the CLOCK hand when the byte budget of the shard is exceeded
+ *          Hits and misses are counted in cells per thread, so readers write no shared cache line
+ *          Entries may expire after a TTL, CacheExpirer removes them on a lite::Thread
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ * @update          2026-10-18      Oversize Put erases the old value, CLOCK hand drops expired entries,
+ *                                  hits and misses counted per thread
+ */
+
+#ifndef _LITE_CACHE_H_
+#define _LITE_CACHE_H_
+
+#include "base/lite_base.h"
+#include "base/noncopyable.h"
+#include "event/mutex.h"
+#include "event/mutex_lock.h"
+#include "event/thread.h"
+#include "ring_queue.h"
+#include "time_tool.h"
+
+#ifdef OS_WIN
+#include <windows.h>
+#elif defined(OS_LINUX)
+#include <pthread.h>
+#endif
+
+#ifndef LITE_THREAD_LOCAL
+#ifdef OS_WIN
+#define LITE_THREAD_LOCAL   __declspec(thread)
+#else
+#define LITE_THREAD_LOCAL   __thread
+#endif
+#endif
+
+#define CACHE_DEFAULT_SHARDS    (16)
+#define CACHE_NO_TTL            (0)             ///> Entry never expires
+#define CACHE_EXPIRE_BATCH      (256)           ///> Entries checked by Expire in one hold of a shard lock
+#define CACHE_EXPIRE_MS         (1000)          ///> Default interval of CacheExpirer
+#define CACHE_COUNTER_CELLS     (16)            ///> Cells of hit and miss counters, power of 2
+
+namespace lite {
+
+/**
+ * @brief   Reader-writer lock, SRW lock on windows
+ */
+class CacheRwLock : private NonCopyable
+{
+public:
+    CacheRwLock()
+    {
+#ifdef OS_WIN
+        InitializeSRWLock(&lock_);
+#elif defined(OS_LINUX)
+        pthread_rwlock_init(&lock_, NULL);
+#endif
+    }
+
+    virtual ~CacheRwLock()
+    {
+#ifdef OS_LINUX
+        pthread_rwlock_destroy(&lock_);
+#endif
+    }
+
+    void LockShared()
+    {
+#ifdef OS_WIN
+        AcquireSRWLockShared(&lock_);
+#elif defined(OS_LINUX)
+        pthread_rwlock_rdlock(&lock_);
+#endif
+    }
+
+    void UnlockShared()
+    {
+#ifdef OS_WIN
+        ReleaseSRWLockShared(&lock_);
+#elif defined(OS_LINUX)
+        pthread_rwlock_unlock(&lock_);
+#endif
+    }
+
+    void Lock()
+    {
+#ifdef OS_WIN
+        AcquireSRWLockExclusive(&lock_);
+#elif defined(OS_LINUX)
+        pthread_rwlock_wrlock(&lock_);
+#endif
+    }
+
+    void Unlock()
+    {
+#ifdef OS_WIN
+        ReleaseSRWLockExclusive(&lock_);
+#elif defined(OS_LINUX)
+        pthread_rwlock_unlock(&lock_);
+#endif
+    }
+
+private:
+#ifdef OS_WIN
+    SRWLOCK             lock_;
+#elif defined(OS_LINUX)
+    pthread_rwlock_t    lock_;
+#endif
+};
+
+class CacheReadLock : private NonCopyable
+{
+public:
+    CacheReadLock(CacheRwLock& lock)
+        : lock_(lock)
+    {
+        lock_.LockShared();
+    }
+
+    virtual ~CacheReadLock()
+    {
+        lock_.UnlockShared();
+    }
+
+private:
+    CacheRwLock&    lock_;
+};
+
+class CacheWriteLock : private NonCopyable
+{
+public:
+    CacheWriteLock(CacheRwLock& lock)
+        : lock_(lock)
+    {
+        lock_.Lock();
+    }
+
+    virtual ~CacheWriteLock()
+    {
+        lock_.Unlock();
+    }
+
+private:
+    CacheRwLock&    lock_;
+};
+
+/**
+ * @brief   Finalizer of 64-bit hash, spreads keys over shards and buckets
+ */
+inline
+uint64_t CacheMix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief   Hash of integer keys, specialize it for other key types
+ */
+template <typename K>
+struct CacheHash
+{
+    uint64_t operator()(const K& key) const
+    {
+        return CacheMix((uint64_t)key);
+    }
+};
+
+template <>
+struct CacheHash<string>
+{
+    uint64_t operator()(const string& key) const
+    {
+        uint64_t h = 14695981039346656037ULL;   // FNV-1a
+        for (size_t i = 0; i < key.length(); i++)
+        {
+            h = (h ^ (uint8_t)key[i]) * 1099511628211ULL;
+        }
+        return CacheMix(h);
+    }
+};
+
+/**
+ * @brief   Cell of hit and miss counters of the calling thread, threads take cells in turn
+ */
+inline
+uint32_t CacheCounterCell()
+{
+    static volatile int64_t         next_cell = 0;
+    static LITE_THREAD_LOCAL int32_t cell     = -1;
+    if (cell < 0)
+    {
+        cell = (int32_t)(RingAdd(next_cell, 1) & (CACHE_COUNTER_CELLS - 1));
+    }
+    return (uint32_t)cell;
+}
+
+/**
+ * @brief   Counters of a cache
+ */
+struct CacheStats
+{
+    int64_t     hits_;
+    int64_t     misses_;
+    int64_t     inserts_;
+    int64_t     evictions_;                     ///> Removed by CLOCK for the byte budget
+    int64_t     expirations_;                   ///> Removed after TTL, by Expire or the CLOCK hand
+    uint64_t    entries_;
+    uint64_t    charge_;                        ///> Bytes charged by entries
+
+    CacheStats()
+        : hits_(0)
+        , misses_(0)
+        , inserts_(0)
+        , evictions_(0)
+        , expirations_(0)
+        , entries_(0)
+        , charge_(0)
+    {
+    }
+};
+
+/**
+ * @brief   A cache which CacheExpirer can drive
+ */
+class IExpirable
+{
+public:
+    virtual ~IExpirable()
+    {
+    }
+
+    /**
+     * @brief   Remove expired entries
+     * @return  Entries removed
+     */
+    virtual uint32_t Expire() = 0;
+};
+
+/**
+ * @brief   Sharded cache of copies of V, use a shared_ptr as V for large values
+ *          ConcurrentCache<string, ResultPtr> cache(64 * 1024 * 1024);
+ *          cache.Put(key, result, result->Bytes(), 30000);
+ *          if (cache.Get(key, result)) ...
+ */
+template <typename K, typename V, typename HASH = CacheHash<K> >
+class ConcurrentCache : public IExpirable, private NonCopyable
+{
+public:
+    /**
+     * @param   capacity    Byte budget, split evenly over shards
+     * @param   shards      Rounded up to a power of 2, more shards for more writing threads
+     */
+    ConcurrentCache(uint64_t capacity, uint32_t shards = CACHE_DEFAULT_SHARDS)
+        : num_shards_(_PowerOf2(shards))
+        , shards_(new Shard[num_shards_])
+    {
+        for (uint32_t i = 0; i < num_shards_; i++)
+        {
+            shards_[i].capacity_ = capacity / num_shards_ > 0 ? capacity / num_shards_ : 1;
+            shards_[i].buckets_.resize(16, NULL);
+        }
+    }
+
+    virtual ~ConcurrentCache()
+    {
+        Clear();
+        delete[] shards_;
+    }
+
+    /**
+     * @brief   Copy value of a key out, an expired entry is a miss
+     */
+    bool Get(const K& key, V& value)
+    {
+        uint64_t hash  = hasher_(key);
+        Shard&   shard = _Shard(hash);
+        {
+            CacheReadLock lock(shard.lock_);
+            Entry* entry = _Find(shard, key, hash);
+            if (NULL != entry && !_Expired(entry, 0))
+            {
+                // Written only when clear, a hot entry does not bounce its cache line between readers
+                if (0 == entry->referenced_)
+                {
+                    entry->referenced_ = 1;
+                }
+                value = entry->value_;
+                RingAdd(counters_[CacheCounterCell()].hits_, 1);
+                return true;
+            }
+        }
+        RingAdd(counters_[CacheCounterCell()].misses_, 1);
+        return false;
+    }
+
+    /**
+     * @brief   Insert or replace a value
+     * @param   charge  Bytes the entry counts against the budget
+     * @param   ttl_ms  Time to live, CACHE_NO_TTL for none
+     * @return  false if charge is larger than the budget of a shard, the key is erased then
+     */
+    bool Put(const K& key, const V& value, uint32_t charge = 1, uint32_t ttl_ms = CACHE_NO_TTL)
+    {
+        uint64_t hash   = hasher_(key);
+        Shard&   shard  = _Shard(hash);
+        uint64_t expire = CACHE_NO_TTL == ttl_ms ? 0 : GetMonotonicMicroSecond() + (uint64_t)ttl_ms * 1000;
+
+        CacheWriteLock lock(shard.lock_);
+        Entry* entry = _Find(shard, key, hash);
+        if (charge > shard.capacity_)
+        {
+            // The old value must not be read as if the put succeeded
+            if (NULL != entry)
+            {
+                _Remove(shard, entry);
+            }
+            return false;
+        }
+        if (NULL != entry)
+        {
+            shard.charge_      = shard.charge_ - entry->charge_ + charge;
+            entry->value_      = value;
+            entry->charge_     = charge;
+            entry->expire_us_  = expire;
+            entry->referenced_ = 1;
+        }
+        else
+        {
+            entry = new Entry(key, value, hash, charge, expire);
+            _Insert(shard, entry);
+            RingAdd(shard.inserts_, 1);
+        }
+        _Evict(shard, entry);
+        return true;
+    }
+
+    bool Erase(const K& key)
+    {
+        uint64_t       hash  = hasher_(key);
+        Shard&         shard = _Shard(hash);
+        CacheWriteLock lock(shard.lock_);
+        Entry*         entry = _Find(shard, key, hash);
+        if (NULL == entry)
+        {
+            return false;
+        }
+        _Remove(shard, entry);
+        return true;
+    }
+
+    void Clear()
+    {
+        for (uint32_t i = 0; i < num_shards_; i++)
+        {
+            Shard&         shard = shards_[i];
+            CacheWriteLock lock(shard.lock_);
+            for (size_t j = 0; j < shard.clock_.size(); j++)
+            {
+                delete shard.clock_[j];
+            }
+            shard.clock_.clear();
+            shard.free_slots_.clear();
+            shard.buckets_.assign(16, NULL);
+            shard.count_  = 0;
+            shard.charge_ = 0;
+            shard.hand_   = 0;
+        }
+    }
+
+    /**
+     * @brief   Remove expired entries, a shard lock is held for CACHE_EXPIRE_BATCH entries at a time
+     */
+    virtual uint32_t Expire()
+    {
+        uint32_t removed = 0;
+        uint64_t now     = GetMonotonicMicroSecond();
+        for (uint32_t i = 0; i < num_shards_; i++)
+        {
+            Shard& shard = shards_[i];
+            for (size_t start = 0; ; start += CACHE_EXPIRE_BATCH)
+            {
+                CacheWriteLock lock(shard.lock_);
+                if (start >= shard.clock_.size())
+                {
+                    break;
+                }
+                size_t end = start + CACHE_EXPIRE_BATCH < shard.clock_.size() ? start + CACHE_EXPIRE_BATCH : shard.clock_.size();
+                for (size_t slot = start; slot < end; slot++)
+                {
+                    Entry* entry = shard.clock_[slot];
+                    if (NULL != entry && _Expired(entry, now))
+                    {
+                        _Remove(shard, entry);
+                        RingAdd(shard.expirations_, 1);
+                        removed++;
+                    }
+                }
+            }
+        }
+        return removed;
+    }
+
+    /**
+     * @brief   Counters summed over shards
+     */
+    CacheStats GetStats()
+    {
+        CacheStats stats;
+        for (uint32_t i = 0; i < CACHE_COUNTER_CELLS; i++)
+        {
+            stats.hits_   += RingLoad(counters_[i].hits_);
+            stats.misses_ += RingLoad(counters_[i].misses_);
+        }
+        for (uint32_t i = 0; i < num_shards_; i++)
+        {
+            Shard& shard = shards_[i];
+            stats.inserts_     += RingLoad(shard.inserts_);
+            stats.evictions_   += RingLoad(shard.evictions_);
+            stats.expirations_ += RingLoad(shard.expirations_);
+            CacheReadLock lock(shard.lock_);
+            stats.entries_     += shard.count_;
+            stats.charge_      += shard.charge_;
+        }
+        return stats;
+    }
+
+    void ResetStats()
+    {
+        for (uint32_t i = 0; i < CACHE_COUNTER_CELLS; i++)
+        {
+            RingStore(counters_[i].hits_,   0);
+            RingStore(counters_[i].misses_, 0);
+        }
+        for (uint32_t i = 0; i < num_shards_; i++)
+        {
+            RingStore(shards_[i].inserts_,     0);
+            RingStore(shards_[i].evictions_,   0);
+            RingStore(shards_[i].expirations_, 0);
+        }
+    }
+
+private:
+    static uint32_t _PowerOf2(uint32_t value)
+    {
+        uint32_t power = 1;
+        while (power < value && power < 0x80000000)
+        {
+            power <<= 1;
+        }
+        return power;
+    }
+
+    struct Entry
+    {
+        K                   key_;
+        V                   value_;
+        uint64_t            hash_;
+        uint64_t            expire_us_;         ///> 0 for never
+        uint32_t            charge_;
+        uint32_t            slot_;              ///> Index in clock_
+        Entry*              next_;              ///> Hash chain
+        volatile uint8_t    referenced_;        ///> Set by hits, cleared by the passing CLOCK hand
+
+        Entry(const K& key, const V& value, uint64_t hash, uint32_t charge, uint64_t expire_us)
+            : key_(key)
+            , value_(value)
+            , hash_(hash)
+            , expire_us_(expire_us)
+            , charge_(charge)
+            , slot_(0)
+            , next_(NULL)
+            , referenced_(0)
+        {
+        }
+    };
+
+    struct Shard
+    {
+        CacheRwLock         lock_;
+        vector<Entry*>      buckets_;           ///> Power of 2
+        vector<Entry*>      clock_;             ///> Entries in CLOCK order, NULL for free slots
+        vector<uint32_t>    free_slots_;
+        uint32_t            hand_;
+        uint64_t            count_;
+        uint64_t            charge_;
+        uint64_t            capacity_;
+        volatile int64_t    inserts_;
+        volatile int64_t    evictions_;
+        volatile int64_t    expirations_;
+        char                pad_[RING_CACHE_LINE];  ///> Keep counters of shards apart
+
+        Shard()
+            : hand_(0)
+            , count_(0)
+            , charge_(0)
+            , capacity_(0)
+            , inserts_(0)
+            , evictions_(0)
+            , expirations_(0)
+        {
+        }
+    };
+
+    /**
+     * @brief   Hit and miss counters of the threads using a cell
+     */
+    struct CounterCell
+    {
+        volatile int64_t    hits_;
+        volatile int64_t    misses_;
+        char                pad_[RING_CACHE_LINE];  ///> Keep counters of cells apart
+
+        CounterCell()
+            : hits_(0)
+            , misses_(0)
+        {
+        }
+    };
+
+    Shard& _Shard(uint64_t hash)
+    {
+        return shards_[(hash >> 32) & (num_shards_ - 1)];
+    }
+
+    Entry* _Find(Shard& shard, const K& key, uint64_t hash)
+    {
+        for (Entry* entry = shard.buckets_[hash & (shard.buckets_.size() - 1)]; NULL != entry; entry = entry->next_)
+        {
+            if (entry->hash_ == hash && entry->key_ == key)
+            {
+                return entry;
+            }
+        }
+        return NULL;
+    }
+
+    bool _Expired(const Entry* entry, uint64_t now) const
+    {
+        return 0 != entry->expire_us_ && (0 == now ? GetMonotonicMicroSecond() : now) >= entry->expire_us_;
+    }
+
+    void _Insert(Shard& shard, Entry* entry)
+    {
+        if (shard.count_ >= shard.buckets_.size())
+        {
+            _Rehash(shard, shard.buckets_.size() * 2);
+        }
+        Entry*& head = shard.buckets_[entry->hash_ & (shard.buckets_.size() - 1)];
+        entry->next_ = head;
+        head         = entry;
+
+        if (shard.free_slots_.empty())
+        {
+            entry->slot_ = (uint32_t)shard.clock_.size();
+            shard.clock_.push_back(entry);
+        }
+        else
+        {
+            entry->slot_ = shard.free_slots_.back();
+            shard.free_slots_.pop_back();
+            shard.clock_[entry->slot_] = entry;
+        }
+        shard.count_++;
+        shard.charge_ += entry->charge_;
+    }
+
+    void _Remove(Shard& shard, Entry* entry)
+    {
+        Entry** link = &shard.buckets_[entry->hash_ & (shard.buckets_.size() - 1)];
+        while (*link != entry)
+        {
+            link = &(*link)->next_;
+        }
+        *link = entry->next_;
+        shard.clock_[entry->slot_] = NULL;
+        shard.free_slots_.push_back(entry->slot_);
+        shard.count_--;
+        shard.charge_ -= entry->charge_;
+        delete entry;
+    }
+
+    void _Rehash(Shard& shard, size_t size)
+    {
+        vector<Entry*> buckets(size, NULL);
+        for (size_t i = 0; i < shard.buckets_.size(); i++)
+        {
+            Entry* entry = shard.buckets_[i];
+            while (NULL != entry)
+            {
+                Entry* next = entry->next_;
+                Entry*& head = buckets[entry->hash_ & (size - 1)];
+                entry->next_ = head;
+                head         = entry;
+                entry        = next;
+            }
+        }
+        shard.buckets_.swap(buckets);
+    }
+
+    /**
+     * @brief   Move the CLOCK hand until the shard fits its budget, an expired entry it passes is
+     *          removed first, one referenced since the last pass gets a second chance, keep is never evicted
+     */
+    void _Evict(Shard& shard, const Entry* keep)
+    {
+        uint64_t now = 0;
+        while (shard.charge_ > shard.capacity_ && shard.count_ > 1)
+        {
+            if (shard.hand_ >= shard.clock_.size())
+            {
+                shard.hand_ = 0;
+            }
+            Entry* entry = shard.clock_[shard.hand_++];
+            if (NULL == entry || entry == keep)
+            {
+                continue;
+            }
+            if (0 != entry->expire_us_)
+            {
+                now = 0 == now ? GetMonotonicMicroSecond() : now;
+                if (_Expired(entry, now))
+                {
+                    _Remove(shard, entry);
+                    RingAdd(shard.expirations_, 1);
+                    continue;
+                }
+            }
+            if (0 != entry->referenced_)
+            {
+                entry->referenced_ = 0;
+                continue;
+            }
+            _Remove(shard, entry);
+            RingAdd(shard.evictions_, 1);
+        }
+    }
+
+    const uint32_t  num_shards_;
+    Shard*          shards_;
+    CounterCell     counters_[CACHE_COUNTER_CELLS];
+    HASH            hasher_;
+};
+
+/**
+ * @brief   Thread calling Expire of caches at an interval
+ */
+class CacheExpirer : public Thread
+{
+public:
+    CacheExpirer(uint32_t interval_ms = CACHE_EXPIRE_MS)
+        : Thread("<cache_expirer>")
+        , interval_ms_(0 == interval_ms ? 1 : interval_ms)
+    {
+    }
+
+    void AddCache(IExpirable* cache)
+    {
+        MutexLock lock(mutex_);
+        vec_cache_.push_back(cache);
+    }
+
+    void RemoveCache(IExpirable* cache)
+    {
+        MutexLock lock(mutex_);
+        for (size_t i = 0; i < vec_cache_.size(); i++)
+        {
+            if (vec_cache_[i] == cache)
+            {
+                vec_cache_.erase(vec_cache_.begin() + i);
+                return;
+            }
+        }
+    }
+
+protected:
+    virtual uint32_t _Run()
+    {
+        // The stop signal ends the wait
+        while (!event_.Wait(interval_ms_))
+        {
+            MutexLock lock(mutex_);
+            for (size_t i = 0; i < vec_cache_.size(); i++)
+            {
+                vec_cache_[i]->Expire();
+            }
+        }
+        return 0;
+    }
+
+private:
+    uint32_t            interval_ms_;
+    Mutex               mutex_;
+    vector<IExpirable*> vec_cache_;
+};
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_CACHE_H_
@@ -0,0 +1,63 @@
+/**
+ * @file    tools\crc32.h
+ * @brief   CRC-32(IEEE 802.3, same as zlib)
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ */
+
+#ifndef _LITE_CRC32_H_
+#define _LITE_CRC32_H_
+
+#include "base/lite_base.h"
+
+namespace lite {
+
+/**
+ * @brief   Table of reflected polynomial 0xEDB88320
+ */
+struct Crc32Table
+{
+    uint32_t    table_[256];
+
+    Crc32Table()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+            }
+            table_[i] = c;
+        }
+    }
+};
+
+/**
+ * @brief   Continue a crc with more data, start with crc 0
+ */
+inline
+uint32_t Crc32Update(uint32_t crc, const void* data, uint32_t size)
+{
+    static const Crc32Table table;
+
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc = table.table_[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline
+uint32_t Crc32(const void* data, uint32_t size)
+{
+    return Crc32Update(0, data, size);
+}
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_CRC32_H_
@@ -0,0 +1,1301 @@
+/**
+ * @file    tools\file_io.h
+ * @brief   Asynchronous file IO engine
+ *          Reads, writes and syncs are submitted in batches and completed by a few engine threads,
+ *          which call back the submitter, so many files are written without a thread each
+ *          FILEIOENGINE_Iocp       Overlapped IO on an IO completion port(windows)
+ *          FILEIOENGINE_Uring      io_uring driven by system calls, no liburing(linux 5.6 or later)
+ *          FILEIOENGINE_Threads    Blocking IO by a pool of threads, writes to adjacent offsets are
+ *                                  gathered into one call(pwritev on linux)
+ *          Submit never waits for room, so it may be called from completion callbacks
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ * @update          2026-10-18      Add io_uring engine, requests which find the queue full wait in an overflow list
+ *                                  Read at end of file which fails at once completes with 0 bytes
+ */
+
+#ifndef _LITE_FILE_IO_H_
+#define _LITE_FILE_IO_H_
+
+#include "base/lite_base.h"
+#include "base/noncopyable.h"
+#include "event/thread.h"
+#include "event/mutex_lock.h"
+#include "ring_queue.h"
+
+#ifdef OS_WIN
+#include <windows.h>
+#include <malloc.h>
+#elif defined(OS_LINUX)
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#endif
+
+#define FILEIO_ALIGN            (4096)          ///> Alignment of buffers, offsets and sizes of direct IO
+#define FILEIO_DEFAULT_THREADS  (2)
+#define FILEIO_MAX_BATCH        (64)            ///> Completions handled, or writes gathered, at once
+#define FILEIO_QUEUE_SIZE       (4096)          ///> Requests queued for FILEIOENGINE_Threads
+#define FILEIO_WAIT_MS          (100)           ///> Longest wait of an engine thread before checking stop
+#define FILEIO_URING_ENTRIES    (256)           ///> Submission queue entries of each io_uring
+
+namespace lite {
+
+typedef enum
+{
+    FILEIO_Read = 0,
+    FILEIO_Write,
+    FILEIO_Sync,                                ///> Flush writes completed before it to disk
+}FILEIO_OP;
+
+/**
+ * @brief   Flags of AsyncFile open
+ */
+typedef enum
+{
+    FILEOPEN_Read       = 0x01,
+    FILEOPEN_Write      = 0x02,
+    FILEOPEN_Create     = 0x04,                 ///> Create if not exists
+    FILEOPEN_Truncate   = 0x08,
+    FILEOPEN_Direct     = 0x10,                 ///> Bypass page cache, IO must be FILEIO_ALIGN aligned
+}FILEOPEN;
+
+typedef enum
+{
+    FILEIOENGINE_Iocp = 0,                      ///> Windows only
+    FILEIOENGINE_Threads,
+    FILEIOENGINE_Uring,                         ///> Linux only
+}FILEIOENGINE;
+
+#ifdef OS_WIN
+#define FILEIO_DEFAULT_ENGINE   FILEIOENGINE_Iocp
+#else
+#define FILEIO_DEFAULT_ENGINE   FILEIOENGINE_Uring
+#endif
+
+struct FileIoRequest;
+
+/**
+ * @brief   Called by an engine thread when a request completed, the request may be reused in it
+ */
+typedef void (*FILEIOFUNC)(FileIoRequest* request, void* user_ptr);
+
+class AsyncFile;
+
+/**
+ * @brief   One IO, owned by the submitter until its callback, so IO needs no allocation
+ */
+struct FileIoRequest
+{
+#ifdef OS_WIN
+    OVERLAPPED  overlapped_;                    ///> Must be first, completion port gives it back
+#endif
+    AsyncFile*  file_;
+    FILEIO_OP   op_;
+    uint64_t    offset_;
+    uint8_t*    data_;
+    uint32_t    size_;
+    uint32_t    transferred_;                   ///> Bytes read or written
+    uint32_t    error_;                         ///> 0, or system error code
+    FILEIOFUNC  func_;
+    void*       user_ptr_;
+
+    FileIoRequest()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+#ifdef OS_WIN
+        ZeroMemory(&overlapped_, sizeof(overlapped_));
+#endif
+        file_        = NULL;
+        op_          = FILEIO_Read;
+        offset_      = 0;
+        data_        = NULL;
+        size_        = 0;
+        transferred_ = 0;
+        error_       = 0;
+        func_        = NULL;
+        user_ptr_    = NULL;
+    }
+};
+
+/**
+ * @brief   Buffer aligned for direct IO
+ */
+class AlignedBuffer : private NonCopyable
+{
+public:
+    /**
+     * @param   size    Rounded up to alignment
+     */
+    AlignedBuffer(uint32_t size, uint32_t alignment = FILEIO_ALIGN)
+        : data_(NULL)
+        , size_(Align(size, alignment))
+    {
+#ifdef OS_WIN
+        data_ = (uint8_t*)_aligned_malloc(size_, alignment);
+#elif defined(OS_LINUX)
+        void* data = NULL;
+        data_ = 0 == posix_memalign(&data, alignment, size_) ? (uint8_t*)data : NULL;
+#endif
+    }
+
+    virtual ~AlignedBuffer()
+    {
+#ifdef OS_WIN
+        _aligned_free(data_);
+#elif defined(OS_LINUX)
+        free(data_);
+#endif
+    }
+
+    uint8_t* Data() const
+    {
+        return data_;
+    }
+
+    uint32_t Size() const
+    {
+        return size_;
+    }
+
+    /**
+     * @brief   Round size up to a multiple of alignment(a power of 2)
+     */
+    static uint32_t Align(uint32_t size, uint32_t alignment = FILEIO_ALIGN)
+    {
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+private:
+    uint8_t*    data_;
+    uint32_t    size_;
+};
+
+/**
+ * @brief   File opened by FileIoEngine::Open
+ */
+class AsyncFile : private NonCopyable
+{
+public:
+    AsyncFile()
+        : flags_(0)
+#ifdef OS_WIN
+        , handle_(INVALID_HANDLE_VALUE)
+#elif defined(OS_LINUX)
+        , fd_(-1)
+#endif
+    {
+    }
+
+    virtual ~AsyncFile()
+    {
+        Close();
+    }
+
+    const string& Name() const
+    {
+        return name_;
+    }
+
+    bool IsOpen() const
+    {
+#ifdef OS_WIN
+        return INVALID_HANDLE_VALUE != handle_;
+#elif defined(OS_LINUX)
+        return fd_ >= 0;
+#endif
+    }
+
+    bool IsDirect() const
+    {
+        return 0 != (flags_ & FILEOPEN_Direct);
+    }
+
+    uint64_t Size() const
+    {
+#ifdef OS_WIN
+        LARGE_INTEGER size;
+        return GetFileSizeEx(handle_, &size) ? (uint64_t)size.QuadPart : 0;
+#elif defined(OS_LINUX)
+        struct stat st;
+        return 0 == fstat(fd_, &st) ? (uint64_t)st.st_size : 0;
+#endif
+    }
+
+    /**
+     * @brief   Set size, e.g. to cut padding of the last direct write, no IO may be in flight
+     */
+    bool SetSize(uint64_t size)
+    {
+#ifdef OS_WIN
+        LARGE_INTEGER pos;
+        pos.QuadPart = (LONGLONG)size;
+        return SetFilePointerEx(handle_, pos, NULL, FILE_BEGIN) && SetEndOfFile(handle_);
+#elif defined(OS_LINUX)
+        return 0 == ftruncate(fd_, (off_t)size);
+#endif
+    }
+
+    /**
+     * @brief   Close, no IO may be in flight
+     */
+    void Close()
+    {
+#ifdef OS_WIN
+        if (INVALID_HANDLE_VALUE != handle_)
+        {
+            CloseHandle(handle_);
+            handle_ = INVALID_HANDLE_VALUE;
+        }
+#elif defined(OS_LINUX)
+        if (fd_ >= 0)
+        {
+            close(fd_);
+            fd_ = -1;
+        }
+#endif
+    }
+
+private:
+    friend class FileIoEngine;
+    friend class FileIoUring;
+
+    string      name_;
+    uint32_t    flags_;
+#ifdef OS_WIN
+    HANDLE      handle_;
+#elif defined(OS_LINUX)
+    int         fd_;
+#endif
+};
+
+/**
+ * @brief   Counters of an engine
+ */
+struct FileIoStats
+{
+    int64_t     submitted_;
+    int64_t     completed_;
+    int64_t     failed_;
+    int64_t     bytes_read_;
+    int64_t     bytes_written_;
+    int64_t     calls_;                         ///> System calls of reads and writes, less than requests when gathered or batched
+
+    FileIoStats()
+        : submitted_(0)
+        , completed_(0)
+        , failed_(0)
+        , bytes_read_(0)
+        , bytes_written_(0)
+        , calls_(0)
+    {
+    }
+};
+
+class FileIoEngine;
+
+/**
+ * @brief   Engine thread
+ */
+class FileIoThread : public Thread
+{
+public:
+    FileIoThread(FileIoEngine* engine, uint32_t index)
+        : Thread("<file_io>")
+        , engine_(engine)
+        , index_(index)
+    {
+    }
+
+    bool Signalled()
+    {
+        return _Signalled();
+    }
+
+    uint32_t Index() const
+    {
+        return index_;
+    }
+
+protected:
+    virtual uint32_t _Run();
+
+private:
+    FileIoEngine*   engine_;
+    uint32_t        index_;
+};
+
+#ifdef OS_LINUX
+
+/**
+ * @brief   io_uring set up by system calls, submitters share its submission queue under a lock,
+ *          one engine thread reaps its completion queue
+ *          Requests in the ring are limited to completion queue entries, the others wait in an overflow list
+ */
+class FileIoUring : private NonCopyable
+{
+public:
+    /**
+     * @param   calls   Counter of system calls which submit IO
+     */
+    FileIoUring(volatile int64_t& calls)
+        : calls_(calls)
+        , fd_(-1)
+        , sq_entries_(0)
+        , cq_entries_(0)
+        , in_ring_(0)
+        , sq_ring_(NULL)
+        , cq_ring_(NULL)
+        , sqes_(NULL)
+        , sq_ring_size_(0)
+        , cq_ring_size_(0)
+        , sqes_size_(0)
+        , sq_head_(NULL)
+        , sq_tail_(NULL)
+        , sq_mask_(NULL)
+        , sq_array_(NULL)
+        , cq_head_(NULL)
+        , cq_tail_(NULL)
+        , cq_mask_(NULL)
+        , cqes_(NULL)
+    {
+    }
+
+    virtual ~FileIoUring()
+    {
+        Close();
+    }
+
+    /**
+     * @return  false if io_uring is not supported, e.g. kernel before 5.6 or disabled
+     */
+    bool Open(uint32_t entries)
+    {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        fd_ = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (fd_ < 0)
+        {
+            return false;
+        }
+        // IORING_OP_READ and IORING_OP_WRITE came with this feature
+        if (0 == (params.features & IORING_FEAT_RW_CUR_POS))
+        {
+            Close();
+            return false;
+        }
+        sq_entries_   = params.sq_entries;
+        cq_entries_   = params.cq_entries;
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        sqes_size_    = params.sq_entries * sizeof(struct io_uring_sqe);
+        sq_ring_      = (uint8_t*)_Map(sq_ring_size_, IORING_OFF_SQ_RING);
+        cq_ring_      = (uint8_t*)_Map(cq_ring_size_, IORING_OFF_CQ_RING);
+        sqes_         = (struct io_uring_sqe*)_Map(sqes_size_, IORING_OFF_SQES);
+        if (NULL == sq_ring_ || NULL == cq_ring_ || NULL == sqes_)
+        {
+            Close();
+            return false;
+        }
+        sq_head_  = (uint32_t*)(sq_ring_ + params.sq_off.head);
+        sq_tail_  = (uint32_t*)(sq_ring_ + params.sq_off.tail);
+        sq_mask_  = (uint32_t*)(sq_ring_ + params.sq_off.ring_mask);
+        sq_array_ = (uint32_t*)(sq_ring_ + params.sq_off.array);
+        cq_head_  = (uint32_t*)(cq_ring_ + params.cq_off.head);
+        cq_tail_  = (uint32_t*)(cq_ring_ + params.cq_off.tail);
+        cq_mask_  = (uint32_t*)(cq_ring_ + params.cq_off.ring_mask);
+        cqes_     = (struct io_uring_cqe*)(cq_ring_ + params.cq_off.cqes);
+        return true;
+    }
+
+    /**
+     * @brief   Close, no IO may be in flight
+     */
+    void Close()
+    {
+        if (NULL != sqes_)
+        {
+            munmap(sqes_, sqes_size_);
+            sqes_ = NULL;
+        }
+        if (NULL != cq_ring_)
+        {
+            munmap(cq_ring_, cq_ring_size_);
+            cq_ring_ = NULL;
+        }
+        if (NULL != sq_ring_)
+        {
+            munmap(sq_ring_, sq_ring_size_);
+            sq_ring_ = NULL;
+        }
+        if (fd_ >= 0)
+        {
+            close(fd_);
+            fd_ = -1;
+        }
+        overflow_.clear();
+        in_ring_ = 0;
+    }
+
+    /**
+     * @brief   Queue requests and submit them by one system call, never waits for room
+     */
+    void Submit(FileIoRequest** requests, uint32_t count)
+    {
+        MutexLock lock(mt_sq_);
+        uint32_t  i = 0;
+        while (i < count && overflow_.empty() && _Prepare(requests[i]))
+        {
+            i++;
+        }
+        for (; i < count; i++)
+        {
+            overflow_.push_back(requests[i]);
+        }
+        _Enter();
+    }
+
+    /**
+     * @brief   Wake the thread waiting in Reap
+     */
+    void Wake()
+    {
+        FileIoRequest* nop = NULL;
+        Submit(&nop, 1);
+    }
+
+    /**
+     * @brief   Wait for completions and take up to max_count(FILEIO_MAX_BATCH at most) of them,
+     *          a short write is submitted again for the rest
+     * @return  Requests finished, 0 if woken or interrupted
+     */
+    uint32_t Reap(FileIoRequest** requests, uint32_t max_count)
+    {
+        uint32_t head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+        {
+            // Also submits entries a busy kernel did not take when they were queued
+            syscall(__NR_io_uring_enter, fd_, sq_entries_, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        }
+
+        FileIoRequest* again[FILEIO_MAX_BATCH];
+        uint32_t       num_again = 0;
+        uint32_t       count     = 0;
+        uint32_t       reaped    = 0;
+        uint32_t       tail      = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        while (head != tail && reaped < max_count)
+        {
+            struct io_uring_cqe* cqe     = &cqes_[head & *cq_mask_];
+            FileIoRequest*       request = (FileIoRequest*)(uintptr_t)cqe->user_data;
+            int32_t              res     = cqe->res;
+            head++;
+            reaped++;
+            if (NULL == request)
+            {
+                continue;                       // Wake
+            }
+            if (res < 0)
+            {
+                request->error_ = (uint32_t)-res;
+            }
+            else if (FILEIO_Write == request->op_ && request->transferred_ + (uint32_t)res < request->size_)
+            {
+                request->transferred_ += (uint32_t)res;
+                if (res > 0)
+                {
+                    again[num_again++] = request;
+                    continue;
+                }
+                request->error_ = EIO;
+            }
+            else
+            {
+                // A short read is the end of file
+                request->transferred_ += (uint32_t)res;
+            }
+            requests[count++] = request;
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+        if (0 != reaped)
+        {
+            MutexLock lock(mt_sq_);
+            in_ring_ -= reaped;
+            while (num_again > 0)
+            {
+                overflow_.push_front(again[--num_again]);
+            }
+            while (!overflow_.empty() && _Prepare(overflow_.front()))
+            {
+                overflow_.pop_front();
+            }
+            _Enter();
+        }
+        return count;
+    }
+
+private:
+    void* _Map(size_t size, uint64_t offset)
+    {
+        void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, (off_t)offset);
+        return MAP_FAILED == ptr ? NULL : ptr;
+    }
+
+    /**
+     * @brief   Fill a submission queue entry, a NULL request is a nop, under mt_sq_
+     * @return  false if ring is full
+     */
+    bool _Prepare(FileIoRequest* request)
+    {
+        uint32_t tail = *sq_tail_;
+        if (in_ring_ >= cq_entries_ || tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+        {
+            return false;
+        }
+        uint32_t             index = tail & *sq_mask_;
+        struct io_uring_sqe* sqe   = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        if (NULL == request)
+        {
+            sqe->opcode = IORING_OP_NOP;
+        }
+        else if (FILEIO_Sync == request->op_)
+        {
+            sqe->opcode      = IORING_OP_FSYNC;
+            sqe->fd          = request->file_->fd_;
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        }
+        else
+        {
+            // Continues after transferred_ for the rest of a short write
+            sqe->opcode = FILEIO_Write == request->op_ ? IORING_OP_WRITE : IORING_OP_READ;
+            sqe->fd     = request->file_->fd_;
+            sqe->addr   = (uint64_t)(uintptr_t)(request->data_ + request->transferred_);
+            sqe->len    = request->size_ - request->transferred_;
+            sqe->off    = request->offset_ + request->transferred_;
+        }
+        sqe->user_data   = (uint64_t)(uintptr_t)request;
+        sq_array_[index] = index;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        in_ring_++;
+        return true;
+    }
+
+    /**
+     * @brief   Submit entries queued, under mt_sq_, a busy kernel leaves them to the next call
+     */
+    void _Enter()
+    {
+        uint32_t pending = *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        while (0 != pending)
+        {
+            RingAdd(calls_, 1);
+            if (syscall(__NR_io_uring_enter, fd_, pending, 0, 0, NULL, 0) >= 0 || EINTR != errno)
+            {
+                break;
+            }
+        }
+    }
+
+    volatile int64_t&       calls_;
+    int                     fd_;
+    uint32_t                sq_entries_;
+    uint32_t                cq_entries_;
+    uint32_t                in_ring_;               ///> Entries submitted or queued and not reaped, under mt_sq_
+    Mutex                   mt_sq_;
+    list<FileIoRequest*>    overflow_;              ///> Requests waiting for room, under mt_sq_
+    uint8_t*                sq_ring_;
+    uint8_t*                cq_ring_;
+    struct io_uring_sqe*    sqes_;
+    size_t                  sq_ring_size_;
+    size_t                  cq_ring_size_;
+    size_t                  sqes_size_;
+    uint32_t*               sq_head_;
+    uint32_t*               sq_tail_;
+    uint32_t*               sq_mask_;
+    uint32_t*               sq_array_;
+    uint32_t*               cq_head_;
+    uint32_t*               cq_tail_;
+    uint32_t*               cq_mask_;
+    struct io_uring_cqe*    cqes_;
+};
+
+#endif // ifdef OS_LINUX
+
+/**
+ * @brief   Asynchronous file IO
+ *          FileIoEngine engine;
+ *          engine.Start();
+ *          engine.Open(file, "a.log", FILEOPEN_Write | FILEOPEN_Create);
+ *          engine.Write(&request, file, offset, data, size, OnWritten, this);
+ *          A sync covers writes completed before it is submitted, submit it from the write callback
+ */
+class FileIoEngine : private NonCopyable
+{
+public:
+    /**
+     * @param   type        FILEIOENGINE_Iocp and FILEIOENGINE_Uring fall back to FILEIOENGINE_Threads
+     *                      where not supported
+     * @param   threads     Engine threads, a sync blocks one of them while flushing,
+     *                      each thread has its own ring with FILEIOENGINE_Uring
+     * @param   max_batch   Completions handled, or requests taken, at once by a thread
+     */
+    FileIoEngine(FILEIOENGINE type = FILEIO_DEFAULT_ENGINE, uint32_t threads = FILEIO_DEFAULT_THREADS, uint32_t max_batch = FILEIO_MAX_BATCH)
+        : num_threads_(0 == threads ? 1 : threads)
+        , max_batch_(0 == max_batch ? 1 : (max_batch > FILEIO_MAX_BATCH ? FILEIO_MAX_BATCH : max_batch))
+        , running_(false)
+        , in_flight_(0)
+        , queue_(FILEIO_QUEUE_SIZE)
+        , overflowed_(0)
+#ifdef OS_WIN
+        , type_(FILEIOENGINE_Uring == type ? FILEIOENGINE_Threads : type)
+        , iocp_(NULL)
+#else
+        , type_(FILEIOENGINE_Iocp == type ? FILEIOENGINE_Threads : type)
+        , next_ring_(0)
+#endif
+    {
+    }
+
+    virtual ~FileIoEngine()
+    {
+        Stop();
+    }
+
+    /**
+     * @brief   Engine in use, FILEIOENGINE_Threads after Start if the one asked for is not supported
+     */
+    FILEIOENGINE Type() const
+    {
+        return type_;
+    }
+
+    bool Start()
+    {
+        if (running_)
+        {
+            return true;
+        }
+#ifdef OS_WIN
+        if (FILEIOENGINE_Iocp == type_)
+        {
+            iocp_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, num_threads_);
+            if (NULL == iocp_)
+            {
+                return false;
+            }
+        }
+#elif defined(OS_LINUX)
+        if (FILEIOENGINE_Uring == type_)
+        {
+            for (uint32_t i = 0; i < num_threads_; i++)
+            {
+                vec_ring_.push_back(new FileIoUring(stats_.calls_));
+                if (!vec_ring_.back()->Open(FILEIO_URING_ENTRIES))
+                {
+                    _CloseRings();
+                    type_ = FILEIOENGINE_Threads;
+                    break;
+                }
+            }
+        }
+#endif
+        running_ = true;
+        for (uint32_t i = 0; i < num_threads_; i++)
+        {
+            vec_thread_.push_back(new FileIoThread(this, i));
+            if (!vec_thread_.back()->Start())
+            {
+                Stop();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief   Wait for requests in flight, then stop threads
+     */
+    void Stop()
+    {
+        running_ = false;
+        while (!vec_thread_.empty() && 0 != RingLoad(in_flight_))
+        {
+            RingYield();
+        }
+        for (size_t i = 0; i < vec_thread_.size(); i++)
+        {
+            vec_thread_[i]->Signal();
+        }
+#ifdef OS_LINUX
+        // Threads of rings wait in the kernel
+        for (size_t i = 0; i < vec_ring_.size(); i++)
+        {
+            vec_ring_[i]->Wake();
+        }
+#endif
+        for (size_t i = 0; i < vec_thread_.size(); i++)
+        {
+            vec_thread_[i]->Stop();
+            delete vec_thread_[i];
+        }
+        vec_thread_.clear();
+#ifdef OS_WIN
+        if (NULL != iocp_)
+        {
+            CloseHandle(iocp_);
+            iocp_ = NULL;
+        }
+#elif defined(OS_LINUX)
+        _CloseRings();
+#endif
+    }
+
+    /**
+     * @brief   Open a file for IO by this engine, after Start
+     * @param   flags   FILEOPEN_*
+     */
+    bool Open(AsyncFile& file, const string& filename, uint32_t flags);
+
+    /**
+     * @brief   Submit requests, each is completed by its callback, also on failure
+     *          Never waits, requests beyond room of the engine wait in an overflow list
+     * @return  false if none submitted(engine not running, or a request invalid)
+     */
+    bool Submit(FileIoRequest** requests, uint32_t count)
+    {
+        if (!running_)
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (!_Valid(requests[i]))
+            {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            requests[i]->transferred_ = 0;
+            requests[i]->error_       = 0;
+        }
+        RingAdd(in_flight_, count);
+        RingAdd(stats_.submitted_, count);
+#ifdef OS_WIN
+        if (FILEIOENGINE_Iocp == type_)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                _StartOverlapped(requests[i]);
+            }
+            return true;
+        }
+#elif defined(OS_LINUX)
+        if (FILEIOENGINE_Uring == type_)
+        {
+            // A batch goes to one ring, so it is submitted by one system call
+            vec_ring_[(uint64_t)RingAdd(next_ring_, 1) % vec_ring_.size()]->Submit(requests, count);
+            return true;
+        }
+#endif
+        // Waiting for room here would deadlock engine threads submitting from callbacks
+        uint32_t pushed = 0 == RingLoad(overflowed_) ? queue_.PushBatch(requests, count) : 0;
+        if (pushed < count)
+        {
+            MutexLock lock(mt_overflow_);
+            for (uint32_t i = pushed; i < count; i++)
+            {
+                overflow_.push_back(requests[i]);
+            }
+            RingAdd(overflowed_, count - pushed);
+        }
+        _DrainOverflow();
+        return true;
+    }
+
+    bool Submit(FileIoRequest* request)
+    {
+        return Submit(&request, 1);
+    }
+
+    bool Write(FileIoRequest* request, AsyncFile& file, uint64_t offset, const void* data, uint32_t size, FILEIOFUNC func, void* user_ptr)
+    {
+        _Prepare(request, file, FILEIO_Write, offset, (uint8_t*)data, size, func, user_ptr);
+        return Submit(request);
+    }
+
+    bool Read(FileIoRequest* request, AsyncFile& file, uint64_t offset, void* data, uint32_t size, FILEIOFUNC func, void* user_ptr)
+    {
+        _Prepare(request, file, FILEIO_Read, offset, (uint8_t*)data, size, func, user_ptr);
+        return Submit(request);
+    }
+
+    bool Sync(FileIoRequest* request, AsyncFile& file, FILEIOFUNC func, void* user_ptr)
+    {
+        _Prepare(request, file, FILEIO_Sync, 0, NULL, 0, func, user_ptr);
+        return Submit(request);
+    }
+
+    /**
+     * @brief   Requests submitted and not called back yet
+     */
+    uint32_t InFlight() const
+    {
+        return (uint32_t)RingLoad(in_flight_);
+    }
+
+    FileIoStats GetStats() const
+    {
+        FileIoStats stats;
+        stats.submitted_     = RingLoad(stats_.submitted_);
+        stats.completed_     = RingLoad(stats_.completed_);
+        stats.failed_        = RingLoad(stats_.failed_);
+        stats.bytes_read_    = RingLoad(stats_.bytes_read_);
+        stats.bytes_written_ = RingLoad(stats_.bytes_written_);
+        stats.calls_         = RingLoad(stats_.calls_);
+        return stats;
+    }
+
+protected:
+    friend class FileIoThread;
+
+    /**
+     * @brief   Loop of engine thread
+     */
+    void _Run(FileIoThread* thread)
+    {
+#ifdef OS_WIN
+        if (FILEIOENGINE_Iocp == type_)
+        {
+            _RunIocp(thread);
+            return;
+        }
+#elif defined(OS_LINUX)
+        if (FILEIOENGINE_Uring == type_)
+        {
+            _RunUring(thread);
+            return;
+        }
+#endif
+        _RunQueue(thread);
+    }
+
+private:
+    void _Prepare(FileIoRequest* request, AsyncFile& file, FILEIO_OP op, uint64_t offset, uint8_t* data, uint32_t size, FILEIOFUNC func, void* user_ptr)
+    {
+        request->Reset();
+        request->file_     = &file;
+        request->op_       = op;
+        request->offset_   = offset;
+        request->data_     = data;
+        request->size_     = size;
+        request->func_     = func;
+        request->user_ptr_ = user_ptr;
+    }
+
+    bool _Valid(const FileIoRequest* request) const
+    {
+        if (NULL == request->file_ || !request->file_->IsOpen())
+        {
+            return false;
+        }
+        if (FILEIO_Sync == request->op_ || !request->file_->IsDirect())
+        {
+            return true;
+        }
+        return 0 == request->offset_ % FILEIO_ALIGN
+            && 0 == request->size_ % FILEIO_ALIGN
+            && 0 == (size_t)request->data_ % FILEIO_ALIGN;
+    }
+
+    /**
+     * @brief   Count and call back a finished request
+     */
+    void _Complete(FileIoRequest* request)
+    {
+        if (0 != request->error_)
+        {
+            RingAdd(stats_.failed_, 1);
+        }
+        else if (FILEIO_Write == request->op_)
+        {
+            RingAdd(stats_.bytes_written_, request->transferred_);
+        }
+        else if (FILEIO_Read == request->op_)
+        {
+            RingAdd(stats_.bytes_read_, request->transferred_);
+        }
+        RingAdd(stats_.completed_, 1);
+        if (NULL != request->func_)
+        {
+            request->func_(request, request->user_ptr_);
+        }
+        // After the callback, so Stop waits for callbacks too
+        RingAdd(in_flight_, -1);
+    }
+
+    void _RunQueue(FileIoThread* thread)
+    {
+        FileIoRequest* batch[FILEIO_MAX_BATCH];
+        while (true)
+        {
+            if (!queue_.Pop(batch[0], FILEIO_WAIT_MS))
+            {
+                if (thread->Signalled())
+                {
+                    break;
+                }
+                continue;
+            }
+            uint32_t count = 1 + queue_.PopBatch(batch + 1, max_batch_ - 1);
+            for (uint32_t i = 0; i < count; )
+            {
+                i += _Execute(batch + i, count - i);
+            }
+            for (uint32_t i = 0; i < count; i++)
+            {
+                _Complete(batch[i]);
+            }
+            _DrainOverflow();
+        }
+    }
+
+    /**
+     * @brief   Move requests which found the queue full into it, as far as it has room
+     */
+    void _DrainOverflow()
+    {
+        if (0 == RingLoad(overflowed_))
+        {
+            return;
+        }
+        MutexLock lock(mt_overflow_);
+        while (!overflow_.empty() && queue_.TryPush(overflow_.front()))
+        {
+            overflow_.pop_front();
+            RingAdd(overflowed_, -1);
+        }
+    }
+
+    /**
+     * @brief   Run first request by blocking IO, with following writes to the adjacent range of same file
+     * @return  Requests done
+     */
+    uint32_t _Execute(FileIoRequest** requests, uint32_t count);
+
+#ifdef OS_WIN
+    void _StartOverlapped(FileIoRequest* request);
+    void _RunIocp(FileIoThread* thread);
+#elif defined(OS_LINUX)
+    void _RunUring(FileIoThread* thread)
+    {
+        FileIoUring*   ring = vec_ring_[thread->Index()];
+        FileIoRequest* batch[FILEIO_MAX_BATCH];
+        while (!thread->Signalled())
+        {
+            uint32_t count = ring->Reap(batch, max_batch_);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                _Complete(batch[i]);
+            }
+        }
+    }
+
+    void _CloseRings()
+    {
+        for (size_t i = 0; i < vec_ring_.size(); i++)
+        {
+            delete vec_ring_[i];
+        }
+        vec_ring_.clear();
+    }
+#endif
+
+    uint32_t                num_threads_;
+    uint32_t                max_batch_;
+    volatile bool           running_;
+    volatile int64_t        in_flight_;
+    FileIoStats             stats_;
+    MpmcRing<FileIoRequest*> queue_;            ///> Requests for FILEIOENGINE_Threads
+    Mutex                   mt_overflow_;
+    list<FileIoRequest*>    overflow_;              ///> Requests which found queue_ full, under mt_overflow_
+    volatile int64_t        overflowed_;            ///> Size of overflow_
+    vector<FileIoThread*>   vec_thread_;
+    FILEIOENGINE            type_;
+#ifdef OS_WIN
+    HANDLE                  iocp_;
+#elif defined(OS_LINUX)
+    vector<FileIoUring*>    vec_ring_;
+    volatile int64_t        next_ring_;
+#endif
+};
+
+inline
+uint32_t FileIoThread::_Run()
+{
+    engine_->_Run(this);
+    return 0;
+}
+
+#ifdef OS_WIN
+
+#define FILEIO_KEY_IO       (0)                 ///> Completion of overlapped IO
+#define FILEIO_KEY_SYNC     (1)                 ///> Sync posted to an engine thread
+#define FILEIO_KEY_FAILED   (2)                 ///> IO ended when started(failure or end of file), error_ set
+
+inline
+bool FileIoEngine::Open(AsyncFile& file, const string& filename, uint32_t flags)
+{
+    file.Close();
+    DWORD access = ((flags & FILEOPEN_Read)  ? GENERIC_READ  : 0)
+                 | ((flags & FILEOPEN_Write) ? GENERIC_WRITE : 0);
+    DWORD create = OPEN_EXISTING;
+    if (flags & FILEOPEN_Create)
+    {
+        create = (flags & FILEOPEN_Truncate) ? CREATE_ALWAYS : OPEN_ALWAYS;
+    }
+    else if (flags & FILEOPEN_Truncate)
+    {
+        create = TRUNCATE_EXISTING;
+    }
+    DWORD attr = FILE_ATTRIBUTE_NORMAL;
+    attr |= FILEIOENGINE_Iocp == type_ ? FILE_FLAG_OVERLAPPED : 0;
+    attr |= (flags & FILEOPEN_Direct) ? FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH : 0;
+
+    file.handle_ = CreateFileA(filename.c_str(), access, FILE_SHARE_READ, NULL, create, attr, NULL);
+    if (INVALID_HANDLE_VALUE == file.handle_)
+    {
+        return false;
+    }
+    if (FILEIOENGINE_Iocp == type_ && NULL == CreateIoCompletionPort(file.handle_, iocp_, FILEIO_KEY_IO, 0))
+    {
+        file.Close();
+        return false;
+    }
+    file.name_  = filename;
+    file.flags_ = flags;
+    return true;
+}
+
+inline
+void FileIoEngine::_StartOverlapped(FileIoRequest* request)
+{
+    ZeroMemory(&request->overlapped_, sizeof(request->overlapped_));
+    request->overlapped_.Offset     = (DWORD)request->offset_;
+    request->overlapped_.OffsetHigh = (DWORD)(request->offset_ >> 32);
+    if (FILEIO_Sync == request->op_)
+    {
+        // FlushFileBuffers can not be overlapped, an engine thread does it
+        PostQueuedCompletionStatus(iocp_, 0, FILEIO_KEY_SYNC, &request->overlapped_);
+        return;
+    }
+    HANDLE handle = request->file_->handle_;
+    BOOL   ok     = FILEIO_Write == request->op_
+                  ? WriteFile(handle, request->data_, request->size_, NULL, &request->overlapped_)
+                  : ReadFile(handle, request->data_, request->size_, NULL, &request->overlapped_);
+    RingAdd(stats_.calls_, 1);
+    DWORD err = ok ? ERROR_SUCCESS : GetLastError();
+    if (!ok && ERROR_IO_PENDING != err)
+    {
+        // Reading at end of file may fail at once without a completion, it reads nothing
+        request->transferred_ = 0;
+        request->error_       = ERROR_HANDLE_EOF == err ? 0 : err;
+        PostQueuedCompletionStatus(iocp_, 0, FILEIO_KEY_FAILED, &request->overlapped_);
+    }
+}
+
+inline
+void FileIoEngine::_RunIocp(FileIoThread* thread)
+{
+    OVERLAPPED_ENTRY entries[FILEIO_MAX_BATCH];
+    while (!thread->Signalled())
+    {
+        ULONG count = 0;
+        if (!GetQueuedCompletionStatusEx(iocp_, entries, max_batch_, &count, FILEIO_WAIT_MS, FALSE))
+        {
+            continue;
+        }
+        for (ULONG i = 0; i < count; i++)
+        {
+            FileIoRequest* request = (FileIoRequest*)entries[i].lpOverlapped;
+            switch (entries[i].lpCompletionKey)
+            {
+            case FILEIO_KEY_IO:
+            {
+                DWORD transferred = 0;
+                if (!GetOverlappedResult(request->file_->handle_, &request->overlapped_, &transferred, FALSE))
+                {
+                    request->error_ = GetLastError();
+                }
+                request->transferred_ = transferred;
+                // Reading at end of file is not an error, it reads nothing
+                if (ERROR_HANDLE_EOF == request->error_)
+                {
+                    request->error_ = 0;
+                }
+                break;
+            }
+            case FILEIO_KEY_SYNC:
+                request->error_ = FlushFileBuffers(request->file_->handle_) ? 0 : GetLastError();
+                break;
+            default:
+                break;
+            }
+            _Complete(request);
+        }
+    }
+}
+
+inline
+uint32_t FileIoEngine::_Execute(FileIoRequest** requests, uint32_t count)
+{
+    // Windows has no gathered write of buffered files, each request is one call
+    FileIoRequest* request = requests[0];
+    HANDLE         handle  = request->file_->handle_;
+    if (FILEIO_Sync == request->op_)
+    {
+        request->error_ = FlushFileBuffers(handle) ? 0 : GetLastError();
+        return 1;
+    }
+    OVERLAPPED overlapped;
+    ZeroMemory(&overlapped, sizeof(overlapped));
+    overlapped.Offset     = (DWORD)request->offset_;
+    overlapped.OffsetHigh = (DWORD)(request->offset_ >> 32);
+    DWORD transferred = 0;
+    BOOL  ok          = FILEIO_Write == request->op_
+                      ? WriteFile(handle, request->data_, request->size_, &transferred, &overlapped)
+                      : ReadFile(handle, request->data_, request->size_, &transferred, &overlapped);
+    RingAdd(stats_.calls_, 1);
+    request->transferred_ = transferred;
+    request->error_       = ok || ERROR_HANDLE_EOF == GetLastError() ? 0 : GetLastError();
+    return 1;
+}
+
+#elif defined(OS_LINUX)
+
+inline
+bool FileIoEngine::Open(AsyncFile& file, const string& filename, uint32_t flags)
+{
+    file.Close();
+    int oflags = 0;
+    if ((flags & FILEOPEN_Read) && (flags & FILEOPEN_Write))
+    {
+        oflags = O_RDWR;
+    }
+    else
+    {
+        oflags = (flags & FILEOPEN_Write) ? O_WRONLY : O_RDONLY;
+    }
+    oflags |= (flags & FILEOPEN_Create)   ? O_CREAT : 0;
+    oflags |= (flags & FILEOPEN_Truncate) ? O_TRUNC : 0;
+    if (flags & FILEOPEN_Direct)
+    {
+#ifdef O_DIRECT
+        oflags |= O_DIRECT;
+#else
+        return false;
+#endif
+    }
+    file.fd_ = open(filename.c_str(), oflags, 0644);
+    if (file.fd_ < 0)
+    {
+        return false;
+    }
+    file.name_  = filename;
+    file.flags_ = flags;
+    return true;
+}
+
+inline
+uint32_t FileIoEngine::_Execute(FileIoRequest** requests, uint32_t count)
+{
+    FileIoRequest* request = requests[0];
+    int            fd      = request->file_->fd_;
+    if (FILEIO_Sync == request->op_)
+    {
+        request->error_ = 0 == fdatasync(fd) ? 0 : errno;
+        return 1;
+    }
+    if (FILEIO_Read == request->op_)
+    {
+        ssize_t ret;
+        do
+        {
+            ret = pread(fd, request->data_, request->size_, (off_t)request->offset_);
+        } while (ret < 0 && EINTR == errno);
+        RingAdd(stats_.calls_, 1);
+        request->transferred_ = ret < 0 ? 0 : (uint32_t)ret;
+        request->error_       = ret < 0 ? errno : 0;
+        return 1;
+    }
+
+    // Gather following writes which continue the range
+    struct iovec iov[FILEIO_MAX_BATCH];
+    uint32_t     num = 0;
+    uint64_t     end = request->offset_;
+    while (num < count
+        && FILEIO_Write      == requests[num]->op_
+        && request->file_    == requests[num]->file_
+        && end               == requests[num]->offset_)
+    {
+        iov[num].iov_base = requests[num]->data_;
+        iov[num].iov_len  = requests[num]->size_;
+        end += requests[num]->size_;
+        num++;
+    }
+
+    // A short write is finished request by request
+    uint64_t offset  = request->offset_;
+    uint32_t first   = 0;
+    size_t   written = 0;
+    while (first < num)
+    {
+        ssize_t ret = pwritev(fd, iov + first, (int)(num - first), (off_t)offset);
+        RingAdd(stats_.calls_, 1);
+        if (ret <= 0)
+        {
+            if (ret < 0 && EINTR == errno)
+            {
+                continue;
+            }
+            for (uint32_t i = first; i < num; i++)
+            {
+                requests[i]->error_ = ret < 0 ? errno : EIO;
+            }
+            break;
+        }
+        offset += ret;
+        for (written = (size_t)ret; first < num && written >= iov[first].iov_len; first++)
+        {
+            written -= iov[first].iov_len;
+            requests[first]->transferred_ = requests[first]->size_;
+        }
+        if (first < num && written > 0)
+        {
+            iov[first].iov_base = (uint8_t*)iov[first].iov_base + written;
+            iov[first].iov_len -= written;
+            requests[first]->transferred_ += (uint32_t)written;
+        }
+    }
+    return num;
+}
+
+#endif
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_FILE_IO_H_
@@ -0,0 +1,739 @@
+/**
+ * @file    tools\journal.h
+ * @brief   Append-only segmented journal with group commit
+ *          Records are length-prefixed and CRC-checked, a background thread writes appended records
+ *          in batches with one sync per batch, files roll over at a size limit, replay reads them mapped
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ */
+
+#ifndef _LITE_JOURNAL_H_
+#define _LITE_JOURNAL_H_
+
+#include "base/lite_base.h"
+#include "base/noncopyable.h"
+#include "base/byte_order.h"
+#include "event/event.h"
+#include "event/mutex.h"
+#include "event/mutex_lock.h"
+#include "event/thread.h"
+#include "byte_stream.h"
+#include "crc32.h"
+#include "mapped_file.h"
+#include "time_tool.h"
+#include <stdio.h>
+#include <ctype.h>
+#include <algorithm>
+
+#ifdef OS_WIN
+#include <windows.h>
+#define JOURNAL_PATH_SEP        "\\"
+#elif defined(OS_LINUX)
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define JOURNAL_PATH_SEP        "/"
+#endif
+
+#define JOURNAL_MAGIC           (0x4C4A4E4C)            ///> "LJNL"
+#define JOURNAL_VERSION         (1)
+#define JOURNAL_HEADER_SIZE     (16)                    ///> Magic, version, sequence of first record
+#define JOURNAL_RECORD_HEADER   (8)                     ///> Length, crc of payload
+#define JOURNAL_MAX_RECORD      (64 * 1024 * 1024)
+#define JOURNAL_SEGMENT_LIMIT   (64 * 1024 * 1024)      ///> Default size to roll over
+#define JOURNAL_COMMIT_MS       (2)                     ///> Default interval of group commit
+#define JOURNAL_BATCH_BYTES     (1024 * 1024)           ///> Pending bytes which commit before the interval
+
+namespace lite {
+
+/**
+ * @brief   Called for each record in replay, data is valid during the call only
+ */
+typedef void (*JOURNALREPLAYFUNC)(uint64_t seq, const uint8_t* data, uint32_t size, void* user_ptr);
+
+/**
+ * @brief   File name of a segment, named by sequence of its first record so names sort in order
+ */
+inline
+string JournalSegmentName(const string& path, const string& name, uint64_t first_seq)
+{
+    char seq[20];
+    sprintf(seq, "%016llx", (unsigned long long)first_seq);
+    return (path.empty() ? string("") : path + JOURNAL_PATH_SEP) + name + "." + seq + ".jnl";
+}
+
+/**
+ * @brief   Segment file written by the journal
+ */
+class JournalFile : private NonCopyable
+{
+public:
+    JournalFile()
+#ifdef OS_WIN
+        : file_(INVALID_HANDLE_VALUE)
+#elif defined(OS_LINUX)
+        : fd_(-1)
+#endif
+    {
+    }
+
+    virtual ~JournalFile()
+    {
+        Close();
+    }
+
+    /**
+     * @brief   Create a file, an existing one is replaced
+     *          (a segment of same name holds no valid record, as the journal starts after the last one)
+     */
+    bool Create(const string& filename);
+
+    /**
+     * @brief   Write all bytes at the end
+     */
+    bool Write(const void* data, uint32_t size);
+
+    /**
+     * @brief   Flush written data to disk
+     */
+    bool Sync();
+
+    void Close();
+
+    bool IsOpen() const
+    {
+#ifdef OS_WIN
+        return INVALID_HANDLE_VALUE != file_;
+#elif defined(OS_LINUX)
+        return fd_ >= 0;
+#endif
+    }
+
+private:
+#ifdef OS_WIN
+    HANDLE  file_;
+#elif defined(OS_LINUX)
+    int     fd_;
+#endif
+};
+
+#ifdef OS_WIN
+
+inline
+bool JournalFile::Create(const string& filename)
+{
+    Close();
+    file_ = CreateFileA(filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    return INVALID_HANDLE_VALUE != file_;
+}
+
+inline
+bool JournalFile::Write(const void* data, uint32_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    while (size > 0)
+    {
+        DWORD written = 0;
+        if (!WriteFile(file_, p, size, &written, NULL))
+        {
+            return false;
+        }
+        p    += written;
+        size -= written;
+    }
+    return true;
+}
+
+inline
+bool JournalFile::Sync()
+{
+    return TRUE == FlushFileBuffers(file_);
+}
+
+inline
+void JournalFile::Close()
+{
+    if (INVALID_HANDLE_VALUE != file_)
+    {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+}
+
+#elif defined(OS_LINUX)
+
+inline
+bool JournalFile::Create(const string& filename)
+{
+    Close();
+    fd_ = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+    {
+        return false;
+    }
+    // The new directory entry must be durable too
+    size_t sep = filename.rfind('/');
+    string dir_name = string::npos == sep ? string(".") : filename.substr(0, sep + 1);
+    int    dir      = open(dir_name.c_str(), O_RDONLY);
+    if (dir >= 0)
+    {
+        fsync(dir);
+        close(dir);
+    }
+    return true;
+}
+
+inline
+bool JournalFile::Write(const void* data, uint32_t size)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    while (size > 0)
+    {
+        ssize_t written = write(fd_, p, size);
+        if (written < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            return false;
+        }
+        p    += written;
+        size -= (uint32_t)written;
+    }
+    return true;
+}
+
+inline
+bool JournalFile::Sync()
+{
+    return 0 == fdatasync(fd_);
+}
+
+inline
+void JournalFile::Close()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+#endif
+
+/**
+ * @brief   Read records of a journal, segments are mapped and parsed in place
+ *          A damaged record(torn write of a crash) ends its segment, the next segment is read on
+ */
+class JournalReader : private NonCopyable
+{
+public:
+    JournalReader(const string& path, const string& name)
+        : path_(path)
+        , name_(name)
+        , damaged_(0)
+    {
+    }
+
+    /**
+     * @brief   Call func for records from sequence from_seq on
+     * @return  Records replayed
+     */
+    uint64_t Replay(JOURNALREPLAYFUNC func, void* user_ptr, uint64_t from_seq = 1)
+    {
+        vector<uint64_t> segments;
+        ListSegments(path_, name_, segments);
+        damaged_ = 0;
+
+        uint64_t count = 0;
+        uint64_t last  = 0;
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            // Records before from_seq are all in segments before it
+            if (i + 1 < segments.size() && segments[i + 1] <= from_seq)
+            {
+                continue;
+            }
+            count += _ReadSegment(segments[i], func, user_ptr, from_seq, last);
+        }
+        return count;
+    }
+
+    /**
+     * @brief   Sequence of last valid record, 0 if none
+     */
+    uint64_t LastSequence()
+    {
+        vector<uint64_t> segments;
+        ListSegments(path_, name_, segments);
+        damaged_ = 0;
+        if (segments.empty())
+        {
+            return 0;
+        }
+        // Segments are created on commit, so records before the last one are all in earlier segments
+        uint64_t last = segments.back() - 1;
+        _ReadSegment(segments.back(), NULL, NULL, (uint64_t)-1, last);
+        return last;
+    }
+
+    /**
+     * @brief   Segments with a damaged record found by last Replay or LastSequence
+     */
+    uint32_t Damaged() const
+    {
+        return damaged_;
+    }
+
+    /**
+     * @brief   Sequences of first records of segments, in order
+     */
+    static void ListSegments(const string& path, const string& name, vector<uint64_t>& segments);
+
+private:
+    /**
+     * @brief   Get sequence from a file name made by JournalSegmentName
+     */
+    static bool _ParseSegmentName(const char* filename, const string& name, uint64_t& seq)
+    {
+        if (strlen(filename) != name.length() + 21
+            || 0 != strncmp(filename, name.c_str(), name.length())
+            || '.' != filename[name.length()]
+            || 0 != strcmp(filename + name.length() + 17, ".jnl"))
+        {
+            return false;
+        }
+        seq = 0;
+        for (const char* p = filename + name.length() + 1; p < filename + name.length() + 17; p++)
+        {
+            if (!isxdigit((uint8_t)*p))
+            {
+                return false;
+            }
+            seq = (seq << 4) | (uint64_t)(*p <= '9' ? *p - '0' : (*p | 0x20) - 'a' + 10);
+        }
+        return true;
+    }
+
+    /**
+     * @brief   Parse one segment
+     * @param   last    Set to sequence of each valid record
+     */
+    uint64_t _ReadSegment(uint64_t first_seq, JOURNALREPLAYFUNC func, void* user_ptr, uint64_t from_seq, uint64_t& last)
+    {
+        MappedFile file;
+        if (!file.Open(JournalSegmentName(path_, name_, first_seq), MAPHINT_Sequential) || 0 == file.Size())
+        {
+            return 0;
+        }
+        ByteView view = file.View();
+        view.SetByteOrder(NETWORK_BYTEORDER);
+        if (view.Remaining() < JOURNAL_HEADER_SIZE
+            || JOURNAL_MAGIC   != view.GetUint32()
+            || JOURNAL_VERSION != view.GetUint32()
+            || first_seq       != view.GetUint64())
+        {
+            damaged_++;
+            return 0;
+        }
+
+        uint64_t count = 0;
+        uint64_t seq   = first_seq;
+        while (!view.Eof())
+        {
+            if (view.Remaining() < JOURNAL_RECORD_HEADER)
+            {
+                damaged_++;
+                break;
+            }
+            uint32_t size = view.GetUint32();
+            uint32_t crc  = view.GetUint32();
+            if (0 == size || size > JOURNAL_MAX_RECORD || size > view.Remaining())
+            {
+                damaged_++;
+                break;
+            }
+            const uint8_t* data = view.GetBytes(size);
+            if (crc != Crc32(data, size))
+            {
+                damaged_++;
+                break;
+            }
+            last = seq;
+            if (NULL != func && seq >= from_seq)
+            {
+                func(seq, data, size, user_ptr);
+                count++;
+            }
+            seq++;
+        }
+        return count;
+    }
+
+    string      path_;
+    string      name_;
+    uint32_t    damaged_;
+};
+
+#ifdef OS_WIN
+
+inline
+void JournalReader::ListSegments(const string& path, const string& name, vector<uint64_t>& segments)
+{
+    segments.clear();
+    string          pattern = (path.empty() ? string("") : path + JOURNAL_PATH_SEP) + name + ".*.jnl";
+    WIN32_FIND_DATAA data;
+    HANDLE          find = FindFirstFileA(pattern.c_str(), &data);
+    if (INVALID_HANDLE_VALUE == find)
+    {
+        return;
+    }
+    do
+    {
+        uint64_t seq = 0;
+        if (_ParseSegmentName(data.cFileName, name, seq))
+        {
+            segments.push_back(seq);
+        }
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+    std::sort(segments.begin(), segments.end());
+}
+
+#elif defined(OS_LINUX)
+
+inline
+void JournalReader::ListSegments(const string& path, const string& name, vector<uint64_t>& segments)
+{
+    segments.clear();
+    DIR* dir = opendir(path.empty() ? "." : path.c_str());
+    if (NULL == dir)
+    {
+        return;
+    }
+    struct dirent* entry = NULL;
+    while (NULL != (entry = readdir(dir)))
+    {
+        uint64_t seq = 0;
+        if (_ParseSegmentName(entry->d_name, name, seq))
+        {
+            segments.push_back(seq);
+        }
+    }
+    closedir(dir);
+    std::sort(segments.begin(), segments.end());
+}
+
+#endif
+
+/**
+ * @brief   Counters of a journal
+ */
+struct JournalStats
+{
+    uint64_t    records_;                       ///> Records committed
+    uint64_t    bytes_;                         ///> Bytes written
+    uint64_t    commits_;                       ///> Batches written, one sync each
+    uint64_t    max_batch_;                     ///> Most records in one commit
+    uint32_t    segments_;                      ///> Segments created
+
+    JournalStats()
+        : records_(0)
+        , bytes_(0)
+        , commits_(0)
+        , max_batch_(0)
+        , segments_(0)
+    {
+    }
+};
+
+/**
+ * @brief   Journal written in segment files <path>/<name>.<first sequence>.jnl
+ *          Append only copies the record into the pending batch, the journal thread writes the batch
+ *          every commit interval(or earlier when it grows large or someone waits) and syncs it once
+ *          Journal journal("data", "orders");
+ *          journal.Open();                         // Goes on after records already on disk
+ *          uint64_t seq = journal.Append(bs);
+ *          journal.WaitDurable(seq);
+ */
+class Journal : private Thread
+{
+public:
+    /**
+     * @param   segment_limit   Bytes to roll over to a new segment, checked between batches
+     * @param   commit_ms       Longest time a record waits to be written
+     */
+    Journal(const string& path, const string& name, uint64_t segment_limit = JOURNAL_SEGMENT_LIMIT, uint32_t commit_ms = JOURNAL_COMMIT_MS)
+        : Thread("<journal>")
+        , path_(path)
+        , name_(name)
+        , segment_limit_(segment_limit)
+        , commit_ms_(0 == commit_ms ? 1 : commit_ms)
+        , opened_(false)
+        , stream_a_(JOURNAL_BATCH_BYTES)
+        , stream_b_(JOURNAL_BATCH_BYTES)
+        , input_(&stream_a_)
+        , output_(&stream_b_)
+        , next_seq_(1)
+        , input_first_seq_(1)
+        , durable_seq_(0)
+        , failed_(false)
+        , segment_bytes_(0)
+    {
+        stream_a_.SetByteOrder(NETWORK_BYTEORDER);
+        stream_b_.SetByteOrder(NETWORK_BYTEORDER);
+    }
+
+    virtual ~Journal()
+    {
+        Close();
+    }
+
+    /**
+     * @brief   Find the last record on disk and start the journal thread, new records go to a new segment
+     */
+    bool Open()
+    {
+        if (opened_)
+        {
+            return true;
+        }
+        JournalReader reader(path_, name_);
+        next_seq_        = reader.LastSequence() + 1;
+        input_first_seq_ = next_seq_;
+        durable_seq_     = next_seq_ - 1;
+        failed_          = false;
+        opened_          = true;
+        if (!Start())
+        {
+            opened_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief   Commit pending records and stop, no Append may run meanwhile
+     */
+    void Close()
+    {
+        if (!opened_)
+        {
+            return;
+        }
+        opened_ = false;
+        Signal();
+        wake_.Signal();
+        Stop();
+        file_.Close();
+    }
+
+    /**
+     * @brief   Add a record, thread safe
+     * @return  Sequence of the record, 0 if journal not open, failed or size not in 1 ~ JOURNAL_MAX_RECORD
+     */
+    uint64_t Append(const void* data, uint32_t size)
+    {
+        if (!opened_ || failed_ || NULL == data || 0 == size || size > JOURNAL_MAX_RECORD)
+        {
+            return 0;
+        }
+        uint32_t crc  = Crc32(data, size);
+        uint64_t seq  = 0;
+        bool     wake = false;
+        {
+            MutexLock lock(mutex_);
+            if (0 == input_->GetWritePtr())
+            {
+                input_first_seq_ = next_seq_;
+            }
+            input_->PutUint32(size);
+            input_->PutUint32(crc);
+            input_->Add(data, size);
+            seq  = next_seq_++;
+            wake = input_->GetWritePtr() >= JOURNAL_BATCH_BYTES;
+        }
+        if (wake)
+        {
+            wake_.Signal();
+        }
+        return seq;
+    }
+
+    uint64_t Append(const ByteStream& record)
+    {
+        return Append(record.GetBuffer(), record.GetWritePtr());
+    }
+
+    /**
+     * @brief   Wait until a record is on disk, the pending batch is committed at once
+     * @return  false if timed out or the journal failed to write
+     */
+    bool WaitDurable(uint64_t seq, uint32_t timeout_ms = 0xffffffff)
+    {
+        uint64_t deadline = 0xffffffff == timeout_ms ? 0 : GetMonotonicMicroSecond() + (uint64_t)timeout_ms * 1000;
+        while (durable_seq_ < seq)
+        {
+            if (failed_ || !opened_ || seq >= next_seq_)
+            {
+                return false;
+            }
+            wake_.Signal();
+            uint32_t wait = commit_ms_;
+            if (0 != deadline)
+            {
+                uint64_t now = GetMonotonicMicroSecond();
+                if (now >= deadline)
+                {
+                    return false;
+                }
+                wait = (uint32_t)((deadline - now + 999) / 1000) < wait ? (uint32_t)((deadline - now + 999) / 1000) : wait;
+            }
+            durable_.Wait(wait);
+        }
+        return true;
+    }
+
+    /**
+     * @brief   Sequence of last appended record
+     */
+    uint64_t LastSequence() const
+    {
+        return next_seq_ - 1;
+    }
+
+    /**
+     * @brief   Sequence of last record on disk
+     */
+    uint64_t DurableSequence() const
+    {
+        return durable_seq_;
+    }
+
+    /**
+     * @brief   A write or sync failed, the journal takes no more records
+     */
+    bool Failed() const
+    {
+        return failed_;
+    }
+
+    /**
+     * @brief   Counters, read while running they may be slightly stale
+     */
+    JournalStats GetStats() const
+    {
+        return stats_;
+    }
+
+protected:
+    virtual uint32_t _Run()
+    {
+        while (!_Signalled())
+        {
+            wake_.Wait(commit_ms_);
+            wake_.Reset();
+            _Commit();
+        }
+        _Commit();
+        return 0;
+    }
+
+private:
+    /**
+     * @brief   Write pending records as one batch and sync, journal thread only
+     */
+    void _Commit()
+    {
+        uint64_t first = 0;
+        uint64_t last  = 0;
+        {
+            MutexLock lock(mutex_);
+            if (0 == input_->GetWritePtr())
+            {
+                return;
+            }
+            ByteStream* stream = output_;
+            output_ = input_;
+            input_  = stream;
+            first   = input_first_seq_;
+            last    = next_seq_ - 1;
+        }
+        durable_.Reset();
+
+        if (file_.IsOpen() && segment_bytes_ >= segment_limit_)
+        {
+            file_.Close();
+        }
+        bool ok = file_.IsOpen() || _NewSegment(first);
+        ok = ok && file_.Write(output_->GetBuffer(), output_->GetWritePtr()) && file_.Sync();
+        if (ok)
+        {
+            segment_bytes_   += output_->GetWritePtr();
+            stats_.bytes_    += output_->GetWritePtr();
+            stats_.records_  += last - first + 1;
+            stats_.commits_++;
+            stats_.max_batch_ = last - first + 1 > stats_.max_batch_ ? last - first + 1 : stats_.max_batch_;
+            durable_seq_      = last;
+        }
+        else
+        {
+            THREAD_LOG_ERROR("Journal %s failed to write records %llu ~ %llu", name_.c_str(), (unsigned long long)first, (unsigned long long)last);
+            failed_ = true;
+            file_.Close();
+        }
+        output_->SetWritePtr(0);
+        durable_.Signal();
+    }
+
+    bool _NewSegment(uint64_t first_seq)
+    {
+        if (!file_.Create(JournalSegmentName(path_, name_, first_seq)))
+        {
+            return false;
+        }
+        ByteStream header(JOURNAL_HEADER_SIZE);
+        header.SetByteOrder(NETWORK_BYTEORDER);
+        header.PutUint32(JOURNAL_MAGIC);
+        header.PutUint32(JOURNAL_VERSION);
+        header.PutUint64(first_seq);
+        if (!file_.Write(header.GetBuffer(), header.GetWritePtr()))
+        {
+            return false;
+        }
+        segment_bytes_ = JOURNAL_HEADER_SIZE;
+        stats_.segments_++;
+        return true;
+    }
+
+    string              path_;
+    string              name_;
+    uint64_t            segment_limit_;
+    uint32_t            commit_ms_;
+    volatile bool       opened_;
+
+    Mutex               mutex_;                 ///> Guards input_, next_seq_, input_first_seq_
+    ByteStream          stream_a_;
+    ByteStream          stream_b_;
+    ByteStream*         input_;                 ///> Appended to
+    ByteStream*         output_;                ///> Being written
+    volatile uint64_t   next_seq_;
+    uint64_t            input_first_seq_;
+
+    volatile uint64_t   durable_seq_;
+    volatile bool       failed_;
+    Event               wake_;                  ///> Commit now
+    Event               durable_;               ///> Signalled after each commit
+
+    JournalFile         file_;                  ///> Journal thread only
+    uint64_t            segment_bytes_;
+    JournalStats        stats_;
+};
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_JOURNAL_H_
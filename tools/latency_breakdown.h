@@ -0,0 +1,93 @@
+/**
+ * @file    tools\latency_breakdown.h
+ * @brief   Split latency of received messages into kernel-to-user, queueing and handler time
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ */
+
+#ifndef _LITE_LATENCY_BREAKDOWN_H_
+#define _LITE_LATENCY_BREAKDOWN_H_
+
+#include "tools/latency_histogram.h"
+#include "event/mutex_lock.h"
+
+namespace lite {
+
+/**
+ * @brief   Histograms(us) of the stages of a message, all times are of GetMonotonicMicroSecond clock
+ *          recv_us     Kernel receive time(RECEIVEFROMTSCALLBACK/RECEIVEDTSCALLBACK), 0 if unknown
+ *          queue_us    Time the message was queued for processing
+ *          start_us    Time the handler started
+ *          end_us      Time the handler finished
+ * @note    Thread safe
+ */
+class LatencyBreakdown : private NonCopyable
+{
+public:
+    void Record(uint64_t recv_us, uint64_t queue_us, uint64_t start_us, uint64_t end_us)
+    {
+        MutexLock lock(mt_);
+        if (0 != recv_us && queue_us >= recv_us)
+        {
+            kernel_to_user_.Record(queue_us - recv_us);
+        }
+        if (start_us >= queue_us)
+        {
+            queueing_.Record(start_us - queue_us);
+        }
+        if (end_us >= start_us)
+        {
+            handler_.Record(end_us - start_us);
+        }
+        if (end_us >= (0 != recv_us ? recv_us : queue_us))
+        {
+            total_.Record(end_us - (0 != recv_us ? recv_us : queue_us));
+        }
+    }
+
+    void Reset()
+    {
+        MutexLock lock(mt_);
+        kernel_to_user_.Reset();
+        queueing_.Reset();
+        handler_.Reset();
+        total_.Reset();
+    }
+
+    /**
+     * @brief   Copy histograms, e.g. to merge them with other processes
+     */
+    void Snapshot(LatencyHistogram& kernel_to_user, LatencyHistogram& queueing, LatencyHistogram& handler, LatencyHistogram& total)
+    {
+        MutexLock lock(mt_);
+        kernel_to_user = kernel_to_user_;
+        queueing       = queueing_;
+        handler        = handler_;
+        total          = total_;
+    }
+
+    /**
+     * @brief   One summary line of each stage
+     */
+    string Summary()
+    {
+        MutexLock lock(mt_);
+        return "kernel_to_user: " + kernel_to_user_.Summary() + "\n" +
+               "queueing:       " + queueing_.Summary() + "\n" +
+               "handler:        " + handler_.Summary() + "\n" +
+               "total:          " + total_.Summary() + "\n";
+    }
+
+private:
+    Mutex               mt_;
+    LatencyHistogram    kernel_to_user_;    ///> Kernel receive to queued
+    LatencyHistogram    queueing_;          ///> Queued to handler start
+    LatencyHistogram    handler_;           ///> Handler start to end
+    LatencyHistogram    total_;             ///> Kernel receive(or queued) to handler end
+};
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_LATENCY_BREAKDOWN_H_
@@ -0,0 +1,302 @@
+/**
+ * @file    tools\latency_histogram.h
+ * @brief   Log-linear latency histogram with fixed relative precision(< 1.6%)
+ *          Histograms of several threads or processes can be merged, also through ByteStream
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ */
+
+#ifndef _LITE_LATENCY_HISTOGRAM_H_
+#define _LITE_LATENCY_HISTOGRAM_H_
+
+#include "base/lite_base.h"
+#include "base/exception.h"
+#include "tools/byte_stream.h"
+#include <string.h>
+#include <stdio.h>
+
+namespace lite {
+
+#define LATENCY_HISTOGRAM_SUB_BITS      (7)                                         ///> Values below 2^7 are exact
+#define LATENCY_HISTOGRAM_SUB_COUNT     (1 << LATENCY_HISTOGRAM_SUB_BITS)
+#define LATENCY_HISTOGRAM_HALF_COUNT    (LATENCY_HISTOGRAM_SUB_COUNT / 2)
+#define LATENCY_HISTOGRAM_BUCKETS       (LATENCY_HISTOGRAM_SUB_COUNT + (64 - LATENCY_HISTOGRAM_SUB_BITS) * LATENCY_HISTOGRAM_HALF_COUNT)
+#define LATENCY_HISTOGRAM_MAGIC         (0x4C484731)                                ///> "LHG1"
+
+/**
+ * @brief   Histogram of values(unit is up to the user, e.g. microseconds)
+ * @note    Not thread safe, use one per thread and merge them
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        memset(counts_, 0, sizeof(counts_));
+        count_ = 0;
+        sum_   = 0;
+        min_   = 0;
+        max_   = 0;
+    }
+
+    void Record(uint64_t value, uint64_t times = 1)
+    {
+        if (0 == times)
+        {
+            return;
+        }
+        counts_[_Index(value)] += times;
+        if (0 == count_ || value < min_)
+        {
+            min_ = value;
+        }
+        if (value > max_)
+        {
+            max_ = value;
+        }
+        count_ += times;
+        sum_   += value * times;
+    }
+
+    void Merge(const LatencyHistogram& other)
+    {
+        if (0 == other.count_)
+        {
+            return;
+        }
+        for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        {
+            counts_[i] += other.counts_[i];
+        }
+        if (0 == count_ || other.min_ < min_)
+        {
+            min_ = other.min_;
+        }
+        if (other.max_ > max_)
+        {
+            max_ = other.max_;
+        }
+        count_ += other.count_;
+        sum_   += other.sum_;
+    }
+
+    uint64_t Count() const
+    {
+        return count_;
+    }
+
+    uint64_t Min() const
+    {
+        return min_;
+    }
+
+    uint64_t Max() const
+    {
+        return max_;
+    }
+
+    double Mean() const
+    {
+        return 0 == count_ ? 0 : (double)sum_ / count_;
+    }
+
+    /**
+     * @brief   Get value at percentile
+     * @param   percentile  0~100, e.g. 99.9
+     * @return  Highest value of the bucket, 0 if empty
+     */
+    uint64_t Percentile(double percentile) const
+    {
+        if (0 == count_)
+        {
+            return 0;
+        }
+        uint64_t target = (uint64_t)(percentile / 100.0 * count_ + 0.5);
+        if (target < 1)
+        {
+            target = 1;
+        }
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        {
+            total += counts_[i];
+            if (total >= target)
+            {
+                uint64_t value = _HighestValue(i);
+                return value > max_ ? max_ : (value < min_ ? min_ : value);
+            }
+        }
+        return max_;
+    }
+
+    /**
+     * @brief   Summary line: count, min, mean, p50, p90, p99, p99.9, p99.99, max
+     */
+    string Summary() const
+    {
+        char str[256];
+        sprintf(str,
+                "count=%llu min=%llu mean=%.1f p50=%llu p90=%llu p99=%llu p99.9=%llu p99.99=%llu max=%llu",
+                (unsigned long long)count_,
+                (unsigned long long)min_,
+                Mean(),
+                (unsigned long long)Percentile(50),
+                (unsigned long long)Percentile(90),
+                (unsigned long long)Percentile(99),
+                (unsigned long long)Percentile(99.9),
+                (unsigned long long)Percentile(99.99),
+                (unsigned long long)max_);
+        return str;
+    }
+
+    /**
+     * @brief   Append histogram to stream, only non-empty buckets are written
+     */
+    void Encode(ByteStream& bs) const
+    {
+        bs.SetByteOrder(NETWORK_BYTEORDER);
+        bs.PutUint32(LATENCY_HISTOGRAM_MAGIC);
+        bs.PutUint64(count_);
+        bs.PutUint64(sum_);
+        bs.PutUint64(min_);
+        bs.PutUint64(max_);
+        uint32_t buckets = 0;
+        for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        {
+            if (0 != counts_[i])
+            {
+                buckets++;
+            }
+        }
+        bs.PutUint32(buckets);
+        for (uint32_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+        {
+            if (0 != counts_[i])
+            {
+                bs.PutUint32(i);
+                bs.PutUint64(counts_[i]);
+            }
+        }
+    }
+
+    /**
+     * @brief   Read a histogram written by Encode and merge it into this one
+     * @return  false if the data is broken, this histogram is not changed then
+     */
+    bool MergeFrom(ByteStream& bs)
+    {
+        LatencyHistogram other;
+        try
+        {
+            bs.SetByteOrder(NETWORK_BYTEORDER);
+            if (LATENCY_HISTOGRAM_MAGIC != bs.GetUint32())
+            {
+                return false;
+            }
+            other.count_     = bs.GetUint64();
+            other.sum_       = bs.GetUint64();
+            other.min_       = bs.GetUint64();
+            other.max_       = bs.GetUint64();
+            uint32_t buckets = bs.GetUint32();
+            for (uint32_t i = 0; i < buckets; i++)
+            {
+                uint32_t index = bs.GetUint32();
+                if (index >= LATENCY_HISTOGRAM_BUCKETS)
+                {
+                    return false;
+                }
+                other.counts_[index] = bs.GetUint64();
+            }
+        }
+        catch (access_violation_exception&)
+        {
+            return false;
+        }
+        Merge(other);
+        return true;
+    }
+
+    /**
+     * @brief   Save to file, so worker processes can hand histograms to a parent
+     */
+    bool SaveToFile(const char* path) const
+    {
+        ByteStream bs;
+        Encode(bs);
+        FILE* file = fopen(path, "wb");
+        if (NULL == file)
+        {
+            return false;
+        }
+        bool ok = (bs.GetWritePtr() == fwrite(bs.GetBuffer(), 1, bs.GetWritePtr(), file));
+        fclose(file);
+        return ok;
+    }
+
+    /**
+     * @brief   Merge a histogram saved by SaveToFile
+     */
+    bool MergeFromFile(const char* path)
+    {
+        FILE* file = fopen(path, "rb");
+        if (NULL == file)
+        {
+            return false;
+        }
+        ByteStream bs;
+        char       buf[4096];
+        size_t     len = 0;
+        while (0 < (len = fread(buf, 1, sizeof(buf), file)))
+        {
+            bs.Add(buf, (uint32_t)len);
+        }
+        fclose(file);
+        return MergeFrom(bs);
+    }
+
+private:
+    static uint32_t _Index(uint64_t value)
+    {
+        if (value < LATENCY_HISTOGRAM_SUB_COUNT)
+        {
+            return (uint32_t)value;
+        }
+        uint32_t msb = 0;
+        for (uint64_t v = value; v > 1; v >>= 1)
+        {
+            msb++;
+        }
+        // Keep the top SUB_BITS bits, value >> shift is in [HALF_COUNT, SUB_COUNT)
+        uint32_t shift = msb - (LATENCY_HISTOGRAM_SUB_BITS - 1);
+        uint32_t sub   = (uint32_t)(value >> shift);
+        return LATENCY_HISTOGRAM_SUB_COUNT + (shift - 1) * LATENCY_HISTOGRAM_HALF_COUNT + (sub - LATENCY_HISTOGRAM_HALF_COUNT);
+    }
+
+    static uint64_t _HighestValue(uint32_t index)
+    {
+        if (index < LATENCY_HISTOGRAM_SUB_COUNT)
+        {
+            return index;
+        }
+        uint32_t shift = (index - LATENCY_HISTOGRAM_SUB_COUNT) / LATENCY_HISTOGRAM_HALF_COUNT + 1;
+        uint64_t sub   = (index - LATENCY_HISTOGRAM_SUB_COUNT) % LATENCY_HISTOGRAM_HALF_COUNT + LATENCY_HISTOGRAM_HALF_COUNT;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    uint64_t    counts_[LATENCY_HISTOGRAM_BUCKETS];
+    uint64_t    count_;
+    uint64_t    sum_;
+    uint64_t    min_;
+    uint64_t    max_;
+};
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_LATENCY_HISTOGRAM_H_
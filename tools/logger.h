@@ -3,6 +3,8 @@
  * @brief   Encapsulation log operations
  * @author  Nik Yan
  * @version 1.0     2014-07-01
+ * @update          2026-10-18      Bug free for background running(lists not set, start and stop swapped)
+ *                                  Add allocation scope
  */
 
 #ifndef _LITE_LOGGER_H_
@@ -14,6 +16,7 @@
 #include "event/mutex.h"
 #include "event/mutex_lock.h"
 #include "time_tool.h"
+#include "alloc_tracker.h"
 #include "thread.h"
 
 namespace lite {
@@ -42,6 +45,8 @@ public:
         , output_to_file_(false)
         , output_to_screen_(true)
         , asyn_(false)
+        , log_input_(&log_text_lista_)
+        , log_output_(&log_text_listb_)
     {
     }
 
@@ -86,11 +91,11 @@ public:
         }
         else if (asyn)
         {
-            Stop();
+            Start();
         }
         else
         {
-            Start();
+            Stop();
         }
         asyn_ = asyn;
     }
@@ -421,6 +426,7 @@ void Logger::_Write(LOGLEVEL level, const char* fmt_text, va_list va)
     {
         return;
     }
+    LITE_ALLOC_SCOPE("logger.write");
 
     ByteStream bs_text(MAX_LOG_BUFFER_SIZE);
     char*      log_text = (char*)bs_text.GetBuffer();
@@ -490,6 +496,7 @@ uint32_t Logger::_Run()
             {
                 _Write( (*it).c_str() );
             }
+            log_output_->clear();
         }
     }
 
@@ -0,0 +1,596 @@
+/**
+ * @file    tools\mapped_file.h
+ * @brief   Read-only memory-mapped file, ByteView to parse it in place, and a page prefetching thread
+ *          Large files are parsed directly from the page cache, without reading them into a ByteStream
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ */
+
+#ifndef _LITE_MAPPED_FILE_H_
+#define _LITE_MAPPED_FILE_H_
+
+#include "base/lite_base.h"
+#include "base/noncopyable.h"
+#include "base/byte_order.h"
+#include "base/exception.h"
+#include "event/event.h"
+#include "event/thread.h"
+#include <string.h>
+
+#ifdef OS_WIN
+#include <windows.h>
+#elif defined(OS_LINUX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define MAPPED_PREFETCH_WINDOW  (64 * 1024 * 1024)  ///> Bytes kept resident ahead of the reader
+#define MAPPED_PREFETCH_CHUNK   (4 * 1024 * 1024)   ///> Bytes prefetched at once
+
+namespace lite {
+
+/**
+ * @brief   Access hints of mapped pages(madvise)
+ */
+typedef enum
+{
+    MAPHINT_Normal = 0,
+    MAPHINT_Sequential,                         ///> Read ahead aggressively, drop pages behind
+    MAPHINT_Random,                             ///> No read ahead
+    MAPHINT_WillNeed,                           ///> Start reading pages in now
+    MAPHINT_DontNeed,                           ///> Pages may be dropped, read again from file if touched
+    MAPHINT_HugePages,                          ///> Back with huge pages(linux, file systems supporting it)
+}MAPHINT;
+
+/**
+ * @brief   Read-only view of bytes with the Get interface of ByteStream, never copies the data
+ *          Reads past the end throw access_violation_exception
+ */
+class ByteView
+{
+public:
+    ByteView()
+        : data_(NULL)
+        , size_(0)
+        , read_idx_(0)
+        , byte_order_(HOST_BYTEORDER)
+    {
+    }
+
+    ByteView(const uint8_t* data, uint64_t size)
+        : data_(data)
+        , size_(size)
+        , read_idx_(0)
+        , byte_order_(HOST_BYTEORDER)
+    {
+    }
+
+    void SetByteOrder(BYTEORDER byte_order)
+    {
+        byte_order_ = byte_order;
+    }
+
+    const uint8_t* Data() const
+    {
+        return data_;
+    }
+
+    uint64_t Size() const
+    {
+        return size_;
+    }
+
+    uint64_t Remaining() const
+    {
+        return size_ - read_idx_;
+    }
+
+    bool Eof() const
+    {
+        return read_idx_ == size_;
+    }
+
+    uint64_t GetReadPtr() const
+    {
+        return read_idx_;
+    }
+
+    void SetReadPtr(uint64_t read_idx)
+    {
+        if (read_idx > size_)
+        {
+            throw access_violation_exception("byte view overflow");
+        }
+        read_idx_ = read_idx;
+    }
+
+    void Skip(uint64_t len)
+    {
+        SetReadPtr(read_idx_ + len);
+    }
+
+    /**
+     * @brief   Pointer to next len bytes, valid while the mapping is
+     */
+    const uint8_t* GetBytes(uint64_t len)
+    {
+        _Check(len);
+        const uint8_t* bytes = data_ + read_idx_;
+        read_idx_ += len;
+        return bytes;
+    }
+
+    /**
+     * @brief   Copy next len bytes
+     */
+    void Get(void* data, uint64_t len)
+    {
+        memcpy(data, GetBytes(len), (size_t)len);
+    }
+
+    /**
+     * @brief   View of next len bytes, with same byte order
+     */
+    ByteView GetView(uint64_t len)
+    {
+        ByteView view(GetBytes(len), len);
+        view.byte_order_ = byte_order_;
+        return view;
+    }
+
+    int8_t   GetInt8()   { return (int8_t)*GetBytes(1); }
+    uint8_t  GetUint8()  { return *GetBytes(1); }
+    int16_t  GetInt16()  { return (int16_t)GetUint16(); }
+    int32_t  GetInt32()  { return (int32_t)GetUint32(); }
+    int64_t  GetInt64()  { return (int64_t)GetUint64(); }
+
+    uint16_t GetUint16()
+    {
+        uint16_t value;
+        Get(&value, 2);
+        return byte_order_ == NETWORK_BYTEORDER ? NtohUint16(value) : value;
+    }
+
+    uint32_t GetUint32()
+    {
+        uint32_t value;
+        Get(&value, 4);
+        return byte_order_ == NETWORK_BYTEORDER ? NtohUint32(value) : value;
+    }
+
+    uint64_t GetUint64()
+    {
+        uint64_t value;
+        Get(&value, 8);
+        return byte_order_ == NETWORK_BYTEORDER ? NtohUint64(value) : value;
+    }
+
+    /**
+     * @brief   Read a string until '\0' or end
+     */
+    string GetString()
+    {
+        const uint8_t* start = data_ + read_idx_;
+        const uint8_t* end   = (const uint8_t*)memchr(start, 0, (size_t)Remaining());
+        uint64_t       len   = NULL == end ? Remaining() : (uint64_t)(end - start);
+        read_idx_ += NULL == end ? len : len + 1;
+        return string((const char*)start, (size_t)len);
+    }
+
+    /**
+     * @brief   Next line without '\n'(and '\r' before it), pointing into the view
+     * @return  false at end
+     */
+    bool GetLine(const char*& line, uint32_t& len)
+    {
+        if (Eof())
+        {
+            return false;
+        }
+        const uint8_t* start = data_ + read_idx_;
+        const uint8_t* end   = (const uint8_t*)memchr(start, '\n', (size_t)Remaining());
+        uint64_t       size  = NULL == end ? Remaining() : (uint64_t)(end - start);
+        read_idx_ += NULL == end ? size : size + 1;
+        if (size > 0 && '\r' == start[size - 1])
+        {
+            size--;
+        }
+        line = (const char*)start;
+        len  = (uint32_t)size;
+        return true;
+    }
+
+private:
+    void _Check(uint64_t len) const
+    {
+        if (len > size_ - read_idx_)
+        {
+            throw access_violation_exception("byte view overflow");
+        }
+    }
+
+    const uint8_t*  data_;
+    uint64_t        size_;
+    uint64_t        read_idx_;
+    BYTEORDER       byte_order_;
+};
+
+/**
+ * @brief   Whole file mapped read-only
+ */
+class MappedFile : private NonCopyable
+{
+public:
+    MappedFile()
+        : data_(NULL)
+        , size_(0)
+#ifdef OS_WIN
+        , file_(INVALID_HANDLE_VALUE)
+        , mapping_(NULL)
+#elif defined(OS_LINUX)
+        , fd_(-1)
+#endif
+    {
+    }
+
+    virtual ~MappedFile()
+    {
+        Close();
+    }
+
+    /**
+     * @brief   Map a file
+     * @param   hint    Access pattern, on windows Sequential and Random are only taken here
+     * @return  false if file can not be opened or mapped, an empty file maps to no data
+     */
+    bool Open(const string& path, MAPHINT hint = MAPHINT_Normal);
+
+    void Close();
+
+    bool IsOpen() const;
+
+    const uint8_t* Data() const
+    {
+        return data_;
+    }
+
+    uint64_t Size() const
+    {
+        return size_;
+    }
+
+    /**
+     * @brief   View of bytes of the file
+     */
+    ByteView View(uint64_t offset = 0, uint64_t len = (uint64_t)-1) const
+    {
+        offset = offset > size_ ? size_ : offset;
+        len    = len > size_ - offset ? size_ - offset : len;
+        return ByteView(data_ + offset, len);
+    }
+
+    /**
+     * @brief   Give an access hint of a range, len 0 for up to the end
+     * @return  false if hint not supported on this system
+     */
+    bool Advise(MAPHINT hint, uint64_t offset = 0, uint64_t len = 0);
+
+    /**
+     * @brief   Touch a page of each page size in a range, so it is resident when parsed
+     */
+    void Touch(uint64_t offset, uint64_t len) const
+    {
+        if (offset >= size_)
+        {
+            return;
+        }
+        len = len > size_ - offset ? size_ - offset : len;
+        volatile uint8_t sum  = 0;
+        uint32_t         page = PageSize();
+        for (uint64_t pos = offset - offset % page; pos < offset + len; pos += page)
+        {
+            sum += data_[pos];
+        }
+    }
+
+    static uint32_t PageSize()
+    {
+#ifdef OS_WIN
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwPageSize;
+#elif defined(OS_LINUX)
+        return (uint32_t)sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+private:
+    const uint8_t*  data_;
+    uint64_t        size_;
+#ifdef OS_WIN
+    HANDLE          file_;
+    HANDLE          mapping_;
+#elif defined(OS_LINUX)
+    int             fd_;
+#endif
+};
+
+#ifdef OS_WIN
+
+inline
+bool MappedFile::Open(const string& path, MAPHINT hint)
+{
+    Close();
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    flags |= MAPHINT_Sequential == hint ? FILE_FLAG_SEQUENTIAL_SCAN : 0;
+    flags |= MAPHINT_Random     == hint ? FILE_FLAG_RANDOM_ACCESS   : 0;
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+    if (INVALID_HANDLE_VALUE == file_)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size))
+    {
+        Close();
+        return false;
+    }
+    size_ = (uint64_t)size.QuadPart;
+    if (0 == size_)
+    {
+        return true;
+    }
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (NULL == mapping_)
+    {
+        Close();
+        return false;
+    }
+    data_ = (const uint8_t*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (NULL == data_)
+    {
+        Close();
+        return false;
+    }
+    if (MAPHINT_WillNeed == hint)
+    {
+        Advise(hint);
+    }
+    return true;
+}
+
+inline
+void MappedFile::Close()
+{
+    if (NULL != data_)
+    {
+        UnmapViewOfFile(data_);
+        data_ = NULL;
+    }
+    if (NULL != mapping_)
+    {
+        CloseHandle(mapping_);
+        mapping_ = NULL;
+    }
+    if (INVALID_HANDLE_VALUE != file_)
+    {
+        CloseHandle(file_);
+        file_ = INVALID_HANDLE_VALUE;
+    }
+    size_ = 0;
+}
+
+inline
+bool MappedFile::IsOpen() const
+{
+    return INVALID_HANDLE_VALUE != file_;
+}
+
+inline
+bool MappedFile::Advise(MAPHINT hint, uint64_t offset, uint64_t len)
+{
+    if (NULL == data_ || offset >= size_)
+    {
+        return false;
+    }
+    len = 0 == len || len > size_ - offset ? size_ - offset : len;
+
+    if (MAPHINT_WillNeed == hint)
+    {
+        // PrefetchVirtualMemory is Windows 8 and later
+        typedef struct
+        {
+            PVOID   VirtualAddress;
+            SIZE_T  NumberOfBytes;
+        } MAPPED_RANGE_ENTRY;
+        typedef BOOL (WINAPI *PREFETCHVIRTUALMEMORY)(HANDLE, ULONG_PTR, MAPPED_RANGE_ENTRY*, ULONG);
+        static PREFETCHVIRTUALMEMORY prefetch =
+            (PREFETCHVIRTUALMEMORY)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+        if (NULL == prefetch)
+        {
+            return false;
+        }
+        MAPPED_RANGE_ENTRY range;
+        range.VirtualAddress = (PVOID)(data_ + offset);
+        range.NumberOfBytes  = (SIZE_T)len;
+        return TRUE == prefetch(GetCurrentProcess(), 1, &range, 0);
+    }
+    if (MAPHINT_DontNeed == hint)
+    {
+        // Unlocking pages not locked removes them from the working set
+        VirtualUnlock((LPVOID)(data_ + offset), (SIZE_T)len);
+        return true;
+    }
+    return MAPHINT_Normal == hint;
+}
+
+#elif defined(OS_LINUX)
+
+inline
+bool MappedFile::Open(const string& path, MAPHINT hint)
+{
+    Close();
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (0 != fstat(fd_, &st))
+    {
+        Close();
+        return false;
+    }
+    size_ = (uint64_t)st.st_size;
+    if (0 == size_)
+    {
+        return true;
+    }
+    void* data = mmap(NULL, (size_t)size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (MAP_FAILED == data)
+    {
+        size_ = 0;
+        Close();
+        return false;
+    }
+    data_ = (const uint8_t*)data;
+    if (MAPHINT_Normal != hint)
+    {
+        Advise(hint);
+    }
+    return true;
+}
+
+inline
+void MappedFile::Close()
+{
+    if (NULL != data_)
+    {
+        munmap((void*)data_, (size_t)size_);
+        data_ = NULL;
+    }
+    if (fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+inline
+bool MappedFile::IsOpen() const
+{
+    return fd_ >= 0;
+}
+
+inline
+bool MappedFile::Advise(MAPHINT hint, uint64_t offset, uint64_t len)
+{
+    if (NULL == data_ || offset >= size_)
+    {
+        return false;
+    }
+    len = 0 == len || len > size_ - offset ? size_ - offset : len;
+
+    // madvise needs a page aligned address
+    uint64_t start = offset - offset % PageSize();
+    len += offset - start;
+
+    int advice = MADV_NORMAL;
+    switch (hint)
+    {
+    case MAPHINT_Sequential:    advice = MADV_SEQUENTIAL;   break;
+    case MAPHINT_Random:        advice = MADV_RANDOM;       break;
+    case MAPHINT_WillNeed:      advice = MADV_WILLNEED;     break;
+    case MAPHINT_DontNeed:      advice = MADV_DONTNEED;     break;
+#ifdef MADV_HUGEPAGE
+    case MAPHINT_HugePages:     advice = MADV_HUGEPAGE;     break;
+#else
+    case MAPHINT_HugePages:     return false;
+#endif
+    default:                    break;
+    }
+    return 0 == madvise((void*)(data_ + start), (size_t)len, advice);
+}
+
+#endif
+
+/**
+ * @brief   Thread keeping pages ahead of a reader resident, so parsing does not wait for the disk
+ *          The reader reports its position by SetPosition
+ */
+class MappedFilePrefetcher : public Thread
+{
+public:
+    /**
+     * @param   window  Bytes ahead of the reader to prefetch
+     */
+    MappedFilePrefetcher(const MappedFile& file, uint64_t window = MAPPED_PREFETCH_WINDOW, uint64_t chunk = MAPPED_PREFETCH_CHUNK)
+        : Thread("<mapped_prefetch>")
+        , file_(file)
+        , window_(window)
+        , chunk_(0 == chunk ? MAPPED_PREFETCH_CHUNK : chunk)
+        , position_(0)
+        , prefetched_(0)
+    {
+    }
+
+    /**
+     * @brief   Report read position, called by reader
+     */
+    void SetPosition(uint64_t position)
+    {
+        position_ = position;
+        if (prefetched_ < position + window_ && prefetched_ < file_.Size())
+        {
+            wake_.Signal();
+        }
+    }
+
+    /**
+     * @brief   Bytes from start of file prefetched
+     */
+    uint64_t Prefetched() const
+    {
+        return prefetched_;
+    }
+
+protected:
+    virtual uint32_t _Run()
+    {
+        while (!_Signalled() && prefetched_ < file_.Size())
+        {
+            // Skip what the reader already passed
+            uint64_t position = position_;
+            uint64_t next     = prefetched_ < position ? position : prefetched_;
+            uint64_t target   = position + window_ < file_.Size() ? position + window_ : file_.Size();
+            if (next >= target)
+            {
+                wake_.Wait(10);
+                wake_.Reset();
+                continue;
+            }
+            uint64_t len = target - next < chunk_ ? target - next : chunk_;
+            const_cast<MappedFile&>(file_).Advise(MAPHINT_WillNeed, next, len);
+            file_.Touch(next, len);
+            prefetched_ = next + len;
+        }
+        return 0;
+    }
+
+private:
+    const MappedFile&   file_;
+    uint64_t            window_;
+    uint64_t            chunk_;
+    volatile uint64_t   position_;
+    volatile uint64_t   prefetched_;
+    Event               wake_;
+};
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_MAPPED_FILE_H_
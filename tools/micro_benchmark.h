@@ -0,0 +1,298 @@
+/**
+ * @file    tools\micro_benchmark.h
+ * @brief   Microbenchmark harness, results are printed and saved as JSON for comparison across commits
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ * @update          2026-10-18      Add counters to results(cycles, context switches)
+ *                                  Add allocations per op when allocation tracking is enabled
+ */
+
+#ifndef _LITE_MICRO_BENCHMARK_H_
+#define _LITE_MICRO_BENCHMARK_H_
+
+#include "base/lite_base.h"
+#include "tools/latency_histogram.h"
+#include "tools/time_tool.h"
+#include "tools/alloc_tracker.h"
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+
+namespace lite {
+
+/**
+ * @brief   Function to measure, runs the operation iterations times
+ * @param   arg     Argument passed to MicroBenchmark::Run
+ */
+typedef void (*BENCHMARKFUNC)(uint64_t iterations, void* arg);
+
+/**
+ * @brief   Keep a value computed in a benchmark, so the compiler does not remove the computation
+ */
+inline
+void BenchmarkKeep(uint64_t value)
+{
+    static volatile uint64_t sink = 0;
+    sink = value;
+}
+
+/**
+ * @brief   Result of a benchmark
+ */
+struct BenchmarkResult
+{
+    string              name_;
+    uint64_t            iterations_;            ///> Operations of one repetition
+    double              ns_per_op_;             ///> Median of repetitions
+    double              min_ns_per_op_;
+    double              max_ns_per_op_;
+    double              ops_per_sec_;           ///> By median
+    bool                has_latency_;
+    LatencyHistogram    latency_ns_;            ///> Latency of single operations, if measured by the benchmark
+    vector<pair<string, double> > counters_;    ///> Other measurements, e.g. cycles per op
+
+    BenchmarkResult()
+        : iterations_(0)
+        , ns_per_op_(0)
+        , min_ns_per_op_(0)
+        , max_ns_per_op_(0)
+        , ops_per_sec_(0)
+        , has_latency_(false)
+    {
+    }
+};
+
+class MicroBenchmark
+{
+public:
+    /**
+     * @param   label   Name of this run in JSON, e.g. commit id
+     */
+    MicroBenchmark(const string& label = "")
+        : label_(label)
+        , min_time_ms_(200)
+        , repetitions_(5)
+    {
+    }
+
+    /**
+     * @brief   Minimum time of one repetition, iterations are calibrated to reach it
+     */
+    void SetMinTime(uint32_t min_time_ms)
+    {
+        min_time_ms_ = 0 == min_time_ms ? 1 : min_time_ms;
+    }
+
+    void SetRepetitions(uint32_t repetitions)
+    {
+        repetitions_ = 0 == repetitions ? 1 : repetitions;
+    }
+
+    /**
+     * @brief   Calibrate iterations, then time repetitions of func
+     */
+    const BenchmarkResult& Run(const string& name, BENCHMARKFUNC func, void* arg = NULL)
+    {
+        // Grow iterations until a run is long enough to time reliably
+        uint64_t iterations = 1;
+        uint64_t elapsed_ns = 0;
+        uint64_t target_ns  = (uint64_t)min_time_ms_ * 1000000;
+        while (true)
+        {
+            uint64_t start = GetMonotonicNanoSecond();
+            func(iterations, arg);
+            elapsed_ns = GetMonotonicNanoSecond() - start;
+            if (elapsed_ns >= target_ns / 10 || iterations >= ((uint64_t)1 << 40))
+            {
+                break;
+            }
+            iterations *= elapsed_ns < target_ns / 100 ? 10 : 2;
+        }
+        if (elapsed_ns > 0 && elapsed_ns < target_ns)
+        {
+            iterations = (uint64_t)((double)iterations * target_ns / elapsed_ns) + 1;
+        }
+
+        vector<double> samples;
+        samples.reserve(repetitions_);
+        uint64_t allocs      = AllocTracker::Instance().TotalCount();
+        uint64_t alloc_bytes = AllocTracker::Instance().TotalBytes();
+        for (uint32_t i = 0; i < repetitions_; i++)
+        {
+            uint64_t start = GetMonotonicNanoSecond();
+            func(iterations, arg);
+            samples.push_back((double)(GetMonotonicNanoSecond() - start) / iterations);
+        }
+        allocs      = AllocTracker::Instance().TotalCount() - allocs;
+        alloc_bytes = AllocTracker::Instance().TotalBytes() - alloc_bytes;
+
+        const BenchmarkResult& result = _AddSamples(name, iterations, samples, NULL);
+        if (AllocTracker::Instance().IsEnabled())
+        {
+            AddCounter("allocs_per_op", (double)allocs / ((double)iterations * repetitions_));
+            AddCounter("alloc_bytes_per_op", (double)alloc_bytes / ((double)iterations * repetitions_));
+        }
+        return result;
+    }
+
+    /**
+     * @brief   Add a result measured by the caller(e.g. with several threads)
+     * @param   ops         Operations done
+     * @param   elapsed_ns  Wall time of the operations
+     * @param   latency_ns  Latency of single operations, NULL if not measured
+     */
+    const BenchmarkResult& AddResult(const string& name, uint64_t ops, uint64_t elapsed_ns, const LatencyHistogram* latency_ns = NULL)
+    {
+        vector<double> samples;
+        samples.push_back(0 == ops ? 0 : (double)elapsed_ns / ops);
+        return _AddSamples(name, ops, samples, latency_ns);
+    }
+
+    /**
+     * @brief   Add a counter to the last result
+     */
+    void AddCounter(const string& name, double value)
+    {
+        if (!list_result_.empty())
+        {
+            list_result_.back().counters_.push_back(make_pair(name, value));
+        }
+    }
+
+    const list<BenchmarkResult>& Results() const
+    {
+        return list_result_;
+    }
+
+    /**
+     * @brief   Print one line of each result
+     */
+    void Print(FILE* file = stdout) const
+    {
+        for (list<BenchmarkResult>::const_iterator it = list_result_.begin(); it != list_result_.end(); it++)
+        {
+            fprintf(file, "%-48s %12.2f ns/op %14.0f ops/s", it->name_.c_str(), it->ns_per_op_, it->ops_per_sec_);
+            if (it->has_latency_)
+            {
+                fprintf(file, "  p50=%llu p99=%llu p99.9=%llu ns",
+                        (unsigned long long)it->latency_ns_.Percentile(50),
+                        (unsigned long long)it->latency_ns_.Percentile(99),
+                        (unsigned long long)it->latency_ns_.Percentile(99.9));
+            }
+            for (size_t i = 0; i < it->counters_.size(); i++)
+            {
+                fprintf(file, "  %s=%.2f", it->counters_[i].first.c_str(), it->counters_[i].second);
+            }
+            fprintf(file, "\n");
+        }
+    }
+
+    /**
+     * @brief   Results as JSON object
+     */
+    string ToJson() const
+    {
+        char   str[512];
+        string json = "{\n  \"label\": \"" + _Escape(label_) + "\",\n";
+        sprintf(str, "  \"time\": %llu,\n  \"results\": [", (unsigned long long)time(NULL));
+        json += str;
+        for (list<BenchmarkResult>::const_iterator it = list_result_.begin(); it != list_result_.end(); it++)
+        {
+            json += it == list_result_.begin() ? "\n" : ",\n";
+            json += "    {\"name\": \"" + _Escape(it->name_) + "\"";
+            sprintf(str,
+                    ", \"iterations\": %llu, \"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, \"max_ns_per_op\": %.3f, \"ops_per_sec\": %.1f",
+                    (unsigned long long)it->iterations_,
+                    it->ns_per_op_,
+                    it->min_ns_per_op_,
+                    it->max_ns_per_op_,
+                    it->ops_per_sec_);
+            json += str;
+            if (it->has_latency_)
+            {
+                sprintf(str,
+                        ", \"latency_ns\": {\"count\": %llu, \"min\": %llu, \"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p99_9\": %llu, \"max\": %llu}",
+                        (unsigned long long)it->latency_ns_.Count(),
+                        (unsigned long long)it->latency_ns_.Min(),
+                        it->latency_ns_.Mean(),
+                        (unsigned long long)it->latency_ns_.Percentile(50),
+                        (unsigned long long)it->latency_ns_.Percentile(90),
+                        (unsigned long long)it->latency_ns_.Percentile(99),
+                        (unsigned long long)it->latency_ns_.Percentile(99.9),
+                        (unsigned long long)it->latency_ns_.Max());
+                json += str;
+            }
+            if (!it->counters_.empty())
+            {
+                json += ", \"counters\": {";
+                for (size_t i = 0; i < it->counters_.size(); i++)
+                {
+                    sprintf(str, "%s\"%s\": %.3f", 0 == i ? "" : ", ", _Escape(it->counters_[i].first).c_str(), it->counters_[i].second);
+                    json += str;
+                }
+                json += "}";
+            }
+            json += "}";
+        }
+        json += "\n  ]\n}\n";
+        return json;
+    }
+
+    bool SaveJson(const char* path) const
+    {
+        FILE* file = fopen(path, "w");
+        if (NULL == file)
+        {
+            return false;
+        }
+        string json = ToJson();
+        bool   ok   = (json.size() == fwrite(json.data(), 1, json.size(), file));
+        fclose(file);
+        return ok;
+    }
+
+private:
+    const BenchmarkResult& _AddSamples(const string& name, uint64_t iterations, vector<double>& samples, const LatencyHistogram* latency_ns)
+    {
+        sort(samples.begin(), samples.end());
+        BenchmarkResult result;
+        result.name_          = name;
+        result.iterations_    = iterations;
+        result.ns_per_op_     = samples[samples.size() / 2];
+        result.min_ns_per_op_ = samples.front();
+        result.max_ns_per_op_ = samples.back();
+        result.ops_per_sec_   = result.ns_per_op_ > 0 ? 1e9 / result.ns_per_op_ : 0;
+        if (NULL != latency_ns)
+        {
+            result.has_latency_ = true;
+            result.latency_ns_  = *latency_ns;
+        }
+        list_result_.push_back(result);
+        return list_result_.back();
+    }
+
+    static string _Escape(const string& str)
+    {
+        string out;
+        for (size_t i = 0; i < str.size(); i++)
+        {
+            if ('"' == str[i] || '\\' == str[i])
+            {
+                out += '\\';
+            }
+            out += str[i];
+        }
+        return out;
+    }
+
+    string                  label_;
+    uint32_t                min_time_ms_;
+    uint32_t                repetitions_;
+    list<BenchmarkResult>   list_result_;
+};
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_MICRO_BENCHMARK_H_
@@ -0,0 +1,504 @@
+/**
+ * @file    tools\pipeline.h
+ * @brief   Staged pipeline, works pass through stages connected by bounded queues
+ *          e.g. decode -> validate -> enrich -> persist, each stage runs on its own threads,
+ *          so stages of different works run in parallel across cores
+ *          Memory is bounded by queue capacities, a full queue blocks the stage before it(backpressure)
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ * @update          2026-10-18      Support linux, release works discarded on stop by release func
+ *                                  Submit fails without stages
+ */
+
+#ifndef _LITE_PIPELINE_H_
+#define _LITE_PIPELINE_H_
+
+#include "base/lite_base.h"
+#include "base/noncopyable.h"
+#include "event/mutex_lock.h"
+#include "event/thread.h"
+#include "work_queue.h"
+#include "ring_queue.h"
+#include "latency_histogram.h"
+#include "time_tool.h"
+
+#ifdef OS_LINUX
+#include <unistd.h>
+#endif
+
+#define PIPELINE_POP_WAIT_MS    (100)           ///> Longest wait for input, stop is checked after it
+
+namespace lite {
+
+/**
+ * @brief   Handler of a stage, processes a batch of works
+ *          Set works[i] to NULL to drop a work(the handler owns it then),
+ *          the others are passed to next stage
+ * @param   user_ptr    Pointer given to AddStage
+ */
+typedef void (*PIPELINESTAGEFUNC)(Work** works, uint32_t count, void* user_ptr);
+
+/**
+ * @brief   Called with each work which passed the last stage or was discarded by a stopped pipeline,
+ *          works are deleted if not set
+ */
+typedef void (*PIPELINERELEASEFUNC)(Work* work, void* user_ptr);
+
+/**
+ * @brief   Counters of a stage
+ */
+struct PipelineStageStats
+{
+    string              name_;
+    uint32_t            parallelism_;
+    uint32_t            capacity_;              ///> Of input queue
+    uint32_t            queued_;                ///> Works in input queue now
+    uint64_t            works_;                 ///> Works handled
+    uint64_t            batches_;
+    uint64_t            dropped_;               ///> Works set to NULL by handler
+    uint64_t            blocked_;               ///> Pushes which found input queue full(backpressure)
+    double              works_per_sec_;         ///> Since start or ResetStats
+    LatencyHistogram    queue_us_;              ///> Time of works in input queue
+    LatencyHistogram    handler_us_;            ///> Time of handler per batch
+
+    PipelineStageStats()
+        : parallelism_(0)
+        , capacity_(0)
+        , queued_(0)
+        , works_(0)
+        , batches_(0)
+        , dropped_(0)
+        , blocked_(0)
+        , works_per_sec_(0)
+    {
+    }
+};
+
+class Pipeline;
+
+/**
+ * @brief   Stage of pipeline, input queue and threads
+ */
+class PipelineStage : private NonCopyable
+{
+public:
+    PipelineStage(Pipeline* pipeline, uint32_t index, const string& name, PIPELINESTAGEFUNC func, void* user_ptr,
+                  uint32_t parallelism, uint32_t batch, uint32_t capacity)
+        : pipeline_(pipeline)
+        , index_(index)
+        , func_(func)
+        , user_ptr_(user_ptr)
+        , batch_(0 == batch ? 1 : batch)
+        , queue_(capacity, RINGWAIT_Block)
+        , start_us_(0)
+    {
+        stats_.name_        = name;
+        stats_.parallelism_ = 0 == parallelism ? 1 : parallelism;
+        stats_.capacity_    = queue_.Capacity();
+    }
+
+    const string& Name() const
+    {
+        return stats_.name_;
+    }
+
+    /**
+     * @brief   Queue a work, waiting while the queue is full, queue_us_ of work is set
+     * @return  false if timeout
+     */
+    bool Push(Work* work, uint32_t timeout_ms)
+    {
+        work->queue_us_ = GetMonotonicMicroSecond();
+        if (queue_.TryPush(work))
+        {
+            return true;
+        }
+        {
+            MutexLock lock(mt_stats_);
+            stats_.blocked_++;
+        }
+        return 0 != timeout_ms && queue_.Push(work, timeout_ms);
+    }
+
+    /**
+     * @brief   Take a work left in queue, after threads stopped
+     */
+    bool TakeQueued(Work*& work)
+    {
+        return queue_.TryPop(work);
+    }
+
+    void GetStats(PipelineStageStats& stats)
+    {
+        MutexLock lock(mt_stats_);
+        stats         = stats_;
+        stats.queued_ = queue_.Size();
+        uint64_t us   = GetMonotonicMicroSecond() - start_us_;
+        stats.works_per_sec_ = 0 == start_us_ || 0 == us ? 0 : stats_.works_ * 1e6 / us;
+    }
+
+    void ResetStats()
+    {
+        MutexLock lock(mt_stats_);
+        stats_.works_   = 0;
+        stats_.batches_ = 0;
+        stats_.dropped_ = 0;
+        stats_.blocked_ = 0;
+        stats_.queue_us_.Reset();
+        stats_.handler_us_.Reset();
+        start_us_ = GetMonotonicMicroSecond();
+    }
+
+    bool Start();
+
+    void Stop();
+
+    /**
+     * @brief   Run by stage threads, pop a batch, handle it and pass it on
+     * @return  false if no work within PIPELINE_POP_WAIT_MS
+     */
+    bool RunBatch(vector<Work*>& works);
+
+private:
+    class StageThread : public Thread
+    {
+    public:
+        StageThread(PipelineStage* stage, const string& name)
+            : Thread(name)
+            , stage_(stage)
+        {
+        }
+
+    protected:
+        virtual uint32_t _Run()
+        {
+            vector<Work*> works;
+            while (!_Signalled())
+            {
+                stage_->RunBatch(works);
+            }
+            return 0;
+        }
+
+    private:
+        PipelineStage*  stage_;
+    };
+
+    Pipeline*                   pipeline_;
+    uint32_t                    index_;
+    PIPELINESTAGEFUNC           func_;
+    void*                       user_ptr_;
+    uint32_t                    batch_;
+    MpmcRing<Work*>             queue_;
+    list<StageThread*>          list_thread_;
+    Mutex                       mt_stats_;
+    PipelineStageStats          stats_;
+    uint64_t                    start_us_;
+};
+
+/**
+ * @brief   Pipeline of stages
+ *          Pipeline pipeline;
+ *          pipeline.AddStage("decode",   Decode,   NULL, 2, 32);
+ *          pipeline.AddStage("validate", Validate, NULL);
+ *          pipeline.AddStage("persist",  Persist,  NULL, 1, 128);
+ *          pipeline.Start();
+ *          pipeline.Submit(work);
+ */
+class Pipeline : private NonCopyable
+{
+public:
+    Pipeline()
+        : release_func_(NULL)
+        , release_ptr_(NULL)
+        , in_flight_(0)
+        , running_(false)
+    {
+    }
+
+    virtual ~Pipeline()
+    {
+        Stop(false);
+        for (size_t i = 0; i < vec_stage_.size(); i++)
+        {
+            Work* work = NULL;
+            while (vec_stage_[i]->TakeQueued(work))
+            {
+                _Release(work);
+            }
+            delete vec_stage_[i];
+        }
+    }
+
+    /**
+     * @brief   Add a stage after the last one, before Start
+     * @param   parallelism     Threads of the stage, works may leave it out of order if more than 1
+     * @param   batch           Most works given to one call of func
+     * @param   capacity        Works the input queue holds, rounded up to a power of 2
+     * @return  Index of stage
+     */
+    uint32_t AddStage(const string& name, PIPELINESTAGEFUNC func, void* user_ptr,
+                      uint32_t parallelism = 1, uint32_t batch = 1, uint32_t capacity = 1024)
+    {
+        uint32_t index = (uint32_t)vec_stage_.size();
+        vec_stage_.push_back(new PipelineStage(this, index, name, func, user_ptr, parallelism, batch, capacity));
+        return index;
+    }
+
+    void SetReleaseFunc(PIPELINERELEASEFUNC func, void* user_ptr)
+    {
+        release_func_ = func;
+        release_ptr_  = user_ptr;
+    }
+
+    bool Start()
+    {
+        if (running_ || vec_stage_.empty())
+        {
+            return false;
+        }
+        running_ = true;
+        for (size_t i = 0; i < vec_stage_.size(); i++)
+        {
+            if (!vec_stage_[i]->Start())
+            {
+                Stop(false);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief   Stop threads of all stages
+     * @param   drain   Wait until works submitted passed all stages first,
+     *                  else works still queued stay until restart or are released with the pipeline
+     */
+    void Stop(bool drain = true)
+    {
+        while (drain && running_ && 0 != RingLoad(in_flight_))
+        {
+#ifdef OS_WIN
+            Sleep(1);
+#else
+            usleep(1000);
+#endif
+        }
+        running_ = false;
+        for (size_t i = 0; i < vec_stage_.size(); i++)
+        {
+            vec_stage_[i]->Stop();
+        }
+    }
+
+    /**
+     * @brief   Submit a work to the first stage, the pipeline owns it then
+     * @param   timeout_ms  Time to wait while first stage is full, 0 for not waiting
+     * @return  false if pipeline is full or has no stage, the caller still owns the work
+     */
+    bool Submit(Work* work, uint32_t timeout_ms = 0xffffffff)
+    {
+        if (vec_stage_.empty())
+        {
+            return false;
+        }
+        RingAdd(in_flight_, 1);
+        if (!vec_stage_[0]->Push(work, timeout_ms))
+        {
+            RingAdd(in_flight_, -1);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief   Works submitted which have not left the pipeline
+     */
+    uint64_t InFlight() const
+    {
+        return (uint64_t)RingLoad(in_flight_);
+    }
+
+    void GetStats(vector<PipelineStageStats>& stats)
+    {
+        stats.resize(vec_stage_.size());
+        for (size_t i = 0; i < vec_stage_.size(); i++)
+        {
+            vec_stage_[i]->GetStats(stats[i]);
+        }
+    }
+
+    void ResetStats()
+    {
+        for (size_t i = 0; i < vec_stage_.size(); i++)
+        {
+            vec_stage_[i]->ResetStats();
+        }
+    }
+
+    /**
+     * @brief   One line of each stage
+     */
+    string Summary()
+    {
+        vector<PipelineStageStats> stats;
+        GetStats(stats);
+        string summary;
+        char   str[256];
+        for (size_t i = 0; i < stats.size(); i++)
+        {
+            sprintf(str, "%-16s x%u queued=%u/%u works=%llu dropped=%llu blocked=%llu %.0f/s\n",
+                    stats[i].name_.c_str(),
+                    stats[i].parallelism_,
+                    stats[i].queued_,
+                    stats[i].capacity_,
+                    (unsigned long long)stats[i].works_,
+                    (unsigned long long)stats[i].dropped_,
+                    (unsigned long long)stats[i].blocked_,
+                    stats[i].works_per_sec_);
+            summary += str;
+            summary += "  queue(us):   " + stats[i].queue_us_.Summary() + "\n";
+            summary += "  handler(us): " + stats[i].handler_us_.Summary() + "\n";
+        }
+        return summary;
+    }
+
+protected:
+    friend class PipelineStage;
+
+    /**
+     * @brief   Pass works handled by a stage on, waiting while next stage is full
+     */
+    void _Forward(uint32_t index, Work** works, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (NULL == works[i])
+            {
+                RingAdd(in_flight_, -1);
+            }
+            else if (index + 1 < vec_stage_.size())
+            {
+                // Wait in short slices, so a stopping pipeline never hangs on a stopped next stage
+                while (!vec_stage_[index + 1]->Push(works[i], PIPELINE_POP_WAIT_MS))
+                {
+                    if (!running_)
+                    {
+                        _Release(works[i]);
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                _Release(works[i]);
+            }
+        }
+    }
+
+    /**
+     * @brief   Give a work which passed the last stage or can not pass the pipeline any more
+     *          to the release func, delete it if not set
+     */
+    void _Release(Work* work)
+    {
+        RingAdd(in_flight_, -1);
+        if (NULL != release_func_)
+        {
+            release_func_(work, release_ptr_);
+        }
+        else
+        {
+            delete work;
+        }
+    }
+
+    vector<PipelineStage*>  vec_stage_;
+    PIPELINERELEASEFUNC     release_func_;
+    void*                   release_ptr_;
+    volatile int64_t        in_flight_;
+    volatile bool           running_;
+};
+
+inline
+bool PipelineStage::Start()
+{
+    ResetStats();
+    for (uint32_t i = 0; i < stats_.parallelism_; i++)
+    {
+        char name[32];
+        sprintf(name, "#%u", i);
+        StageThread* thread = new StageThread(this, "<pipeline " + stats_.name_ + name + ">");
+        list_thread_.push_back(thread);
+        if (!thread->Start())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline
+void PipelineStage::Stop()
+{
+    for (list<StageThread*>::iterator it = list_thread_.begin(); it != list_thread_.end(); it++)
+    {
+        (*it)->Signal();
+    }
+    for (list<StageThread*>::iterator it = list_thread_.begin(); it != list_thread_.end(); it++)
+    {
+        (*it)->Stop();
+        delete *it;
+    }
+    list_thread_.clear();
+}
+
+inline
+bool PipelineStage::RunBatch(vector<Work*>& works)
+{
+    works.resize(batch_);
+    uint32_t count = queue_.PopBatch(&works[0], batch_);
+    if (0 == count)
+    {
+        if (!queue_.Pop(works[0], PIPELINE_POP_WAIT_MS))
+        {
+            return false;
+        }
+        count = 1 + (batch_ > 1 ? queue_.PopBatch(&works[1], batch_ - 1) : 0);
+    }
+
+    // Time in queue is recorded before handler, which may delete works
+    uint64_t start_us = GetMonotonicMicroSecond();
+    {
+        MutexLock lock(mt_stats_);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            stats_.queue_us_.Record(start_us > works[i]->queue_us_ ? start_us - works[i]->queue_us_ : 0);
+        }
+    }
+
+    func_(&works[0], count, user_ptr_);
+
+    uint64_t end_us  = GetMonotonicMicroSecond();
+    uint32_t dropped = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        dropped += NULL == works[i] ? 1 : 0;
+    }
+    {
+        MutexLock lock(mt_stats_);
+        stats_.works_   += count;
+        stats_.batches_ += 1;
+        stats_.dropped_ += dropped;
+        stats_.handler_us_.Record(end_us - start_us);
+    }
+
+    pipeline_->_Forward(index_, &works[0], count);
+    return true;
+}
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_PIPELINE_H_
@@ -0,0 +1,803 @@
+/**
+ * @file    tools\ring_queue.h
+ * @brief   Bounded lock-free ring queues for passing values between threads
+ *          SpscRing        One producer, one consumer
+ *          MpscRing        Producers, one consumer
+ *          MpmcRing        Producers, consumers(Vyukov's bounded queue)
+ *          BroadcastRing   One producer, every consumer reads every value(disruptor)
+ *          Capacity is rounded up to a power of 2, values are copied in and out
+ *          Waiting threads spin, then yield(RINGWAIT_Spin) or sleep on an Event(RINGWAIT_Block)
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ * @update          2026-10-18      Blocked waiters sleep on an auto-reset Event
+ */
+
+#ifndef _LITE_RING_QUEUE_H_
+#define _LITE_RING_QUEUE_H_
+
+#include "base/lite_base.h"
+#include "base/noncopyable.h"
+#include "event/event.h"
+#include "tools/time_tool.h"
+
+#ifdef OS_WIN
+#include <windows.h>
+#include <intrin.h>
+#elif defined(OS_LINUX)
+#include <sched.h>
+#endif
+
+#define RING_CACHE_LINE     (64)
+#define RING_SPIN_ROUNDS    (256)               ///> Rounds of pause before yielding or blocking
+#define RING_BLOCK_WAIT_MS  (5)                 ///> Longest sleep of a blocked waiter, covers a Reset by another waiter
+
+namespace lite {
+
+/**
+ * @brief   Atomic operations of ring positions
+ */
+inline
+int64_t RingLoad(const volatile int64_t& value)
+{
+#ifdef OS_WIN
+#ifdef _WIN64
+    int64_t result = value;
+    _ReadWriteBarrier();
+    return result;
+#else
+    return InterlockedCompareExchange64((volatile LONG64*)&value, 0, 0);
+#endif
+#else
+    return __atomic_load_n(&value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline
+void RingStore(volatile int64_t& value, int64_t desired)
+{
+#ifdef OS_WIN
+#ifdef _WIN64
+    _ReadWriteBarrier();
+    value = desired;
+#else
+    InterlockedExchange64((volatile LONG64*)&value, desired);
+#endif
+#else
+    __atomic_store_n(&value, desired, __ATOMIC_RELEASE);
+#endif
+}
+
+inline
+bool RingCas(volatile int64_t& value, int64_t expected, int64_t desired)
+{
+#ifdef OS_WIN
+    return expected == InterlockedCompareExchange64((volatile LONG64*)&value, desired, expected);
+#else
+    return __sync_bool_compare_and_swap(&value, expected, desired);
+#endif
+}
+
+inline
+int64_t RingAdd(volatile int64_t& value, int64_t delta)
+{
+#ifdef OS_WIN
+    return InterlockedExchangeAdd64((volatile LONG64*)&value, delta) + delta;
+#else
+    return __sync_add_and_fetch(&value, delta);
+#endif
+}
+
+inline
+void RingFence()
+{
+#ifdef OS_WIN
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+inline
+void RingPause()
+{
+#ifdef OS_WIN
+    YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+inline
+void RingYield()
+{
+#ifdef OS_WIN
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+inline
+uint32_t RingCapacity(uint32_t capacity)
+{
+    uint32_t power = 2;
+    while (power < capacity && power < 0x80000000)
+    {
+        power <<= 1;
+    }
+    return power;
+}
+
+/**
+ * @brief   Position on its own cache line, so producer and consumer do not invalidate each other
+ */
+struct RingCursor
+{
+    volatile int64_t    value_;
+    char                pad_[RING_CACHE_LINE - sizeof(int64_t)];
+
+    RingCursor()
+        : value_(0)
+    {
+    }
+};
+
+typedef enum
+{
+    RINGWAIT_Spin = 0,                          ///> Pause, then yield the processor, lowest latency
+    RINGWAIT_Block,                             ///> Pause, then sleep until notified
+}RINGWAIT;
+
+/**
+ * @brief   Wait strategy of one side of a queue(e.g. consumers waiting for values)
+ *          Waiting thread:     for (round = 0; !TryPop(value); round++) { if (!waiter.Idle(round, deadline)) break; }
+ *                              waiter.Done(round);     // Calls of Idle which returned true
+ *          Other side:         waiter.Notify() after the queue changed
+ */
+class RingWaiter : private NonCopyable
+{
+public:
+    RingWaiter(RINGWAIT mode = RINGWAIT_Block)
+        : mode_(mode)
+        , waiters_(0)
+        , event_(false)
+    {
+    }
+
+    /**
+     * @brief   Wait a little, the caller checks the queue again after it
+     * @param   round       Times called in this wait, from 0
+     * @param   deadline_us GetMonotonicMicroSecond time to give up, 0 for never
+     * @return  false if deadline passed
+     */
+    bool Idle(uint32_t round, uint64_t deadline_us)
+    {
+        if (round < RING_SPIN_ROUNDS)
+        {
+            RingPause();
+            return true;
+        }
+
+        uint64_t now = 0 == deadline_us ? 0 : GetMonotonicMicroSecond();
+        if (0 != deadline_us && now >= deadline_us)
+        {
+            return false;
+        }
+        if (RINGWAIT_Spin == mode_)
+        {
+            RingYield();
+        }
+        else if (RING_SPIN_ROUNDS == round)
+        {
+            // Announce the waiter first, then the caller checks again, so a Notify is not missed.
+            // A signal left from an earlier Notify only costs one more check
+            RingAdd(waiters_, 1);
+        }
+        else
+        {
+            uint64_t wait_ms = 0 == deadline_us ? RING_BLOCK_WAIT_MS : (deadline_us - now + 999) / 1000;
+            event_.Wait((uint32_t)(wait_ms > RING_BLOCK_WAIT_MS ? RING_BLOCK_WAIT_MS : wait_ms));
+        }
+        return true;
+    }
+
+    /**
+     * @brief   End a wait
+     * @param   rounds  Calls of Idle which returned true, the waiter was announced if more than RING_SPIN_ROUNDS
+     */
+    void Done(uint32_t rounds)
+    {
+        if (RINGWAIT_Block == mode_ && rounds > RING_SPIN_ROUNDS)
+        {
+            // One Notify wakes one waiter, pass the wake on since a batch may have left values for others
+            if (RingAdd(waiters_, -1) > 0)
+            {
+                event_.Signal();
+            }
+        }
+    }
+
+    /**
+     * @brief   Wake one waiting thread, cheap if none is blocked
+     *          The event resets when a waiter wakes, so waiters which lose the value to another thread
+     *          sleep again instead of spinning on a signaled event
+     */
+    void Notify()
+    {
+        if (RINGWAIT_Block != mode_)
+        {
+            return;
+        }
+        // The change of the queue must be visible before waiters_ is read, pairs with RingAdd in Idle
+        RingFence();
+        if (0 != RingLoad(waiters_))
+        {
+            event_.Signal();
+        }
+    }
+
+private:
+    RINGWAIT            mode_;
+    volatile int64_t    waiters_;
+    Event               event_;
+};
+
+inline
+uint64_t RingDeadline(uint32_t timeout_ms)
+{
+    return 0xffffffff == timeout_ms ? 0 : GetMonotonicMicroSecond() + (uint64_t)timeout_ms * 1000 + 1;
+}
+
+/**
+ * @brief   Single producer single consumer ring
+ *          Each side caches the position of the other, so it is read again only when the ring looks full or empty
+ */
+template <typename T>
+class SpscRing : private NonCopyable
+{
+public:
+    SpscRing(uint32_t capacity, RINGWAIT mode = RINGWAIT_Block)
+        : capacity_(RingCapacity(capacity))
+        , mask_(capacity_ - 1)
+        , buffer_(capacity_)
+        , not_empty_(mode)
+        , not_full_(mode)
+    {
+        head_cache_.value_ = 0;
+        tail_cache_.value_ = 0;
+    }
+
+    uint32_t Capacity() const
+    {
+        return capacity_;
+    }
+
+    uint32_t Size() const
+    {
+        return (uint32_t)(RingLoad(tail_.value_) - RingLoad(head_.value_));
+    }
+
+    /**
+     * @brief   Push values without waiting, called by producer only
+     * @return  Values pushed, less than count if ring is full
+     */
+    uint32_t PushBatch(const T* values, uint32_t count)
+    {
+        int64_t tail = tail_.value_;
+        if (tail + count - head_cache_.value_ > capacity_)
+        {
+            head_cache_.value_ = RingLoad(head_.value_);
+        }
+        int64_t free = capacity_ - (tail - head_cache_.value_);
+        count        = count > free ? (uint32_t)free : count;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            buffer_[(tail + i) & mask_] = values[i];
+        }
+        if (0 != count)
+        {
+            RingStore(tail_.value_, tail + count);
+            not_empty_.Notify();
+        }
+        return count;
+    }
+
+    /**
+     * @brief   Pop values without waiting, called by consumer only
+     * @return  Values popped
+     */
+    uint32_t PopBatch(T* values, uint32_t max_count)
+    {
+        int64_t head = head_.value_;
+        if (tail_cache_.value_ - head < max_count)
+        {
+            tail_cache_.value_ = RingLoad(tail_.value_);
+        }
+        int64_t  avail = tail_cache_.value_ - head;
+        uint32_t count = max_count > avail ? (uint32_t)avail : max_count;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            values[i] = buffer_[(head + i) & mask_];
+        }
+        if (0 != count)
+        {
+            RingStore(head_.value_, head + count);
+            not_full_.Notify();
+        }
+        return count;
+    }
+
+    bool TryPush(const T& value)
+    {
+        return 1 == PushBatch(&value, 1);
+    }
+
+    bool TryPop(T& value)
+    {
+        return 1 == PopBatch(&value, 1);
+    }
+
+    /**
+     * @brief   Push, waiting while ring is full
+     * @return  false if timeout
+     */
+    bool Push(const T& value, uint32_t timeout_ms = 0xffffffff)
+    {
+        return _Wait(not_full_, &SpscRing::TryPush, value, timeout_ms);
+    }
+
+    /**
+     * @brief   Pop, waiting while ring is empty
+     * @return  false if timeout
+     */
+    bool Pop(T& value, uint32_t timeout_ms = 0xffffffff)
+    {
+        return _Wait(not_empty_, &SpscRing::TryPop, value, timeout_ms);
+    }
+
+private:
+    template <typename F, typename V>
+    bool _Wait(RingWaiter& waiter, F func, V& value, uint32_t timeout_ms)
+    {
+        uint64_t deadline = 0;
+        uint32_t round    = 0;
+        bool     ok       = true;
+        while (!(this->*func)(value))
+        {
+            if (RING_SPIN_ROUNDS == round && 0 == deadline)
+            {
+                deadline = RingDeadline(timeout_ms);
+            }
+            if (!(ok = waiter.Idle(round, deadline)))
+            {
+                break;
+            }
+            round++;
+        }
+        waiter.Done(round);
+        return ok;
+    }
+
+    const uint32_t  capacity_;
+    const int64_t   mask_;
+    vector<T>       buffer_;
+    RingCursor      head_;                      ///> Next position to pop, written by consumer
+    RingCursor      tail_cache_;                ///> Consumer copy of tail_
+    RingCursor      tail_;                      ///> Next position to push, written by producer
+    RingCursor      head_cache_;                ///> Producer copy of head_
+    RingWaiter      not_empty_;
+    RingWaiter      not_full_;
+};
+
+/**
+ * @brief   Ring with a sequence number in each cell(Vyukov), base of MpscRing and MpmcRing
+ *          A cell is free for position pos when its sequence is pos, and full when pos + 1
+ * @param   MULTI_CONSUMER  false if only one thread pops, popping needs no CAS then
+ */
+template <typename T, bool MULTI_CONSUMER>
+class SequenceRing : private NonCopyable
+{
+public:
+    SequenceRing(uint32_t capacity, RINGWAIT mode)
+        : capacity_(RingCapacity(capacity))
+        , mask_(capacity_ - 1)
+        , cells_(capacity_)
+        , not_empty_(mode)
+        , not_full_(mode)
+    {
+        for (uint32_t i = 0; i < capacity_; i++)
+        {
+            cells_[i].seq_ = i;
+        }
+    }
+
+    uint32_t Capacity() const
+    {
+        return capacity_;
+    }
+
+    /**
+     * @brief   Values in ring, approximate while other threads push or pop
+     */
+    uint32_t Size() const
+    {
+        int64_t size = RingLoad(tail_.value_) - RingLoad(head_.value_);
+        return size < 0 ? 0 : (uint32_t)size;
+    }
+
+    bool TryPush(const T& value)
+    {
+        if (!_Push(value))
+        {
+            return false;
+        }
+        not_empty_.Notify();
+        return true;
+    }
+
+    bool TryPop(T& value)
+    {
+        if (!_Pop(value))
+        {
+            return false;
+        }
+        not_full_.Notify();
+        return true;
+    }
+
+    /**
+     * @brief   Push values without waiting, each value claims its cell,
+     *          so values of other producers may be between them
+     * @return  Values pushed
+     */
+    uint32_t PushBatch(const T* values, uint32_t count)
+    {
+        uint32_t pushed = 0;
+        while (pushed < count && _Push(values[pushed]))
+        {
+            pushed++;
+        }
+        if (0 != pushed)
+        {
+            not_empty_.Notify();
+        }
+        return pushed;
+    }
+
+    /**
+     * @brief   Pop values without waiting
+     * @return  Values popped
+     */
+    uint32_t PopBatch(T* values, uint32_t max_count)
+    {
+        uint32_t popped = 0;
+        while (popped < max_count && _Pop(values[popped]))
+        {
+            popped++;
+        }
+        if (0 != popped)
+        {
+            not_full_.Notify();
+        }
+        return popped;
+    }
+
+    bool Push(const T& value, uint32_t timeout_ms = 0xffffffff)
+    {
+        return _Wait(not_full_, &SequenceRing::TryPush, value, timeout_ms);
+    }
+
+    bool Pop(T& value, uint32_t timeout_ms = 0xffffffff)
+    {
+        return _Wait(not_empty_, &SequenceRing::TryPop, value, timeout_ms);
+    }
+
+private:
+    struct Cell
+    {
+        volatile int64_t    seq_;
+        T                   value_;
+    };
+
+    bool _Push(const T& value)
+    {
+        int64_t pos = RingLoad(tail_.value_);
+        while (true)
+        {
+            Cell&   cell = cells_[pos & mask_];
+            int64_t diff = RingLoad(cell.seq_) - pos;
+            if (0 == diff)
+            {
+                if (RingCas(tail_.value_, pos, pos + 1))
+                {
+                    cell.value_ = value;
+                    RingStore(cell.seq_, pos + 1);
+                    return true;
+                }
+                pos = RingLoad(tail_.value_);
+            }
+            else if (diff < 0)
+            {
+                return false;                   // Full
+            }
+            else
+            {
+                pos = RingLoad(tail_.value_);   // Taken by another producer
+            }
+        }
+    }
+
+    bool _Pop(T& value)
+    {
+        int64_t pos = RingLoad(head_.value_);
+        while (true)
+        {
+            Cell&   cell = cells_[pos & mask_];
+            int64_t diff = RingLoad(cell.seq_) - (pos + 1);
+            if (0 == diff)
+            {
+                if (!MULTI_CONSUMER)
+                {
+                    RingStore(head_.value_, pos + 1);
+                }
+                else if (!RingCas(head_.value_, pos, pos + 1))
+                {
+                    pos = RingLoad(head_.value_);
+                    continue;
+                }
+                value = cell.value_;
+                RingStore(cell.seq_, pos + capacity_);
+                return true;
+            }
+            else if (diff < 0)
+            {
+                return false;                   // Empty
+            }
+            else
+            {
+                pos = RingLoad(head_.value_);   // Taken by another consumer
+            }
+        }
+    }
+
+    template <typename F, typename V>
+    bool _Wait(RingWaiter& waiter, F func, V& value, uint32_t timeout_ms)
+    {
+        uint64_t deadline = 0;
+        uint32_t round    = 0;
+        bool     ok       = true;
+        while (!(this->*func)(value))
+        {
+            if (RING_SPIN_ROUNDS == round && 0 == deadline)
+            {
+                deadline = RingDeadline(timeout_ms);
+            }
+            if (!(ok = waiter.Idle(round, deadline)))
+            {
+                break;
+            }
+            round++;
+        }
+        waiter.Done(round);
+        return ok;
+    }
+
+    const uint32_t  capacity_;
+    const int64_t   mask_;
+    vector<Cell>    cells_;
+    RingCursor      head_;
+    RingCursor      tail_;
+    RingWaiter      not_empty_;
+    RingWaiter      not_full_;
+};
+
+template <typename T>
+class MpscRing : public SequenceRing<T, false>
+{
+public:
+    MpscRing(uint32_t capacity, RINGWAIT mode = RINGWAIT_Block)
+        : SequenceRing<T, false>(capacity, mode)
+    {
+    }
+};
+
+template <typename T>
+class MpmcRing : public SequenceRing<T, true>
+{
+public:
+    MpmcRing(uint32_t capacity, RINGWAIT mode = RINGWAIT_Block)
+        : SequenceRing<T, true>(capacity, mode)
+    {
+    }
+};
+
+/**
+ * @brief   Single producer ring read by a fixed number of consumers, each reads every value
+ *          The producer waits for the slowest consumer when the ring is full
+ *          Put MpscRing in front of it for several producers
+ */
+template <typename T>
+class BroadcastRing : private NonCopyable
+{
+public:
+    /**
+     * @param   consumers   Number of consumers, identified by 0 to consumers - 1
+     */
+    BroadcastRing(uint32_t capacity, uint32_t consumers, RINGWAIT mode = RINGWAIT_Block)
+        : capacity_(RingCapacity(capacity))
+        , mask_(capacity_ - 1)
+        , buffer_(capacity_)
+        , cursors_(0 == consumers ? 1 : consumers)
+        , not_full_(mode)
+    {
+        min_cache_.value_ = 0;
+        for (size_t i = 0; i < cursors_.size(); i++)
+        {
+            vec_not_empty_.push_back(new RingWaiter(mode));
+        }
+    }
+
+    ~BroadcastRing()
+    {
+        for (size_t i = 0; i < vec_not_empty_.size(); i++)
+        {
+            delete vec_not_empty_[i];
+        }
+    }
+
+    uint32_t Capacity() const
+    {
+        return capacity_;
+    }
+
+    uint32_t Consumers() const
+    {
+        return (uint32_t)cursors_.size();
+    }
+
+    /**
+     * @brief   Values not read yet by a consumer
+     */
+    uint32_t Pending(uint32_t consumer) const
+    {
+        return (uint32_t)(RingLoad(published_.value_) - RingLoad(cursors_[consumer].value_));
+    }
+
+    /**
+     * @brief   Publish values without waiting, called by producer only
+     * @return  Values published, less than count if the slowest consumer is a ring behind
+     */
+    uint32_t PublishBatch(const T* values, uint32_t count)
+    {
+        int64_t pos = published_.value_;
+        if (pos + count - min_cache_.value_ > capacity_)
+        {
+            min_cache_.value_ = _MinCursor();
+        }
+        int64_t free = capacity_ - (pos - min_cache_.value_);
+        count        = count > free ? (uint32_t)free : count;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            buffer_[(pos + i) & mask_] = values[i];
+        }
+        if (0 != count)
+        {
+            RingStore(published_.value_, pos + count);
+            for (size_t i = 0; i < vec_not_empty_.size(); i++)
+            {
+                vec_not_empty_[i]->Notify();
+            }
+        }
+        return count;
+    }
+
+    /**
+     * @brief   Read values without waiting, each consumer is called by one thread only
+     * @return  Values read
+     */
+    uint32_t ReadBatch(uint32_t consumer, T* values, uint32_t max_count)
+    {
+        RingCursor& cursor = cursors_[consumer];
+        int64_t     pos    = cursor.value_;
+        int64_t     avail  = RingLoad(published_.value_) - pos;
+        uint32_t    count  = max_count > avail ? (uint32_t)avail : max_count;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            values[i] = buffer_[(pos + i) & mask_];
+        }
+        if (0 != count)
+        {
+            RingStore(cursor.value_, pos + count);
+            not_full_.Notify();
+        }
+        return count;
+    }
+
+    bool TryPublish(const T& value)
+    {
+        return 1 == PublishBatch(&value, 1);
+    }
+
+    bool TryRead(uint32_t consumer, T& value)
+    {
+        return 1 == ReadBatch(consumer, &value, 1);
+    }
+
+    /**
+     * @brief   Publish, waiting while the slowest consumer is a ring behind
+     * @return  false if timeout
+     */
+    bool Publish(const T& value, uint32_t timeout_ms = 0xffffffff)
+    {
+        uint64_t deadline = 0;
+        uint32_t round    = 0;
+        bool     ok       = true;
+        while (!TryPublish(value))
+        {
+            if (RING_SPIN_ROUNDS == round && 0 == deadline)
+            {
+                deadline = RingDeadline(timeout_ms);
+            }
+            if (!(ok = not_full_.Idle(round, deadline)))
+            {
+                break;
+            }
+            round++;
+        }
+        not_full_.Done(round);
+        return ok;
+    }
+
+    /**
+     * @brief   Read, waiting while nothing new is published
+     * @return  false if timeout
+     */
+    bool Read(uint32_t consumer, T& value, uint32_t timeout_ms = 0xffffffff)
+    {
+        RingWaiter& not_empty = *vec_not_empty_[consumer];
+        uint64_t    deadline  = 0;
+        uint32_t round    = 0;
+        bool     ok       = true;
+        while (!TryRead(consumer, value))
+        {
+            if (RING_SPIN_ROUNDS == round && 0 == deadline)
+            {
+                deadline = RingDeadline(timeout_ms);
+            }
+            if (!(ok = not_empty.Idle(round, deadline)))
+            {
+                break;
+            }
+            round++;
+        }
+        not_empty.Done(round);
+        return ok;
+    }
+
+private:
+    int64_t _MinCursor() const
+    {
+        int64_t min = RingLoad(cursors_[0].value_);
+        for (size_t i = 1; i < cursors_.size(); i++)
+        {
+            int64_t pos = RingLoad(cursors_[i].value_);
+            min = pos < min ? pos : min;
+        }
+        return min;
+    }
+
+    const uint32_t      capacity_;
+    const int64_t       mask_;
+    vector<T>           buffer_;
+    RingCursor          published_;             ///> Values published, written by producer
+    RingCursor          min_cache_;             ///> Producer copy of slowest cursor
+    vector<RingCursor>  cursors_;               ///> Next position of each consumer
+    vector<RingWaiter*> vec_not_empty_;         ///> Waiter of each consumer, so a consumer never resets the event of another
+    RingWaiter          not_full_;
+};
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_RING_QUEUE_H_
@@ -0,0 +1,155 @@
+/**
+ * @file    tools\sha1.h
+ * @brief   SHA-1 message digest(RFC 3174)
+ * @author  Nik Yan
+ * @version 1.0     2026-10-18
+ */
+
+#ifndef _LITE_SHA1_H_
+#define _LITE_SHA1_H_
+
+#include "base/lite_base.h"
+#include <string.h>
+
+namespace lite {
+
+#define SHA1_DIGEST_SIZE    (20)
+
+class Sha1
+{
+public:
+    Sha1()
+    {
+        Reset();
+    }
+
+    void Reset()
+    {
+        state_[0] = 0x67452301;
+        state_[1] = 0xEFCDAB89;
+        state_[2] = 0x98BADCFE;
+        state_[3] = 0x10325476;
+        state_[4] = 0xC3D2E1F0;
+        total_len_ = 0;
+        block_len_ = 0;
+    }
+
+    /**
+     * @brief   Add data to digest
+     */
+    void Update(const void* data, uint32_t size)
+    {
+        const uint8_t* p = (const uint8_t*)data;
+        total_len_ += size;
+        while (size > 0)
+        {
+            uint32_t n = 64 - block_len_;
+            if (n > size)
+            {
+                n = size;
+            }
+            memcpy(block_ + block_len_, p, n);
+            block_len_ += n;
+            p          += n;
+            size       -= n;
+            if (64 == block_len_)
+            {
+                _Transform(block_);
+                block_len_ = 0;
+            }
+        }
+    }
+
+    /**
+     * @brief   Finish digest, the object needs Reset before reuse
+     */
+    void Final(uint8_t digest[SHA1_DIGEST_SIZE])
+    {
+        uint64_t bit_len = total_len_ * 8;
+        uint8_t  pad     = 0x80;
+        Update(&pad, 1);
+        pad = 0;
+        while (56 != block_len_)
+        {
+            Update(&pad, 1);
+        }
+        uint8_t len_buf[8];
+        for (int i = 0; i < 8; i++)
+        {
+            len_buf[i] = (uint8_t)(bit_len >> (56 - 8 * i));
+        }
+        Update(len_buf, 8);
+        for (int i = 0; i < SHA1_DIGEST_SIZE; i++)
+        {
+            digest[i] = (uint8_t)(state_[i >> 2] >> (24 - 8 * (i & 3)));
+        }
+    }
+
+private:
+    static uint32_t _Rol(uint32_t v, int bits)
+    {
+        return (v << bits) | (v >> (32 - bits));
+    }
+
+    void _Transform(const uint8_t* block)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++)
+        {
+            w[i] = ((uint32_t)block[4*i] << 24) | ((uint32_t)block[4*i+1] << 16) |
+                   ((uint32_t)block[4*i+2] << 8) | (uint32_t)block[4*i+3];
+        }
+        for (int i = 16; i < 80; i++)
+        {
+            w[i] = _Rol(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+        }
+
+        uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3], e = state_[4];
+        for (int i = 0; i < 80; i++)
+        {
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = _Rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = _Rol(b, 30);
+            b = a;
+            a = t;
+        }
+        state_[0] += a;
+        state_[1] += b;
+        state_[2] += c;
+        state_[3] += d;
+        state_[4] += e;
+    }
+
+    uint32_t    state_[5];
+    uint8_t     block_[64];
+    uint32_t    block_len_;
+    uint64_t    total_len_;
+};
+
+} // end of namespace lite
+
+using namespace lite;
+
+#endif // ifndef _LITE_SHA1_H_
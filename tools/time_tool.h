@@ -3,6 +3,9 @@
  * @brief   Encapsulation that operations on time
  * @author  Nik Yan
  * @version 1.0     2014-07-01
+ * @update          2026-10-18      Add monotonic clock in microseconds
+ *                                  Add monotonic clock in nanoseconds
+ *                                  Fix linux build of GetCurDataTime
  */
 
 #ifndef _LITE_TIME_TOOL_H_
@@ -144,7 +147,7 @@ Time GetCurDataTime()
     cur_time.year_         = t.tm_year + 1900;
     cur_time.month_        = t.tm_mon + 1;
     cur_time.day_          = t.tm_mday;
-    cur_time.uHou          = t.tm_hour;
+    cur_time.hour_         = t.tm_hour;
     cur_time.minute_       = t.tm_min;
     cur_time.second_       = t.tm_sec;
     cur_time.milli_second_ = 0;
@@ -153,6 +156,53 @@ Time GetCurDataTime()
     return cur_time;
 }
 
+/**
+ * @brief   Get monotonic time in microseconds, for measuring intervals only
+ */
+inline
+uint64_t GetMonotonicMicroSecond()
+{
+#ifdef OS_WIN
+    static LARGE_INTEGER freq = {0};
+    if (0 == freq.QuadPart)
+    {
+        QueryPerformanceFrequency(&freq);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / freq.QuadPart * 1000000 +
+                      counter.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+#elif defined(OS_LINUX)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * @brief   Get monotonic time in nanoseconds, for measuring short intervals only
+ *          Resolution is the performance counter period on windows(typically 100ns)
+ */
+inline
+uint64_t GetMonotonicNanoSecond()
+{
+#ifdef OS_WIN
+    static LARGE_INTEGER freq = {0};
+    if (0 == freq.QuadPart)
+    {
+        QueryPerformanceFrequency(&freq);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / freq.QuadPart * 1000000000 +
+                      counter.QuadPart % freq.QuadPart * 1000000000 / freq.QuadPart);
+#elif defined(OS_LINUX)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
 /**
  * @brief   Get Date Time string(Format: yyyy-mm-dd hh-MM-ss)
  */
@@ -3,6 +3,10 @@
  * @brief   Encapsulation for work queue
  * @author  Nik Yan
  * @version 1.0     2014-07-02
+ * @update          2026-10-18      Add latency breakdown of queueing and handler time
+ *                                  Bug free for QueueWork
+ *                                  Add allocation scope
+ *                                  Work is defined for linux too
  */
 
 #ifndef _LITE_WORK_QUEUE_H_
@@ -12,11 +16,12 @@
 #include "event/mutex_lock.h"
 #include "event/thread.h"
 #include "byte_stream.h"
+#include "time_tool.h"
+#include "latency_breakdown.h"
+#include "alloc_tracker.h"
 
 namespace lite {
 
-#ifdef OS_WIN
-
 struct Work;
 
 /**
@@ -34,12 +39,16 @@ struct Work
     ByteStream  user_buffer_;
     work_func_t work_func_;
     Thread*     thread_;
+    uint64_t    recv_us_;                   ///> Kernel receive time of the message, 0 if unknown
+    uint64_t    queue_us_;                  ///> Time queued, set by QueueWork if latency breakdown is on
 
     Work() 
         : user_ptr_(NULL)
         , user_data_(NULL)
         , work_func_(NULL)
         , thread_(NULL)
+        , recv_us_(0)
+        , queue_us_(0)
     {
     }
     Work(void* user_data) 
@@ -47,6 +56,8 @@ struct Work
         , user_data_(user_data)
         , work_func_(NULL)
         , thread_(NULL)
+        , recv_us_(0)
+        , queue_us_(0)
     {
     }
     Work(uint8_t* buffer, uint32_t size) 
@@ -54,6 +65,8 @@ struct Work
         , user_data_(NULL)
         , work_func_(NULL)
         , thread_(NULL)
+        , recv_us_(0)
+        , queue_us_(0)
     {
         user_buffer_.Add(buffer,size);
     }
@@ -74,10 +87,14 @@ struct Work
         user_buffer_   = src.user_buffer_;
         work_func_     = src.work_func_;
         thread_        = src.thread_;
+        recv_us_       = src.recv_us_;
+        queue_us_      = src.queue_us_;
         return *this;
     }
 };
 
+#ifdef OS_WIN
+
 class WorkQueue : public Thread
 {
 public:
@@ -86,6 +103,7 @@ public:
         : default_work_func_(NULL)
         , is_working_(false)
         , current_work_(NULL)
+        , breakdown_(NULL)
     {
     }
 
@@ -117,10 +135,15 @@ public:
      */
     void QueueWork(Work* work)
     {
+        LITE_ALLOC_SCOPE("work_queue.queue");
         MutexLock lock(list_mutex_);
         work->thread_ = this;
+        if (NULL != breakdown_)
+        {
+            work->queue_us_ = GetMonotonicMicroSecond();
+        }
         work_list_.push_back(work);
-        list<Work*>::iterator it = work_list.end();
+        list<Work*>::iterator it = work_list_.end();
         work_map_.insert(std::make_pair(work, --it));
         queue_event_.Signal();
     }
@@ -176,6 +199,16 @@ public:
         return default_work_func_;
     }
 
+    /**
+     * @brief   Record kernel-to-user(if Work::recv_us_ is set), queueing and handler time of works
+     * @param   breakdown   NULL to stop recording
+     */
+    void SetLatencyBreakdown(LatencyBreakdown* breakdown)
+    {
+        MutexLock lock(list_mutex_);
+        breakdown_ = breakdown;
+    }
+
 protected:
 
     uint32_t _Run();
@@ -187,6 +220,7 @@ protected:
     work_func_t                         default_work_func_;
     bool                                is_working_;
     Work*                               current_work_;
+    LatencyBreakdown*                   breakdown_;
 };
 
 inline
@@ -203,6 +237,9 @@ uint32_t WorkQueue::_Run()
         while (!_Signalled())
         {
             // Get work from queue
+            LatencyBreakdown* breakdown = NULL;
+            uint64_t          recv_us   = 0;
+            uint64_t          queue_us  = 0;
             {
                 MutexLock lock(list_mutex_);
                 if (work_list_.empty())
@@ -219,8 +256,17 @@ uint32_t WorkQueue::_Run()
                 {
                     work_map_.erase(it);
                 }
+                if (NULL != breakdown_ && 0 != current_work_->queue_us_)
+                {
+                    breakdown = breakdown_;
+                    recv_us   = current_work_->recv_us_;
+                    queue_us  = current_work_->queue_us_;
+                }
             }
             
+            // Work may be deleted by its function, times are copied before
+            uint64_t start_us = NULL == breakdown ? 0 : GetMonotonicMicroSecond();
+
             // Execute work function
             if (current_work_->work_func_ != NULL)
             {
@@ -230,6 +276,10 @@ uint32_t WorkQueue::_Run()
             {
                 default_work_func_(current_work_);
             }
+            if (NULL != breakdown)
+            {
+                breakdown->Record(recv_us, queue_us, start_us, GetMonotonicMicroSecond());
+            }
 
             {
                 MutexLock lock(list_mutex_);